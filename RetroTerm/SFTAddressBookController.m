@@ -23,10 +23,14 @@
 #import "SFTAddressBookController.h"
 #import "SFTAddressBookEntry+CoreDataClass.h"
 #import "SFTAddressBookSerialiser.h"
+#import "SFTCommon.h"
 #import "SFTDataController.h"
 #import "SFTDataToImageTransformer.h"
 #import "SFTDocument.h"
 #import "SFTQuickConnectWindowController.h"
+#import "SFTTerminalEmulatorContext.h"
+
+#import "SFTCoreThumbnail.h"
 
 typedef NS_ENUM(NSUInteger, SFTActionSegmentIndex) {
   SFTActionSegmentIndexAdd = 0,
@@ -55,6 +59,7 @@ typedef NS_ENUM(NSUInteger, SFTActionSegmentIndex) {
 - (IBAction)doubleActionOnRow:(id)sender;
 - (IBAction)importAddressBookEntries:(id)sender;
 - (IBAction)exportAddressBookEntries:(id)sender;
+- (IBAction)refreshThumbnailsFromCaptures:(id)sender;
 - (IBAction)quickConnect:(id)sender;
 
 @end
@@ -318,6 +323,105 @@ typedef NS_ENUM(NSUInteger, SFTActionSegmentIndex) {
                 }];
 }
 
+/**
+ * Finds the most recent session capture for each host in the capture
+ * directory, captures being named after the host they were recorded from.
+ */
+- (nonnull NSDictionary<NSString *, NSURL *> *)latestCaptures {
+  NSString *directory = [NSUserDefaults.standardUserDefaults
+      stringForKey:SFTSessionCaptureDirectoryKey];
+  if (directory.length == 0) {
+    return @{};
+  }
+
+  NSArray<NSURL *> *urls = [NSFileManager.defaultManager
+        contentsOfDirectoryAtURL:
+            [NSURL fileURLWithPath:directory.stringByExpandingTildeInPath
+                       isDirectory:YES]
+      includingPropertiesForKeys:@[ NSURLContentModificationDateKey ]
+                         options:NSDirectoryEnumerationSkipsHiddenFiles
+                           error:nil];
+
+  NSMutableDictionary<NSString *, NSURL *> *captures =
+      [NSMutableDictionary new];
+  NSMutableDictionary<NSString *, NSDate *> *dates =
+      [NSMutableDictionary new];
+  for (NSURL *url in urls) {
+    if (![url.pathExtension isEqualToString:@"sftcapture"]) {
+      continue;
+    }
+
+    NSString *host =
+        [url.lastPathComponent componentsSeparatedByString:@" "].firstObject;
+    NSDate *date;
+    [url getResourceValue:&date
+                   forKey:NSURLContentModificationDateKey
+                    error:nil];
+    if ((date != nil) && ((dates[host] == nil) ||
+                          ([dates[host] compare:date] == NSOrderedAscending))) {
+      captures[host] = url;
+      dates[host] = date;
+    }
+  }
+
+  return captures;
+}
+
+- (IBAction)refreshThumbnailsFromCaptures:(id)sender {
+  NSDictionary<NSString *, NSURL *> *captures = [self latestCaptures];
+
+  NSMutableArray<SFTAddressBookEntry *> *entries = [NSMutableArray new];
+  NSMutableArray<NSURL *> *urls = [NSMutableArray new];
+  for (SFTAddressBookEntry *entry in self.entriesArrayController
+           .arrangedObjects) {
+    NSURL *capture =
+        entry.address.host != nil ? captures[entry.address.host] : nil;
+    if (capture != nil) {
+      [entries addObject:entry];
+      [urls addObject:capture];
+    }
+  }
+
+  if (entries.count == 0) {
+    NSBeep();
+    return;
+  }
+
+  // Screens are rebuilt as a new connection would, with the cursor hidden.
+  NSUInteger count = entries.count;
+  NSMutableData *jobs =
+      [NSMutableData dataWithLength:count * sizeof(SFTCoreThumbnailJob)];
+  SFTCoreThumbnailJob *job = (SFTCoreThumbnailJob *)jobs.mutableBytes;
+  for (NSUInteger index = 0; index < count; index++) {
+    job[index] = (SFTCoreThumbnailJob){
+        .path = strdup(urls[index].fileSystemRepresentation),
+        .width = SFTTerminalEmulatorContext.preferredWidth,
+        .height = SFTTerminalEmulatorContext.preferredHeight,
+        .background = SFTC64ColourBlack,
+        .foreground = SFTC64ColourLightBlue,
+        .asciiMode = true,
+        .scale = SFTEntryThumbnailScale};
+  }
+
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+    SFTCoreThumbnailRenderBatch((SFTCoreThumbnailJob *)jobs.mutableBytes,
+                                count, 0);
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+      SFTCoreThumbnailJob *finished = (SFTCoreThumbnailJob *)jobs.mutableBytes;
+      for (NSUInteger index = 0; index < count; index++) {
+        free((void *)finished[index].path);
+        if (finished[index].png != NULL) {
+          entries[index].image =
+              [NSData dataWithBytesNoCopy:finished[index].png
+                                   length:finished[index].pngLength
+                             freeWhenDone:YES];
+        }
+      }
+    });
+  });
+}
+
 - (IBAction)quickConnect:(id)sender {
   __weak SFTAddressBookWindowController *weakSelf = self;
   [self.window
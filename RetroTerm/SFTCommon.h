@@ -28,10 +28,6 @@ extern NSExceptionName SFTInternalErrorException;
 
 extern NSErrorDomain SFTErrorDomain;
 
-extern const NSUInteger SFTViewColumns;
-extern const NSUInteger SFTViewRows;
-extern const NSUInteger SFTViewSize;
-
 typedef NS_ENUM(NSUInteger, SFTC64Colour) {
   SFTC64ColourBlack = 0,
   SFTC64ColourWhite,
@@ -64,4 +60,37 @@ typedef NS_ENUM(NSInteger, SFTErrorDomainCodes) {
 };
 
 extern const NSUInteger SFTDefaultPort;
+extern const NSUInteger SFTDefaultScreenColumns;
+extern const NSUInteger SFTDefaultScreenRows;
 extern NSString *SFTDefaultScheme;
+
+extern const float SFTEntryThumbnailScale;
+
+/**
+ * User defaults the application reads, none of which need to be set:
+ *
+ * - UseSharedEventLoop (bool, NO): connections share one kqueue event loop
+ *   instead of running a thread each.
+ * - UseInstancedRendering (bool, NO): cells are drawn as one instance each
+ *   instead of by the full-screen fragment shader.
+ * - SessionCaptureDirectory (string, unset): directory every session is
+ *   recorded to as a timestamped capture, and where the address book looks
+ *   for the captures its entry images are drawn from.
+ * - PacketLogByteBudget (integer, 1 MiB): bytes of packets each session keeps
+ *   for the data flow inspector.
+ * - ScrollbackMemoryCap (integer, 8 MiB): memory each session's history may
+ *   take before its oldest rows are dropped.
+ * - ScreenColumns and ScreenRows (integers, 40 and 25): screen size of new
+ *   sessions, up to 1024x256.
+ *
+ * They are set from the command line, for example:
+ *
+ *     defaults write it.frob.sixtyfourterm UseSharedEventLoop -bool YES
+ */
+extern NSString *SFTUseSharedEventLoopKey;
+extern NSString *SFTUseInstancedRenderingKey;
+extern NSString *SFTSessionCaptureDirectoryKey;
+extern NSString *SFTPacketLogByteBudgetKey;
+extern NSString *SFTScrollbackMemoryCapKey;
+extern NSString *SFTScreenColumnsKey;
+extern NSString *SFTScreenRowsKey;
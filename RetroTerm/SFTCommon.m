@@ -28,10 +28,18 @@ NSExceptionName SFTInternalErrorException = @"InternalErrorException";
 
 NSErrorDomain SFTErrorDomain = @"SFTErrorDomain";
 
-const NSUInteger SFTViewColumns = 40;
-const NSUInteger SFTViewRows = 25;
-const NSUInteger SFTViewSize = SFTViewRows * SFTViewColumns;
-
 const NSUInteger SFTDefaultPort = 23;
+const NSUInteger SFTDefaultScreenColumns = 40;
+const NSUInteger SFTDefaultScreenRows = 25;
 
 NSString *SFTDefaultScheme = @"telnet";
+
+const float SFTEntryThumbnailScale = 0.5f;
+
+NSString *SFTUseSharedEventLoopKey = @"UseSharedEventLoop";
+NSString *SFTUseInstancedRenderingKey = @"UseInstancedRendering";
+NSString *SFTSessionCaptureDirectoryKey = @"SessionCaptureDirectory";
+NSString *SFTPacketLogByteBudgetKey = @"PacketLogByteBudget";
+NSString *SFTScrollbackMemoryCapKey = @"ScrollbackMemoryCap";
+NSString *SFTScreenColumnsKey = @"ScreenColumns";
+NSString *SFTScreenRowsKey = @"ScreenRows";
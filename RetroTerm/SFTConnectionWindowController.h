@@ -23,15 +23,31 @@
 @import AppKit;
 
 #import "SFTAddressBookEntry+CoreDataClass.h"
+#import "SFTTerminalEmulatorContext.h"
 
 @interface SFTConnectionWindowController : NSWindowController
 
+/**
+ * Emulator context of the session shown, whose geometry is fixed for the
+ * whole session.  Anything else in it must only be touched on the parse
+ * queue.
+ */
+@property(strong, nonatomic, readonly, nonnull)
+    SFTTerminalEmulatorContext *terminalContext;
+
 @property(NS_NONATOMIC_IOSONLY, readonly, copy)
     NSImage *_Nullable contentsImage;
 
+/**
+ * PNG thumbnail of the screen, at SFTEntryThumbnailScale.
+ */
+@property(NS_NONATOMIC_IOSONLY, readonly, copy)
+    NSData *_Nullable contentsThumbnail;
+
 + (nonnull NSString *)nibName;
 
 - (void)replaySession;
+- (void)seekReplayToOffset:(NSUInteger)offset;
 
 @property(NS_NONATOMIC_IOSONLY, readonly, copy)
     NSData *_Nonnull rawContentsBuffer;
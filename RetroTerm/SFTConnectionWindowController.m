@@ -27,37 +27,147 @@
 #import "SFTCommon.h"
 #import "SFTDataFlowLogger.h"
 #import "SFTDocument.h"
+#import "SFTEventLoopIOProcessor.h"
 #import "SFTIOProcessor.h"
 #import "SFTNetworkIOProcessor.h"
 #import "SFTPlaybackIOProcessor.h"
+#import "SFTRenderScheduler.h"
 #import "SFTReplaySpeedSelectorViewController.h"
 #import "SFTSharedMetalResources.h"
 #import "SFTSharedResources.h"
+#import "SFTTerminalEmulator.h"
+
+#import "SFTCoreRenderer.h"
+#import "SFTCoreThumbnail.h"
 
-#import "MTKView+Screenshot.h"
 
 static NSString *kWindowNibName = @"Connection";
 
 static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
 
+static const NSUInteger kMaximumSearchHits = 65536;
+
+/**
+ * Frames the CPU may get ahead of the GPU by, each drawn from cells of its
+ * own so that none is written while a command buffer still reads it.
+ */
+#define kFramesInFlight 3
+
 @interface SFTConnectionWindowController () <MTKViewDelegate, NSWindowDelegate,
-                                             SFTIOProcessorDelegate>
+                                             SFTIOProcessorDelegate,
+                                             SFTRenderSchedulerDelegate> {
+  /**
+   * Sequence number of the snapshot each frame's cells were last brought up
+   * to date with, and whether they hold the scrolled back viewport rather
+   * than the screen.
+   */
+  uint64_t _frameSequences[kFramesInFlight];
+  BOOL _frameHoldsViewport[kFramesInFlight];
+}
 
 @property(weak) IBOutlet MTKView *contentsView;
 
 @property(strong, nonatomic) id<MTLCommandQueue> metalCommandQueue;
+
+/**
+ * Whether the screen is drawn with one instance per cell, rather than by a
+ * single quad decoding cells for every pixel.
+ */
+@property(assign, nonatomic) BOOL usesInstancedRendering;
 @property(strong, nonatomic, nonnull) NSTimer *cursorBlinkTimer;
 @property(strong, nonatomic, nullable) SFTIOProcessor *ioProcessor;
+@property(strong, nonatomic, nonnull) SFTRenderScheduler *renderScheduler;
 
-@property(strong, nonatomic, nonnull)
+/**
+ * Emulator, context and cell buffer of this session only, touched solely
+ * on the render scheduler's parse queue once the session starts.  The
+ * screen reaches the main thread through the context's snapshots.
+ */
+@property(strong, nonatomic, nonnull) SFTTerminalEmulator *terminalEmulator;
+@property(strong, nonatomic, readwrite, nonnull)
     SFTTerminalEmulatorContext *terminalContext;
+@property(strong, nonatomic, nonnull) NSMutableData *terminalCells;
+
+/**
+ * Snapshot last acquired from the terminal context, and its sequence
+ * number.  It stays valid until the next acquisition, which only
+ * publishTerminal makes, so every reader on the main thread sees the same
+ * cells.
+ */
+@property(assign, nonatomic, nonnull) const SFTCoreSnapshot *snapshot;
+@property(assign, nonatomic) uint64_t acquiredSequence;
+
+/**
+ * Cells of every frame in flight, laid out like the cell buffer whether
+ * they hold the screen or the viewport so that the shader context needs no
+ * changes, and the semaphore counting the frames the GPU is done with.
+ */
+@property(strong, nonatomic, nonnull) NSArray<id<MTLBuffer>> *frameContents;
+@property(strong, nonatomic, nonnull) dispatch_semaphore_t framesAvailable;
+@property(assign, nonatomic) NSUInteger frameIndex;
+@property(assign, nonatomic) BOOL isScrolledBack;
+
+/**
+ * History row shown at the top as of the snapshot last acquired, counting
+ * every row ever scrolled off the screen so that it stays put as the
+ * history grows.
+ */
+@property(assign, nonatomic) uint64_t viewportLine;
+@property(assign, nonatomic) CGFloat scrollRemainder;
+
+@property(copy, nonatomic, nullable) NSString *searchText;
+
+/**
+ * Position of the search hit last shown, as viewportLine * width + column.
+ */
+@property(assign, nonatomic) uint64_t searchPosition;
+@property(assign, nonatomic) BOOL hasSearchHit;
 
 - (void)initialiseGraphics;
 - (void)initialiseTerminal;
 - (void)initialiseNetwork;
+- (void)startCaptureForAddress:(nonnull NSURL *)address;
 
 - (void)updateWindowSize:(CGSize)size;
-- (void)processIncomingBuffer:(nonnull NSData *)buffer;
+
+/**
+ * Returns the content size drawing cells at the given size, scaled down
+ * when needed to fit the visible part of the screen the window is on.
+ */
+- (NSSize)contentSizeForCellSize:(CGFloat)cellSize;
+
+/**
+ * Passes the screen size in cells to the shader.
+ */
+- (void)updateScreenGeometry;
+
+/**
+ * Converts a position in the view, normalised to 0-1 with the origin at the
+ * top left, into a visible cell index.
+ */
+- (NSUInteger)cellIndexAtX:(CGFloat)x y:(CGFloat)y;
+
+/**
+ * Runs the given block on the parse queue without waiting for it, then
+ * publishes whatever it changed.
+ */
+- (void)performOnParseQueue:(void (^_Nonnull)(void))block;
+- (BOOL)processIncomingRing:(nonnull SFTCoreByteRing *)ring;
+- (BOOL)publishTerminal;
+- (BOOL)updateShaderContextFromSnapshot:
+    (nonnull const SFTCoreSnapshot *)snapshot;
+- (void)uploadSnapshotToFrame:(NSUInteger)frame;
+- (void)scrollViewportToLine:(uint64_t)line;
+- (void)findSearchTextTowardsOlderRows:(BOOL)older;
+- (void)showSearchHits:(nonnull NSData *)hitsBuffer
+                 count:(NSUInteger)count
+            textLength:(size_t)length
+            oldestLine:(uint64_t)oldest
+            bottomLine:(uint64_t)pushed
+      towardsOlderRows:(BOOL)older;
+- (SFTCoreRendererContext)rendererContext;
+- (NSUInteger)publishedBaseRow;
+- (nonnull const SFTTerminalEmulatorCell *)visibleCells;
 
 - (void)setEnabledForMenuItemTag:(SFTUserInterfaceTag)menuItemTag
                          enabled:(BOOL)enabled;
@@ -73,8 +183,8 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
 - (void)windowDidLoad {
   [super windowDidLoad];
 
-  [self initialiseGraphics];
   [self initialiseTerminal];
+  [self initialiseGraphics];
   [self initialiseNetwork];
 }
 
@@ -87,13 +197,29 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
   self.contentsView.framebufferOnly = NO;
 
   self.metalCommandQueue = [device newCommandQueue];
+  self.usesInstancedRendering = [NSUserDefaults.standardUserDefaults
+      boolForKey:SFTUseInstancedRenderingKey];
+  self.renderScheduler =
+      [[SFTRenderScheduler alloc] initWithView:self.contentsView];
+  self.renderScheduler.delegate = self;
+
+  // Cells are drawn square, at twice their glyph size to start with.
+  self.window.contentMinSize = [self contentSizeForCellSize:8.0];
+  [self.window setContentSize:[self contentSizeForCellSize:16.0]];
   [self updateWindowSize:self.window.frame.size];
-  [self.document
-      setScreenContents:
-          [device
-              newBufferWithLength:SFTViewSize * sizeof(SFTTerminalEmulatorCell)
-                          options:MTLResourceStorageModeManaged |
-                                  MTLResourceCPUCacheModeWriteCombined]];
+  [self updateScreenGeometry];
+
+  NSUInteger length = self.terminalContext.cellBufferLength;
+  MTLResourceOptions options =
+      MTLResourceStorageModeManaged | MTLResourceCPUCacheModeWriteCombined;
+  NSMutableArray<id<MTLBuffer>> *frameContents = [NSMutableArray new];
+  for (NSUInteger frame = 0; frame < kFramesInFlight; frame++) {
+    [frameContents addObject:[device newBufferWithLength:length
+                                                 options:options]];
+  }
+  self.frameContents = frameContents;
+  self.framesAvailable = dispatch_semaphore_create(kFramesInFlight);
+  [self publishTerminal];
 
   __weak SFTConnectionWindowController *weakSelf = self;
   self.cursorBlinkTimer = [NSTimer
@@ -114,28 +240,33 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
                                                             SFTShaderContext,
                                                             flags),
                                                         sizeof(uint8_t))];
-                                 [strongSelf.contentsView draw];
+                                 [strongSelf.renderScheduler setNeedsDisplay];
                                }];
+  [self.renderScheduler start];
 }
 
 - (void)initialiseTerminal {
   // @TODO: Default to upper case
-  self.terminalContext =
-      [[SFTTerminalEmulatorContext alloc] initWithWidth:SFTViewColumns
-                                              andHeight:SFTViewRows
-                                        usingBackground:SFTC64ColourBlack
-                                          andForeground:SFTC64ColourLightBlue
-                                            inASCIIMode:YES
-                                         usingLowerCase:NO];
-
-  [SFTSharedResources.sharedInstance.terminalEmulator
+  self.terminalContext = [[SFTTerminalEmulatorContext alloc]
+        initWithWidth:SFTTerminalEmulatorContext.preferredWidth
+            andHeight:SFTTerminalEmulatorContext.preferredHeight
+      usingBackground:SFTC64ColourBlack
+        andForeground:SFTC64ColourLightBlue
+          inASCIIMode:YES
+       usingLowerCase:NO];
+  self.terminalEmulator = [SFTTerminalEmulator new];
+  self.terminalCells =
+      [NSMutableData dataWithLength:self.terminalContext.cellBufferLength];
+
+  // The parse queue does not exist yet, nor does anything else using the
+  // context.
+  [self.terminalEmulator
       clearScreenForContext:self.terminalContext
                onCellBuffer:(SFTTerminalEmulatorCell *)
-                                [self.document screenContents]
-                                    .contents];
-  [[self.document screenContents]
-      didModifyRange:NSMakeRange(0, sizeof(SFTViewSize) *
-                                        sizeof(SFTTerminalEmulatorCell))];
+                                self.terminalCells.mutableBytes];
+  [self.terminalContext
+      publishSnapshotFromCellBuffer:(const SFTTerminalEmulatorCell *)
+                                        self.terminalCells.bytes];
 }
 
 - (void)initialiseNetwork {
@@ -150,45 +281,113 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
                                                               entry.address]];
   }
 
-  self.ioProcessor = [SFTNetworkIOProcessor networkIOProcessorWithURL:address];
+  if ([NSUserDefaults.standardUserDefaults
+          boolForKey:SFTUseSharedEventLoopKey]) {
+    self.ioProcessor =
+        [SFTEventLoopIOProcessor eventLoopIOProcessorWithURL:address];
+  } else {
+    self.ioProcessor =
+        [SFTNetworkIOProcessor networkIOProcessorWithURL:address];
+  }
   if (self.ioProcessor == nil) {
-    self.ioProcessor = [SFTPlaybackIOProcessor new];
+    SFTPlaybackIOProcessor *playback = [SFTPlaybackIOProcessor new];
+    playback.replayQueue = self.renderScheduler.parseQueue;
+    self.ioProcessor = playback;
+  } else {
+    if ((address.scheme == nil) ||
+        [address.scheme isEqualToString:SFTDefaultScheme]) {
+      [self.ioProcessor enableTelnetWithWidth:self.terminalContext.width
+                                       height:self.terminalContext.height];
+    }
+    [self startCaptureForAddress:address];
   }
 
   self.ioProcessor.delegate = self;
+  self.ioProcessor.inputRing = self.renderScheduler.inputRing;
+  self.ioProcessor.packetLogger = [self.document packetLogger];
   [self.ioProcessor start];
 }
 
+- (void)startCaptureForAddress:(nonnull NSURL *)address {
+  NSString *directory = [NSUserDefaults.standardUserDefaults
+      stringForKey:SFTSessionCaptureDirectoryKey];
+  if (directory.length == 0) {
+    return;
+  }
+
+  NSDateFormatter *formatter = [NSDateFormatter new];
+  formatter.dateFormat = @"yyyy-MM-dd HH.mm.ss";
+  NSString *host = address.host != nil ? address.host : @"Session";
+  NSString *name =
+      [NSString stringWithFormat:@"%@ %@.sftcapture", host,
+                                 [formatter stringFromDate:NSDate.date]];
+  NSURL *url = [[NSURL fileURLWithPath:directory.stringByExpandingTildeInPath
+                           isDirectory:YES] URLByAppendingPathComponent:name];
+
+  // Opened right here, as the pipeline picks the capture up when the I/O
+  // processor starts.  Nothing was parsed yet, so the parse queue cannot be
+  // touching the context or the cell buffer.
+  if (![self.ioProcessor
+          startCaptureToURL:url
+                 forContext:self.terminalContext
+               onCellBuffer:(const SFTTerminalEmulatorCell *)
+                                self.terminalCells.bytes]) {
+    NSLog(@"Cannot record session to %@", url.path);
+  }
+}
+
 - (void)mtkView:(MTKView *)view drawableSizeWillChange:(CGSize)size {
   [self updateWindowSize:size];
+  [self.renderScheduler setNeedsDisplay];
 }
 
 - (void)drawInMTKView:(MTKView *)view {
+  // Only cells no command buffer reads any longer are brought up to date.
+  dispatch_semaphore_wait(self.framesAvailable, DISPATCH_TIME_FOREVER);
+  self.frameIndex = (self.frameIndex + 1) % kFramesInFlight;
+  [self uploadSnapshotToFrame:self.frameIndex];
+  id<MTLBuffer> cells = self.frameContents[self.frameIndex];
+
+  // The shader context is copied as it is now, as the main thread keeps
+  // changing it while the frame is drawn.
+  const void *shaderContext = [self.document shaderContext].contents;
+
   id<MTLCommandBuffer> commandBuffer = [self.metalCommandQueue commandBuffer];
+  dispatch_semaphore_t framesAvailable = self.framesAvailable;
+  [commandBuffer addCompletedHandler:^(id<MTLCommandBuffer> buffer) {
+    dispatch_semaphore_signal(framesAvailable);
+  }];
 
   MTLRenderPassDescriptor *passDescriptor =
       self.contentsView.currentRenderPassDescriptor;
   if (passDescriptor != nil) {
     id<MTLRenderCommandEncoder> encoder =
         [commandBuffer renderCommandEncoderWithDescriptor:passDescriptor];
-    [encoder setRenderPipelineState:SFTSharedMetalResources.sharedInstance
-                                        .renderPipelineState];
-    [encoder setFragmentBuffer:[self.document shaderContext]
-                        offset:0
-                       atIndex:0];
-    [encoder setFragmentBuffer:[self.document screenContents]
-                        offset:0
-                       atIndex:1];
-    [encoder
-        setFragmentTexture:SFTSharedMetalResources.sharedInstance.charsetTexture
-                   atIndex:0];
-    [encoder
-        setVertexBuffer:SFTSharedMetalResources.sharedInstance.vertexBufferQuad
-                 offset:0
-                atIndex:0];
-    [encoder drawPrimitives:MTLPrimitiveTypeTriangleStrip
-                vertexStart:0
-                vertexCount:SFTVertexBufferQuadItemsCount];
+    SFTSharedMetalResources *resources = SFTSharedMetalResources.sharedInstance;
+    [encoder setFragmentTexture:resources.charsetTexture atIndex:0];
+
+    if (self.usesInstancedRendering) {
+      [encoder setRenderPipelineState:resources.cellRenderPipelineState];
+      [encoder setVertexBytes:shaderContext
+                       length:sizeof(SFTShaderContext)
+                      atIndex:0];
+      [encoder setVertexBuffer:cells offset:0 atIndex:1];
+      [encoder drawPrimitives:MTLPrimitiveTypeTriangleStrip
+                  vertexStart:0
+                  vertexCount:4
+                instanceCount:self.terminalContext.width *
+                              self.terminalContext.height];
+    } else {
+      [encoder setRenderPipelineState:resources.renderPipelineState];
+      [encoder setFragmentBytes:shaderContext
+                         length:sizeof(SFTShaderContext)
+                        atIndex:0];
+      [encoder setFragmentBuffer:cells offset:0 atIndex:1];
+      [encoder setVertexBuffer:resources.vertexBufferQuad offset:0 atIndex:0];
+      [encoder drawPrimitives:MTLPrimitiveTypeTriangleStrip
+                  vertexStart:0
+                  vertexCount:SFTVertexBufferQuadItemsCount];
+    }
     [encoder endEncoding];
   }
 
@@ -196,6 +395,40 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
   [commandBuffer commit];
 }
 
+- (void)updateScreenGeometry {
+  SFTShaderContext *shaderContext =
+      (SFTShaderContext *)[self.document shaderContext].contents;
+  shaderContext->cellsWide = (uint32_t)self.terminalContext.width;
+  shaderContext->cellsTall = (uint32_t)self.terminalContext.height;
+  [[self.document shaderContext]
+      didModifyRange:NSMakeRange(offsetof(SFTShaderContext, cellsWide),
+                                 sizeof(uint32_t) * 2)];
+}
+
+- (NSUInteger)cellIndexAtX:(CGFloat)x y:(CGFloat)y {
+  NSUInteger width = self.terminalContext.width;
+  NSUInteger height = self.terminalContext.height;
+  NSUInteger row = MIN((NSUInteger)(y * height), height - 1);
+  NSUInteger column = MIN((NSUInteger)(x * width), width - 1);
+  return (row * width) + column;
+}
+
+- (NSSize)contentSizeForCellSize:(CGFloat)cellSize {
+  NSSize size = NSMakeSize(self.terminalContext.width * cellSize,
+                           self.terminalContext.height * cellSize);
+  NSScreen *screen =
+      self.window.screen != nil ? self.window.screen : NSScreen.mainScreen;
+  if (screen == nil) {
+    return size;
+  }
+
+  NSSize visible =
+      [self.window contentRectForFrameRect:screen.visibleFrame].size;
+  CGFloat scale =
+      MIN(1.0, MIN(visible.width / size.width, visible.height / size.height));
+  return NSMakeSize(floor(size.width * scale), floor(size.height * scale));
+}
+
 - (void)updateWindowSize:(CGSize)size {
   SFTShaderContext *shaderContext =
       (SFTShaderContext *)[self.document shaderContext].contents;
@@ -218,11 +451,9 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
     return;
   }
 
-  uint16_t start =
-      (uint16_t)(((((NSInteger)(y * SFTViewRows)) * SFTViewColumns) +
-                  (NSInteger)(x * SFTViewColumns)) &
-                 0xFFFF);
+  NSUInteger start = [self cellIndexAtX:x y:y];
   [self.document setSelectionRangeFromIndex:start toIndex:start];
+  [self.renderScheduler setNeedsDisplay];
   [super mouseDown:event];
 }
 
@@ -242,13 +473,10 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
   if ((x < 0.0) || (x > 1.0) || (y < 0.0) || (y > 1.0)) {
     [self.document setSelectionRangeFromIndex:0 toIndex:0];
   } else {
-    uint16_t end =
-        (uint16_t)(((((NSInteger)(y * SFTViewRows)) * SFTViewColumns) +
-                    (NSInteger)(x * SFTViewColumns)) &
-                   0xFFFF);
-    [self.document setSelectionEnd:end];
+    [self.document setSelectionEnd:[self cellIndexAtX:x y:y]];
   }
 
+  [self.renderScheduler setNeedsDisplay];
   [super mouseDragged:event];
 }
 
@@ -262,13 +490,10 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
   if ((x < 0.0) || (x > 1.0) || (y < 0.0) || (y > 1.0)) {
     [self.document setSelectionRangeFromIndex:0 toIndex:0];
   } else {
-    uint16_t end =
-        (uint16_t)(((((NSInteger)(y * SFTViewRows)) * SFTViewColumns) +
-                    (NSInteger)(x * SFTViewColumns)) &
-                   0xFFFF);
-    [self.document setSelectionEnd:end];
+    [self.document setSelectionEnd:[self cellIndexAtX:x y:y]];
   }
 
+  [self.renderScheduler setNeedsDisplay];
   [super mouseUp:event];
 }
 
@@ -286,14 +511,192 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
 //  }
 //
 //  [self.document
-//      setPointerPosition:((((NSInteger)(y * SFTViewRows)) * SFTViewColumns) +
-//                          (NSInteger)(x * SFTViewColumns))];
+//      setPointerPosition:(NSInteger)[self cellIndexAtX:x y:y]];
 //
 //  [super mouseMoved:event];
 //}
 
+- (void)scrollWheel:(NSEvent *)event {
+  CGFloat rows = event.scrollingDeltaY;
+  if (event.hasPreciseScrollingDeltas) {
+    rows /= self.contentsView.frame.size.height / self.terminalContext.height;
+  }
+
+  self.scrollRemainder += rows;
+  NSInteger delta = (NSInteger)self.scrollRemainder;
+  if (delta == 0) {
+    return;
+  }
+  self.scrollRemainder -= delta;
+
+  // Moving up the screen goes towards older history rows.
+  [self performOnParseQueue:^{
+    [self.terminalContext scrollViewportByRows:-delta];
+  }];
+}
+
+- (void)scrollViewportToLine:(uint64_t)line {
+  // The viewport is composed on the parse queue along with the next
+  // snapshot, and shows up once that is uploaded.
+  [self performOnParseQueue:^{
+    [self.terminalContext scrollViewportToLine:line];
+  }];
+}
+
+- (void)findSearchTextTowardsOlderRows:(BOOL)older {
+  NSData *text = [self.searchText dataUsingEncoding:NSASCIIStringEncoding
+                               allowLossyConversion:YES];
+  NSMutableData *glyphs = [NSMutableData dataWithLength:text.length];
+  size_t length = SFTCoreSearchGlyphsFromText(
+      (const char *)text.bytes, text.length, (uint8_t *)glyphs.mutableBytes);
+
+  NSMutableData *hits =
+      [NSMutableData dataWithLength:kMaximumSearchHits *
+                                    sizeof(SFTCoreSearchHit)];
+  [self performOnParseQueue:^{
+    NSUInteger count = 0;
+    if (length > 0) {
+      count = [self.terminalContext
+           findGlyphs:(const uint8_t *)glyphs.bytes
+               length:length
+         inCellBuffer:(const SFTTerminalEmulatorCell *)self.terminalCells.bytes
+             withHits:(SFTCoreSearchHit *)hits.mutableBytes
+          maximumHits:kMaximumSearchHits];
+    }
+
+    SFTCoreScrollback *scrollback = self.terminalContext.scrollback;
+    uint64_t oldest = scrollback->pushed - SFTCoreScrollbackCount(scrollback);
+    uint64_t pushed = scrollback->pushed;
+    dispatch_async(dispatch_get_main_queue(), ^{
+      [self showSearchHits:hits
+                     count:count
+                textLength:length
+                oldestLine:oldest
+                bottomLine:pushed
+          towardsOlderRows:older];
+    });
+  }];
+}
+
+- (void)showSearchHits:(nonnull NSData *)hitsBuffer
+                 count:(NSUInteger)count
+            textLength:(size_t)length
+            oldestLine:(uint64_t)oldest
+            bottomLine:(uint64_t)pushed
+      towardsOlderRows:(BOOL)older {
+  // Hits are numbered from the oldest history row, so they are moved to the
+  // same numbering as viewportLine to stay put as the history grows.
+  const SFTCoreSearchHit *hits = (const SFTCoreSearchHit *)hitsBuffer.bytes;
+  NSUInteger width = self.terminalContext.width;
+  BOOL found = NO;
+  uint64_t best = 0;
+  for (NSUInteger index = 0; index < count; index++) {
+    uint64_t position =
+        ((oldest + hits[index].line) * width) + hits[index].column;
+    BOOL eligible =
+        !self.hasSearchHit || (older ? position < self.searchPosition
+                                     : position > self.searchPosition);
+    if (eligible &&
+        (!found || ((older || !self.hasSearchHit) ? position > best
+                                                  : position < best))) {
+      best = position;
+      found = YES;
+    }
+  }
+
+  if (!found) {
+    NSBeep();
+    return;
+  }
+  self.searchPosition = best;
+  self.hasSearchHit = YES;
+
+  // The hit is shown halfway down the screen, if the history allows.
+  uint64_t line = best / width;
+  uint64_t half = self.terminalContext.height / 2;
+  uint64_t top = (line > oldest + half) ? line - half : oldest;
+  [self scrollViewportToLine:top];
+  top = MIN(top, pushed);
+  NSUInteger start = (NSUInteger)((line - top) * width + (best % width));
+  [self.document setSelectionRangeFromIndex:start
+                                    toIndex:start + length - 1];
+  [self.renderScheduler setNeedsDisplay];
+}
+
+- (IBAction)performFindPanelAction:(id)sender {
+  switch ((NSFindPanelAction)[sender tag]) {
+  case NSFindPanelActionShowFindPanel: {
+    NSTextField *field =
+        [NSTextField textFieldWithString:self.searchText ?: @""];
+    field.frame = NSMakeRect(0, 0, 240, 22);
+
+    NSAlert *alert = [[NSAlert alloc] init];
+    alert.messageText =
+        NSLocalizedString(@"Find in session", @"Find question message");
+    alert.informativeText = NSLocalizedString(
+        @"Both the screen and the scrollback history are searched, newest "
+        @"rows first.",
+        @"Find question info");
+    [alert addButtonWithTitle:NSLocalizedString(@"Find",
+                                                @"Find button title")];
+    [alert addButtonWithTitle:NSLocalizedString(@"Cancel",
+                                                @"Cancel button title")];
+    alert.accessoryView = field;
+    alert.window.initialFirstResponder = field;
+
+    __weak SFTConnectionWindowController *weakSelf = self;
+    [alert beginSheetModalForWindow:self.window
+                  completionHandler:^(NSModalResponse returnCode) {
+                    SFTConnectionWindowController *strongSelf = weakSelf;
+                    if ((strongSelf == nil) ||
+                        (returnCode != NSAlertFirstButtonReturn)) {
+                      return;
+                    }
+
+                    strongSelf.searchText = field.stringValue;
+                    strongSelf.hasSearchHit = NO;
+                    [strongSelf findSearchTextTowardsOlderRows:YES];
+                  }];
+    break;
+  }
+
+  case NSFindPanelActionNext:
+    [self findSearchTextTowardsOlderRows:YES];
+    break;
+
+  case NSFindPanelActionPrevious:
+    [self findSearchTextTowardsOlderRows:NO];
+    break;
+
+  default:
+    break;
+  }
+}
+
+- (BOOL)validateMenuItem:(NSMenuItem *)menuItem {
+  if (menuItem.action != @selector(performFindPanelAction:)) {
+    return YES;
+  }
+
+  switch ((NSFindPanelAction)menuItem.tag) {
+  case NSFindPanelActionShowFindPanel:
+    return YES;
+
+  case NSFindPanelActionNext:
+  case NSFindPanelActionPrevious:
+    return self.searchText.length > 0;
+
+  default:
+    return NO;
+  }
+}
+
 - (void)keyDown:(NSEvent *)event {
   [self.document setSelectionRangeFromIndex:0 toIndex:0];
+  if (self.isScrolledBack) {
+    [self scrollViewportToLine:UINT64_MAX];
+  }
+  [self.renderScheduler setNeedsDisplay];
 
   if (event.characters.length == 0) {
     [super keyDown:event];
@@ -309,39 +712,151 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
 
   NSMutableData *keyboardBuffer = [NSMutableData new];
 
-  if ([SFTSharedResources.sharedInstance.terminalEmulator
-          convertKeyCodeForContext:self.terminalContext
-                       withKeyCode:character
-                      toCharacters:keyboardBuffer]) {
-
+  // The screen modes are read from the snapshot last acquired, as the
+  // parsing state belongs to the parse queue.
+  if ([self.terminalEmulator convertKeyCodeForSnapshot:self.snapshot
+                                           withKeyCode:character
+                                          toCharacters:keyboardBuffer]) {
     [self.ioProcessor sendData:keyboardBuffer];
   } else {
     [super keyDown:event];
   }
 }
 
-- (void)processIncomingBuffer:(nonnull NSData *)buffer {
-  if ([SFTSharedResources.sharedInstance.terminalEmulator
-          processIncomingDataForContext:self.terminalContext
-                           onCellBuffer:(SFTTerminalEmulatorCell *)
-                                            [self.document screenContents]
-                                                .contents
-                                forData:buffer]) {
-    [[self.document screenContents]
-        didModifyRange:NSMakeRange(0, sizeof(SFTViewSize) *
-                                          sizeof(SFTTerminalEmulatorCell))];
+- (void)performOnParseQueue:(void (^_Nonnull)(void))block {
+  dispatch_async(self.renderScheduler.parseQueue, ^{
+    block();
+    if ([self.terminalContext
+            publishSnapshotFromCellBuffer:(const SFTTerminalEmulatorCell *)
+                                              self.terminalCells.bytes]) {
+      [self.renderScheduler setNeedsPublish];
+    }
+  });
+}
+
+- (BOOL)processIncomingRing:(nonnull SFTCoreByteRing *)ring {
+  [self.terminalEmulator
+      processIncomingDataForContext:self.terminalContext
+                       onCellBuffer:(SFTTerminalEmulatorCell *)
+                                        self.terminalCells.mutableBytes
+                           fromRing:ring];
+
+  // The I/O processor may have stopped reading while the ring was full.
+  if (SFTCoreByteRingResumeProducer(ring)) {
+    [self.ioProcessor resumeInput];
+  }
+
+  // Dirty rows are the authority on what changed, regardless of whether the
+  // emulator asked for a redraw.
+  return [self.terminalContext
+      publishSnapshotFromCellBuffer:(const SFTTerminalEmulatorCell *)
+                                        self.terminalCells.bytes];
+}
+
+- (BOOL)publishTerminal {
+  // The parse queue is never waited for, the latest snapshot is enough.
+  const SFTCoreSnapshot *snapshot = [self.terminalContext acquireSnapshot];
+  if (snapshot->sequence == self.acquiredSequence) {
+    return NO;
+  }
+
+  // Cells reach the GPU as each frame is drawn, see uploadSnapshotToFrame:.
+  self.snapshot = snapshot;
+  self.acquiredSequence = snapshot->sequence;
+  self.isScrolledBack = snapshot->isScrolledBack;
+  self.viewportLine = snapshot->viewportLine;
+  [self updateShaderContextFromSnapshot:snapshot];
+  return YES;
+}
+
+- (void)uploadSnapshotToFrame:(NSUInteger)frame {
+  const SFTCoreSnapshot *snapshot = self.snapshot;
+  id<MTLBuffer> contents = self.frameContents[frame];
+  uint8_t *destination = (uint8_t *)contents.contents;
+  NSUInteger height = self.terminalContext.height;
+  NSUInteger rowLength =
+      self.terminalContext.width * sizeof(SFTTerminalEmulatorCell);
+
+  if (snapshot->isScrolledBack) {
+    if (_frameHoldsViewport[frame] &&
+        (_frameSequences[frame] == snapshot->sequence)) {
+      return;
+    }
+
+    // Rows go around the base row published along with them, which is the
+    // one the shader context gets too.
+    const uint8_t *source = (const uint8_t *)snapshot->viewport;
+    for (NSUInteger row = 0; row < height; row++) {
+      NSUInteger physical = (snapshot->baseRow + row) % height;
+      memcpy(destination + (physical * rowLength), source + (row * rowLength),
+             rowLength);
+    }
+    [contents didModifyRange:NSMakeRange(0, height * rowLength)];
+    _frameHoldsViewport[frame] = YES;
+    _frameSequences[frame] = snapshot->sequence;
+    return;
+  }
+
+  // Rows changed since this frame's previous upload are copied in
+  // consecutive runs, all of them if it held the viewport.
+  const uint8_t *source = (const uint8_t *)snapshot->cells;
+  uint64_t uploaded = _frameHoldsViewport[frame] ? 0 : _frameSequences[frame];
+  NSUInteger row = 0;
+  while (row < height) {
+    if (snapshot->rowSequences[row] <= uploaded) {
+      row++;
+      continue;
+    }
+
+    NSUInteger first = row;
+    while ((row < height) && (snapshot->rowSequences[row] > uploaded)) {
+      row++;
+    }
+    NSRange range = NSMakeRange(first * rowLength, (row - first) * rowLength);
+    memcpy(destination + range.location, source + range.location,
+           range.length);
+    [contents didModifyRange:range];
   }
+  _frameHoldsViewport[frame] = NO;
+  _frameSequences[frame] = snapshot->sequence;
+}
 
+- (BOOL)updateShaderContextFromSnapshot:
+    (nonnull const SFTCoreSnapshot *)snapshot {
   SFTShaderContext *shaderContext =
       (SFTShaderContext *)[self.document shaderContext].contents;
-  shaderContext->flags.lowerCase = (uint8_t)self.terminalContext.useLowerCase;
-  shaderContext->cursorRow = (uint16_t)(self.terminalContext.row & 0xFFFF);
-  shaderContext->cursorColumn =
-      (uint16_t)(self.terminalContext.column & 0xFFFF);
+  uint8_t lowerCase = (uint8_t)snapshot->useLowerCase;
+  uint32_t cursorRow = (uint32_t)snapshot->row;
+  uint32_t cursorColumn = (uint32_t)snapshot->column;
+  uint32_t baseRow = (uint32_t)snapshot->baseRow;
+
+  if ((shaderContext->flags.lowerCase == lowerCase) &&
+      (shaderContext->cursorRow == cursorRow) &&
+      (shaderContext->cursorColumn == cursorColumn) &&
+      (shaderContext->baseRow == baseRow)) {
+    return NO;
+  }
+
+  shaderContext->flags.lowerCase = lowerCase;
+  shaderContext->cursorRow = cursorRow;
+  shaderContext->cursorColumn = cursorColumn;
+  shaderContext->baseRow = baseRow;
 
   [[self.document shaderContext]
       didModifyRange:NSMakeRange(offsetof(SFTShaderContext, cursorRow),
-                                 sizeof(uint8_t) + (sizeof(uint16_t) * 2))];
+                                 offsetof(SFTShaderContext, flags) +
+                                     sizeof(uint8_t) -
+                                     offsetof(SFTShaderContext, cursorRow))];
+  return YES;
+}
+
+- (BOOL)renderScheduler:(nonnull SFTRenderScheduler *)scheduler
+             parseInput:(nonnull SFTCoreByteRing *)input {
+  return [self processIncomingRing:input];
+}
+
+- (BOOL)renderSchedulerPublishFrame:(nonnull SFTRenderScheduler *)scheduler {
+  return [self publishTerminal];
 }
 
 - (void)windowWillClose:(NSNotification *)notification {
@@ -351,6 +866,7 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
 
   if (window == self.window) {
     [self.cursorBlinkTimer invalidate];
+    [self.renderScheduler stop];
     [self.ioProcessor stop];
   }
 }
@@ -378,14 +894,104 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
     new.height = ((new.width * current.height) / current.width);
   }
 
-  new.width = MAX(self.terminalContext.width * 8, new.width);
-  new.height = MAX(self.terminalContext.height * 8, new.height);
+  NSSize minimum =
+      [sender frameRectForContentRect:NSMakeRect(0.0, 0.0,
+                                                 sender.contentMinSize.width,
+                                                 sender.contentMinSize.height)]
+          .size;
+  new.width = MAX(minimum.width, new.width);
+  new.height = MAX(minimum.height, new.height);
+
+  // Large screens are kept within the visible part of the display.
+  if (sender.screen != nil) {
+    NSSize visible = sender.screen.visibleFrame.size;
+    CGFloat scale =
+        MIN(1.0, MIN(visible.width / new.width, visible.height / new.height));
+    new.width = floor(new.width * scale);
+    new.height = floor(new.height * scale);
+  }
 
   return new;
 }
 
+- (SFTCoreRendererContext)rendererContext {
+  const SFTShaderContext *shaderContext =
+      (const SFTShaderContext *)[self.document shaderContext].contents;
+  SFTCoreRendererContext context = {
+      .selectionStart = shaderContext->selectionStart,
+      .selectionEnd = shaderContext->selectionEnd,
+      .cursorRow = shaderContext->cursorRow,
+      .cursorColumn = shaderContext->cursorColumn};
+  // The renderer reads the flags the same way the shader does.
+  memcpy(&context.flags, &shaderContext->flags, sizeof(uint8_t));
+  return context;
+}
+
+- (NSUInteger)publishedBaseRow {
+  // The viewport is published in visible order, the screen around the base
+  // row published along with it.
+  return self.snapshot->isScrolledBack ? 0 : self.snapshot->baseRow;
+}
+
+- (nonnull const SFTTerminalEmulatorCell *)visibleCells {
+  return self.snapshot->isScrolledBack ? self.snapshot->viewport
+                                       : self.snapshot->cells;
+}
+
 - (nullable NSImage *)contentsImage {
-  return self.contentsView.screenshot;
+  // Drawn in software, as the view's drawables cannot be read back.
+  SFTCoreRenderer renderer;
+  if (!SFTCoreRendererInitialise(&renderer, self.terminalContext.width,
+                                 self.terminalContext.height)) {
+    return nil;
+  }
+
+  SFTCoreRendererContext context = [self rendererContext];
+  SFTCoreRendererDraw(&renderer, [self visibleCells],
+                      [self publishedBaseRow], &context);
+
+  size_t width = SFTCoreRendererStride(&renderer);
+  size_t height = renderer.height * SFTCoreRendererCellSize;
+  NSData *pixels =
+      [NSData dataWithBytesNoCopy:renderer.pixels
+                           length:width * height * sizeof(uint32_t)
+                     freeWhenDone:YES];
+  renderer.pixels = NULL;
+  SFTCoreRendererRelease(&renderer);
+
+  CGDataProviderRef provider =
+      CGDataProviderCreateWithCFData((__bridge CFDataRef)pixels);
+  CGColorSpaceRef colourSpace = CGColorSpaceCreateDeviceRGB();
+  CGImageRef image = CGImageCreate(
+      width, height, 8, 32, width * sizeof(uint32_t), colourSpace,
+      kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big, provider, NULL,
+      false, kCGRenderingIntentDefault);
+  CGColorSpaceRelease(colourSpace);
+  CGDataProviderRelease(provider);
+  if (image == NULL) {
+    return nil;
+  }
+
+  NSImage *contents =
+      [[NSImage alloc] initWithCGImage:image size:NSMakeSize(width, height)];
+  CGImageRelease(image);
+  return contents;
+}
+
+- (nullable NSData *)contentsThumbnail {
+  SFTCoreThumbnailJob job = {.cells = [self visibleCells],
+                             .baseRow = [self publishedBaseRow],
+                             .width = self.terminalContext.width,
+                             .height = self.terminalContext.height,
+                             .context = [self rendererContext],
+                             .scale = SFTEntryThumbnailScale};
+  if (!SFTCoreThumbnailRender(&job)) {
+    return nil;
+  }
+
+  return [NSData dataWithBytesNoCopy:job.png
+                              length:job.pngLength
+                        freeWhenDone:YES];
 }
 
 - (void)replaySession {
@@ -411,22 +1017,26 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
     NSUInteger bps = [SFTReplaySpeedSelectorViewController
         bpsForSpeed:accessoryViewController.replaySpeed];
 
-    [SFTSharedResources.sharedInstance.terminalEmulator
-        clearScreenForContext:self.terminalContext
-                 onCellBuffer:(SFTTerminalEmulatorCell *)
-                                  [self.document screenContents]
-                                      .contents];
-    [[self.document screenContents]
-        didModifyRange:NSMakeRange(0, sizeof(SFTViewSize) *
-                                          sizeof(SFTTerminalEmulatorCell))];
-
-    if ([self.ioProcessor isKindOfClass:SFTPlaybackIOProcessor.class]) {
-      [(SFTPlaybackIOProcessor *)self.ioProcessor
-          injectSessionDataFromURL:panel.URL
-                    withSpeedInBps:bps > 0 ? bps
-                                           : accessoryViewController
-                                                 .customBaudRate];
-    }
+    NSUInteger speed = bps > 0 ? bps : accessoryViewController.customBaudRate;
+    NSURL *url = panel.URL;
+
+    [self performOnParseQueue:^{
+      SFTTerminalEmulatorCell *cellBuffer =
+          (SFTTerminalEmulatorCell *)self.terminalCells.mutableBytes;
+
+      // Bytes still queued from a previous replay belong to the old screen.
+      SFTCoreByteRingDiscard(self.renderScheduler.inputRing);
+      [self.terminalEmulator clearScreenForContext:self.terminalContext
+                                      onCellBuffer:cellBuffer];
+
+      if ([self.ioProcessor isKindOfClass:SFTPlaybackIOProcessor.class]) {
+        [(SFTPlaybackIOProcessor *)self.ioProcessor
+            injectSessionDataFromURL:url
+                      withSpeedInBps:speed
+                          forContext:self.terminalContext
+                        onCellBuffer:cellBuffer];
+      }
+    }];
 
     break;
   }
@@ -442,9 +1052,35 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
   }
 }
 
+- (void)seekReplayToOffset:(NSUInteger)offset {
+  if (![self.ioProcessor isKindOfClass:SFTPlaybackIOProcessor.class]) {
+    return;
+  }
+
+  [self performOnParseQueue:^{
+    SFTCoreByteRingDiscard(self.renderScheduler.inputRing);
+    [(SFTPlaybackIOProcessor *)self.ioProcessor
+        seekToOffset:offset
+          forContext:self.terminalContext
+        onCellBuffer:(SFTTerminalEmulatorCell *)self.terminalCells
+                         .mutableBytes];
+  }];
+}
+
 - (NSData *)rawContentsBuffer {
-  return [NSData dataWithBytes:[self.document screenContents].contents
-                        length:SFTViewSize * sizeof(SFTTerminalEmulatorCell)];
+  // Copied from the screen in the snapshot last acquired, in visible order.
+  NSUInteger height = self.terminalContext.height;
+  NSUInteger rowLength =
+      self.terminalContext.width * sizeof(SFTTerminalEmulatorCell);
+  NSUInteger baseRow = self.snapshot->baseRow;
+  const uint8_t *source = (const uint8_t *)self.snapshot->cells;
+  NSMutableData *contents = [NSMutableData dataWithLength:height * rowLength];
+  uint8_t *destination = (uint8_t *)contents.mutableBytes;
+  for (NSUInteger row = 0; row < height; row++) {
+    memcpy(destination + (row * rowLength),
+           source + (((baseRow + row) % height) * rowLength), rowLength);
+  }
+  return contents;
 }
 
 + (nonnull NSString *)nibName {
@@ -463,18 +1099,6 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
       receivedEvent:(SFTIOProcessorEvent)event
            withData:(NSData *)data {
   switch (event) {
-  case SFTIOProcessorEventReceivedData:
-    //    if ([self.document logPackets]) {
-    //      SFTDataFlowLogEntry *entry = [SFTDataFlowLogEntry
-    //          dataFlowLogEntryWithBytes:data
-    //                       andDirection:SFTDataPacketDirectionInbound];
-    //      [[self.document packetLogger] appendEntry:entry];
-    //      NSLog(@"%@", entry);
-    //    }
-
-    [self processIncomingBuffer:data];
-    break;
-
   case SFTIOProcessorEventDisconnected: {
     SFTShaderContext *shaderContext =
         (SFTShaderContext *)[self.document shaderContext].contents;
@@ -484,7 +1108,7 @@ static const NSTimeInterval kCursorStateChangeInterval = 0.5f;
         didModifyRange:NSMakeRange(offsetof(SFTShaderContext, flags),
                                    sizeof(uint8_t))];
 
-    [self.contentsView draw];
+    [self.renderScheduler setNeedsDisplay];
 
     self.window.title =
         [self.window.title stringByAppendingString:@" - DISCONNECTED"];
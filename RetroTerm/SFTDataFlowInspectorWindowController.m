@@ -57,11 +57,13 @@ NSString *SFTDataFlowEntryDirectionToGlyphTransformerName =
 
 @end
 
-@interface SFTDataFlowInspectorWindowController ()
+@interface SFTDataFlowInspectorWindowController () <NSTableViewDataSource>
 
 @property(weak) IBOutlet NSTableView *packetsTable;
 @property(strong, nonatomic, nonnull) id<NSObject> changedNotificationObserver;
-@property(strong) IBOutlet NSObjectController *packetLoggerController;
+@property(strong, nonatomic, nonnull) id<NSObject> mainWindowObserver;
+
+- (nullable SFTDataFlowLogger *)currentLogger;
 
 @end
 
@@ -70,16 +72,25 @@ NSString *SFTDataFlowEntryDirectionToGlyphTransformerName =
 - (void)windowDidLoad {
   [super windowDidLoad];
 
+  // The table is not bound to the packets: it asks for the rows it shows
+  // whenever it is reloaded, which happens a few times per second at most.
   __weak SFTDataFlowInspectorWindowController *weakSelf = self;
   self.changedNotificationObserver = [NSNotificationCenter.defaultCenter
       addObserverForName:SFTDataFlowLoggerChangedNotificationName
                   object:nil
                    queue:nil
-              usingBlock:^(NSNotification *_Nonnull __unused note) {
+              usingBlock:^(NSNotification *_Nonnull note) {
                 SFTDataFlowInspectorWindowController *strongSelf = weakSelf;
-                (strongSelf.packetLoggerController).content =
-                    [strongSelf.document packetLogger].packets;
-                [strongSelf.packetsTable reloadData];
+                if (note.object == strongSelf.currentLogger) {
+                  [strongSelf.packetsTable reloadData];
+                }
+              }];
+  self.mainWindowObserver = [NSNotificationCenter.defaultCenter
+      addObserverForName:NSWindowDidBecomeMainNotification
+                  object:nil
+                   queue:nil
+              usingBlock:^(NSNotification *_Nonnull __unused note) {
+                [weakSelf.packetsTable reloadData];
               }];
 }
 
@@ -88,6 +99,27 @@ NSString *SFTDataFlowEntryDirectionToGlyphTransformerName =
       removeObserver:self.changedNotificationObserver
                 name:SFTDataFlowLoggerChangedNotificationName
               object:nil];
+  [NSNotificationCenter.defaultCenter
+      removeObserver:self.mainWindowObserver
+                name:NSWindowDidBecomeMainNotification
+              object:nil];
+}
+
+- (nullable SFTDataFlowLogger *)currentLogger {
+  id document = NSApp.mainWindow.windowController.document;
+  return [document isKindOfClass:SFTDocument.class]
+             ? ((SFTDocument *)document).packetLogger
+             : nil;
+}
+
+- (NSInteger)numberOfRowsInTableView:(NSTableView *__unused)tableView {
+  return (NSInteger)self.currentLogger.count;
+}
+
+- (id)tableView:(NSTableView *__unused)tableView
+    objectValueForTableColumn:(NSTableColumn *__unused)tableColumn
+                          row:(NSInteger)row {
+  return (row >= 0) ? [self.currentLogger entryAtIndex:(NSUInteger)row] : nil;
 }
 
 + (nonnull instancetype)sharedInstance {
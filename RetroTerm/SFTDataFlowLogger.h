@@ -30,6 +30,9 @@ typedef NS_ENUM(NSUInteger, SFTDataPacketDirection) {
 
 extern NSNotificationName _Nonnull SFTDataFlowLoggerChangedNotificationName;
 
+/**
+ * A logged packet, only created for the inspector rows being displayed.
+ */
 @interface SFTDataFlowLogEntry : NSObject
 
 @property(assign, nonatomic) NSTimeInterval unixTimestamp;
@@ -38,17 +41,56 @@ extern NSNotificationName _Nonnull SFTDataFlowLoggerChangedNotificationName;
 
 + (nonnull instancetype)dataFlowLogEntryWithBytes:(nonnull NSData *)bytes
                                      andDirection:
-                                         (SFTDataPacketDirection)direction;
+                                         (SFTDataPacketDirection)direction
+                                      atTimestamp:(NSTimeInterval)timestamp;
 
 @end
 
-@interface SFTDataFlowLogger
-    : NSObject <NSTableViewDelegate, NSTableViewDataSource>
+/**
+ * Log of the most recent packets of a session, within a fixed byte budget.
+ *
+ * Packets can be appended from any thread; observers of
+ * SFTDataFlowLoggerChangedNotificationName are notified on the main thread,
+ * no more than a few times per second.
+ */
+@interface SFTDataFlowLogger : NSObject
+
+/**
+ * Whether appended packets are kept, can be changed from any thread.
+ */
+@property(assign, atomic) BOOL enabled;
+
+/**
+ * Amount of packets currently in the log.
+ */
+@property(assign, nonatomic, readonly) NSUInteger count;
 
-@property(strong, nonatomic, nonnull)
-    NSMutableArray<SFTDataFlowLogEntry *> *packets;
+/**
+ * Creates a log whose byte budget comes from the PacketLogByteBudget user
+ * default, if set.
+ */
+- (nonnull instancetype)init;
+
+/**
+ * Creates a log keeping at most the given amount of payload bytes, evicting
+ * the oldest packets first.
+ */
+- (nonnull instancetype)initWithByteBudget:(NSUInteger)byteBudget
+    NS_DESIGNATED_INITIALIZER;
+
+- (void)appendBytes:(nonnull const uint8_t *)bytes
+             length:(size_t)length
+          direction:(SFTDataPacketDirection)direction;
+
+/**
+ * Returns the packet at the given position, oldest first.
+ *
+ * @param[in] index the packet position.
+ *
+ * @return the packet, or nil if it was evicted in the meantime.
+ */
+- (nullable SFTDataFlowLogEntry *)entryAtIndex:(NSUInteger)index;
 
-- (void)appendEntry:(nonnull SFTDataFlowLogEntry *)entry;
 - (void)clear;
 
 @end
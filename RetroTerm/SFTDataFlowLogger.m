@@ -21,17 +21,34 @@
  */
 
 #import "SFTDataFlowLogger.h"
+#import "SFTCommon.h"
+#import "SFTCorePacketLog.h"
+
+#include <os/lock.h>
+#include <stdatomic.h>
+#include <time.h>
 
 NSNotificationName SFTDataFlowLoggerChangedNotificationName =
     @"SFTDataFlowLoggerChangedNotification";
 
+/**
+ * Packet payload bytes kept when no budget is configured.
+ */
+static const NSUInteger kDefaultByteBudget = 1024 * 1024;
+
+/**
+ * Shortest time between two change notifications.
+ */
+static const int64_t kChangeNotificationInterval = NSEC_PER_SEC / 4;
+
 @implementation SFTDataFlowLogEntry
 
 + (nonnull instancetype)dataFlowLogEntryWithBytes:(nonnull NSData *)bytes
                                      andDirection:
-                                         (SFTDataPacketDirection)direction {
+                                         (SFTDataPacketDirection)direction
+                                      atTimestamp:(NSTimeInterval)timestamp {
   SFTDataFlowLogEntry *entry = [[SFTDataFlowLogEntry alloc] init];
-  entry.unixTimestamp = NSDate.date.timeIntervalSince1970;
+  entry.unixTimestamp = timestamp;
   entry.direction = direction;
   entry.contents = bytes;
 
@@ -48,45 +65,120 @@ NSNotificationName SFTDataFlowLoggerChangedNotificationName =
 
 @end
 
-@interface SFTDataFlowLogger ()
+@interface SFTDataFlowLogger () {
+  SFTCorePacketLog _log;
+  os_unfair_lock _lock;
+  atomic_bool _changeScheduled;
+}
+
+- (void)scheduleChangeNotification;
 
 @end
 
 @implementation SFTDataFlowLogger
 
 - (nonnull instancetype)init {
+  NSInteger budget = [NSUserDefaults.standardUserDefaults
+      integerForKey:SFTPacketLogByteBudgetKey];
+  return [self initWithByteBudget:(budget > 0) ? (NSUInteger)budget
+                                               : kDefaultByteBudget];
+}
+
+- (nonnull instancetype)initWithByteBudget:(NSUInteger)byteBudget {
   self = [super init];
   if (self != nil) {
-    _packets = [[NSMutableArray alloc] init];
+    if (!SFTCorePacketLogInitialise(&_log, byteBudget)) {
+      [NSException raise:SFTMemoryException
+                  format:@"Cannot allocate a %lu bytes packet log",
+                         (unsigned long)byteBudget];
+    }
+    _lock = OS_UNFAIR_LOCK_INIT;
+    atomic_init(&_changeScheduled, false);
+    _enabled = YES;
   }
 
   return self;
 }
 
+- (void)dealloc {
+  SFTCorePacketLogRelease(&_log);
+}
+
+- (NSUInteger)count {
+  os_unfair_lock_lock(&_lock);
+  NSUInteger count = _log.count;
+  os_unfair_lock_unlock(&_lock);
+  return count;
+}
+
 - (void)clear {
-  [self.packets removeAllObjects];
+  os_unfair_lock_lock(&_lock);
+  SFTCorePacketLogClear(&_log);
+  os_unfair_lock_unlock(&_lock);
+
   [NSNotificationCenter.defaultCenter
       postNotificationName:SFTDataFlowLoggerChangedNotificationName
-                    object:nil];
+                    object:self];
 }
 
-- (void)appendEntry:(nonnull SFTDataFlowLogEntry *)entry {
-  if (self.packets.count < NSIntegerMax) {
-    [self.packets addObject:entry];
-    [NSNotificationCenter.defaultCenter
-        postNotificationName:SFTDataFlowLoggerChangedNotificationName
-                      object:nil];
+- (void)appendBytes:(nonnull const uint8_t *)bytes
+             length:(size_t)length
+          direction:(SFTDataPacketDirection)direction {
+  if (!self.enabled) {
+    return;
   }
+
+  os_unfair_lock_lock(&_lock);
+  SFTCorePacketLogAppend(&_log, clock_gettime_nsec_np(CLOCK_REALTIME),
+                         direction == SFTDataPacketDirectionInbound, bytes,
+                         length);
+  os_unfair_lock_unlock(&_lock);
+
+  [self scheduleChangeNotification];
 }
 
-- (NSInteger)numberOfRowsInTableView:(NSTableView *)tableView {
-  return (NSInteger)self.packets.count;
+- (void)scheduleChangeNotification {
+  // Packets arriving while a notification is pending are covered by it.
+  if (atomic_exchange(&_changeScheduled, true)) {
+    return;
+  }
+
+  __weak SFTDataFlowLogger *weakSelf = self;
+  dispatch_after(
+      dispatch_time(DISPATCH_TIME_NOW, kChangeNotificationInterval),
+      dispatch_get_main_queue(), ^{
+        SFTDataFlowLogger *strongSelf = weakSelf;
+        if (strongSelf == nil) {
+          return;
+        }
+
+        atomic_store(&strongSelf->_changeScheduled, false);
+        [NSNotificationCenter.defaultCenter
+            postNotificationName:SFTDataFlowLoggerChangedNotificationName
+                          object:strongSelf];
+      });
 }
 
-- (id)tableView:(NSTableView *)tableView
-    objectValueForTableColumn:(NSTableColumn *)tableColumn
-                          row:(NSInteger)row {
-  return self.packets[(NSUInteger)row];
+- (nullable SFTDataFlowLogEntry *)entryAtIndex:(NSUInteger)index {
+  SFTDataFlowLogEntry *entry = nil;
+
+  os_unfair_lock_lock(&_lock);
+  if (index < _log.count) {
+    const uint8_t *payload;
+    const SFTCorePacketLogRecord *record =
+        SFTCorePacketLogGet(&_log, index, &payload);
+    entry = [SFTDataFlowLogEntry
+        dataFlowLogEntryWithBytes:
+            [NSData dataWithBytes:payload
+                           length:SFTCorePacketLogRecordLength(record)]
+                     andDirection:SFTCorePacketLogRecordIsInbound(record)
+                                      ? SFTDataPacketDirectionInbound
+                                      : SFTDataPacketDirectionOutbound
+                      atTimestamp:(NSTimeInterval)record->timestamp / 1e9];
+  }
+  os_unfair_lock_unlock(&_lock);
+
+  return entry;
 }
 
 @end
@@ -45,9 +45,15 @@ NSString *SFTDataToImageTransformerName = @"DataToImageTransformer";
 }
 
 - (id)reverseTransformedValue:(id)value {
-  return [value isKindOfClass:NSImage.class]
-             ? ((NSImage *)value).TIFFRepresentation
-             : nil;
+  if (![value isKindOfClass:NSImage.class]) {
+    return nil;
+  }
+
+  // Stored as PNG, which takes a fraction of the space of TIFF.
+  NSBitmapImageRep *representation = [NSBitmapImageRep
+      imageRepWithData:((NSImage *)value).TIFFRepresentation];
+  return [representation representationUsingType:NSBitmapImageFileTypePNG
+                                       properties:@{}];
 }
 
 @end
@@ -24,6 +24,7 @@
 
 #import "SFTDebugInspectorWindowController.h"
 #import "SFTCommon.h"
+#import "SFTConnectionWindowController.h"
 #import "SFTDocument.h"
 #import "SFTKeyConverter.h"
 
@@ -206,12 +207,16 @@ NSString *SFTIndexToPositionStringTransformerName =
   NSString *result = nil;
   if ((value != nil) && [value isKindOfClass:NSNumber.class]) {
     NSNumber *number = (NSNumber *)value;
-    if (number.integerValue >= 0) {
-      result = [NSString
-          stringWithFormat:@"%ld (x: %lu y: %lu)",
-                           (long)number.unsignedIntegerValue,
-                           number.unsignedIntegerValue % SFTViewColumns,
-                           number.unsignedIntegerValue / SFTViewColumns];
+    // Indices belong to the session in the main window, as bound.
+    NSWindowController *controller = NSApp.mainWindow.windowController;
+    if ((number.integerValue >= 0) &&
+        [controller isKindOfClass:SFTConnectionWindowController.class]) {
+      NSUInteger width = ((SFTConnectionWindowController *)controller)
+                             .terminalContext.width;
+      result = [NSString stringWithFormat:@"%ld (x: %lu y: %lu)",
+                                          (long)number.unsignedIntegerValue,
+                                          number.unsignedIntegerValue % width,
+                                          number.unsignedIntegerValue / width];
     }
   }
 
@@ -46,12 +46,6 @@
  */
 @property(strong, nonatomic, nonnull) id<MTLBuffer> shaderContext;
 
-/**
- * Buffer containing a list of SFTTerminalEmulatorCell instances that represent
- * the screen contents.
- */
-@property(strong, nonatomic, nonnull) id<MTLBuffer> screenContents;
-
 - (nonnull instancetype)initWithEntry:(nonnull SFTAddressBookEntry *)entry
                                 error:(NSError *_Nonnull *_Nullable)error;
 
@@ -59,12 +59,14 @@ static NSString *kDebugWindowName = @"Debug Window";
                           MTLResourceCPUCacheModeWriteCombined];
   SFTShaderContext *context = (SFTShaderContext *)[_shaderContext contents];
 
-  context->cellsTall = (uint16_t)SFTViewRows;
-  context->cellsWide = (uint16_t)SFTViewColumns;
+  // The screen size is only known once the session's window is loaded.
+  context->cellsTall = 0;
+  context->cellsWide = 0;
   context->selectionStart = 0;
   context->selectionEnd = 0;
   context->cursorRow = 0;
   context->cursorColumn = 0;
+  context->baseRow = 0;
   context->flags.lowerCase = YES;
   context->flags.blink = YES;
   context->flags.disconnected = NO;
@@ -148,9 +150,9 @@ static NSString *kDebugWindowName = @"Debug Window";
 }
 
 - (IBAction)useScreenshotAsEntryImage:(id __unused)sender {
-  NSImage *screenshot = self.connectionWindowController.contentsImage;
-  if (screenshot != nil) {
-    self.entry.image = screenshot.TIFFRepresentation;
+  NSData *thumbnail = self.connectionWindowController.contentsThumbnail;
+  if (thumbnail != nil) {
+    self.entry.image = thumbnail;
   }
 }
 
@@ -166,6 +168,11 @@ static NSString *kDebugWindowName = @"Debug Window";
   [self.packetLogger clear];
 }
 
+- (void)setLogPackets:(BOOL)logPackets {
+  _logPackets = logPackets;
+  self.packetLogger.enabled = logPackets;
+}
+
 - (IBAction)replaySavedSession:(id __unused)sender {
   [self.connectionWindowController replaySession];
 }
@@ -220,20 +227,19 @@ static NSString *kDebugWindowName = @"Debug Window";
 - (void)setSelectionRangeFromIndex:(NSUInteger)startIndex
                            toIndex:(NSUInteger)endIndex {
   if (endIndex < startIndex) {
-    self.selectionRange = NSMakeRange(endIndex, endIndex - startIndex);
+    self.selectionRange = NSMakeRange(endIndex, startIndex - endIndex);
   } else {
-    self.selectionRange = NSMakeRange(startIndex, startIndex - endIndex);
+    self.selectionRange = NSMakeRange(startIndex, endIndex - startIndex);
   }
 
   SFTShaderContext *shaderContext =
       (SFTShaderContext *)self.shaderContext.contents;
-  shaderContext->selectionStart =
-      (uint16_t)(self.selectionRange.location & 0xFFFF);
-  shaderContext->selectionEnd = shaderContext->selectionStart +
-                                (uint16_t)(self.selectionRange.length & 0xFFFF);
+  shaderContext->selectionStart = (uint32_t)self.selectionRange.location;
+  shaderContext->selectionEnd =
+      (uint32_t)(self.selectionRange.location + self.selectionRange.length);
   [self.shaderContext
       didModifyRange:NSMakeRange(offsetof(SFTShaderContext, selectionStart),
-                                 sizeof(uint16_t) * 2)];
+                                 sizeof(uint32_t) * 2)];
 }
 
 - (void)setSelectionRangeStart:(NSUInteger)start {
@@ -0,0 +1,475 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#import "SFTEventLoopIOProcessor.h"
+#import "SFTCommon.h"
+#import "SFTSharedResources.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * Outbound ring size, large enough to hold a screenful of pasted text.
+ */
+static const size_t kEventLoopOutputRingCapacity = 64 * 1024;
+
+@interface SFTEventLoopIOProcessor () {
+  SFTCoreEventLoop *_loop;
+  SFTCoreEventSource _source;
+  SFTCoreByteRing _outputRing;
+  atomic_bool _writeScheduled;
+}
+
+@property(strong, nonatomic, nonnull) NSURL *url;
+
+/**
+ * Cleared by stop, so that a connection completing afterwards is dropped.
+ */
+@property(assign, atomic) BOOL running;
+
+/**
+ * Loop thread only: whether the socket is registered with the loop.
+ */
+@property(assign, nonatomic) BOOL attached;
+
+/**
+ * Loop thread only: whether the non-blocking connection completed.
+ */
+@property(assign, nonatomic) BOOL connected;
+
+/**
+ * Loop thread only: whether reading stopped because the input ring is full.
+ */
+@property(assign, nonatomic) BOOL readSuspended;
+
+/**
+ * Outgoing bytes that did not fit in the output ring, main thread only.
+ */
+@property(strong, nonatomic, nonnull) NSMutableData *outputOverflow;
+
+/**
+ * Amount of outputOverflow bytes already moved into the output ring.
+ */
+@property(assign, nonatomic) NSUInteger outputOverflowOffset;
+
+- (nonnull instancetype)initWithURL:(nonnull NSURL *)url;
+- (void)performOnLoop:(nonnull SFTCoreEventLoopTask)task;
+- (void)attachToLoop;
+- (void)detachFromLoopNotifying:(BOOL)notify;
+- (void)handleEvents:(uint32_t)events;
+- (BOOL)readFromSocket;
+- (void)writeToSocket;
+- (void)updateInterest;
+- (void)resumeReading;
+- (void)scheduleWrite;
+- (void)flushOutputOverflow;
+
+@end
+
+// Every task receives a retained reference to its processor and takes
+// ownership of it, so the processor outlives anything queued on the loop.
+
+static void SFTEventLoopIOProcessorAttachTask(void *context) {
+  [(__bridge_transfer SFTEventLoopIOProcessor *)context attachToLoop];
+}
+
+static void SFTEventLoopIOProcessorDetachTask(void *context) {
+  [(__bridge_transfer SFTEventLoopIOProcessor *)context
+      detachFromLoopNotifying:NO];
+}
+
+static void SFTEventLoopIOProcessorResumeTask(void *context) {
+  [(__bridge_transfer SFTEventLoopIOProcessor *)context resumeReading];
+}
+
+static void SFTEventLoopIOProcessorWriteTask(void *context) {
+  SFTEventLoopIOProcessor *processor =
+      (__bridge_transfer SFTEventLoopIOProcessor *)context;
+  [processor writeToSocket];
+  [processor updateInterest];
+}
+
+static void SFTEventLoopIOProcessorReleaseTask(void *context) {
+  CFBridgingRelease(context);
+}
+
+static void SFTEventLoopIOProcessorSourceReady(SFTCoreEventSource *source,
+                                               uint32_t events) {
+  [(__bridge SFTEventLoopIOProcessor *)source->userData handleEvents:events];
+}
+
+@implementation SFTEventLoopIOProcessor
+
+- (nonnull instancetype)initWithURL:(nonnull NSURL *)url {
+  self = [super init];
+  if (self != nil) {
+    _url = url;
+    _loop = SFTSharedResources.sharedInstance.eventLoop;
+    _source.descriptor = -1;
+    _source.callback = SFTEventLoopIOProcessorSourceReady;
+    atomic_init(&_writeScheduled, false);
+    _outputOverflow = [NSMutableData new];
+    _outputOverflowOffset = 0;
+    if (!SFTCoreByteRingInitialise(&_outputRing,
+                                   kEventLoopOutputRingCapacity)) {
+      [NSException raise:SFTInternalErrorException
+                  format:@"Cannot allocate output ring"];
+    }
+  }
+
+  return self;
+}
+
+- (void)dealloc {
+  SFTCoreByteRingRelease(&_outputRing);
+}
+
++ (nullable instancetype)eventLoopIOProcessorWithURL:(nonnull NSURL *)url {
+  if (url.host == nil) {
+    return nil;
+  }
+
+  return [[SFTEventLoopIOProcessor alloc] initWithURL:url];
+}
+
++ (int)connectToHost:(nonnull NSString *)host port:(NSUInteger)port {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  struct addrinfo *addresses;
+  if (getaddrinfo(host.UTF8String, @(port).stringValue.UTF8String, &hints,
+                  &addresses) != 0) {
+    return -1;
+  }
+
+  int descriptor = -1;
+  for (struct addrinfo *address = addresses; address != NULL;
+       address = address->ai_next) {
+    descriptor = socket(address->ai_family, address->ai_socktype,
+                        address->ai_protocol);
+    if (descriptor < 0) {
+      continue;
+    }
+
+    int enabled = 1;
+    setsockopt(descriptor, SOL_SOCKET, SO_NOSIGPIPE, &enabled,
+               sizeof(enabled));
+    int flags = fcntl(descriptor, F_GETFL);
+    if ((flags >= 0) && (fcntl(descriptor, F_SETFL, flags | O_NONBLOCK) == 0) &&
+        ((connect(descriptor, address->ai_addr, address->ai_addrlen) == 0) ||
+         (errno == EINPROGRESS))) {
+      break;
+    }
+
+    close(descriptor);
+    descriptor = -1;
+  }
+
+  freeaddrinfo(addresses);
+  return descriptor;
+}
+
+- (void)start {
+  if (self.inputRing == NULL) {
+    [NSException raise:SFTInternalErrorException
+                format:@"No input ring set before starting"];
+  }
+
+  [self preparePipeline];
+  self.running = YES;
+  NSString *host = self.url.host;
+  NSUInteger port = (self.url.port != nil) ? self.url.port.unsignedIntegerValue
+                                           : SFTDefaultPort;
+
+  // Name resolution blocks, so it must not happen on the shared loop.
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+    int descriptor = [SFTEventLoopIOProcessor connectToHost:host port:port];
+    if (descriptor < 0) {
+      dispatch_async(dispatch_get_main_queue(), ^{
+        [self.delegate ioProcessor:self
+                     receivedEvent:SFTIOProcessorEventDisconnected
+                          withData:nil];
+      });
+      return;
+    }
+
+    self->_source.descriptor = descriptor;
+    [self performOnLoop:SFTEventLoopIOProcessorAttachTask];
+  });
+}
+
+- (void)stop {
+  self.running = NO;
+  [self performOnLoop:SFTEventLoopIOProcessorDetachTask];
+}
+
+- (void)resumeInput {
+  [self performOnLoop:SFTEventLoopIOProcessorResumeTask];
+}
+
+- (void)sendData:(nonnull NSData *)data {
+  // Anything already waiting in the overflow buffer has to go out first.
+  if (self.outputOverflow.length > 0) {
+    [self.outputOverflow appendData:data];
+    return;
+  }
+
+  size_t written = SFTCoreByteRingWrite(
+      &_outputRing, (const uint8_t *)data.bytes, data.length);
+  if (written < data.length) {
+    [self.outputOverflow
+        appendBytes:(const uint8_t *)data.bytes + written
+             length:data.length - written];
+    [self flushOutputOverflow];
+    return;
+  }
+
+  [self scheduleWrite];
+}
+
+- (void)flushOutputOverflow {
+  while (self.outputOverflowOffset < self.outputOverflow.length) {
+    size_t written = SFTCoreByteRingWrite(
+        &_outputRing,
+        (const uint8_t *)self.outputOverflow.bytes + self.outputOverflowOffset,
+        self.outputOverflow.length - self.outputOverflowOffset);
+    self.outputOverflowOffset += written;
+
+    if (written == 0) {
+      // The loop calls back once it has made room, unless room was made
+      // while suspending.
+      if (SFTCoreByteRingSuspendProducer(&_outputRing)) {
+        [self scheduleWrite];
+        return;
+      }
+    }
+  }
+
+  self.outputOverflow.length = 0;
+  self.outputOverflowOffset = 0;
+  [self scheduleWrite];
+}
+
+- (void)scheduleWrite {
+  if (atomic_exchange(&_writeScheduled, true)) {
+    return;
+  }
+
+  [self performOnLoop:SFTEventLoopIOProcessorWriteTask];
+}
+
+- (void)performOnLoop:(nonnull SFTCoreEventLoopTask)task {
+  void *context = (__bridge_retained void *)self;
+  if (!SFTCoreEventLoopPerform(_loop, task, context)) {
+    CFBridgingRelease(context);
+  }
+}
+
+- (void)attachToLoop {
+  if (!self.running) {
+    close(_source.descriptor);
+    _source.descriptor = -1;
+    return;
+  }
+
+  // The loop holds a reference to the processor while the socket is
+  // registered, balanced when detaching.
+  _source.userData = (__bridge_retained void *)self;
+  if (!SFTCoreEventLoopAddSource(_loop, &_source, SFTCoreEventWritable)) {
+    close(_source.descriptor);
+    _source.descriptor = -1;
+    CFBridgingRelease(_source.userData);
+    _source.userData = NULL;
+    dispatch_async(dispatch_get_main_queue(), ^{
+      [self.delegate ioProcessor:self
+                   receivedEvent:SFTIOProcessorEventDisconnected
+                        withData:nil];
+    });
+    return;
+  }
+
+  self.attached = YES;
+}
+
+- (void)detachFromLoopNotifying:(BOOL)notify {
+  if (!self.attached) {
+    return;
+  }
+
+  int descriptor = _source.descriptor;
+  SFTCoreEventLoopRemoveSource(_loop, &_source);
+  close(descriptor);
+  self.attached = NO;
+  self.connected = NO;
+
+  // Released once the current batch of events was dispatched, as it may
+  // still reference the source.
+  if (!SFTCoreEventLoopPerform(_loop, SFTEventLoopIOProcessorReleaseTask,
+                               _source.userData)) {
+    CFBridgingRelease(_source.userData);
+  }
+  _source.userData = NULL;
+
+  if (notify) {
+    dispatch_async(dispatch_get_main_queue(), ^{
+      [self.delegate ioProcessor:self
+                   receivedEvent:SFTIOProcessorEventDisconnected
+                        withData:nil];
+    });
+  }
+}
+
+- (void)handleEvents:(uint32_t)events {
+  if (!self.connected) {
+    // The first writable event completes the non-blocking connection.
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if ((getsockopt(_source.descriptor, SOL_SOCKET, SO_ERROR, &error,
+                    &length) != 0) ||
+        (error != 0)) {
+      [self detachFromLoopNotifying:YES];
+      return;
+    }
+    self.connected = YES;
+  }
+
+  if ((events & SFTCoreEventReadable) && ![self readFromSocket]) {
+    [self detachFromLoopNotifying:YES];
+    return;
+  }
+
+  // Bytes injected by the pipeline, such as negotiation replies, are sent
+  // as soon as they are queued.
+  if ((events & SFTCoreEventWritable) || self.hasInjectedOutbound) {
+    [self writeToSocket];
+  }
+
+  [self updateInterest];
+}
+
+- (BOOL)readFromSocket {
+  // Bytes are read straight into the ring, without any intermediate copy.
+  for (;;) {
+    uint8_t *span;
+    size_t length = [self deliverInjectedInbound]
+                        ? SFTCoreByteRingWritableSpan(self.inputRing, &span)
+                        : 0;
+    if (length == 0) {
+      // Stop watching for input until the consumer makes room and calls
+      // resumeInput, unless some room was freed while suspending.
+      if (SFTCoreByteRingSuspendProducer(self.inputRing)) {
+        self.readSuspended = YES;
+        return YES;
+      }
+      continue;
+    }
+
+    ssize_t bytesRead = read(_source.descriptor, span, length);
+    if (bytesRead > 0) {
+      // The pipeline works on the span in place, and only what it leaves
+      // is handed over to the emulator.  The loop being the only writer,
+      // the span cannot change under it.
+      size_t kept = [self processInboundBytes:span length:(size_t)bytesRead];
+      if (kept > 0) {
+        SFTCoreByteRingCommitWrite(self.inputRing, kept);
+      }
+      continue;
+    }
+
+    if (bytesRead == 0) {
+      // End of stream
+      return NO;
+    }
+
+    return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+  }
+}
+
+- (void)writeToSocket {
+  atomic_store(&_writeScheduled, false);
+  if (!self.connected) {
+    return;
+  }
+
+  // Everything queued so far goes out in as few writes as possible, one per
+  // span; partial writes only move the ring's read index.
+  for (;;) {
+    const uint8_t *span;
+    size_t length = [self outboundSpan:&span fromRing:&_outputRing];
+    if (length == 0) {
+      break;
+    }
+
+    ssize_t bytesWritten = write(_source.descriptor, span, length);
+    if (bytesWritten <= 0) {
+      // Error or socket buffer full
+      break;
+    }
+
+    [self commitOutbound:(size_t)bytesWritten fromRing:&_outputRing];
+  }
+
+  if (SFTCoreByteRingResumeProducer(&_outputRing)) {
+    dispatch_async(dispatch_get_main_queue(), ^{
+      [self flushOutputOverflow];
+    });
+  }
+}
+
+- (void)updateInterest {
+  if (!self.attached) {
+    return;
+  }
+
+  uint32_t interest = SFTCoreEventWritable;
+  if (self.connected) {
+    interest = self.readSuspended ? 0 : SFTCoreEventReadable;
+    if ((SFTCoreByteRingAvailable(&_outputRing) > 0) ||
+        self.hasInjectedOutbound) {
+      interest |= SFTCoreEventWritable;
+    }
+  }
+
+  SFTCoreEventLoopSetInterest(_loop, &_source, interest);
+}
+
+- (void)resumeReading {
+  self.readSuspended = NO;
+  if (!self.attached || !self.connected) {
+    return;
+  }
+
+  if (![self readFromSocket]) {
+    [self detachFromLoopNotifying:YES];
+    return;
+  }
+
+  [self updateInterest];
+}
+
+@end
@@ -22,17 +22,25 @@
 
 @import Foundation;
 
+#import "SFTCoreByteRing.h"
+#import "SFTCoreCapture.h"
+#import "SFTCorePipeline.h"
+#import "SFTDataFlowLogger.h"
+#import "SFTTerminalEmulatorContext.h"
+
 @class SFTIOProcessor;
 
 typedef NS_ENUM(NSUInteger, SFTIOProcessorEvent) {
-  SFTIOProcessorEventDisconnected = 0,
-  SFTIOProcessorEventReceivedData
+  SFTIOProcessorEventDisconnected = 0
 };
 
 @protocol SFTIOProcessorDelegate <NSObject>
 
 @required
 
+/**
+ * Notifies the delegate of an I/O event, always on the main thread.
+ */
 - (void)ioProcessor:(nonnull SFTIOProcessor *)processor
       receivedEvent:(SFTIOProcessorEvent)event
            withData:(nullable NSData *)data;
@@ -43,8 +51,133 @@ typedef NS_ENUM(NSUInteger, SFTIOProcessorEvent) {
 
 @property(weak, nonatomic, nullable) id<SFTIOProcessorDelegate> delegate;
 
+/**
+ * Ring receiving incoming bytes, must be set before the processor starts.
+ *
+ * The processor is the ring's only producer: when the ring fills up it stops
+ * reading until resumeInput is invoked.
+ */
+@property(assign, nonatomic, nullable) SFTCoreByteRing *inputRing;
+
+/**
+ * Capture the session is being recorded to, or NULL when not recording.
+ */
+@property(assign, nonatomic, readonly, nullable)
+    SFTCoreCaptureWriter *captureWriter;
+
+/**
+ * Log every packet sent and received is appended to, if any; must be set
+ * before the processor starts.
+ */
+@property(strong, nonatomic, nullable) SFTDataFlowLogger *packetLogger;
+
 - (void)start;
 - (void)sendData:(nonnull NSData *)data;
 - (void)stop;
 
+/**
+ * Resumes reading after the input ring consumer freed some space, following
+ * a producer suspension.  Can be called from any thread.
+ */
+- (void)resumeInput;
+
+/**
+ * Starts recording every packet sent and received to the given file, must
+ * be called before the processor starts.
+ *
+ * The capture is completed when the processor is deallocated, once its I/O
+ * thread can no longer touch it.
+ *
+ * @param[in] url the capture file, replaced if it already exists.
+ * @param[in] context the emulator context the session starts from.
+ * @param[in] cellBuffer the screen contents the session starts from.
+ *
+ * @return YES if the capture was created, NO otherwise.
+ */
+- (BOOL)startCaptureToURL:(nonnull NSURL *)url
+               forContext:(nonnull SFTTerminalEmulatorContext *)context
+             onCellBuffer:(nonnull const SFTTerminalEmulatorCell *)cellBuffer;
+
+/**
+ * Makes the processor strip Telnet commands from incoming bytes and answer
+ * negotiations, must be called before the processor starts.
+ *
+ * @param[in] width the window width reported to the server, in cells.
+ * @param[in] height the window height reported to the server, in cells.
+ */
+- (void)enableTelnetWithWidth:(NSUInteger)width height:(NSUInteger)height;
+
+/**
+ * Adds a stage to the pipeline bytes go through between the transport and
+ * the emulator, must be called before the processor starts.
+ *
+ * Stages added this way sit past the built-in ones, from the transport
+ * side: the packet log, which sees bytes as they are on the wire, the
+ * Telnet filter, and the session capture.  Stages are only ever run from
+ * the processor's I/O thread.
+ *
+ * @param[in] process the stage's processing function.
+ * @param[in] context the stage's private data, not retained.
+ *
+ * @return YES if the stage was added, NO if there is no room left for it.
+ */
+- (BOOL)addPipelineStage:(nonnull SFTCorePipelineProcess)process
+                 context:(nullable void *)context;
+
+/**
+ * Assembles the pipeline from the stages configured so far, must be called
+ * by subclasses when starting and before any byte goes through.
+ */
+- (void)preparePipeline;
+
+/**
+ * Runs bytes just read from the transport through the pipeline, in place.
+ * Must only be called from the processor's I/O thread.
+ *
+ * @param[in,out] bytes the incoming bytes, replaced by what is left of them.
+ * @param[in] length the incoming bytes length.
+ *
+ * @return the amount of bytes left for the emulator.
+ */
+- (size_t)processInboundBytes:(nonnull uint8_t *)bytes length:(size_t)length;
+
+/**
+ * Moves bytes injected towards the emulator by pipeline stages into the
+ * input ring.  Must only be called from the processor's I/O thread, before
+ * reading anything else from the transport.
+ *
+ * @return YES if nothing is left to move, NO if the ring is full.
+ */
+- (BOOL)deliverInjectedInbound;
+
+/**
+ * Whether bytes injected towards the transport by pipeline stages are
+ * waiting to be sent.  Must only be called from the processor's I/O thread.
+ */
+@property(assign, nonatomic, readonly) BOOL hasInjectedOutbound;
+
+/**
+ * Returns the next outgoing span to write to the transport, running bytes
+ * queued in the given ring through the pipeline first.  Must only be
+ * called from the processor's I/O thread, the ring's only consumer.
+ *
+ * Injected bytes come first, but never in the middle of a span taken from
+ * the ring.
+ *
+ * @param[out] span the outgoing span.
+ * @param[in,out] ring the ring queued outgoing bytes are taken from.
+ *
+ * @return the span length, or 0 if there is nothing to write.
+ */
+- (size_t)outboundSpan:(const uint8_t *_Nonnull *_Nonnull)span
+              fromRing:(nonnull SFTCoreByteRing *)ring;
+
+/**
+ * Marks part of the span returned by outboundSpan:fromRing: as written.
+ *
+ * @param[in] length the amount of bytes written from the start of the span.
+ * @param[in,out] ring the ring the span was taken from.
+ */
+- (void)commitOutbound:(size_t)length fromRing:(nonnull SFTCoreByteRing *)ring;
+
 @end
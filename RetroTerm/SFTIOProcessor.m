@@ -22,9 +22,81 @@
 
 #import "SFTIOProcessor.h"
 #import "SFTCommon.h"
+#import "SFTCoreTelnet.h"
+
+#include <time.h>
+
+/**
+ * Terminal type reported to servers asking for it, so PETSCII aware boards
+ * can skip their own detection.
+ */
+static const char *kTelnetTerminalType = "PETSCII";
+
+@interface SFTIOProcessor () {
+  SFTCoreCaptureWriter _capture;
+  SFTCoreTelnet _telnet;
+  SFTCorePipeline _pipeline;
+
+  /**
+   * Stages added with addPipelineStage:context:, kept apart until the
+   * pipeline is assembled past the built-in ones.
+   */
+  SFTCorePipelineStage _extraStages[SFTCorePipelineMaximumStages];
+  size_t _extraStagesCount;
+
+  /**
+   * Bytes at the front of the output ring that went through the pipeline
+   * and are still to be written, and bytes right after them that stages
+   * dropped, to be skipped once the former are out.
+   */
+  size_t _outboundPending;
+  size_t _outboundDropped;
+}
+
+@property(assign, nonatomic) BOOL capturing;
+@property(assign, nonatomic) BOOL telnetEnabled;
+
+@end
+
+static size_t SFTIOProcessorPacketLogStage(SFTCorePipeline *pipeline,
+                                           size_t stage,
+                                           SFTCorePipelineDirection direction,
+                                           uint8_t *bytes, size_t length) {
+  [(__bridge SFTDataFlowLogger *)SFTCorePipelineContext(pipeline, stage)
+      appendBytes:bytes
+           length:length
+        direction:direction == SFTCorePipelineDirectionInbound
+                      ? SFTDataPacketDirectionInbound
+                      : SFTDataPacketDirectionOutbound];
+  return length;
+}
+
+static size_t SFTIOProcessorCaptureStage(SFTCorePipeline *pipeline,
+                                         size_t stage,
+                                         SFTCorePipelineDirection direction,
+                                         uint8_t *bytes, size_t length) {
+  SFTCoreCaptureWriterAppend(
+      (SFTCoreCaptureWriter *)SFTCorePipelineContext(pipeline, stage),
+      clock_gettime_nsec_np(CLOCK_REALTIME),
+      direction == SFTCorePipelineDirectionInbound
+          ? SFTCoreCaptureRecordInbound
+          : SFTCoreCaptureRecordOutbound,
+      bytes, length);
+  return length;
+}
 
 @implementation SFTIOProcessor
 
+- (void)dealloc {
+  if (self.capturing) {
+    SFTCoreCaptureWriterClose(&_capture);
+  }
+}
+
+- (nullable SFTCoreCaptureWriter *)captureWriter {
+  return self.capturing ? &_capture : NULL;
+}
+
 - (void)start {
   [NSException raise:SFTInternalErrorException
               format:@"Forgot to override %@", NSStringFromSelector(_cmd)];
@@ -40,4 +112,150 @@
               format:@"Forgot to override %@", NSStringFromSelector(_cmd)];
 }
 
+- (void)resumeInput {
+}
+
+- (BOOL)startCaptureToURL:(nonnull NSURL *)url
+               forContext:(nonnull SFTTerminalEmulatorContext *)context
+             onCellBuffer:(nonnull const SFTTerminalEmulatorCell *)cellBuffer {
+  if (self.capturing) {
+    return NO;
+  }
+
+  self.capturing = SFTCoreCaptureWriterOpen(
+      &_capture, url.fileSystemRepresentation, context.state, cellBuffer,
+      SFTCoreCaptureDefaultCheckpointInterval,
+      clock_gettime_nsec_np(CLOCK_REALTIME));
+  return self.capturing;
+}
+
+- (void)enableTelnetWithWidth:(NSUInteger)width height:(NSUInteger)height {
+  SFTCoreTelnetInitialise(&_telnet, (uint16_t)width, (uint16_t)height,
+                          kTelnetTerminalType);
+  self.telnetEnabled = YES;
+}
+
+- (BOOL)addPipelineStage:(nonnull SFTCorePipelineProcess)process
+                 context:(nullable void *)context {
+  if (_extraStagesCount == SFTCorePipelineMaximumStages) {
+    return NO;
+  }
+
+  _extraStages[_extraStagesCount].process = process;
+  _extraStages[_extraStagesCount].context = context;
+  _extraStagesCount++;
+  return YES;
+}
+
+- (void)preparePipeline {
+  SFTCorePipelineInitialise(&_pipeline);
+  _outboundPending = 0;
+  _outboundDropped = 0;
+
+  if (self.packetLogger != nil) {
+    SFTCorePipelineAppend(&_pipeline, SFTIOProcessorPacketLogStage,
+                          (__bridge void *)self.packetLogger);
+  }
+
+  if (self.telnetEnabled) {
+    SFTCorePipelineAppend(&_pipeline, SFTCoreTelnetProcess, &_telnet);
+  }
+
+  // The capture only holds what the emulator sees, so it can be replayed.
+  if (self.capturing) {
+    SFTCorePipelineAppend(&_pipeline, SFTIOProcessorCaptureStage, &_capture);
+  }
+
+  for (size_t index = 0; index < _extraStagesCount; index++) {
+    if (!SFTCorePipelineAppend(&_pipeline, _extraStages[index].process,
+                               _extraStages[index].context)) {
+      [NSException raise:SFTInternalErrorException
+                  format:@"Too many pipeline stages"];
+    }
+  }
+}
+
+- (size_t)processInboundBytes:(nonnull uint8_t *)bytes length:(size_t)length {
+  return SFTCorePipelineRun(&_pipeline, SFTCorePipelineDirectionInbound, bytes,
+                            length);
+}
+
+- (BOOL)deliverInjectedInbound {
+  const SFTCorePipelineInjection *injected =
+      SFTCorePipelineInjected(&_pipeline, SFTCorePipelineDirectionInbound);
+  if (injected->length == 0) {
+    return YES;
+  }
+
+  size_t written =
+      SFTCoreByteRingWrite(self.inputRing, injected->bytes, injected->length);
+  SFTCorePipelineConsumeInjected(&_pipeline, SFTCorePipelineDirectionInbound,
+                                 written);
+  return injected->length == 0;
+}
+
+- (BOOL)hasInjectedOutbound {
+  return SFTCorePipelineInjected(&_pipeline, SFTCorePipelineDirectionOutbound)
+             ->length > 0;
+}
+
+- (size_t)outboundSpan:(const uint8_t *_Nonnull *_Nonnull)span
+              fromRing:(nonnull SFTCoreByteRing *)ring {
+  if (_outboundPending > 0) {
+    SFTCoreByteRingReadableSpan(ring, span);
+    return _outboundPending;
+  }
+
+  for (;;) {
+    const SFTCorePipelineInjection *injected =
+        SFTCorePipelineInjected(&_pipeline, SFTCorePipelineDirectionOutbound);
+    if (injected->length > 0) {
+      *span = injected->bytes;
+      return injected->length;
+    }
+
+    const uint8_t *queued;
+    size_t length = SFTCoreByteRingReadableSpan(ring, &queued);
+    if (length == 0) {
+      return 0;
+    }
+
+    // The Telnet stage may need twice the room to escape the span.
+    if (length > SFTCoreTelnetOutboundSpanCapacity) {
+      length = SFTCoreTelnetOutboundSpanCapacity;
+    }
+
+    // The span belongs to the consumer until committed, so stages can work
+    // on it in place.  It only goes through them once, however many writes
+    // it takes to send it.
+    _outboundPending = SFTCorePipelineRun(
+        &_pipeline, SFTCorePipelineDirectionOutbound, (uint8_t *)queued,
+        length);
+    _outboundDropped = length - _outboundPending;
+    if (_outboundPending > 0) {
+      *span = queued;
+      return _outboundPending;
+    }
+
+    SFTCoreByteRingCommitRead(ring, _outboundDropped);
+    _outboundDropped = 0;
+  }
+}
+
+- (void)commitOutbound:(size_t)length
+              fromRing:(nonnull SFTCoreByteRing *)ring {
+  if (_outboundPending == 0) {
+    SFTCorePipelineConsumeInjected(&_pipeline,
+                                   SFTCorePipelineDirectionOutbound, length);
+    return;
+  }
+
+  _outboundPending -= length;
+  if (_outboundPending == 0) {
+    length += _outboundDropped;
+    _outboundDropped = 0;
+  }
+  SFTCoreByteRingCommitRead(ring, length);
+}
+
 @end
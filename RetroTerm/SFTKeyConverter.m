@@ -21,78 +21,15 @@
  */
 
 #import "SFTKeyConverter.h"
-
-static const uint16_t kUnmappedKey = 0xFFFF;
-
-static const uint16_t kControlBell = 0x0200;
-static const uint16_t kControlBackspace = 0x0201;
-static const uint16_t kControlNewLine = 0x0202;
-static const uint16_t kControlCarriageReturn = 0x0203;
-static const uint16_t kControlIgnore = 0x0208;
+#import "SFTCoreCharacterSet.h"
+#import "SFTPETSCIIConverter.h"
 
 static const uint8_t kPETSCIIMovementUpKey = 145;
 static const uint8_t kPETSCIIMovementDownKey = 17;
-static const uint8_t kPETSCIIMovementLeftKey = 147;
+static const uint8_t kPETSCIIMovementLeftKey = 157;
 static const uint8_t kPETSCIIMovementRightKey = 29;
-
-#define ____ kUnmappedKey
-#define CBEL kControlBell
-#define CBSP kControlBackspace
-#define CNLN kControlNewLine
-#define CCRN kControlCarriageReturn
-#define CIGN kControlIgnore
-
-// clang-format off
-
-static const uint16_t kPETSCIIKeyCodeToASCII[256] = {
-    // 0     1     2     3     4     5     6     7     8     9     A     B     C     D     E     F
-    0x40, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F, // 0
-    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x5B, ____, 0x5D, ____, ____, // 1
-    0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, // 2
-    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F, // 3
-    ____, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, // 4
-    0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, ____, ____, ____, ____, ____, // 5
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // 6
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // 7
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // 8
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // 9
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // A
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // B
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // C
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // D
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // E
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____  // F
-};
-
-// @TODO: Merge with kASCIILookupLowerCase?
-static const uint16_t kKeycodeToPETSCIILookup[256] = {
-    // 0     1     2     3     4     5     6     7     8     9     A     B     C     D     E     F
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, 0x0D, ____, ____, // 0
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // 1
-    0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, // 2
-    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F, // 3
-    0x40, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F, // 4
-    0x70, 0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x7B, ____, 0x1D, ____, ____, // 5
-    ____, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, // 6
-    0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, ____, ____, ____, ____, 0x14, // 7
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // 8
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // 9
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // A
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // B
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // C
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // D
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, // E
-    ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____, ____  // F
-};
-
-// clang-format on
-
-#undef ____
-#undef CBEL
-#undef CBSP
-#undef CNLN
-#undef CCRN
-#undef CIGN
+static const uint8_t kPETSCIIReturnKey = 13;
+static const uint8_t kPETSCIIDeleteKey = 20;
 
 const NSUInteger SFTUnmappedKey = NSUIntegerMax;
 
@@ -436,6 +373,12 @@ const NSUInteger SFTUnmappedKey = NSUIntegerMax;
   case NSRightArrowFunctionKey:
     return kPETSCIIMovementRightKey;
 
+  case 0x0D:
+    return kPETSCIIReturnKey;
+
+  case 0x7F:
+    return kPETSCIIDeleteKey;
+
   default:
     break;
   }
@@ -444,8 +387,8 @@ const NSUInteger SFTUnmappedKey = NSUIntegerMax;
     return SFTUnmappedKey;
   }
 
-  uint16_t mapped = kKeycodeToPETSCIILookup[keyCode & 0xFF];
-  if (mapped == kUnmappedKey) {
+  uint16_t mapped = SFTASCIIToPETSCII[keyCode];
+  if (mapped == SFTUnmappedPETSCIICharacter) {
     return SFTUnmappedKey;
   }
 
@@ -457,47 +400,13 @@ const NSUInteger SFTUnmappedKey = NSUIntegerMax;
     return nil;
   }
 
-  switch (keyCode) {
-  default: {
-    uint16_t mapped = kPETSCIIKeyCodeToASCII[keyCode];
-    switch (mapped) {
-    case kControlBell:
-      return @"BELL";
-
-    case kControlBackspace:
-      return @"BACKSPACE";
-
-    case kControlNewLine:
-      return @"NEW LINE";
-
-    case kControlCarriageReturn:
-      return @"CARRIAGE RETURN";
-
-    case kControlIgnore:
-      return nil;
-
-    case kUnmappedKey:
-      switch (keyCode) {
-      case kPETSCIIMovementUpKey:
-        return @"CURSOR UP";
-
-      case kPETSCIIMovementDownKey:
-        return @"CURSOR DOWN";
-
-      case kPETSCIIMovementLeftKey:
-        return @"CURSOR LEFT";
-
-      case kPETSCIIMovementRightKey:
-        return @"CURSOR RIGHT";
-      default:
-        return nil;
-      }
-
-    default:
-      return [NSString stringWithFormat:@"%c", (unichar)mapped];
-    }
-  }
+  uint16_t mapped = SFTPETSCIIToASCII[keyCode];
+  if (mapped != SFTUnmappedASCIICharacter) {
+    return [NSString stringWithFormat:@"%c", (unichar)mapped];
   }
+
+  return [SFTPETSCIIConverter
+      nameForPETSCIIControlCode:SFTPETSCIIToFontIndex[keyCode]];
 }
 
 @end
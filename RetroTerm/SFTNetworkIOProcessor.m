@@ -24,32 +24,43 @@
 #import "SFTCommon.h"
 
 #include <mach/mach.h>
+#include <stdatomic.h>
 
-#define NETWORK_READ_BUFFER_SIZE 512
-#define NETWORK_WRITE_BUFFER_SIZE 64
-
-static const NSUInteger kNetworkReadBufferSize = 512;
-static const NSUInteger kNetworkWriteBufferSize = 64;
+/**
+ * Outbound ring size, large enough to hold a screenful of pasted text.
+ */
+static const size_t kNetworkOutputRingCapacity = 64 * 1024;
 
 @class SFTNetworkIOProcessor;
 @class SFTNetworkBackgroundThread;
 
-@interface SFTNetworkIOProcessor () <NSStreamDelegate>
+@interface SFTNetworkIOProcessor () <NSStreamDelegate> {
+  SFTCoreByteRing _outputRing;
+}
 
 @property(strong, nonatomic, nonnull)
     SFTNetworkBackgroundThread *backgroundThread;
 @property(strong, nonatomic, nonnull) NSURL *url;
 
+/**
+ * Outgoing bytes that did not fit in the output ring, main thread only.
+ */
+@property(strong, nonatomic, nonnull) NSMutableData *outputOverflow;
+
+/**
+ * Amount of outputOverflow bytes already moved into the output ring.
+ */
+@property(assign, nonatomic) NSUInteger outputOverflowOffset;
+
 - (nonnull instancetype)initWithURL:(nonnull NSURL *)url;
-- (void)backgroundThreadReceivedData:(nonnull NSData *)data;
+- (void)flushOutputOverflow;
 - (void)backgroundThreadDisconnected;
 
 @end
 
-@interface SFTNetworkBackgroundThread : NSThread <NSStreamDelegate>
-
-@property(strong, nonatomic, nonnull)
-    NSMutableArray<NSData *> *outputBacklogQueue;
+@interface SFTNetworkBackgroundThread : NSThread <NSStreamDelegate> {
+  atomic_bool _writeScheduled;
+}
 
 @property(strong, nonatomic, nonnull) NSInputStream *inputStream;
 @property(strong, nonatomic, nonnull) NSOutputStream *outputStream;
@@ -57,26 +68,44 @@ static const NSUInteger kNetworkWriteBufferSize = 64;
 
 @property(assign, atomic) BOOL running;
 
+/**
+ * Incoming bytes destination, this thread being its only producer.
+ */
+@property(assign, nonatomic, nonnull) SFTCoreByteRing *inputRing;
+
+/**
+ * Outgoing bytes source, this thread being its only consumer.
+ */
+@property(assign, nonatomic, nonnull) SFTCoreByteRing *outputRing;
+
 @property(weak, nonatomic) SFTNetworkIOProcessor *processor;
 
 - (nonnull instancetype)initWithURL:(nonnull NSURL *)url
-                     usingProcessor:(nonnull SFTNetworkIOProcessor *)processor;
+                     usingProcessor:(nonnull SFTNetworkIOProcessor *)processor
+                     withOutputRing:(nonnull SFTCoreByteRing *)outputRing;
 - (void)readDataFromStream;
 - (void)writeDataToStream;
 - (void)disconnected;
 
-- (void)enqueueBuffer:(nonnull NSData *)buffer;
+/**
+ * Makes the thread flush the output ring, can be called from any thread.
+ *
+ * Requests made while a flush is already pending are merged into it.
+ */
+- (void)scheduleWrite;
 
 @end
 
 @implementation SFTNetworkBackgroundThread
 
 - (nonnull instancetype)initWithURL:(nonnull NSURL *)url
-                     usingProcessor:(nonnull SFTNetworkIOProcessor *)processor {
+                     usingProcessor:(nonnull SFTNetworkIOProcessor *)processor
+                     withOutputRing:(nonnull SFTCoreByteRing *)outputRing {
   self = [super init];
   if (self != nil) {
     _port = [NSPort port];
-    _outputBacklogQueue = [NSMutableArray<NSData *> new];
+    _outputRing = outputRing;
+    atomic_init(&_writeScheduled, false);
 
     NSInputStream *input;
     NSOutputStream *output;
@@ -95,6 +124,7 @@ static const NSUInteger kNetworkWriteBufferSize = 64;
     _running = NO;
 
     _processor = processor;
+    _inputRing = processor.inputRing;
   }
 
   return self;
@@ -155,27 +185,42 @@ static const NSUInteger kNetworkWriteBufferSize = 64;
 }
 
 - (void)readDataFromStream {
-  uint8_t buffer[NETWORK_READ_BUFFER_SIZE];
+  SFTNetworkIOProcessor *processor = self.processor;
+
+  // Bytes are read straight into the ring, without any intermediate copy.
+  while (self.inputStream.hasBytesAvailable) {
+    uint8_t *span;
+    size_t length = [processor deliverInjectedInbound]
+                        ? SFTCoreByteRingWritableSpan(self.inputRing, &span)
+                        : 0;
+    if (length == 0) {
+      // Stop reading until the consumer makes room and calls resumeInput,
+      // unless some room was freed while suspending.
+      if (SFTCoreByteRingSuspendProducer(self.inputRing)) {
+        return;
+      }
+      continue;
+    }
 
-  NSInteger bytesRead = [self.inputStream read:buffer maxLength:sizeof(buffer)];
-  switch (bytesRead) {
-  case -1:
-    // Error
-    return;
+    NSInteger bytesRead = [self.inputStream read:span maxLength:length];
+    if (bytesRead <= 0) {
+      // Error or nothing to read
+      return;
+    }
 
-  case 0:
-    // Nothing
-    return;
+    // The pipeline works on the span in place, and only what it leaves is
+    // handed over to the emulator.  This thread being the only writer, the
+    // span cannot change under it.
+    size_t kept = [processor processInboundBytes:span
+                                          length:(size_t)bytesRead];
+    if (kept > 0) {
+      SFTCoreByteRingCommitWrite(self.inputRing, kept);
+    }
 
-  default:
-    break;
+    if (processor.hasInjectedOutbound) {
+      [self writeDataToStream];
+    }
   }
-
-  [self.processor
-      performSelectorOnMainThread:@selector(backgroundThreadReceivedData:)
-                       withObject:[NSData dataWithBytes:buffer
-                                                 length:(NSUInteger)bytesRead]
-                    waitUntilDone:YES];
 }
 
 - (void)handleStreamInEvent:(NSStreamEvent)event {
@@ -204,41 +249,31 @@ static const NSUInteger kNetworkWriteBufferSize = 64;
 }
 
 - (void)writeDataToStream {
-  BOOL canLoop = YES;
-
-  while (canLoop) {
-    if (!(self.outputStream).hasSpaceAvailable ||
-        self.outputBacklogQueue.count == 0) {
-      canLoop = NO;
-      continue;
+  atomic_store(&_writeScheduled, false);
+  SFTNetworkIOProcessor *processor = self.processor;
+
+  // Everything queued so far goes out in as few writes as possible, one per
+  // span; partial writes only move the ring's read index.
+  while (self.outputStream.hasSpaceAvailable) {
+    const uint8_t *span;
+    size_t length = [processor outboundSpan:&span fromRing:self.outputRing];
+    if (length == 0) {
+      break;
     }
 
-    NSData *item = self.outputBacklogQueue.firstObject;
-    NSInteger bytesWritten =
-        [self.outputStream write:item.bytes
-                       maxLength:(kNetworkWriteBufferSize < item.length)
-                                     ? kNetworkReadBufferSize
-                                     : item.length];
-    switch (bytesWritten) {
-    case -1:
-      // Error
-      return;
-
-    case 0:
-      // Nothing
-      return;
-
-    default:
+    NSInteger bytesWritten = [self.outputStream write:span maxLength:length];
+    if (bytesWritten <= 0) {
+      // Error or nothing written
       break;
     }
 
-    if ((NSUInteger)bytesWritten >= item.length) {
-      [self.outputBacklogQueue removeObjectAtIndex:0];
-    } else {
-      (self.outputBacklogQueue)[0] = [item
-          subdataWithRange:NSMakeRange((NSUInteger)bytesWritten,
-                                       item.length - (NSUInteger)bytesWritten)];
-    }
+    [processor commitOutbound:(size_t)bytesWritten fromRing:self.outputRing];
+  }
+
+  if (SFTCoreByteRingResumeProducer(self.outputRing)) {
+    [processor performSelectorOnMainThread:@selector(flushOutputOverflow)
+                                withObject:nil
+                             waitUntilDone:NO];
   }
 }
 
@@ -267,13 +302,20 @@ static const NSUInteger kNetworkWriteBufferSize = 64;
   }
 }
 
-- (void)enqueueBuffer:(nonnull NSData *)buffer {
-  [self.outputBacklogQueue addObject:buffer];
-  [self writeDataToStream];
+- (void)scheduleWrite {
+  // Until the thread runs, the stream's first space available event takes
+  // care of anything already queued.
+  if ((self.running == NO) || atomic_exchange(&_writeScheduled, true)) {
+    return;
+  }
+
+  [self performSelector:@selector(writeDataToStream)
+               onThread:self
+             withObject:nil
+          waitUntilDone:NO];
 }
 
-- (void)handlePortMessage:(NSPortMessage *)message {
-  [self.outputBacklogQueue addObject:message.components[0]];
+- (void)handlePortMessage:(NSPortMessage *__unused)message {
   [self writeDataToStream];
 }
 
@@ -285,11 +327,22 @@ static const NSUInteger kNetworkWriteBufferSize = 64;
   self = [super init];
   if (self != nil) {
     _url = url;
+    _outputOverflow = [NSMutableData new];
+    _outputOverflowOffset = 0;
+    if (!SFTCoreByteRingInitialise(&_outputRing,
+                                   kNetworkOutputRingCapacity)) {
+      [NSException raise:SFTInternalErrorException
+                  format:@"Cannot allocate output ring"];
+    }
   }
 
   return self;
 }
 
+- (void)dealloc {
+  SFTCoreByteRingRelease(&_outputRing);
+}
+
 + (BOOL)parseAddress:(nonnull NSString *)address
         intoHostName:(NSString *_Nonnull *_Nullable)hostName
              andPort:(nonnull NSUInteger *)port {
@@ -319,18 +372,72 @@ static const NSUInteger kNetworkWriteBufferSize = 64;
 }
 
 - (void)start {
+  if (self.inputRing == NULL) {
+    [NSException raise:SFTInternalErrorException
+                format:@"No input ring set before starting"];
+  }
+
+  [self preparePipeline];
   self.backgroundThread =
       [[SFTNetworkBackgroundThread alloc] initWithURL:self.url
-                                       usingProcessor:self];
+                                       usingProcessor:self
+                                       withOutputRing:&_outputRing];
   self.backgroundThread.name = @"SFTNetworkIOProcessorBackgroundThread";
   [self.backgroundThread start];
 }
 
 - (void)sendData:(nonnull NSData *)data {
-  [self.backgroundThread performSelector:@selector(enqueueBuffer:)
+  // Anything already waiting in the overflow buffer has to go out first.
+  if (self.outputOverflow.length > 0) {
+    [self.outputOverflow appendData:data];
+    return;
+  }
+
+  size_t written = SFTCoreByteRingWrite(
+      &_outputRing, (const uint8_t *)data.bytes, data.length);
+  if (written < data.length) {
+    [self.outputOverflow
+        appendBytes:(const uint8_t *)data.bytes + written
+             length:data.length - written];
+    [self flushOutputOverflow];
+    return;
+  }
+
+  [self.backgroundThread scheduleWrite];
+}
+
+- (void)flushOutputOverflow {
+  while (self.outputOverflowOffset < self.outputOverflow.length) {
+    size_t written = SFTCoreByteRingWrite(
+        &_outputRing,
+        (const uint8_t *)self.outputOverflow.bytes + self.outputOverflowOffset,
+        self.outputOverflow.length - self.outputOverflowOffset);
+    self.outputOverflowOffset += written;
+
+    if (written == 0) {
+      // The background thread calls back once it has made room, unless
+      // room was made while suspending.
+      if (SFTCoreByteRingSuspendProducer(&_outputRing)) {
+        [self.backgroundThread scheduleWrite];
+        return;
+      }
+    }
+  }
+
+  self.outputOverflow.length = 0;
+  self.outputOverflowOffset = 0;
+  [self.backgroundThread scheduleWrite];
+}
+
+- (void)resumeInput {
+  if (self.backgroundThread.running == NO) {
+    return;
+  }
+
+  [self.backgroundThread performSelector:@selector(readDataFromStream)
                                 onThread:self.backgroundThread
-                              withObject:data
-                           waitUntilDone:YES];
+                              withObject:nil
+                           waitUntilDone:NO];
 }
 
 - (void)stop {
@@ -351,12 +458,6 @@ static const NSUInteger kNetworkWriteBufferSize = 64;
   }
 }
 
-- (void)backgroundThreadReceivedData:(NSData *)data {
-  [self.delegate ioProcessor:self
-               receivedEvent:SFTIOProcessorEventReceivedData
-                    withData:data];
-}
-
 - (void)backgroundThreadDisconnected {
   [self.delegate ioProcessor:self
                receivedEvent:SFTIOProcessorEventDisconnected
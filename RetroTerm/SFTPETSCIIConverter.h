@@ -22,52 +22,7 @@
 
 @import Foundation;
 
-typedef NS_ENUM(uint16_t, SFTPETSCIIControlCode) {
-  SFTPETSCIIControlCodeFirstControlCode = 0x0100,
-  SFTPETSCIIControlCodeRunStop,
-  SFTPETSCIIControlCodeBell,
-  SFTPETSCIIControlCodeShiftDisable,
-  SFTPETSCIIControlCodeShiftEnable,
-  SFTPETSCIIControlCodeCarriageReturn,
-  SFTPETSCIIControlCodeLineFeed,
-  SFTPETSCIIControlCodeHome,
-  SFTPETSCIIControlCodeClear,
-  SFTPETSCIIControlCodeInsert,
-  SFTPETSCIIControlCodeDelete,
-  SFTPETSCIIControlCodeCursorUp,
-  SFTPETSCIIControlCodeCursorDown,
-  SFTPETSCIIControlCodeCursorLeft,
-  SFTPETSCIIControlCodeCursorRight,
-  SFTPETSCIIControlCodeReverseOn,
-  SFTPETSCIIControlCodeReverseOff,
-  SFTPETSCIIControlCodeTextMode,
-  SFTPETSCIIControlCodeGraphicsMode,
-  SFTPETSCIIControlCodeColourBlack,
-  SFTPETSCIIControlCodeColourWhite,
-  SFTPETSCIIControlCodeColourRed,
-  SFTPETSCIIControlCodeColourCyan,
-  SFTPETSCIIControlCodeColourPurple,
-  SFTPETSCIIControlCodeColourGreen,
-  SFTPETSCIIControlCodeColourBlue,
-  SFTPETSCIIControlCodeColourYellow,
-  SFTPETSCIIControlCodeColourOrange,
-  SFTPETSCIIControlCodeColourBrown,
-  SFTPETSCIIControlCodeColourLightRed,
-  SFTPETSCIIControlCodeColourDarkGray,
-  SFTPETSCIIControlCodeColourMiddleGray,
-  SFTPETSCIIControlCodeColourLightGreen,
-  SFTPETSCIIControlCodeColourLightBlue,
-  SFTPETSCIIControlCodeColourLightGray,
-  SFTPETSCIIControlCodeF1,
-  SFTPETSCIIControlCodeF2,
-  SFTPETSCIIControlCodeF3,
-  SFTPETSCIIControlCodeF4,
-  SFTPETSCIIControlCodeF5,
-  SFTPETSCIIControlCodeF6,
-  SFTPETSCIIControlCodeF7,
-  SFTPETSCIIControlCodeF8,
-  SFTUnmappedPETSCIICharacter = 0xFFFF
-};
+#import "SFTCoreCharacterSet.h"
 
 @interface SFTPETSCIIConverter : NSObject
 
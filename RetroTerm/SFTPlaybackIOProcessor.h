@@ -21,10 +21,80 @@
  */
 
 #import "SFTIOProcessor.h"
+#import "SFTTerminalEmulatorContext.h"
 
 @interface SFTPlaybackIOProcessor : SFTIOProcessor
 
-- (void)injectSessionDataFromURL:(nonnull NSURL *)url
-                  withSpeedInBps:(NSUInteger)speed;
+/**
+ * Serial queue replays are opened, sought into and delivered on, which must
+ * be the one consuming the input ring so that the ring keeps a single
+ * producer.  Must be set before replaying.
+ */
+@property(strong, nonatomic, nullable) dispatch_queue_t replayQueue;
+
+/**
+ * Amount of incoming bytes in the capture being replayed.
+ */
+@property(assign, nonatomic, readonly) NSUInteger replayLength;
+
+/**
+ * Offset of the next incoming byte to be delivered.
+ */
+@property(assign, nonatomic, readonly) NSUInteger replayOffset;
+
+/**
+ * Starts replaying the given capture, memory mapped rather than loaded.
+ *
+ * Must be called on the replay queue.  Bytes are delivered in batches, once
+ * per tick on the same queue.  Timestamped captures are
+ * replayed with their original timing, raw byte dumps at the given speed.
+ * With an unlimited speed the whole capture is parsed straight away.
+ *
+ * @param[in] url the capture file.
+ * @param[in] speed the speed in bits per second, or NSUIntegerMax.
+ * @param[in] context the emulator context, in the state the capture starts
+ * from.
+ * @param[in] cellBuffer the screen contents the capture starts from.
+ *
+ * @return YES if the capture was opened, NO otherwise.
+ */
+- (BOOL)injectSessionDataFromURL:(nonnull NSURL *)url
+                  withSpeedInBps:(NSUInteger)speed
+                      forContext:(nonnull SFTTerminalEmulatorContext *)context
+                    onCellBuffer:(nonnull SFTTerminalEmulatorCell *)cellBuffer;
+
+/**
+ * Rebuilds the screen as it was after the given amount of incoming bytes,
+ * then keeps replaying from there.  Must be called on the replay queue.
+ *
+ * Bytes still waiting in the input ring must be discarded beforehand.
+ *
+ * @param[in] offset the capture offset to seek to.
+ * @param[in] context the emulator context to overwrite.
+ * @param[in] cellBuffer the screen contents to overwrite.
+ *
+ * @return YES if the screen was rebuilt, NO otherwise.
+ */
+- (BOOL)seekToOffset:(NSUInteger)offset
+          forContext:(nonnull SFTTerminalEmulatorContext *)context
+        onCellBuffer:(nonnull SFTTerminalEmulatorCell *)cellBuffer;
+
+/**
+ * Rebuilds the screen as it was at the given time into a timestamped
+ * capture, then keeps replaying from there.  Must be called on the replay
+ * queue.
+ *
+ * Bytes still waiting in the input ring must be discarded beforehand.
+ *
+ * @param[in] time the time since the capture start.
+ * @param[in] context the emulator context to overwrite.
+ * @param[in] cellBuffer the screen contents to overwrite.
+ *
+ * @return YES if the screen was rebuilt, NO otherwise or if the capture
+ * being replayed has no timing information.
+ */
+- (BOOL)seekToTime:(NSTimeInterval)time
+        forContext:(nonnull SFTTerminalEmulatorContext *)context
+      onCellBuffer:(nonnull SFTTerminalEmulatorCell *)cellBuffer;
 
 @end
@@ -21,66 +21,254 @@
  */
 
 #import "SFTPlaybackIOProcessor.h"
+#import "SFTCoreCapture.h"
+#import "SFTCoreReplay.h"
 
-@interface SFTPlaybackIOProcessor ()
+#include <time.h>
 
-@property(strong, nonatomic, nullable) NSData *replayData;
-@property(strong, nonatomic, nullable) NSTimer *replayTimer;
-@property(assign, nonatomic) NSUInteger replayDataOffset;
+/**
+ * Time between two batches of replayed bytes.
+ */
+static const NSTimeInterval kReplayTickInterval = 1.0 / 60.0;
+
+/**
+ * Longest pause kept when replaying timestamped captures, in microseconds.
+ */
+static const uint64_t kReplayMaximumGap = 2 * 1000 * 1000;
+
+@interface SFTPlaybackIOProcessor () {
+  SFTCoreReplay _replay;
+  SFTCoreCaptureReader _capture;
+}
+
+@property(strong, nonatomic, nullable) dispatch_source_t replayTimer;
+
+/**
+ * Whether _capture rather than _replay holds the capture being replayed.
+ */
+@property(assign, nonatomic) BOOL replayingCapture;
+
+- (void)closeReplay;
+- (void)deliverReplayBatch;
+- (void)deliverCaptureBatch;
+- (void)startReplayTimer;
+- (void)stopReplayTimer;
 
 @end
 
 @implementation SFTPlaybackIOProcessor
 
-- (void)injectSessionDataFromURL:(nonnull NSURL *)url
-                  withSpeedInBps:(NSUInteger)speed {
-  if ((self.replayTimer != nil) && (self.replayTimer.valid == YES)) {
-    [self.replayTimer invalidate];
+- (void)dealloc {
+  if (self.replayTimer != nil) {
+    dispatch_source_cancel(self.replayTimer);
   }
+  SFTCoreReplayClose(&_replay);
+  SFTCoreCaptureReaderClose(&_capture);
+}
+
+- (NSUInteger)replayLength {
+  return self.replayingCapture ? (NSUInteger)_capture.inboundLength
+                               : _replay.length;
+}
+
+- (NSUInteger)replayOffset {
+  return self.replayingCapture
+             ? (NSUInteger)SFTCoreCaptureReaderPosition(&_capture)
+             : _replay.position;
+}
+
+- (void)closeReplay {
+  [self stopReplayTimer];
+  SFTCoreReplayClose(&_replay);
+  SFTCoreCaptureReaderClose(&_capture);
+  self.replayingCapture = NO;
+}
 
-  self.replayData = [NSData dataWithContentsOfURL:url];
-  self.replayDataOffset = 0;
-  NSTimeInterval interval = (NSTimeInterval)(1.0 / ((NSTimeInterval)speed / 8));
+- (BOOL)injectSessionDataFromURL:(nonnull NSURL *)url
+                  withSpeedInBps:(NSUInteger)speed
+                      forContext:(nonnull SFTTerminalEmulatorContext *)context
+                    onCellBuffer:(nonnull SFTTerminalEmulatorCell *)cellBuffer {
+  [self closeReplay];
 
+  if (SFTCoreCaptureReaderOpen(&_capture, url.fileSystemRepresentation)) {
+    self.replayingCapture = YES;
+    _capture.maximumGap = kReplayMaximumGap;
+    return [self seekToOffset:(speed == NSUIntegerMax)
+                                  ? (NSUInteger)_capture.inboundLength
+                                  : 0
+                   forContext:context
+                 onCellBuffer:cellBuffer];
+  }
+
+  if (!SFTCoreReplayOpen(&_replay, url.fileSystemRepresentation) ||
+      !SFTCoreReplayBuildCheckpoints(&_replay, context.state, cellBuffer,
+                                     SFTCoreReplayDefaultCheckpointInterval)) {
+    SFTCoreReplayClose(&_replay);
+    return NO;
+  }
+
+  if (speed == NSUIntegerMax) {
+    return SFTCoreReplaySeek(&_replay, context.state, cellBuffer,
+                             _replay.length)
+               ? YES
+               : NO;
+  }
+
+  SFTCoreReplaySetSpeed(&_replay, speed,
+                        clock_gettime_nsec_np(CLOCK_UPTIME_RAW));
+  [self startReplayTimer];
+  return YES;
+}
+
+- (BOOL)seekToOffset:(NSUInteger)offset
+          forContext:(nonnull SFTTerminalEmulatorContext *)context
+        onCellBuffer:(nonnull SFTTerminalEmulatorCell *)cellBuffer {
+  uint64_t now = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+  if (self.replayingCapture) {
+    if (!SFTCoreCaptureReaderSeek(&_capture, context.state, cellBuffer,
+                                  offset)) {
+      return NO;
+    }
+
+    SFTCoreCaptureReaderStartClock(&_capture, now);
+    if (!SFTCoreCaptureReaderIsFinished(&_capture)) {
+      [self startReplayTimer];
+    }
+    return YES;
+  }
+
+  if (!SFTCoreReplaySeek(&_replay, context.state, cellBuffer, offset)) {
+    return NO;
+  }
+
+  SFTCoreReplaySetSpeed(&_replay, _replay.bitsPerSecond, now);
+  if ((_replay.bitsPerSecond > 0) && !SFTCoreReplayIsFinished(&_replay)) {
+    [self startReplayTimer];
+  }
+
+  return YES;
+}
+
+- (BOOL)seekToTime:(NSTimeInterval)time
+        forContext:(nonnull SFTTerminalEmulatorContext *)context
+      onCellBuffer:(nonnull SFTTerminalEmulatorCell *)cellBuffer {
+  if (!self.replayingCapture) {
+    return NO;
+  }
+
+  uint64_t timestamp = (time > 0.0) ? (uint64_t)(time * 1e6) : 0;
+  return [self seekToOffset:(NSUInteger)SFTCoreCaptureReaderOffsetAtTime(
+                                &_capture, timestamp)
+                 forContext:context
+               onCellBuffer:cellBuffer];
+}
+
+- (void)startReplayTimer {
+  if (self.replayTimer != nil) {
+    return;
+  }
+
+  // Ticks run on the replay queue, as seeks do, since both move the replay
+  // position and feed the input ring.
+  dispatch_queue_t queue = self.replayQueue != nil ? self.replayQueue
+                                                   : dispatch_get_main_queue();
+  dispatch_source_t timer =
+      dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+  uint64_t interval = (uint64_t)(kReplayTickInterval * NSEC_PER_SEC);
+  dispatch_source_set_timer(
+      timer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)interval), interval,
+      interval / 10);
   __weak SFTPlaybackIOProcessor *weakSelf = self;
-  self.replayTimer = [NSTimer
-      scheduledTimerWithTimeInterval:interval
-                             repeats:YES
-                               block:^(NSTimer *_Nonnull timer) {
-                                 SFTPlaybackIOProcessor *strongSelf = weakSelf;
-                                 if (strongSelf.replayDataOffset >=
-                                     strongSelf.replayData.length) {
-                                   [strongSelf.replayTimer invalidate];
-                                   return;
-                                 }
-
-                                 uint8_t byte =
-                                     ((const uint8_t *)(strongSelf.replayData
-                                                            .bytes))
-                                         [strongSelf.replayDataOffset];
-                                 [strongSelf.delegate
-                                       ioProcessor:self
-                                     receivedEvent:
-                                         SFTIOProcessorEventReceivedData
-                                          withData:[NSData
-                                                       dataWithBytesNoCopy:&byte
-                                                                    length:1
-                                                              freeWhenDone:NO]];
-                                 strongSelf.replayDataOffset++;
-                               }];
+  dispatch_source_set_event_handler(timer, ^{
+    [weakSelf deliverReplayBatch];
+  });
+  self.replayTimer = timer;
+  dispatch_resume(timer);
+}
+
+- (void)stopReplayTimer {
+  if (self.replayTimer != nil) {
+    dispatch_source_cancel(self.replayTimer);
+    self.replayTimer = nil;
+  }
+}
+
+- (void)deliverReplayBatch {
+  if (self.replayingCapture) {
+    [self deliverCaptureBatch];
+    return;
+  }
+
+  if (SFTCoreReplayIsFinished(&_replay) || (self.inputRing == NULL)) {
+    [self stopReplayTimer];
+    return;
+  }
+
+  // Whatever does not fit in the ring stays due for the next tick.
+  const uint8_t *bytes;
+  size_t length =
+      SFTCoreReplayNextBatch(&_replay, clock_gettime_nsec_np(CLOCK_UPTIME_RAW),
+                             self.inputRing->capacity, &bytes);
+  if (length > 0) {
+    SFTCoreReplayConsume(&_replay,
+                         SFTCoreByteRingWrite(self.inputRing, bytes, length));
+  }
+}
+
+- (void)deliverCaptureBatch {
+  if (SFTCoreCaptureReaderIsFinished(&_capture) || (self.inputRing == NULL)) {
+    [self stopReplayTimer];
+    return;
+  }
+
+  // Records come one at a time; whatever does not fit in the ring stays due
+  // for the next tick.
+  uint64_t now = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+  const uint8_t *bytes;
+  size_t length;
+  while ((length = SFTCoreCaptureReaderNextBatch(&_capture, now, &bytes)) >
+         0) {
+    size_t written = SFTCoreByteRingWrite(self.inputRing, bytes, length);
+    SFTCoreCaptureReaderConsume(&_capture, written);
+    if (written < length) {
+      break;
+    }
+  }
 }
 
 - (void)start {
 }
 
 - (void)stop {
-  [self.replayTimer invalidate];
+  if (self.replayQueue == nil) {
+    [self stopReplayTimer];
+    return;
+  }
+
+  dispatch_async(self.replayQueue, ^{
+    [self stopReplayTimer];
+  });
 }
 
 - (void)sendData:(nonnull NSData *)data {
-  [self.delegate ioProcessor:self
-               receivedEvent:SFTIOProcessorEventReceivedData
-                    withData:data];
+  if (self.inputRing == NULL) {
+    return;
+  }
+
+  // Echoed bytes join replayed ones from the same queue, the ring's only
+  // producer.
+  if (self.replayQueue == nil) {
+    SFTCoreByteRingWrite(self.inputRing, (const uint8_t *)data.bytes,
+                         data.length);
+    return;
+  }
+
+  NSData *bytes = [data copy];
+  dispatch_async(self.replayQueue, ^{
+    SFTCoreByteRingWrite(self.inputRing, (const uint8_t *)bytes.bytes,
+                         bytes.length);
+  });
 }
 
 @end
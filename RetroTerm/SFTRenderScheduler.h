@@ -0,0 +1,106 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+@import Foundation;
+@import MetalKit;
+
+#import "SFTCoreByteRing.h"
+
+@class SFTRenderScheduler;
+
+@protocol SFTRenderSchedulerDelegate <NSObject>
+
+@required
+
+/**
+ * Parses the bytes waiting in the input ring, invoked on the scheduler's
+ * parse queue whenever new bytes arrive.
+ *
+ * The delegate is the input ring's consumer, and it is expected to drain
+ * the bytes it finds waiting there.  Nothing the render thread reads may
+ * be touched here: changes are handed over by the next
+ * renderSchedulerPublishFrame: invocation.
+ *
+ * @param[in] scheduler the scheduler invoking the method.
+ * @param[in] input the input ring.
+ *
+ * @return YES if something changed and needs to be published, NO otherwise.
+ */
+- (BOOL)renderScheduler:(nonnull SFTRenderScheduler *)scheduler
+             parseInput:(nonnull SFTCoreByteRing *)input;
+
+/**
+ * Publishes what changed since the previous frame, invoked on the main
+ * thread at most once per display refresh and only after parsing reported
+ * changes.
+ *
+ * @param[in] scheduler the scheduler invoking the method.
+ *
+ * @return YES if the view contents changed and need to be drawn, NO
+ * otherwise.
+ */
+- (BOOL)renderSchedulerPublishFrame:(nonnull SFTRenderScheduler *)scheduler;
+
+@end
+
+/**
+ * Paces drawing of a paused MTKView to the display refresh rate.
+ *
+ * Incoming data is accumulated by a single producer thread into a lock-free
+ * ring and parsed by the delegate on a serial queue of its own, so that
+ * sessions never wait on each other or on the main thread.  Changes are
+ * published on the main thread once per frame; the view is drawn only when
+ * either the delegate reports changes or a redraw was explicitly requested.
+ */
+@interface SFTRenderScheduler : NSObject
+
+@property(weak, nonatomic, nullable) id<SFTRenderSchedulerDelegate> delegate;
+
+- (nonnull instancetype)initWithView:(nonnull MTKView *)view;
+
+- (void)start;
+- (void)stop;
+
+/**
+ * Ring holding incoming bytes for the next frame, owned by the scheduler.
+ */
+@property(assign, nonatomic, readonly, nonnull) SFTCoreByteRing *inputRing;
+
+/**
+ * Serial queue the delegate parses incoming bytes on, owned by the
+ * scheduler.  Anything else touching the parsed state must be run on it.
+ */
+@property(strong, nonatomic, readonly, nonnull) dispatch_queue_t parseQueue;
+
+/**
+ * Requests the view to be drawn on the next frame, can be called from any
+ * thread.
+ */
+- (void)setNeedsDisplay;
+
+/**
+ * Requests the delegate to publish on the next frame, for changes made on
+ * the parse queue outside of parsing.  Can be called from any thread.
+ */
+- (void)setNeedsPublish;
+
+@end
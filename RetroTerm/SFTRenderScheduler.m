@@ -0,0 +1,244 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+@import AppKit;
+@import CoreVideo;
+
+#include <stdatomic.h>
+
+#import "SFTCommon.h"
+#import "SFTRenderScheduler.h"
+
+static const size_t kInputRingCapacity = 64 * 1024;
+
+/**
+ * What the display link callback is given instead of the scheduler itself,
+ * so that a callback already running while the scheduler goes away finds
+ * nil rather than a dangling pointer.
+ */
+@interface SFTRenderSchedulerDisplayLinkTarget : NSObject
+
+@property(weak, nonatomic, nullable) SFTRenderScheduler *scheduler;
+
+@end
+
+@implementation SFTRenderSchedulerDisplayLinkTarget
+@end
+
+@interface SFTRenderScheduler () {
+  CVDisplayLinkRef _displayLink;
+
+  /**
+   * The display link callback's context, retained until the display link
+   * is stopped and released.
+   */
+  void *_displayLinkTarget;
+
+  SFTCoreByteRing _inputRing;
+  atomic_bool _parseRequested;
+  atomic_bool _needsPublish;
+  atomic_bool _frameRequested;
+  atomic_bool _needsDisplay;
+}
+
+@property(weak, nonatomic, nullable) MTKView *view;
+
+- (CGDirectDisplayID)currentDisplay;
+- (void)windowDidChangeScreen:(nonnull NSNotification *)notification;
+- (void)displayLinkFired;
+- (void)parseInput;
+- (void)requestFrame;
+- (void)renderFrame;
+
+@end
+
+static CVReturn SFTRenderSchedulerDisplayLinkCallback(
+    CVDisplayLinkRef __unused displayLink, const CVTimeStamp *__unused now,
+    const CVTimeStamp *__unused outputTime, CVOptionFlags __unused flagsIn,
+    CVOptionFlags *__unused flagsOut, void *context) {
+  SFTRenderScheduler *scheduler =
+      ((__bridge SFTRenderSchedulerDisplayLinkTarget *)context).scheduler;
+  [scheduler displayLinkFired];
+  return kCVReturnSuccess;
+}
+
+@implementation SFTRenderScheduler
+
+- (nonnull instancetype)initWithView:(nonnull MTKView *)view {
+  self = [super init];
+  if (self != nil) {
+    _view = view;
+    if (!SFTCoreByteRingInitialise(&_inputRing, kInputRingCapacity)) {
+      [NSException raise:SFTInternalErrorException
+                  format:@"Cannot allocate input ring"];
+    }
+    _parseQueue = dispatch_queue_create(
+        "it.frob.sixtyfourterm.parser",
+        dispatch_queue_attr_make_with_qos_class(
+            DISPATCH_QUEUE_SERIAL, QOS_CLASS_USER_INTERACTIVE, 0));
+    atomic_init(&_parseRequested, false);
+    atomic_init(&_needsPublish, false);
+    atomic_init(&_frameRequested, false);
+    atomic_init(&_needsDisplay, true);
+    _displayLink = NULL;
+    _displayLinkTarget = NULL;
+
+    view.paused = YES;
+    view.enableSetNeedsDisplay = NO;
+  }
+
+  return self;
+}
+
+- (void)dealloc {
+  [self stop];
+  SFTCoreByteRingRelease(&_inputRing);
+}
+
+- (nonnull SFTCoreByteRing *)inputRing {
+  return &_inputRing;
+}
+
+- (void)start {
+  if (_displayLink != NULL) {
+    return;
+  }
+
+  // Refreshes follow the display the window is on, and whichever display
+  // it moves to afterwards.
+  if (CVDisplayLinkCreateWithCGDisplay([self currentDisplay], &_displayLink) !=
+      kCVReturnSuccess) {
+    _displayLink = NULL;
+    return;
+  }
+
+  SFTRenderSchedulerDisplayLinkTarget *target =
+      [SFTRenderSchedulerDisplayLinkTarget new];
+  target.scheduler = self;
+  _displayLinkTarget = (__bridge_retained void *)target;
+  CVDisplayLinkSetOutputCallback(
+      _displayLink, SFTRenderSchedulerDisplayLinkCallback, _displayLinkTarget);
+
+  NSWindow *window = self.view.window;
+  if (window != nil) {
+    [NSNotificationCenter.defaultCenter
+        addObserver:self
+           selector:@selector(windowDidChangeScreen:)
+               name:NSWindowDidChangeScreenNotification
+             object:window];
+  }
+
+  CVDisplayLinkStart(_displayLink);
+}
+
+- (void)stop {
+  if (_displayLink == NULL) {
+    return;
+  }
+
+  [NSNotificationCenter.defaultCenter
+      removeObserver:self
+                name:NSWindowDidChangeScreenNotification
+              object:nil];
+
+  // CVDisplayLinkStop waits for a callback in progress, so the target can
+  // go right after.
+  CVDisplayLinkStop(_displayLink);
+  CVDisplayLinkRelease(_displayLink);
+  _displayLink = NULL;
+  CFBridgingRelease(_displayLinkTarget);
+  _displayLinkTarget = NULL;
+}
+
+- (CGDirectDisplayID)currentDisplay {
+  NSNumber *screenNumber =
+      self.view.window.screen.deviceDescription[@"NSScreenNumber"];
+  return (screenNumber != nil)
+             ? (CGDirectDisplayID)screenNumber.unsignedIntValue
+             : CGMainDisplayID();
+}
+
+- (void)windowDidChangeScreen:(nonnull NSNotification *)notification {
+  if (_displayLink != NULL) {
+    CVDisplayLinkSetCurrentCGDisplay(_displayLink, [self currentDisplay]);
+  }
+}
+
+- (void)setNeedsDisplay {
+  atomic_store(&_needsDisplay, true);
+}
+
+- (void)setNeedsPublish {
+  atomic_store(&_needsPublish, true);
+}
+
+- (void)displayLinkFired {
+  if ((SFTCoreByteRingAvailable(&_inputRing) > 0) &&
+      !atomic_exchange(&_parseRequested, true)) {
+    __weak SFTRenderScheduler *weakSelf = self;
+    dispatch_async(self.parseQueue, ^{
+      [weakSelf parseInput];
+    });
+  }
+
+  // Frames are only ever requested from here, once per refresh.
+  if (atomic_load(&_needsDisplay) || atomic_load(&_needsPublish)) {
+    [self requestFrame];
+  }
+}
+
+- (void)parseInput {
+  // Cleared first, so that bytes arriving while parsing get another pass.
+  atomic_store(&_parseRequested, false);
+
+  if ([self.delegate renderScheduler:self parseInput:&_inputRing]) {
+    atomic_store(&_needsPublish, true);
+  }
+}
+
+- (void)requestFrame {
+  // Do not queue another frame if the main thread has not caught up yet.
+  if (atomic_exchange(&_frameRequested, true)) {
+    return;
+  }
+
+  __weak SFTRenderScheduler *weakSelf = self;
+  dispatch_async(dispatch_get_main_queue(), ^{
+    [weakSelf renderFrame];
+  });
+}
+
+- (void)renderFrame {
+  atomic_store(&_frameRequested, false);
+
+  BOOL shouldDraw = atomic_exchange(&_needsDisplay, false);
+  if (atomic_exchange(&_needsPublish, false) &&
+      [self.delegate renderSchedulerPublishFrame:self]) {
+    shouldDraw = YES;
+  }
+
+  if (shouldDraw) {
+    [self.view draw];
+  }
+}
+
+@end
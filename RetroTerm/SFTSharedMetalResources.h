@@ -29,13 +29,14 @@ extern const NSUInteger SFTVertexBufferQuadItemsCount;
 typedef struct {
   float screenWidth;
   float screenHeight;
-  uint16_t cellsWide;
-  uint16_t cellsTall;
-  uint16_t selectionStart;
-  uint16_t selectionEnd;
-  uint16_t cursorRow;
-  uint16_t cursorColumn;
-  union {
+  uint32_t cellsWide;
+  uint32_t cellsTall;
+  uint32_t selectionStart;
+  uint32_t selectionEnd;
+  uint32_t cursorRow;
+  uint32_t cursorColumn;
+  uint32_t baseRow;
+  struct {
     uint8_t blink : 1;
     uint8_t lowerCase : 1;
     uint8_t disconnected : 1;
@@ -53,6 +54,17 @@ typedef struct {
     terminalFragmentFunction;
 @property(strong, nonatomic, nonnull, readonly) id<MTLRenderPipelineState>
     renderPipelineState;
+
+/**
+ * Functions and pipeline state drawing one instance per cell, resolving
+ * glyphs and colours once per cell rather than once per pixel.
+ */
+@property(strong, nonatomic, nonnull, readonly) id<MTLFunction>
+    cellVertexFunction;
+@property(strong, nonatomic, nonnull, readonly) id<MTLFunction>
+    cellFragmentFunction;
+@property(strong, nonatomic, nonnull, readonly) id<MTLRenderPipelineState>
+    cellRenderPipelineState;
 @property(strong, nonatomic, nonnull, readonly) id<MTLBuffer> vertexBufferQuad;
 
 + (nonnull instancetype)sharedInstance;
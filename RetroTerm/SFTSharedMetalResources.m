@@ -105,6 +105,20 @@ static const SFTVertex kDisplayQuad[VERTEX_COUNT_PER_QUAD * 3] = {
                                    userInfo:nil];
     }
 
+    _cellVertexFunction = [library newFunctionWithName:@"vertex_cells"];
+    _cellFragmentFunction = [library newFunctionWithName:@"fragment_cells"];
+    pipelineStateDescriptor.vertexFunction = _cellVertexFunction;
+    pipelineStateDescriptor.fragmentFunction = _cellFragmentFunction;
+
+    _cellRenderPipelineState =
+        [_device newRenderPipelineStateWithDescriptor:pipelineStateDescriptor
+                                                error:&error];
+    if (error != nil) {
+      @throw [NSException exceptionWithName:SFTMetalException
+                                     reason:error.localizedFailureReason
+                                   userInfo:nil];
+    }
+
     _vertexBufferQuad =
         [_device newBufferWithBytes:(void *)&kDisplayQuad[0]
                              length:sizeof(kDisplayQuad)
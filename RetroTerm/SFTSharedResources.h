@@ -23,14 +23,18 @@
 @import AppKit;
 @import Foundation;
 
-#import "SFTTerminalEmulator.h"
+#import "SFTCoreEventLoop.h"
 
 @interface SFTSharedResources : NSObject
 
-@property(strong, nonatomic, nonnull) SFTTerminalEmulator *terminalEmulator;
 @property(strong, nonatomic, nonnull, readonly)
     NSArray<NSColor *> *paletteColours;
 
+/**
+ * Event loop shared by all connections, started on first access.
+ */
+@property(assign, nonatomic, readonly, nonnull) SFTCoreEventLoop *eventLoop;
+
 + (nonnull instancetype)sharedInstance;
 
 @end
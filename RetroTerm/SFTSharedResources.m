@@ -21,6 +21,7 @@
  */
 
 #import "SFTSharedResources.h"
+#import "SFTCommon.h"
 
 typedef struct {
   float red;
@@ -56,6 +57,13 @@ static const SFTColour kPalette[PALETTE_COLOURS_COUNT] = {
 
 // clang-format on
 
+@interface SFTSharedResources () {
+  SFTCoreEventLoop _eventLoop;
+  dispatch_once_t _eventLoopOnceToken;
+}
+
+@end
+
 @implementation SFTSharedResources
 
 - (instancetype)init {
@@ -74,13 +82,26 @@ static const SFTColour kPalette[PALETTE_COLOURS_COUNT] = {
     }
 
     _paletteColours = palette;
-
-    _terminalEmulator = [SFTTerminalEmulator new];
   }
 
   return self;
 }
 
+- (nonnull SFTCoreEventLoop *)eventLoop {
+  dispatch_once(&_eventLoopOnceToken, ^{
+    if (!SFTCoreEventLoopInitialise(&self->_eventLoop)) {
+      [NSException raise:SFTInternalErrorException
+                  format:@"Cannot create the shared event loop"];
+    }
+    if (!SFTCoreEventLoopStart(&self->_eventLoop)) {
+      [NSException raise:SFTInternalErrorException
+                  format:@"Cannot start the shared event loop"];
+    }
+  });
+
+  return &_eventLoop;
+}
+
 + (nonnull instancetype)sharedInstance {
   static dispatch_once_t onceToken;
   static SFTSharedResources *container;
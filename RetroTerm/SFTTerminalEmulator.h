@@ -22,8 +22,16 @@
 
 @import Foundation;
 
+#import "SFTCoreByteRing.h"
 #import "SFTTerminalEmulatorContext.h"
 
+/**
+ * Drives the emulator core on behalf of a session.
+ *
+ * Emulators keep no state of their own, all of it lives in the context
+ * passed to every method: each session owns its emulator and context, and
+ * must only use them from one thread at a time.
+ */
 @interface SFTTerminalEmulator : NSObject
 
 - (void)clearScreenForContext:(nonnull SFTTerminalEmulatorContext *)context
@@ -38,8 +46,35 @@ processIncomingDataForContext:(nonnull SFTTerminalEmulatorContext *)context
                  onCellBuffer:(nonnull SFTTerminalEmulatorCell *)cellBuffer
                       forData:(nonnull NSData *)data;
 
-- (BOOL)convertKeyCodeForContext:(nonnull SFTTerminalEmulatorContext *)context
-                     withKeyCode:(unichar)keyCode
-                    toCharacters:(nonnull NSMutableData *)characters;
+/**
+ * Parses the bytes waiting in the given ring, acting as its consumer.
+ *
+ * Only the bytes already available when the method is entered are parsed,
+ * so that a fast producer cannot keep the caller busy indefinitely.
+ *
+ * @param[in] context the emulator context.
+ * @param[in] cellBuffer the cell buffer to update.
+ * @param[in] ring the ring to drain.
+ *
+ * @return YES if the cell buffer needs to be redrawn, NO otherwise.
+ */
+- (BOOL)
+processIncomingDataForContext:(nonnull SFTTerminalEmulatorContext *)context
+                 onCellBuffer:(nonnull SFTTerminalEmulatorCell *)cellBuffer
+                     fromRing:(nonnull SFTCoreByteRing *)ring;
+
+/**
+ * Converts a key press for the screen modes as published in the given
+ * snapshot, so that it can be done without touching the parsing state.
+ *
+ * @param[in] snapshot the snapshot holding the screen modes.
+ * @param[in] keyCode the key pressed.
+ * @param[out] characters the data to append the converted bytes to.
+ *
+ * @return YES if the key was converted, NO otherwise.
+ */
+- (BOOL)convertKeyCodeForSnapshot:(nonnull const SFTCoreSnapshot *)snapshot
+                      withKeyCode:(unichar)keyCode
+                     toCharacters:(nonnull NSMutableData *)characters;
 
 @end
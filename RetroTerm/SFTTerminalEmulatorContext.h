@@ -23,20 +23,10 @@
 @import Foundation;
 
 #import "SFTCommon.h"
-
-typedef uint32_t SFTTerminalEmulatorCell;
-
-#define SFTTerminalEmulatorCellPack(context, character)                        \
-  (SFTTerminalEmulatorCell)(((character)&0xFF) +                               \
-                            ((((context).foreground) & 0x0F) << 8) +           \
-                            ((((context).background) & 0x0F) << 12) +          \
-                            ((((context).reverseVideo) & 0x01) << 16))
-#define SFTTerminalEmulatorCellGetCharacter(cell) ((uint8_t)(cell & 0xFF))
-#define SFTTerminalEmulatorCellGetForeground(cell)                             \
-  ((uint8_t)((cell >> 8) & 0x0F))
-#define SFTTerminalEmulatorCellGetBackground(cell)                             \
-  ((uint8_t)((cell >> 12) & 0x0F))
-#define SFTTerminalEmulatorCellGetReverse(cell) ((BOOL)((cell >> 16) & 0xF1))
+#import "SFTCoreEmulator.h"
+#import "SFTCoreScrollback.h"
+#import "SFTCoreSearch.h"
+#import "SFTCoreSnapshot.h"
 
 @interface SFTTerminalEmulatorContext : NSObject
 
@@ -50,16 +40,49 @@ typedef uint32_t SFTTerminalEmulatorCell;
  */
 @property(assign, nonatomic, readonly) NSUInteger height;
 
+/**
+ * Size of the cell buffer this context's screen needs, in bytes.
+ */
+@property(assign, nonatomic, readonly) NSUInteger cellBufferLength;
+
+/**
+ * Screen size new sessions start with, in cells: the ScreenColumns and
+ * ScreenRows user defaults if set and supported, 40x25 otherwise.
+ */
+@property(class, assign, nonatomic, readonly) NSUInteger preferredWidth;
+@property(class, assign, nonatomic, readonly) NSUInteger preferredHeight;
+
 @property(assign, nonatomic) SFTC64Colour background;
 @property(assign, nonatomic) SFTC64Colour foreground;
 
 @property(assign, nonatomic) NSUInteger row;
 @property(assign, nonatomic) NSUInteger column;
 
+/**
+ * Cell buffer row holding the topmost screen row.
+ */
+@property(assign, nonatomic, readonly) NSUInteger baseRow;
+
 @property(assign, nonatomic) BOOL isInASCIIMode;
 @property(assign, nonatomic) BOOL useLowerCase;
 @property(assign, nonatomic) BOOL reverseVideo;
 
+/**
+ * Emulator core state backing this context.
+ */
+@property(assign, nonatomic, readonly, nonnull) SFTCoreEmulatorState *state;
+
+/**
+ * Rows scrolled off the top of the screen, the oldest ones being dropped
+ * once the history grows past the ScrollbackMemoryCap user default.
+ */
+@property(assign, nonatomic, readonly, nonnull) SFTCoreScrollback *scrollback;
+
+/**
+ * Amount of rows in the scrollback history.
+ */
+@property(assign, nonatomic, readonly) NSUInteger historyLength;
+
 /**
  *
  * @param[in] width screen width, in cell.
@@ -78,4 +101,85 @@ typedef uint32_t SFTTerminalEmulatorCell;
                           inASCIIMode:(BOOL)asciiMode
                        usingLowerCase:(BOOL)lowerCase;
 
+/**
+ * Checks whether the given cell buffer row was written to since dirty rows
+ * were last cleared.
+ *
+ * @param[in] row the cell buffer row, not adjusted for baseRow.
+ *
+ * @return YES if the row is dirty, NO otherwise.
+ */
+- (BOOL)isRowDirty:(NSUInteger)row;
+
+/**
+ * Enumerates runs of consecutive dirty cell buffer rows, in buffer order.
+ *
+ * @param[in] block the block to invoke for each run of dirty rows.
+ */
+- (void)enumerateDirtyRowRangesUsingBlock:
+    (void (^_Nonnull)(NSRange rows))block;
+
+/**
+ * Marks all cell buffer rows as clean.
+ */
+- (void)clearDirtyRows;
+
+/**
+ * Publishes the screen as it stands for the rendering thread, consuming the
+ * dirty rows.  Must only be called from the thread parsing incoming data.
+ *
+ * @param[in] cellBuffer the cell buffer.
+ *
+ * @return YES if a snapshot was published, NO if nothing changed since the
+ * previous one.
+ */
+- (BOOL)publishSnapshotFromCellBuffer:
+    (nonnull const SFTTerminalEmulatorCell *)cellBuffer;
+
+/**
+ * Returns the most recently published snapshot, left untouched until the
+ * next call.  Must only be called from the rendering thread, and never
+ * waits for the parsing one.
+ */
+- (nonnull const SFTCoreSnapshot *)acquireSnapshot;
+
+/**
+ * Scrolls the viewport published along with the next snapshots, so that
+ * the given history row is shown at the top.  Must only be called from the
+ * thread parsing incoming data.
+ *
+ * @param[in] line the history row to show at the top, counting every row
+ * ever pushed to the scrollback, or UINT64_MAX to follow the screen.
+ */
+- (void)scrollViewportToLine:(uint64_t)line;
+
+/**
+ * Scrolls the viewport published along with the next snapshots by the given
+ * amount of rows.  Must only be called from the thread parsing incoming
+ * data.
+ *
+ * @param[in] rows rows to scroll by, negative values going towards older
+ * history rows.
+ */
+- (void)scrollViewportByRows:(NSInteger)rows;
+
+/**
+ * Finds the given font indices in the scrollback history and on the
+ * screen, newest rows first, ignoring reverse video and case.
+ *
+ * @param[in] glyphs the font indices to look for.
+ * @param[in] length the amount of font indices to look for.
+ * @param[in] cellBuffer the cell buffer.
+ * @param[out] hits the buffer to fill, with lines numbered from 0 for the
+ * oldest history row to historyLength for the topmost screen row.
+ * @param[in] maximumHits the amount of hits that fit in the buffer.
+ *
+ * @return the amount of hits found, up to maximumHits.
+ */
+- (NSUInteger)findGlyphs:(nonnull const uint8_t *)glyphs
+                  length:(NSUInteger)length
+            inCellBuffer:(nonnull const SFTTerminalEmulatorCell *)cellBuffer
+                withHits:(nonnull SFTCoreSearchHit *)hits
+             maximumHits:(NSUInteger)maximumHits;
+
 @end
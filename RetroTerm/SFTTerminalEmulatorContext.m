@@ -20,8 +20,33 @@
  * SOFTWARE.
  */
 
+@import AppKit;
+
 #import "SFTTerminalEmulatorContext.h"
 
+/**
+ * Recent history rows kept uncompressed.
+ */
+static const NSUInteger kScrollbackHotRows = 1024;
+
+static const NSUInteger kDefaultScrollbackMemoryCap = 8 * 1024 * 1024;
+
+static void SFTTerminalEmulatorContextRingBell(void *__unused userData) {
+  // Sessions parse on their own queues, away from AppKit.
+  dispatch_async(dispatch_get_main_queue(), ^{
+    NSBeep();
+  });
+}
+
+@interface SFTTerminalEmulatorContext () {
+  SFTCoreEmulatorState _state;
+  SFTCoreScrollback _scrollback;
+  SFTCoreSearchIndex _searchIndex;
+  SFTCoreSnapshotBuffer _snapshots;
+}
+
+@end
+
 @implementation SFTTerminalEmulatorContext
 
 - (nonnull instancetype)initWithWidth:(NSUInteger)width
@@ -32,18 +57,198 @@
                        usingLowerCase:(BOOL)lowerCase {
   self = [super init];
   if (self != nil) {
-    _width = width;
-    _height = height;
-    _background = background;
-    _foreground = foreground;
-    _isInASCIIMode = asciiMode;
-    _useLowerCase = lowerCase;
-    _reverseVideo = NO;
-    _row = 0;
-    _column = 0;
+    if (!SFTCoreEmulatorStateInitialise(&_state, width, height,
+                                        (uint8_t)(background & 0x0F),
+                                        (uint8_t)(foreground & 0x0F),
+                                        asciiMode == YES, lowerCase == YES)) {
+      [NSException raise:SFTInternalErrorException
+                  format:@"Unsupported screen size %@x%@", @(width),
+                         @(height)];
+    }
+    _state.bellCallback = SFTTerminalEmulatorContextRingBell;
+    _state.userData = NULL;
+
+    NSInteger memoryCap = [NSUserDefaults.standardUserDefaults
+        integerForKey:SFTScrollbackMemoryCapKey];
+    if (!SFTCoreScrollbackInitialise(&_scrollback, width, kScrollbackHotRows,
+                                     (memoryCap > 0)
+                                         ? (size_t)memoryCap
+                                         : kDefaultScrollbackMemoryCap)) {
+      [NSException raise:SFTMemoryException
+                  format:@"Cannot allocate scrollback for %@ columns",
+                         @(width)];
+    }
+    if (!SFTCoreSearchIndexInitialise(&_searchIndex)) {
+      SFTCoreScrollbackRelease(&_scrollback);
+      [NSException raise:SFTMemoryException
+                  format:@"Cannot allocate scrollback search index"];
+    }
+    _scrollback.searchIndex = &_searchIndex;
+    _state.scrollback = &_scrollback;
+
+    if (!SFTCoreSnapshotBufferInitialise(&_snapshots, width, height)) {
+      SFTCoreScrollbackRelease(&_scrollback);
+      SFTCoreSearchIndexRelease(&_searchIndex);
+      [NSException raise:SFTMemoryException
+                  format:@"Cannot allocate screen snapshots"];
+    }
   }
 
   return self;
 }
 
+- (void)dealloc {
+  SFTCoreScrollbackRelease(&_scrollback);
+  SFTCoreSearchIndexRelease(&_searchIndex);
+  SFTCoreSnapshotBufferRelease(&_snapshots);
+}
+
+- (nonnull SFTCoreEmulatorState *)state {
+  return &_state;
+}
+
+- (nonnull SFTCoreScrollback *)scrollback {
+  return &_scrollback;
+}
+
+- (NSUInteger)historyLength {
+  return SFTCoreScrollbackCount(&_scrollback);
+}
+
+- (NSUInteger)width {
+  return _state.width;
+}
+
+- (NSUInteger)height {
+  return _state.height;
+}
+
+- (NSUInteger)cellBufferLength {
+  return _state.width * _state.height * sizeof(SFTTerminalEmulatorCell);
+}
+
++ (NSUInteger)preferredWidth {
+  NSInteger columns =
+      [NSUserDefaults.standardUserDefaults integerForKey:SFTScreenColumnsKey];
+  return ((columns > 0) && (columns <= SFTCoreEmulatorMaximumWidth))
+             ? (NSUInteger)columns
+             : SFTDefaultScreenColumns;
+}
+
++ (NSUInteger)preferredHeight {
+  NSInteger rows =
+      [NSUserDefaults.standardUserDefaults integerForKey:SFTScreenRowsKey];
+  return ((rows > 0) && (rows <= SFTCoreEmulatorMaximumHeight))
+             ? (NSUInteger)rows
+             : SFTDefaultScreenRows;
+}
+
+- (SFTC64Colour)background {
+  return (SFTC64Colour)_state.background;
+}
+
+- (void)setBackground:(SFTC64Colour)background {
+  _state.background = (uint8_t)(background & 0x0F);
+}
+
+- (SFTC64Colour)foreground {
+  return (SFTC64Colour)_state.foreground;
+}
+
+- (void)setForeground:(SFTC64Colour)foreground {
+  _state.foreground = (uint8_t)(foreground & 0x0F);
+}
+
+- (NSUInteger)row {
+  return _state.row;
+}
+
+- (void)setRow:(NSUInteger)row {
+  _state.row = row;
+}
+
+- (NSUInteger)column {
+  return _state.column;
+}
+
+- (void)setColumn:(NSUInteger)column {
+  _state.column = column;
+}
+
+- (NSUInteger)baseRow {
+  return _state.baseRow;
+}
+
+- (BOOL)isInASCIIMode {
+  return _state.isInASCIIMode ? YES : NO;
+}
+
+- (void)setIsInASCIIMode:(BOOL)isInASCIIMode {
+  _state.isInASCIIMode = isInASCIIMode == YES;
+}
+
+- (BOOL)useLowerCase {
+  return _state.useLowerCase ? YES : NO;
+}
+
+- (void)setUseLowerCase:(BOOL)useLowerCase {
+  _state.useLowerCase = useLowerCase == YES;
+}
+
+- (BOOL)reverseVideo {
+  return _state.reverseVideo ? YES : NO;
+}
+
+- (void)setReverseVideo:(BOOL)reverseVideo {
+  _state.reverseVideo = reverseVideo == YES;
+}
+
+- (BOOL)isRowDirty:(NSUInteger)row {
+  return (row < _state.height) && SFTCoreEmulatorIsRowDirty(&_state, row)
+             ? YES
+             : NO;
+}
+
+- (void)enumerateDirtyRowRangesUsingBlock:
+    (void (^_Nonnull)(NSRange rows))block {
+  size_t count = 0;
+  for (size_t row = SFTCoreEmulatorNextDirtyRows(&_state, 0, &count);
+       row < _state.height;
+       row = SFTCoreEmulatorNextDirtyRows(&_state, row + count, &count)) {
+    block(NSMakeRange(row, count));
+  }
+}
+
+- (void)clearDirtyRows {
+  SFTCoreEmulatorClearDirtyRows(&_state);
+}
+
+- (BOOL)publishSnapshotFromCellBuffer:
+    (nonnull const SFTTerminalEmulatorCell *)cellBuffer {
+  return SFTCoreSnapshotBufferPublish(&_snapshots, &_state, cellBuffer) ? YES
+                                                                        : NO;
+}
+
+- (nonnull const SFTCoreSnapshot *)acquireSnapshot {
+  return SFTCoreSnapshotBufferAcquire(&_snapshots);
+}
+
+- (void)scrollViewportToLine:(uint64_t)line {
+  SFTCoreSnapshotBufferScrollViewportToLine(&_snapshots, line);
+}
+
+- (void)scrollViewportByRows:(NSInteger)rows {
+  SFTCoreSnapshotBufferScrollViewportByRows(&_snapshots, &_state,
+                                            (int64_t)rows);
+}
+
+- (NSUInteger)findGlyphs:(nonnull const uint8_t *)glyphs
+                  length:(NSUInteger)length
+            inCellBuffer:(nonnull const SFTTerminalEmulatorCell *)cellBuffer
+                withHits:(nonnull SFTCoreSearchHit *)hits
+             maximumHits:(NSUInteger)maximumHits {
+  return SFTCoreSearchFind(&_scrollback, &_state, cellBuffer, glyphs, length,
+                           hits, maximumHits);
+}
+
 @end
@@ -54,12 +54,13 @@ struct vertex_out_t {
 struct context_t {
   float screen_width;
   float screen_height;
-  ushort cells_wide;
-  ushort cells_tall;
-  ushort selection_start;
-  ushort selection_end;
-  ushort cursor_row;
-  ushort cursor_column;
+  uint cells_wide;
+  uint cells_tall;
+  uint selection_start;
+  uint selection_end;
+  uint cursor_row;
+  uint cursor_column;
+  uint base_row;
   uchar flags;
 };
 
@@ -84,8 +85,14 @@ fragment half4 fragment_terminal(
   float2 normalised = float2(vtx.texture.x, 1.0 - vtx.texture.y);
   float2 scaled = normalised * float2(ctx.cells_wide, ctx.cells_tall);
   uint2 current = uint2(scaled);
-  ushort index = (current.y * ctx.cells_wide) + current.x;
-  uint data = content[index];
+  uint index = (current.y * ctx.cells_wide) + current.x;
+
+  // The cell buffer is a ring of rows starting at base_row.
+  uint row = current.y + ctx.base_row;
+  if (row >= ctx.cells_tall) {
+    row -= ctx.cells_tall;
+  }
+  uint data = content[(row * ctx.cells_wide) + current.x];
 
   uint character = extract_bits(data, 0, 8);
   uint foreground = extract_bits(data, 8, 4);
@@ -123,3 +130,80 @@ fragment half4 fragment_terminal(
                   : (sign(texel.r) > 0.0 ? half4(texel) * PALETTE[foreground]
                                          : PALETTE[background]);
 }
+
+// Per cell rendering: one instance of a four vertices strip for each cell,
+// in visible order.  The glyph, the colours, the selection and the cursor
+// are all resolved once per cell here, leaving the fragment function with a
+// single texel read and no cell buffer access.
+
+struct cell_out_t {
+  float4 position[[position]];
+
+  // Position within the cell, from 0 to 1 on both axes.
+  float2 cell;
+
+  // Texel holding the glyph's top left pixel, its rows going upwards as the
+  // charset is loaded with its origin at the bottom left.
+  uint2 origin[[flat]];
+
+  half4 foreground[[flat]];
+  half4 background[[flat]];
+};
+
+vertex cell_out_t vertex_cells(uint vtx_id[[vertex_id]],
+                               uint instance_id[[instance_id]],
+                               constant context_t &ctx[[buffer(0)]],
+                               device const uint *content[[buffer(1)]]) {
+  cell_out_t out;
+
+  uint row = instance_id / ctx.cells_wide;
+  uint column = instance_id - (row * ctx.cells_wide);
+  float2 corner = float2(vtx_id & 1, vtx_id >> 1);
+  float2 position = (float2(column, row) + corner) /
+                    float2(ctx.cells_wide, ctx.cells_tall);
+  out.position =
+      float4((position.x * 2.0) - 1.0, 1.0 - (position.y * 2.0), 0.0, 1.0);
+  out.cell = corner;
+
+  // The cell buffer is a ring of rows starting at base_row.
+  uint physical = row + ctx.base_row;
+  if (physical >= ctx.cells_tall) {
+    physical -= ctx.cells_tall;
+  }
+  uint data = content[(physical * ctx.cells_wide) + column];
+
+  // Reverse video glyphs are the second 128 of each charset half, and
+  // anything past the lower case half's end shows as blank, as the space
+  // glyph does.
+  uint glyph = extract_bits(data, 0, 8) + (extract_bits(data, 16, 1) * 128) +
+               (extract_bits(ctx.flags, 1, 1) * 256);
+  if (glyph >= 512) {
+    glyph = 32;
+  }
+  out.origin = uint2((glyph % 32) * 8, 127 - ((glyph / 32) * 8));
+
+  bool reversed = ((ctx.selection_end >= instance_id) &&
+                   (ctx.selection_start <= instance_id)) &&
+                  ((ctx.selection_end - ctx.selection_start) > 0);
+  if ((extract_bits(ctx.flags, 0, 1) != 0) && (column == ctx.cursor_column) &&
+      (row == ctx.cursor_row)) {
+    reversed = !reversed;
+  }
+
+  half4 foreground = PALETTE[extract_bits(data, 8, 4)];
+  half4 background = PALETTE[extract_bits(data, 12, 4)];
+  out.foreground = reversed ? background : foreground;
+  out.background = reversed ? foreground : background;
+
+  return out;
+}
+
+fragment half4 fragment_cells(cell_out_t in[[stage_in]],
+                              texture2d<half, access::read> charset
+                              [[texture(0)]]) {
+  uint2 offset = uint2(min(in.cell * 8.0, float2(7.0)));
+  half4 texel =
+      charset.read(uint2(in.origin.x + offset.x, in.origin.y - offset.y));
+
+  return texel.r > 0.0h ? texel * in.foreground : in.background;
+}
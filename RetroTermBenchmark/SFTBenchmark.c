@@ -0,0 +1,270 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SFTBenchmark.h"
+
+static const uint8_t kPETSCIIClear = 0x93;
+static const uint8_t kPETSCIIHome = 0x13;
+static const uint8_t kPETSCIICarriageReturn = 0x0D;
+static const uint8_t kPETSCIIReverseOn = 0x12;
+static const uint8_t kPETSCIIReverseOff = 0x92;
+
+static const uint8_t kPETSCIIColours[] = {0x90, 0x05, 0x1C, 0x9F, 0x9C, 0x1E,
+                                          0x1F, 0x9E, 0x81, 0x95, 0x96, 0x97,
+                                          0x98, 0x99, 0x9A, 0x9B};
+
+static const uint8_t kPETSCIICursorMovements[] = {0x11, 0x1D, 0x91, 0x9D};
+
+static const char kASCIIAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789 .,:;-";
+
+static const char *kProfileNames[SFTBenchmarkProfilesCount] = {
+    "synthetic-petscii-art", "synthetic-ascii-text", "synthetic-scroll",
+    "synthetic-redraw"};
+
+static uint32_t SFTBenchmarkRandomBelow(uint64_t *random, uint32_t limit) {
+  return (uint32_t)((SFTBenchmarkRandom(random) >> 32) % limit);
+}
+
+static uint8_t SFTBenchmarkPETSCIIPrintable(uint64_t *random) {
+  switch (SFTBenchmarkRandomBelow(random, 4)) {
+  case 0:
+    return (uint8_t)(0x20 + SFTBenchmarkRandomBelow(random, 0x20));
+  case 1:
+    return (uint8_t)(0x41 + SFTBenchmarkRandomBelow(random, 26));
+  case 2:
+    return (uint8_t)(0xA0 + SFTBenchmarkRandomBelow(random, 0x20));
+  default:
+    return (uint8_t)(0xC0 + SFTBenchmarkRandomBelow(random, 0x20));
+  }
+}
+
+uint64_t SFTBenchmarkNow(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+}
+
+bool SFTBenchmarkLoadWorkload(const char *path,
+                              SFTBenchmarkWorkload *workload) {
+  memset(workload, 0, sizeof(SFTBenchmarkWorkload));
+
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+
+  if (fseek(file, 0, SEEK_END) != 0) {
+    fclose(file);
+    return false;
+  }
+
+  long size = ftell(file);
+  if ((size <= 0) || (fseek(file, 0, SEEK_SET) != 0)) {
+    fclose(file);
+    return false;
+  }
+
+  workload->bytes = (uint8_t *)malloc((size_t)size);
+  if (workload->bytes == NULL) {
+    fclose(file);
+    return false;
+  }
+
+  workload->length = fread(workload->bytes, 1, (size_t)size, file);
+  fclose(file);
+
+  if (workload->length != (size_t)size) {
+    SFTBenchmarkReleaseWorkload(workload);
+    return false;
+  }
+
+  const char *name = strrchr(path, '/');
+  snprintf(workload->name, sizeof(workload->name), "%s",
+           name != NULL ? name + 1 : path);
+
+  return true;
+}
+
+bool SFTBenchmarkGenerateWorkload(SFTBenchmarkProfile profile, size_t length,
+                                  SFTBenchmarkWorkload *workload) {
+  memset(workload, 0, sizeof(SFTBenchmarkWorkload));
+
+  if ((profile >= SFTBenchmarkProfilesCount) || (length == 0)) {
+    return false;
+  }
+
+  workload->bytes = (uint8_t *)malloc(length);
+  if (workload->bytes == NULL) {
+    return false;
+  }
+
+  workload->length = length;
+  snprintf(workload->name, sizeof(workload->name), "%s",
+           kProfileNames[profile]);
+
+  uint64_t random = 0x9E3779B97F4A7C15ULL;
+  uint8_t *output = workload->bytes;
+  size_t offset = 0;
+  size_t lineLength = 0;
+
+#define EMIT(byte)                                                             \
+  do {                                                                         \
+    if (offset < length) {                                                     \
+      output[offset++] = (uint8_t)(byte);                                      \
+    }                                                                          \
+  } while (0)
+
+  switch (profile) {
+  case SFTBenchmarkProfilePETSCIIArt:
+    EMIT(kPETSCIIClear);
+    while (offset < length) {
+      uint32_t roll = SFTBenchmarkRandomBelow(&random, 100);
+      if (roll < 10) {
+        EMIT(kPETSCIIColours[SFTBenchmarkRandomBelow(
+            &random, sizeof(kPETSCIIColours))]);
+      } else if (roll < 13) {
+        EMIT(kPETSCIIReverseOn);
+      } else if (roll < 15) {
+        EMIT(kPETSCIIReverseOff);
+      } else if (roll < 17) {
+        EMIT(kPETSCIICursorMovements[SFTBenchmarkRandomBelow(
+            &random, sizeof(kPETSCIICursorMovements))]);
+      } else {
+        EMIT(SFTBenchmarkPETSCIIPrintable(&random));
+        if (++lineLength == 39) {
+          EMIT(kPETSCIICarriageReturn);
+          lineLength = 0;
+        }
+      }
+
+      if (SFTBenchmarkRandomBelow(&random, 2000) == 0) {
+        EMIT(SFTBenchmarkRandomBelow(&random, 2) == 0 ? kPETSCIIClear
+                                                      : kPETSCIIHome);
+      }
+    }
+    break;
+
+  case SFTBenchmarkProfileASCIIText:
+    while (offset < length) {
+      uint32_t count = 20 + SFTBenchmarkRandomBelow(&random, 60);
+      for (uint32_t index = 0; index < count; index++) {
+        EMIT(kASCIIAlphabet[SFTBenchmarkRandomBelow(
+            &random, sizeof(kASCIIAlphabet) - 1)]);
+      }
+      EMIT('\r');
+      EMIT('\n');
+    }
+    break;
+
+  case SFTBenchmarkProfileScroll:
+    EMIT(kPETSCIIClear);
+    while (offset < length) {
+      uint32_t count = 10 + SFTBenchmarkRandomBelow(&random, 30);
+      for (uint32_t index = 0; index < count; index++) {
+        EMIT(SFTBenchmarkPETSCIIPrintable(&random));
+      }
+      EMIT(kPETSCIICarriageReturn);
+    }
+    break;
+
+  case SFTBenchmarkProfileRedraw:
+    while (offset < length) {
+      EMIT(kPETSCIIClear);
+      EMIT(kPETSCIIColours[SFTBenchmarkRandomBelow(&random,
+                                                  sizeof(kPETSCIIColours))]);
+      for (uint32_t index = 0; index < 999; index++) {
+        EMIT(SFTBenchmarkPETSCIIPrintable(&random));
+      }
+      EMIT(kPETSCIIHome);
+    }
+    break;
+
+  default:
+    break;
+  }
+
+#undef EMIT
+
+  return true;
+}
+
+void SFTBenchmarkReleaseWorkload(SFTBenchmarkWorkload *workload) {
+  free(workload->bytes);
+  workload->bytes = NULL;
+  workload->length = 0;
+}
+
+int SFTBenchmarkRunWorkloads(int argc, char *argv[], int first,
+                             size_t syntheticSize,
+                             SFTBenchmarkWorkloadCallback callback,
+                             void *userData) {
+  int result = EXIT_SUCCESS;
+  SFTBenchmarkWorkload workload;
+
+  if (first >= argc) {
+    for (int profile = 0; profile < SFTBenchmarkProfilesCount; profile++) {
+      if (!SFTBenchmarkGenerateWorkload((SFTBenchmarkProfile)profile,
+                                        syntheticSize, &workload)) {
+        fprintf(stderr, "Cannot generate synthetic workload\n");
+        return EXIT_FAILURE;
+      }
+
+      if (!callback(&workload, userData)) {
+        result = EXIT_FAILURE;
+      }
+      SFTBenchmarkReleaseWorkload(&workload);
+    }
+    return result;
+  }
+
+  for (int index = first; index < argc; index++) {
+    if (!SFTBenchmarkLoadWorkload(argv[index], &workload)) {
+      fprintf(stderr, "Cannot load capture %s\n", argv[index]);
+      result = EXIT_FAILURE;
+      continue;
+    }
+
+    if (!callback(&workload, userData)) {
+      result = EXIT_FAILURE;
+    }
+    SFTBenchmarkReleaseWorkload(&workload);
+  }
+  return result;
+}
+
+uint64_t SFTBenchmarkHash(const void *bytes, size_t length, uint64_t seed) {
+  const uint8_t *data = (const uint8_t *)bytes;
+  uint64_t hash = seed != 0 ? seed : 0xCBF29CE484222325ULL;
+
+  for (size_t index = 0; index < length; index++) {
+    hash ^= data[index];
+    hash *= 0x100000001B3ULL;
+  }
+
+  return hash;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTBenchmark_h
+#define SFTBenchmark_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SFTCoreEmulator.h"
+
+/**
+ * A named chunk of terminal traffic to feed through the emulator.
+ */
+typedef struct {
+  char name[64];
+  uint8_t *bytes;
+  size_t length;
+} SFTBenchmarkWorkload;
+
+/**
+ * Synthetic workload profiles, used when no captured session is available.
+ */
+typedef enum {
+  /** PETSCII art: colour codes, reverse video, graphic characters. */
+  SFTBenchmarkProfilePETSCIIArt = 0,
+  /** Plain ASCII text lines, as sent by ASCII boards. */
+  SFTBenchmarkProfileASCIIText,
+  /** Short PETSCII lines scrolling past the bottom of the screen. */
+  SFTBenchmarkProfileScroll,
+  /** Full screen redraws: clear screen followed by a whole screen of text. */
+  SFTBenchmarkProfileRedraw,
+  SFTBenchmarkProfilesCount
+} SFTBenchmarkProfile;
+
+/**
+ * Returns a monotonic timestamp, in nanoseconds.
+ */
+uint64_t SFTBenchmarkNow(void);
+
+/**
+ * Advances a xorshift64 generator, which gives the same sequence everywhere
+ * so that runs, and the inputs they generate, can be repeated.
+ *
+ * @param[in,out] state the generator state, never zero.
+ *
+ * @return the new state, to be used as the next random number.
+ */
+static inline uint64_t SFTBenchmarkRandom(uint64_t *state) {
+  uint64_t value = *state;
+  value ^= value << 13;
+  value ^= value >> 7;
+  value ^= value << 17;
+  *state = value;
+  return value;
+}
+
+/**
+ * Loads a captured session from disk.
+ *
+ * @param[in] path the capture file path.
+ * @param[out] workload the workload to fill.
+ *
+ * @return true if the file was loaded, false otherwise.
+ */
+bool SFTBenchmarkLoadWorkload(const char *path,
+                              SFTBenchmarkWorkload *workload);
+
+/**
+ * Generates a deterministic synthetic workload.
+ *
+ * @param[in] profile the kind of traffic to generate.
+ * @param[in] length the amount of bytes to generate.
+ * @param[out] workload the workload to fill.
+ *
+ * @return true if the workload was generated, false otherwise.
+ */
+bool SFTBenchmarkGenerateWorkload(SFTBenchmarkProfile profile, size_t length,
+                                  SFTBenchmarkWorkload *workload);
+
+/**
+ * Releases memory held by the given workload.
+ */
+void SFTBenchmarkReleaseWorkload(SFTBenchmarkWorkload *workload);
+
+/**
+ * Runs a benchmark on a single workload.
+ *
+ * @param[in] workload the workload to run the benchmark on.
+ * @param[in] userData the opaque pointer given to SFTBenchmarkRunWorkloads.
+ *
+ * @return true if the run succeeded, false otherwise.
+ */
+typedef bool (*SFTBenchmarkWorkloadCallback)(
+    const SFTBenchmarkWorkload *workload, void *userData);
+
+/**
+ * Runs a benchmark on every capture given on the command line or, if there
+ * are none, on a synthetic workload of every profile.
+ *
+ * @param[in] argc the command line arguments count.
+ * @param[in] argv the command line arguments.
+ * @param[in] first the index of the first capture in argv.
+ * @param[in] syntheticSize the length of each synthetic workload.
+ * @param[in] callback the benchmark to run on each workload.
+ * @param[in] userData the opaque pointer to pass to the callback.
+ *
+ * @return EXIT_SUCCESS if every workload was loaded and every run succeeded,
+ *         EXIT_FAILURE otherwise.
+ */
+int SFTBenchmarkRunWorkloads(int argc, char *argv[], int first,
+                             size_t syntheticSize,
+                             SFTBenchmarkWorkloadCallback callback,
+                             void *userData);
+
+/**
+ * FNV-1a hash, used to make sure results are not optimised away and to
+ * compare final screen states between runs.
+ */
+uint64_t SFTBenchmarkHash(const void *bytes, size_t length, uint64_t seed);
+
+/**
+ * Size of the header fuzzer inputs start with, picking the emulator
+ * configuration and how the data is split into chunks.
+ */
+#define SFTBenchmarkFuzzHeaderSize 2
+
+/**
+ * Largest screen a fuzzer input can ask for, in cells.
+ */
+#define SFTBenchmarkFuzzMaximumCells (80 * 25)
+
+/**
+ * A fuzzer input, decoded.
+ */
+typedef struct {
+  size_t width;
+  size_t height;
+  bool asciiMode;
+  bool lowerCase;
+
+  /**
+   * Seed for the chunk sizes the data is split into.
+   */
+  uint8_t chunkSeed;
+
+  const uint8_t *bytes;
+  size_t length;
+} SFTBenchmarkFuzzInput;
+
+/**
+ * Screen left by parsing a fuzzer input.
+ */
+typedef struct {
+  SFTCoreEmulatorState state;
+  SFTTerminalEmulatorCell cells[SFTBenchmarkFuzzMaximumCells];
+  size_t bells;
+} SFTBenchmarkFuzzScreen;
+
+/**
+ * Decodes a fuzzer input.
+ *
+ * @param[in] data the raw input, header included.
+ * @param[in] size the raw input length.
+ * @param[out] input the decoded input.
+ *
+ * @return true if the input was decoded, false if it is too short.
+ */
+bool SFTBenchmarkFuzzDecode(const uint8_t *data, size_t size,
+                            SFTBenchmarkFuzzInput *input);
+
+/**
+ * Parses the given input with both parser implementations, each fed all at
+ * once and in chunks, checking that all of them leave exactly the same
+ * state and cell buffer, and that every row changed by a chunk was marked
+ * dirty.
+ *
+ * @param[in] input the input to parse.
+ * @param[out] screen the screen left by the reference parser, can be NULL.
+ * @param[out] reason what went wrong, if anything.
+ * @param[in] reasonLength the reason buffer length.
+ *
+ * @return true if all parsers agree, false otherwise.
+ */
+bool SFTBenchmarkFuzzCheck(const SFTBenchmarkFuzzInput *input,
+                           SFTBenchmarkFuzzScreen *screen, char *reason,
+                           size_t reasonLength);
+
+int SFTParserBenchmarkMain(int argc, char *argv[]);
+int SFTRingBenchmarkMain(int argc, char *argv[]);
+int SFTEventLoopBenchmarkMain(int argc, char *argv[]);
+int SFTReplayBenchmarkMain(int argc, char *argv[]);
+int SFTCaptureBenchmarkMain(int argc, char *argv[]);
+int SFTPacketLogBenchmarkMain(int argc, char *argv[]);
+int SFTScrollbackBenchmarkMain(int argc, char *argv[]);
+int SFTSearchBenchmarkMain(int argc, char *argv[]);
+int SFTTelnetBenchmarkMain(int argc, char *argv[]);
+int SFTPipelineBenchmarkMain(int argc, char *argv[]);
+int SFTRenderBenchmarkMain(int argc, char *argv[]);
+int SFTThumbnailBenchmarkMain(int argc, char *argv[]);
+int SFTSessionsBenchmarkMain(int argc, char *argv[]);
+int SFTSnapshotBenchmarkMain(int argc, char *argv[]);
+int SFTFuzzBenchmarkMain(int argc, char *argv[]);
+int SFTGoldenBenchmarkMain(int argc, char *argv[]);
+int SFTGeometryBenchmarkMain(int argc, char *argv[]);
+
+#endif /* SFTBenchmark_h */
@@ -0,0 +1,381 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Records each workload as a timestamped session capture, then measures how
+ * long it takes to write, how much space it takes over the raw bytes, how long
+ * it takes to open with and without its trailing index, and how long seeking
+ * into it takes.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreCapture.h"
+#include "SFTCoreEmulator.h"
+
+static const size_t kDefaultSyntheticSize = 8 * 1024 * 1024;
+static const size_t kDefaultSeeks = 1000;
+static const size_t kDefaultWidth = 40;
+static const size_t kDefaultHeight = 25;
+static const size_t kMaximumPacketSize = 1460;
+
+/**
+ * Longest simulated pause between two packets, in microseconds.
+ */
+static const uint64_t kMaximumPacketGap = 20000;
+
+/**
+ * One packet in this many is followed by an outbound keystroke.
+ */
+static const size_t kKeystrokeRatio = 16;
+
+/**
+ * Amount of seeks checked against a parse from the start of the capture.
+ */
+static const size_t kVerifiedSeeks = 16;
+
+typedef struct {
+  size_t width;
+  size_t height;
+  size_t interval;
+  size_t seeks;
+  const char *directory;
+} SFTCaptureBenchmarkOptions;
+
+static void SFTCaptureBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s capture [-n seeks] [-k checkpoint interval] "
+          "[-s synthetic bytes] [-w width] [-h height] [-d directory] "
+          "[capture ...]\n"
+          "\n"
+          "Records each raw capture as timestamped packets, then reopens "
+          "it with and\nwithout its index, replays it against a simulated "
+          "clock and seeks to random\npoints in time, checking some of them "
+          "against a parse from the start.\nSynthetic workloads are used "
+          "when no capture is given.\n",
+          name);
+}
+
+static uint64_t
+SFTCaptureBenchmarkScreenHash(const SFTCoreEmulatorState *state,
+                              const SFTTerminalEmulatorCell *cells,
+                              SFTTerminalEmulatorCell *screen) {
+  SFTCoreEmulatorCopyContents(state, cells, screen);
+  uint64_t hash = SFTBenchmarkHash(
+      screen, state->width * state->height * sizeof(SFTTerminalEmulatorCell),
+      0);
+  hash = SFTBenchmarkHash(&state->row, sizeof(state->row), hash);
+  return SFTBenchmarkHash(&state->column, sizeof(state->column), hash);
+}
+
+static void
+SFTCaptureBenchmarkStartState(const SFTCaptureBenchmarkOptions *options,
+                              SFTCoreEmulatorState *state,
+                              SFTTerminalEmulatorCell *cells) {
+  SFTCoreEmulatorStateInitialise(state, options->width, options->height, 0,
+                                 14, true, false);
+  SFTCoreEmulatorClearScreen(state, cells);
+}
+
+static bool SFTCaptureBenchmarkWrite(const SFTBenchmarkWorkload *workload,
+                                     const SFTCaptureBenchmarkOptions *options,
+                                     const char *path,
+                                     SFTTerminalEmulatorCell *cells) {
+  SFTCoreEmulatorState state;
+  SFTCaptureBenchmarkStartState(options, &state, cells);
+
+  SFTCoreCaptureWriter writer;
+  uint64_t now = 1500000000ULL * 1000000000ULL;
+  if (!SFTCoreCaptureWriterOpen(&writer, path, &state, cells,
+                                options->interval, now)) {
+    return false;
+  }
+
+  uint64_t seed = 0x9E3779B97F4A7C15ULL;
+  bool succeeded = true;
+  size_t packets = 0;
+  for (size_t offset = 0; succeeded && (offset < workload->length);) {
+    size_t length =
+        1 + (size_t)(SFTBenchmarkRandom(&seed) % kMaximumPacketSize);
+    if (length > workload->length - offset) {
+      length = workload->length - offset;
+    }
+    now += (SFTBenchmarkRandom(&seed) % kMaximumPacketGap) * 1000;
+
+    succeeded = SFTCoreCaptureWriterAppend(&writer, now,
+                                           SFTCoreCaptureRecordInbound,
+                                           workload->bytes + offset, length);
+    offset += length;
+
+    if ((++packets % kKeystrokeRatio) == 0) {
+      uint8_t keystroke = (uint8_t)(packets & 0x7F);
+      succeeded = succeeded && SFTCoreCaptureWriterAppend(
+                                   &writer, now, SFTCoreCaptureRecordOutbound,
+                                   &keystroke, 1);
+    }
+  }
+
+  return SFTCoreCaptureWriterClose(&writer) && succeeded;
+}
+
+/**
+ * Replays the whole capture against a simulated 60Hz clock, returning the
+ * simulated time it took in microseconds, or UINT64_MAX if the bytes
+ * delivered are not the recorded ones.
+ */
+static uint64_t
+SFTCaptureBenchmarkReplay(SFTCoreCaptureReader *reader,
+                          const SFTBenchmarkWorkload *workload) {
+  SFTCoreCaptureReaderStartClock(reader, 0);
+
+  uint64_t tick = 0;
+  size_t delivered = 0;
+  while (!SFTCoreCaptureReaderIsFinished(reader)) {
+    tick++;
+    uint64_t now = tick * 1000000000ULL / 60;
+
+    const uint8_t *bytes;
+    size_t length;
+    while ((length = SFTCoreCaptureReaderNextBatch(reader, now, &bytes)) > 0) {
+      if ((length > workload->length - delivered) ||
+          (memcmp(bytes, workload->bytes + delivered, length) != 0)) {
+        return UINT64_MAX;
+      }
+      delivered += length;
+      SFTCoreCaptureReaderConsume(reader, length);
+    }
+  }
+
+  return (delivered == workload->length) ? tick * 1000000 / 60 : UINT64_MAX;
+}
+
+static bool SFTCaptureBenchmarkRun(const SFTBenchmarkWorkload *workload,
+                                   const SFTCaptureBenchmarkOptions *options,
+                                   SFTTerminalEmulatorCell *cells,
+                                   SFTTerminalEmulatorCell *reference,
+                                   SFTTerminalEmulatorCell *screen) {
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/SFTCaptureBenchmark-%d.sftcapture",
+           options->directory, (int)getpid());
+
+  uint64_t start = SFTBenchmarkNow();
+  if (!SFTCaptureBenchmarkWrite(workload, options, path, cells)) {
+    fprintf(stderr, "Cannot write capture %s\n", path);
+    unlink(path);
+    return false;
+  }
+  uint64_t writing = SFTBenchmarkNow() - start;
+
+  SFTCoreCaptureReader reader;
+  start = SFTBenchmarkNow();
+  bool opened = SFTCoreCaptureReaderOpen(&reader, path);
+  uint64_t opening = SFTBenchmarkNow() - start;
+  unlink(path);
+  if (!opened) {
+    fprintf(stderr, "Cannot open capture for %s\n", workload->name);
+    return false;
+  }
+
+  // A capture cut short, as left behind by a crash, has no index and ends
+  // with an incomplete record.
+  bool matches = true;
+  SFTCoreCaptureReader truncated;
+  start = SFTBenchmarkNow();
+  if (!SFTCoreCaptureReaderOpenMemory(&truncated, reader.bytes,
+                                      reader.recordsEnd - 1)) {
+    fprintf(stderr, "Cannot rebuild the index for %s\n", workload->name);
+    matches = false;
+  }
+  uint64_t rebuilding = SFTBenchmarkNow() - start;
+  if (matches && ((truncated.checkpointsCount != reader.checkpointsCount) ||
+                  (truncated.inboundLength > reader.inboundLength))) {
+    fprintf(stderr, "Rebuilt index for %s does not match\n", workload->name);
+    matches = false;
+  }
+  SFTCoreCaptureReaderClose(&truncated);
+
+  uint64_t replaying = SFTCaptureBenchmarkReplay(&reader, workload);
+  if (replaying == UINT64_MAX) {
+    fprintf(stderr, "Replay of %s does not match\n", workload->name);
+    matches = false;
+  }
+
+  SFTCoreEmulatorState state;
+  SFTCaptureBenchmarkStartState(options, &state, cells);
+
+  uint64_t seed = 0x2545F4914F6CDD1DULL;
+  uint64_t seeking = 0;
+  uint64_t slowest = 0;
+  for (size_t index = 0; index < options->seeks; index++) {
+    uint64_t timestamp = SFTBenchmarkRandom(&seed) % (reader.duration + 1);
+
+    start = SFTBenchmarkNow();
+    uint64_t offset = SFTCoreCaptureReaderOffsetAtTime(&reader, timestamp);
+    bool sought = SFTCoreCaptureReaderSeek(&reader, &state, cells, offset);
+    uint64_t elapsed = SFTBenchmarkNow() - start;
+    seeking += elapsed;
+    if (elapsed > slowest) {
+      slowest = elapsed;
+    }
+
+    if (!sought || (SFTCoreCaptureReaderPosition(&reader) != offset)) {
+      fprintf(stderr, "Cannot seek to %llu in %s\n",
+              (unsigned long long)offset, workload->name);
+      matches = false;
+      break;
+    }
+
+    if (index < kVerifiedSeeks) {
+      SFTCoreEmulatorState linear;
+      SFTCaptureBenchmarkStartState(options, &linear, reference);
+      SFTCoreEmulatorProcessIncomingData(&linear, reference, workload->bytes,
+                                         (size_t)offset);
+      if (SFTCaptureBenchmarkScreenHash(&state, cells, screen) !=
+          SFTCaptureBenchmarkScreenHash(&linear, reference, screen)) {
+        fprintf(stderr, "Seek to %llu in %s does not match\n",
+                (unsigned long long)offset, workload->name);
+        matches = false;
+      }
+    }
+  }
+
+  double bytes = (double)workload->length;
+  printf("%-24s %12zu %9.2f %10.2f %9.1f %10.2f %9.1f %9.1f %9.2f %9.2f  "
+         "%s\n",
+         workload->name, workload->length,
+         bytes > 0 ? ((double)reader.length - bytes) * 100.0 / bytes : 0.0,
+         (bytes * 1000.0) / (double)writing, (double)opening / 1e3,
+         (double)rebuilding / 1e6, (double)reader.duration / 1e6,
+         replaying != UINT64_MAX ? (double)replaying / 1e6 : 0.0,
+         (double)seeking / (double)options->seeks / 1e3,
+         (double)slowest / 1e3, matches ? "OK" : "FAILED");
+
+  SFTCoreCaptureReaderClose(&reader);
+  return matches;
+}
+
+/**
+ * Options and buffers shared by every workload.
+ */
+typedef struct {
+  const SFTCaptureBenchmarkOptions *options;
+  SFTTerminalEmulatorCell *cells;
+  SFTTerminalEmulatorCell *reference;
+  SFTTerminalEmulatorCell *screen;
+} SFTCaptureBenchmarkContext;
+
+static bool SFTCaptureBenchmarkRunWorkload(const SFTBenchmarkWorkload *workload,
+                                           void *userData) {
+  const SFTCaptureBenchmarkContext *context =
+      (const SFTCaptureBenchmarkContext *)userData;
+  return SFTCaptureBenchmarkRun(workload, context->options, context->cells,
+                                context->reference, context->screen);
+}
+
+int SFTCaptureBenchmarkMain(int argc, char *argv[]) {
+  const char *directory = getenv("TMPDIR");
+  SFTCaptureBenchmarkOptions options = {
+      .width = kDefaultWidth,
+      .height = kDefaultHeight,
+      .interval = SFTCoreCaptureDefaultCheckpointInterval,
+      .seeks = kDefaultSeeks,
+      .directory = (directory != NULL) ? directory : "/tmp"};
+  size_t syntheticSize = kDefaultSyntheticSize;
+
+  int option;
+  while ((option = getopt(argc, argv, "n:k:s:w:h:d:")) != -1) {
+    switch (option) {
+    case 'n':
+      options.seeks = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'k':
+      options.interval = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 's':
+      syntheticSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'w':
+      options.width = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'h':
+      options.height = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'd':
+      options.directory = optarg;
+      break;
+
+    default:
+      SFTCaptureBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  SFTCoreEmulatorState probe;
+  if ((options.seeks == 0) || (options.interval == 0) ||
+      !SFTCoreEmulatorStateInitialise(&probe, options.width, options.height, 0,
+                                      0, false, false)) {
+    SFTCaptureBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  size_t screenSize = options.width * options.height;
+  SFTTerminalEmulatorCell *cells = (SFTTerminalEmulatorCell *)calloc(
+      screenSize, sizeof(SFTTerminalEmulatorCell));
+  SFTTerminalEmulatorCell *reference = (SFTTerminalEmulatorCell *)calloc(
+      screenSize, sizeof(SFTTerminalEmulatorCell));
+  SFTTerminalEmulatorCell *screen = (SFTTerminalEmulatorCell *)calloc(
+      screenSize, sizeof(SFTTerminalEmulatorCell));
+  if ((cells == NULL) || (reference == NULL) || (screen == NULL)) {
+    fprintf(stderr, "Cannot allocate cell buffer\n");
+    free(cells);
+    free(reference);
+    free(screen);
+    return EXIT_FAILURE;
+  }
+
+  printf("%-24s %12s %9s %10s %9s %10s %9s %9s %9s %9s  %s\n", "workload",
+         "bytes", "overhead%", "write MB/s", "open us", "rebuild ms",
+         "length s", "replay s", "seek us", "seek max", "result");
+
+  SFTCaptureBenchmarkContext context = {.options = &options,
+                                        .cells = cells,
+                                        .reference = reference,
+                                        .screen = screen};
+  int result = SFTBenchmarkRunWorkloads(argc, argv, optind, syntheticSize,
+                                        SFTCaptureBenchmarkRunWorkload,
+                                        &context);
+
+  free(screen);
+  free(reference);
+  free(cells);
+  return result;
+}
@@ -0,0 +1,688 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Opens a number of sessions against an echo server running in a child process,
+ * and compares the shared kqueue/epoll event loop with one thread per session.
+ * Both models report the threads they use, the CPU time they take while idle,
+ * and their throughput and CPU time while busy.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "SFTBenchmark.h"
+#include "SFTCoreEventLoop.h"
+
+static const size_t kDefaultSessions = 12;
+static const unsigned int kDefaultIdleSeconds = 2;
+static const uint64_t kDefaultBusyBytes = 16 * 1024 * 1024;
+
+/**
+ * How long to wait for all sessions to have their data echoed back.
+ */
+static const unsigned int kBusyTimeoutSeconds = 120;
+
+typedef enum {
+  /** All sessions multiplexed on a single SFTCoreEventLoop thread. */
+  SFTEventLoopBenchmarkModelSharedLoop = 0,
+  /** One thread per session, each blocked on its own socket and wake-up
+      pipe, as the NSThread and NSRunLoop based processor does. */
+  SFTEventLoopBenchmarkModelThreads
+} SFTEventLoopBenchmarkModelKind;
+
+typedef struct {
+  const char *name;
+  SFTEventLoopBenchmarkModelKind kind;
+} SFTEventLoopBenchmarkModel;
+
+static const SFTEventLoopBenchmarkModel kModels[] = {
+    {"loop", SFTEventLoopBenchmarkModelSharedLoop},
+    {"threads", SFTEventLoopBenchmarkModelThreads}};
+
+static const size_t kModelsCount = sizeof(kModels) / sizeof(kModels[0]);
+
+struct SFTEventLoopBenchmarkContext;
+
+typedef struct {
+  SFTCoreEventSource source;
+  int descriptor;
+  struct SFTEventLoopBenchmarkContext *context;
+
+  uint64_t toSend;
+  uint64_t sent;
+  uint64_t toReceive;
+  uint64_t received;
+
+  pthread_t thread;
+  int wakeDescriptors[2];
+} SFTEventLoopBenchmarkSession;
+
+typedef struct SFTEventLoopBenchmarkContext {
+  SFTCoreEventLoop loop;
+  SFTEventLoopBenchmarkSession *sessions;
+  size_t sessionsCount;
+  uint64_t busyBytes;
+
+  pthread_mutex_t lock;
+  pthread_cond_t condition;
+  size_t finished;
+  _Atomic bool busy;
+  _Atomic bool stopping;
+} SFTEventLoopBenchmarkContext;
+
+/**
+ * Echo server connection, living in the forked server process.
+ */
+typedef struct {
+  SFTCoreEventSource source;
+  SFTCoreEventLoop *loop;
+  size_t length;
+  size_t offset;
+  uint8_t buffer[64 * 1024];
+} SFTEventLoopBenchmarkEchoConnection;
+
+static uint8_t gPattern[16 * 1024];
+
+static uint64_t SFTEventLoopBenchmarkCPUTime(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return ((uint64_t)usage.ru_utime.tv_sec + (uint64_t)usage.ru_stime.tv_sec) *
+             1000000ULL +
+         (uint64_t)usage.ru_utime.tv_usec + (uint64_t)usage.ru_stime.tv_usec;
+}
+
+static size_t SFTEventLoopBenchmarkThreadCount(void) {
+#if defined(__APPLE__)
+  thread_act_array_t threads;
+  mach_msg_type_number_t count = 0;
+  if (task_threads(mach_task_self(), &threads, &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  for (mach_msg_type_number_t index = 0; index < count; index++) {
+    mach_port_deallocate(mach_task_self(), threads[index]);
+  }
+  vm_deallocate(mach_task_self(), (vm_address_t)threads,
+                count * sizeof(thread_act_t));
+  return count;
+#else
+  DIR *directory = opendir("/proc/self/task");
+  if (directory == NULL) {
+    return 0;
+  }
+  size_t count = 0;
+  struct dirent *entry;
+  while ((entry = readdir(directory)) != NULL) {
+    if (entry->d_name[0] != '.') {
+      count++;
+    }
+  }
+  closedir(directory);
+  return count;
+#endif
+}
+
+static void SFTEventLoopBenchmarkReleaseEchoConnection(void *context) {
+  free(context);
+}
+
+static void SFTEventLoopBenchmarkEcho(SFTCoreEventSource *source,
+                                      uint32_t events) {
+  SFTEventLoopBenchmarkEchoConnection *connection =
+      (SFTEventLoopBenchmarkEchoConnection *)source->userData;
+
+  if ((connection->length == 0) && (events & SFTCoreEventReadable)) {
+    ssize_t bytesRead = read(source->descriptor, connection->buffer,
+                             sizeof(connection->buffer));
+    if ((bytesRead == 0) || ((bytesRead < 0) && (errno != EAGAIN))) {
+      int descriptor = source->descriptor;
+      SFTCoreEventLoopRemoveSource(connection->loop, source);
+      close(descriptor);
+      SFTCoreEventLoopPerform(connection->loop,
+                              SFTEventLoopBenchmarkReleaseEchoConnection,
+                              connection);
+      return;
+    }
+    if (bytesRead > 0) {
+      connection->length = (size_t)bytesRead;
+      connection->offset = 0;
+    }
+  }
+
+  if (connection->length > 0) {
+    ssize_t bytesWritten =
+        write(source->descriptor, connection->buffer + connection->offset,
+              connection->length - connection->offset);
+    if (bytesWritten > 0) {
+      connection->offset += (size_t)bytesWritten;
+      if (connection->offset == connection->length) {
+        connection->length = 0;
+      }
+    }
+  }
+
+  SFTCoreEventLoopSetInterest(connection->loop, source,
+                              (connection->length > 0) ? SFTCoreEventWritable
+                                                       : SFTCoreEventReadable);
+}
+
+static void SFTEventLoopBenchmarkAccept(SFTCoreEventSource *source,
+                                        uint32_t events) {
+  (void)events;
+  SFTCoreEventLoop *loop = (SFTCoreEventLoop *)source->userData;
+
+  int descriptor;
+  while ((descriptor = accept(source->descriptor, NULL, NULL)) >= 0) {
+    SFTEventLoopBenchmarkEchoConnection *connection =
+        (SFTEventLoopBenchmarkEchoConnection *)calloc(
+            1, sizeof(SFTEventLoopBenchmarkEchoConnection));
+    if (connection == NULL) {
+      close(descriptor);
+      continue;
+    }
+
+    connection->loop = loop;
+    connection->source.descriptor = descriptor;
+    connection->source.callback = SFTEventLoopBenchmarkEcho;
+    connection->source.userData = connection;
+    if (!SFTCoreEventLoopAddSource(loop, &connection->source,
+                                   SFTCoreEventReadable)) {
+      close(descriptor);
+      free(connection);
+    }
+  }
+}
+
+/**
+ * Runs the echo server, never returns.
+ */
+static void SFTEventLoopBenchmarkServe(int listener) {
+  SFTCoreEventLoop loop;
+  if (!SFTCoreEventLoopInitialise(&loop)) {
+    _exit(EXIT_FAILURE);
+  }
+
+  SFTCoreEventSource source = {.descriptor = listener,
+                               .interest = 0,
+                               .callback = SFTEventLoopBenchmarkAccept,
+                               .userData = &loop};
+  if (!SFTCoreEventLoopAddSource(&loop, &source, SFTCoreEventReadable) ||
+      !SFTCoreEventLoopStart(&loop)) {
+    _exit(EXIT_FAILURE);
+  }
+
+  for (;;) {
+    pause();
+  }
+}
+
+static void SFTEventLoopBenchmarkSessionFinished(
+    SFTEventLoopBenchmarkSession *session) {
+  pthread_mutex_lock(&session->context->lock);
+  session->context->finished++;
+  pthread_cond_signal(&session->context->condition);
+  pthread_mutex_unlock(&session->context->lock);
+}
+
+static void SFTEventLoopBenchmarkSessionSend(
+    SFTEventLoopBenchmarkSession *session) {
+  while (session->sent < session->toSend) {
+    uint64_t remaining = session->toSend - session->sent;
+    size_t length = (remaining < sizeof(gPattern)) ? (size_t)remaining
+                                                   : sizeof(gPattern);
+    ssize_t bytesWritten = write(session->descriptor, gPattern, length);
+    if (bytesWritten <= 0) {
+      return;
+    }
+    session->sent += (uint64_t)bytesWritten;
+  }
+}
+
+static void SFTEventLoopBenchmarkSessionReceive(
+    SFTEventLoopBenchmarkSession *session, uint8_t *buffer, size_t length) {
+  for (;;) {
+    ssize_t bytesRead = read(session->descriptor, buffer, length);
+    if (bytesRead <= 0) {
+      return;
+    }
+
+    bool wasPending = session->received < session->toReceive;
+    session->received += (uint64_t)bytesRead;
+    if (wasPending && (session->received >= session->toReceive)) {
+      SFTEventLoopBenchmarkSessionFinished(session);
+    }
+  }
+}
+
+static void SFTEventLoopBenchmarkLoopSessionReady(SFTCoreEventSource *source,
+                                                  uint32_t events) {
+  static uint8_t buffer[64 * 1024];
+  SFTEventLoopBenchmarkSession *session =
+      (SFTEventLoopBenchmarkSession *)source->userData;
+
+  if (events & SFTCoreEventWritable) {
+    SFTEventLoopBenchmarkSessionSend(session);
+  }
+  if (events & SFTCoreEventReadable) {
+    SFTEventLoopBenchmarkSessionReceive(session, buffer, sizeof(buffer));
+  }
+
+  SFTCoreEventLoopSetInterest(
+      &session->context->loop, source,
+      SFTCoreEventReadable | ((session->sent < session->toSend)
+                                  ? SFTCoreEventWritable
+                                  : 0));
+}
+
+static void SFTEventLoopBenchmarkLoopStartBusy(void *argument) {
+  SFTEventLoopBenchmarkContext *context =
+      (SFTEventLoopBenchmarkContext *)argument;
+
+  for (size_t index = 0; index < context->sessionsCount; index++) {
+    SFTEventLoopBenchmarkSession *session = &context->sessions[index];
+    session->toSend += context->busyBytes;
+    session->toReceive += context->busyBytes;
+    SFTCoreEventLoopSetInterest(&context->loop, &session->source,
+                                SFTCoreEventReadable | SFTCoreEventWritable);
+  }
+}
+
+static void *SFTEventLoopBenchmarkSessionThread(void *argument) {
+  SFTEventLoopBenchmarkSession *session =
+      (SFTEventLoopBenchmarkSession *)argument;
+  uint8_t buffer[64 * 1024];
+  bool busy = false;
+
+  for (;;) {
+    struct pollfd descriptors[2] = {
+        {.fd = session->wakeDescriptors[0], .events = POLLIN, .revents = 0},
+        {.fd = session->descriptor,
+         .events = (short)(POLLIN |
+                           ((session->sent < session->toSend) ? POLLOUT : 0)),
+         .revents = 0}};
+
+    if (poll(descriptors, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    if (descriptors[0].revents != 0) {
+      uint8_t wakeUps[16];
+      while (read(session->wakeDescriptors[0], wakeUps, sizeof(wakeUps)) > 0) {
+      }
+      if (atomic_load(&session->context->stopping)) {
+        break;
+      }
+
+      // Targets are only ever touched by the thread owning the session, so
+      // the busy phase is picked up here rather than handed over directly.
+      if (!busy && atomic_load(&session->context->busy)) {
+        busy = true;
+        session->toSend += session->context->busyBytes;
+        session->toReceive += session->context->busyBytes;
+        continue;
+      }
+    }
+
+    if (descriptors[1].revents & POLLOUT) {
+      SFTEventLoopBenchmarkSessionSend(session);
+    }
+    if (descriptors[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+      SFTEventLoopBenchmarkSessionReceive(session, buffer, sizeof(buffer));
+    }
+  }
+
+  return NULL;
+}
+
+static bool SFTEventLoopBenchmarkMakeNonBlocking(int descriptor) {
+  int flags = fcntl(descriptor, F_GETFL);
+  return (flags >= 0) && (fcntl(descriptor, F_SETFL, flags | O_NONBLOCK) == 0);
+}
+
+static int SFTEventLoopBenchmarkConnect(uint16_t port) {
+  int descriptor = socket(AF_INET, SOCK_STREAM, 0);
+  if (descriptor < 0) {
+    return -1;
+  }
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if ((connect(descriptor, (struct sockaddr *)&address, sizeof(address)) !=
+       0) ||
+      !SFTEventLoopBenchmarkMakeNonBlocking(descriptor)) {
+    close(descriptor);
+    return -1;
+  }
+
+  return descriptor;
+}
+
+static bool SFTEventLoopBenchmarkStartSessions(
+    SFTEventLoopBenchmarkContext *context,
+    const SFTEventLoopBenchmarkModel *model) {
+  if (model->kind == SFTEventLoopBenchmarkModelSharedLoop) {
+    if (!SFTCoreEventLoopInitialise(&context->loop)) {
+      return false;
+    }
+
+    for (size_t index = 0; index < context->sessionsCount; index++) {
+      SFTEventLoopBenchmarkSession *session = &context->sessions[index];
+      session->source.descriptor = session->descriptor;
+      session->source.callback = SFTEventLoopBenchmarkLoopSessionReady;
+      session->source.userData = session;
+      if (!SFTCoreEventLoopAddSource(&context->loop, &session->source,
+                                     SFTCoreEventReadable)) {
+        SFTCoreEventLoopRelease(&context->loop);
+        return false;
+      }
+    }
+
+    if (!SFTCoreEventLoopStart(&context->loop)) {
+      SFTCoreEventLoopRelease(&context->loop);
+      return false;
+    }
+
+    return true;
+  }
+
+  for (size_t index = 0; index < context->sessionsCount; index++) {
+    SFTEventLoopBenchmarkSession *session = &context->sessions[index];
+    if ((pipe(session->wakeDescriptors) != 0) ||
+        !SFTEventLoopBenchmarkMakeNonBlocking(session->wakeDescriptors[0]) ||
+        (pthread_create(&session->thread, NULL,
+                        SFTEventLoopBenchmarkSessionThread, session) != 0)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void SFTEventLoopBenchmarkWakeSessions(
+    SFTEventLoopBenchmarkContext *context) {
+  uint8_t byte = 0;
+  for (size_t index = 0; index < context->sessionsCount; index++) {
+    if (write(context->sessions[index].wakeDescriptors[1], &byte, 1) < 0) {
+      fprintf(stderr, "Cannot wake session %zu up\n", index);
+    }
+  }
+}
+
+static void SFTEventLoopBenchmarkStopSessions(
+    SFTEventLoopBenchmarkContext *context,
+    const SFTEventLoopBenchmarkModel *model) {
+  if (model->kind == SFTEventLoopBenchmarkModelSharedLoop) {
+    SFTCoreEventLoopStop(&context->loop);
+    SFTCoreEventLoopRelease(&context->loop);
+    return;
+  }
+
+  atomic_store(&context->stopping, true);
+  SFTEventLoopBenchmarkWakeSessions(context);
+  for (size_t index = 0; index < context->sessionsCount; index++) {
+    SFTEventLoopBenchmarkSession *session = &context->sessions[index];
+    pthread_join(session->thread, NULL);
+    close(session->wakeDescriptors[0]);
+    close(session->wakeDescriptors[1]);
+  }
+}
+
+static bool SFTEventLoopBenchmarkRun(const SFTEventLoopBenchmarkModel *model,
+                                     uint16_t port, size_t sessionsCount,
+                                     unsigned int idleSeconds,
+                                     uint64_t busyBytes) {
+  SFTEventLoopBenchmarkContext context;
+  memset(&context, 0, sizeof(context));
+  context.sessionsCount = sessionsCount;
+  context.busyBytes = busyBytes;
+  atomic_init(&context.busy, false);
+  atomic_init(&context.stopping, false);
+  pthread_mutex_init(&context.lock, NULL);
+  pthread_cond_init(&context.condition, NULL);
+
+  context.sessions = (SFTEventLoopBenchmarkSession *)calloc(
+      sessionsCount, sizeof(SFTEventLoopBenchmarkSession));
+  if (context.sessions == NULL) {
+    fprintf(stderr, "Cannot allocate sessions\n");
+    return false;
+  }
+
+  bool succeeded = false;
+  size_t connected = 0;
+  for (; connected < sessionsCount; connected++) {
+    SFTEventLoopBenchmarkSession *session = &context.sessions[connected];
+    session->context = &context;
+    session->descriptor = SFTEventLoopBenchmarkConnect(port);
+    if (session->descriptor < 0) {
+      fprintf(stderr, "Cannot connect session %zu\n", connected);
+      goto cleanup;
+    }
+  }
+
+  size_t threadsBefore = SFTEventLoopBenchmarkThreadCount();
+  if (!SFTEventLoopBenchmarkStartSessions(&context, model)) {
+    fprintf(stderr, "Cannot start sessions\n");
+    goto cleanup;
+  }
+  size_t threads = SFTEventLoopBenchmarkThreadCount() - threadsBefore;
+
+  // Idle: every session connected, nothing flowing either way.
+  uint64_t idleCPU = SFTEventLoopBenchmarkCPUTime();
+  sleep(idleSeconds);
+  idleCPU = SFTEventLoopBenchmarkCPUTime() - idleCPU;
+
+  // Busy: every session pushes its share and waits for the echo.
+  uint64_t busyCPU = SFTEventLoopBenchmarkCPUTime();
+  uint64_t start = SFTBenchmarkNow();
+  if (model->kind == SFTEventLoopBenchmarkModelSharedLoop) {
+    SFTCoreEventLoopPerform(&context.loop, SFTEventLoopBenchmarkLoopStartBusy,
+                            &context);
+  } else {
+    atomic_store(&context.busy, true);
+    SFTEventLoopBenchmarkWakeSessions(&context);
+  }
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += kBusyTimeoutSeconds;
+  pthread_mutex_lock(&context.lock);
+  while (context.finished < sessionsCount) {
+    if (pthread_cond_timedwait(&context.condition, &context.lock,
+                               &deadline) == ETIMEDOUT) {
+      break;
+    }
+  }
+  size_t finished = context.finished;
+  pthread_mutex_unlock(&context.lock);
+  uint64_t elapsed = SFTBenchmarkNow() - start;
+  busyCPU = SFTEventLoopBenchmarkCPUTime() - busyCPU;
+
+  SFTEventLoopBenchmarkStopSessions(&context, model);
+
+  succeeded = finished == sessionsCount;
+  double bytes = (double)busyBytes * (double)sessionsCount;
+  printf("%-10s %8zu %8zu %14.2f %10.2f %14.2f  %s\n", model->name,
+         sessionsCount, threads,
+         (double)idleCPU / (double)idleSeconds / (double)sessionsCount,
+         (bytes * 1000.0) / (double)elapsed,
+         (double)busyCPU / 1000.0 / (double)sessionsCount,
+         succeeded ? "OK" : "TIMEOUT");
+
+cleanup:
+  for (size_t index = 0; index < connected; index++) {
+    close(context.sessions[index].descriptor);
+  }
+  free(context.sessions);
+  pthread_cond_destroy(&context.condition);
+  pthread_mutex_destroy(&context.lock);
+
+  return succeeded;
+}
+
+static int SFTEventLoopBenchmarkListen(uint16_t *port) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0) {
+    return -1;
+  }
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = 0;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if ((bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0) ||
+      (listen(listener, SOMAXCONN) != 0) ||
+      (getsockname(listener, (struct sockaddr *)&address, &length) != 0)) {
+    close(listener);
+    return -1;
+  }
+
+  *port = ntohs(address.sin_port);
+  return listener;
+}
+
+static void SFTEventLoopBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s eventloop [-n sessions] [-t idle seconds] "
+          "[-b bytes per session] [-m loop|threads]\n"
+          "\n"
+          "Opens the given amount of sessions against a local echo server, "
+          "leaves them\nidle for a while and then has each one echo the "
+          "given amount of bytes,\nreporting the threads spent on sessions "
+          "and the CPU time used in either phase.\nBoth connection models "
+          "are measured unless one is chosen.\n",
+          name);
+}
+
+int SFTEventLoopBenchmarkMain(int argc, char *argv[]) {
+  size_t sessionsCount = kDefaultSessions;
+  unsigned int idleSeconds = kDefaultIdleSeconds;
+  uint64_t busyBytes = kDefaultBusyBytes;
+  const SFTEventLoopBenchmarkModel *model = NULL;
+
+  int option;
+  while ((option = getopt(argc, argv, "n:t:b:m:")) != -1) {
+    switch (option) {
+    case 'n':
+      sessionsCount = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 't':
+      idleSeconds = (unsigned int)strtoul(optarg, NULL, 0);
+      break;
+
+    case 'b':
+      busyBytes = (uint64_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'm':
+      for (size_t index = 0; index < kModelsCount; index++) {
+        if (strcmp(optarg, kModels[index].name) == 0) {
+          model = &kModels[index];
+        }
+      }
+      if (model == NULL) {
+        SFTEventLoopBenchmarkUsage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      break;
+
+    default:
+      SFTEventLoopBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if ((sessionsCount == 0) || (idleSeconds == 0) || (busyBytes == 0)) {
+    SFTEventLoopBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  for (size_t index = 0; index < sizeof(gPattern); index++) {
+    gPattern[index] = (uint8_t)(index * 7);
+  }
+
+  uint16_t port;
+  int listener = SFTEventLoopBenchmarkListen(&port);
+  if (listener < 0) {
+    fprintf(stderr, "Cannot open the echo server socket\n");
+    return EXIT_FAILURE;
+  }
+
+  // The echo server lives in its own process, so that its threads and CPU
+  // time do not end up in the measurements.
+  pid_t server = fork();
+  if (server < 0) {
+    fprintf(stderr, "Cannot start the echo server\n");
+    close(listener);
+    return EXIT_FAILURE;
+  }
+  if (server == 0) {
+    SFTEventLoopBenchmarkServe(listener);
+  }
+  close(listener);
+
+  printf("%-10s %8s %8s %14s %10s %14s  %s\n", "model", "sessions",
+         "threads", "idle us/s/ses", "busy MB/s", "busy ms/ses", "result");
+
+  int result = EXIT_SUCCESS;
+  for (size_t index = 0; index < kModelsCount; index++) {
+    if ((model != NULL) && (model != &kModels[index])) {
+      continue;
+    }
+    if (!SFTEventLoopBenchmarkRun(&kModels[index], port, sessionsCount,
+                                  idleSeconds, busyBytes)) {
+      result = EXIT_FAILURE;
+    }
+  }
+
+  kill(server, SIGKILL);
+  waitpid(server, NULL, 0);
+
+  return result;
+}
@@ -0,0 +1,590 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Feeds random inputs, biased towards control codes, cursor movements and
+ * printable runs, to both parser implementations, each fed the whole input at
+ * once and in random chunks.  All of them must leave the same cells, cursor,
+ * colours and modes, ring the bell as many times, keep the cursor on screen and
+ * mark every row they change as dirty.
+ *
+ * Inputs start with two bytes picking the screen size, the starting mode and
+ * how the rest is split, so the same inputs can go through libFuzzer, whose
+ * entry point is included:
+ *
+ *     clang -fsanitize=fuzzer,address -IRetroTermCore -o RetroTermFuzz
+ *         RetroTermCore/SFTCore*.c RetroTermBenchmark/SFTBenchmark.c
+ *         RetroTermBenchmark/SFTFuzzBenchmark.c
+ *
+ * Captures given on the command line are checked whole and in random slices.
+ * Failing inputs are written to $TMPDIR, to be checked again with -i.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreEmulator.h"
+
+static const size_t kDefaultInputs = 20000;
+static const size_t kDefaultMaximumLength = 2048;
+static const size_t kCaptureSlices = 256;
+static const size_t kMaximumReproducers = 8;
+
+/**
+ * Screen widths and heights picked by the header's first byte, bits 2..4
+ * and 5..7 respectively.  The usual sizes come first, odd ones follow.
+ */
+static const size_t kWidths[8] = {40, 80, 1, 2, 7, 39, 41, 64};
+static const size_t kHeights[8] = {25, 1, 2, 3, 5, 12, 24, 25};
+
+/**
+ * Largest chunk the data is split into, picked by the chunk seed's lowest
+ * three bits.
+ */
+static const size_t kChunkLimits[8] = {1, 3, 7, 16, 64, 256, 1024, 4096};
+
+/**
+ * Control codes the random inputs are biased towards, covering every
+ * command either parser handles in PETSCII or ASCII mode.
+ */
+static const uint8_t kControlCodes[] = {
+    0x05, 0x07, 0x08, 0x0A, 0x0D, 0x0E, 0x11, 0x12, 0x13, 0x14, 0x1B,
+    0x1C, 0x1D, 0x1E, 0x1F, 0x81, 0x8D, 0x8E, 0x90, 0x91, 0x92, 0x93,
+    0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E,
+    0x9F};
+
+typedef struct {
+  size_t inputs;
+  size_t maximumLength;
+  uint64_t seed;
+  const char *inputPath;
+} SFTFuzzBenchmarkOptions;
+
+typedef struct {
+  size_t inputs;
+  size_t bytes;
+  size_t mismatches;
+  uint64_t time;
+} SFTFuzzBenchmarkResult;
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static void SFTFuzzBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s fuzz [-n inputs] [-l length] [-s seed] [-i input] "
+          "[capture ...]\n"
+          "\n"
+          "Parses random inputs of up to %zu bytes, %zu of them by default, "
+          "with both\nparser implementations, each fed all at once and in "
+          "random chunks, and\nchecks that they all leave the same screen "
+          "and mark every row they change\nas dirty.  Captures given on the "
+          "command line are checked whole and in\nrandom slices.  Failing "
+          "inputs are written to $TMPDIR, and can be checked\nagain with "
+          "-i, or fed to the libFuzzer entry point.\n",
+          name, kDefaultMaximumLength, kDefaultInputs);
+}
+
+static void SFTFuzzBenchmarkBell(void *userData) {
+  ((SFTBenchmarkFuzzScreen *)userData)->bells++;
+}
+
+bool SFTBenchmarkFuzzDecode(const uint8_t *data, size_t size,
+                            SFTBenchmarkFuzzInput *input) {
+  if (size < SFTBenchmarkFuzzHeaderSize) {
+    return false;
+  }
+
+  input->asciiMode = (data[0] & 0x01) != 0;
+  input->lowerCase = (data[0] & 0x02) != 0;
+  input->width = kWidths[(data[0] >> 2) & 0x07];
+  input->height = kHeights[(data[0] >> 5) & 0x07];
+  input->chunkSeed = data[1];
+  input->bytes = data + SFTBenchmarkFuzzHeaderSize;
+  input->length = size - SFTBenchmarkFuzzHeaderSize;
+  return true;
+}
+
+/**
+ * Checks that every cell buffer row changed since the given copy was taken
+ * is marked dirty, and that the cursor is still on screen.
+ */
+static bool SFTFuzzBenchmarkCheckChunk(const SFTBenchmarkFuzzScreen *screen,
+                                       const SFTTerminalEmulatorCell *previous,
+                                       size_t offset, char *reason,
+                                       size_t reasonLength) {
+  const SFTCoreEmulatorState *state = &screen->state;
+
+  if ((state->row >= state->height) || (state->column >= state->width)) {
+    snprintf(reason, reasonLength,
+             "cursor off screen at %zu,%zu after offset %zu", state->column,
+             state->row, offset);
+    return false;
+  }
+
+  for (size_t row = 0; row < state->height; row++) {
+    size_t start = row * state->width;
+    if (!SFTCoreEmulatorIsRowDirty(state, row) &&
+        (memcmp(screen->cells + start, previous + start,
+                state->width * sizeof(SFTTerminalEmulatorCell)) != 0)) {
+      snprintf(reason, reasonLength,
+               "physical row %zu changed but not dirty after offset %zu", row,
+               offset);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Parses the given input into the given screen, either all at once or in
+ * chunks.
+ *
+ * @return true if every chunk passed the per-chunk checks, false otherwise.
+ */
+static bool SFTFuzzBenchmarkParse(const SFTBenchmarkFuzzInput *input,
+                                  SFTCoreEmulatorParserMode mode, bool split,
+                                  SFTBenchmarkFuzzScreen *screen,
+                                  char *reason, size_t reasonLength) {
+  SFTTerminalEmulatorCell previous[SFTBenchmarkFuzzMaximumCells];
+  size_t cells = input->width * input->height;
+
+  memset(screen, 0, sizeof(SFTBenchmarkFuzzScreen));
+  SFTCoreEmulatorStateInitialise(&screen->state, input->width, input->height,
+                                 0, 14, input->asciiMode, input->lowerCase);
+  screen->state.parserMode = mode;
+  screen->state.bellCallback = SFTFuzzBenchmarkBell;
+  screen->state.userData = screen;
+  SFTCoreEmulatorClearScreen(&screen->state, screen->cells);
+  SFTCoreEmulatorClearDirtyRows(&screen->state);
+
+  uint64_t seed = (uint64_t)input->chunkSeed * UINT64_C(0x9E3779B97F4A7C15) |
+                  1;
+  size_t limit = split ? kChunkLimits[input->chunkSeed & 0x07] : SIZE_MAX;
+  size_t offset = 0;
+  while (offset < input->length) {
+    size_t length = input->length - offset;
+    if (split) {
+      size_t chunk = 1 + (size_t)(SFTBenchmarkRandom(&seed) % limit);
+      if (length > chunk) {
+        length = chunk;
+      }
+    }
+
+    memcpy(previous, screen->cells, cells * sizeof(SFTTerminalEmulatorCell));
+    SFTCoreEmulatorProcessIncomingData(&screen->state, screen->cells,
+                                       input->bytes + offset, length);
+    offset += length;
+    if (!SFTFuzzBenchmarkCheckChunk(screen, previous, offset, reason,
+                                    reasonLength)) {
+      return false;
+    }
+    SFTCoreEmulatorClearDirtyRows(&screen->state);
+  }
+
+  return true;
+}
+
+/**
+ * Compares a screen against the reference one.
+ *
+ * @return true if both are the same, false otherwise.
+ */
+static bool SFTFuzzBenchmarkCompare(const SFTBenchmarkFuzzScreen *reference,
+                                    const SFTBenchmarkFuzzScreen *screen,
+                                    const char *name, char *reason,
+                                    size_t reasonLength) {
+  const SFTCoreEmulatorState *expected = &reference->state;
+  const SFTCoreEmulatorState *actual = &screen->state;
+
+  if ((expected->row != actual->row) ||
+      (expected->column != actual->column)) {
+    snprintf(reason, reasonLength, "%s cursor at %zu,%zu instead of %zu,%zu",
+             name, actual->column, actual->row, expected->column,
+             expected->row);
+    return false;
+  }
+
+  if (expected->baseRow != actual->baseRow) {
+    snprintf(reason, reasonLength, "%s base row %zu instead of %zu", name,
+             actual->baseRow, expected->baseRow);
+    return false;
+  }
+
+  if ((expected->foreground != actual->foreground) ||
+      (expected->background != actual->background) ||
+      (expected->reverseVideo != actual->reverseVideo) ||
+      (expected->useLowerCase != actual->useLowerCase) ||
+      (expected->isInASCIIMode != actual->isInASCIIMode)) {
+    snprintf(reason, reasonLength, "%s attributes or modes differ", name);
+    return false;
+  }
+
+  if (memcmp(expected->linkedRows, actual->linkedRows,
+             sizeof(expected->linkedRows)) != 0) {
+    snprintf(reason, reasonLength, "%s line links differ", name);
+    return false;
+  }
+
+  if (reference->bells != screen->bells) {
+    snprintf(reason, reasonLength, "%s rang %zu bells instead of %zu", name,
+             screen->bells, reference->bells);
+    return false;
+  }
+
+  size_t cells = expected->width * expected->height;
+  for (size_t cell = 0; cell < cells; cell++) {
+    if (reference->cells[cell] != screen->cells[cell]) {
+      snprintf(reason, reasonLength,
+               "%s physical cell %zu,%zu is %05" PRIx32
+               " instead of %05" PRIx32,
+               name, cell % expected->width, cell / expected->width,
+               screen->cells[cell], reference->cells[cell]);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool SFTBenchmarkFuzzCheck(const SFTBenchmarkFuzzInput *input,
+                           SFTBenchmarkFuzzScreen *screen, char *reason,
+                           size_t reasonLength) {
+  static const struct {
+    const char *name;
+    SFTCoreEmulatorParserMode mode;
+    bool split;
+  } kRuns[] = {
+      {"reference split", SFTCoreEmulatorParserModeReference, true},
+      {"fast whole", SFTCoreEmulatorParserModeFast, false},
+      {"fast split", SFTCoreEmulatorParserModeFast, true},
+  };
+
+  SFTBenchmarkFuzzScreen reference;
+  SFTBenchmarkFuzzScreen other;
+
+  if (!SFTFuzzBenchmarkParse(input, SFTCoreEmulatorParserModeReference, false,
+                             &reference, reason, reasonLength)) {
+    return false;
+  }
+
+  for (size_t index = 0; index < sizeof(kRuns) / sizeof(kRuns[0]); index++) {
+    char chunkReason[128];
+    if (!SFTFuzzBenchmarkParse(input, kRuns[index].mode, kRuns[index].split,
+                               &other, chunkReason, sizeof(chunkReason))) {
+      snprintf(reason, reasonLength, "%s: %s", kRuns[index].name,
+               chunkReason);
+      return false;
+    }
+    if (!SFTFuzzBenchmarkCompare(&reference, &other, kRuns[index].name,
+                                 reason, reasonLength)) {
+      return false;
+    }
+  }
+
+  if (screen != NULL) {
+    memcpy(screen, &reference, sizeof(SFTBenchmarkFuzzScreen));
+    screen->state.userData = NULL;
+    screen->state.bellCallback = NULL;
+  }
+
+  return true;
+}
+
+/**
+ * libFuzzer entry point, aborting on the first input the parsers disagree
+ * on.
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  SFTBenchmarkFuzzInput input;
+  char reason[256];
+
+  if (SFTBenchmarkFuzzDecode(data, size, &input) &&
+      !SFTBenchmarkFuzzCheck(&input, NULL, reason, sizeof(reason))) {
+    fprintf(stderr, "Parser mismatch on %zux%zu %s input: %s\n", input.width,
+            input.height, input.asciiMode ? "ASCII" : "PETSCII", reason);
+    abort();
+  }
+
+  return 0;
+}
+
+/**
+ * Fills the given buffer with a random input, header included, made of
+ * printable runs, control codes, cursor movement bursts and noise.
+ *
+ * @return the input length, in bytes.
+ */
+static size_t SFTFuzzBenchmarkGenerate(uint64_t *seed, uint8_t *buffer,
+                                       size_t maximumLength) {
+  size_t length = SFTBenchmarkFuzzHeaderSize +
+                  (size_t)(SFTBenchmarkRandom(seed) % (maximumLength + 1));
+
+  buffer[0] = (uint8_t)SFTBenchmarkRandom(seed);
+  buffer[1] = (uint8_t)SFTBenchmarkRandom(seed);
+
+  size_t offset = SFTBenchmarkFuzzHeaderSize;
+  while (offset < length) {
+    uint64_t value = SFTBenchmarkRandom(seed);
+    size_t run = 1 + (size_t)((value >> 8) % 80);
+    if (run > length - offset) {
+      run = length - offset;
+    }
+
+    switch (value % 8) {
+    case 0:
+    case 1:
+    case 2:
+      for (size_t index = 0; index < run; index++) {
+        value = SFTBenchmarkRandom(seed);
+        buffer[offset++] =
+            (uint8_t)(((value & 0x100) ? 0xA0 : 0x20) + (value % 0x60));
+      }
+      break;
+
+    case 3:
+    case 4:
+      buffer[offset++] =
+          kControlCodes[(value >> 8) % sizeof(kControlCodes)];
+      break;
+
+    case 5:
+      for (size_t index = 0; index < run; index++) {
+        buffer[offset++] = (uint8_t)SFTBenchmarkRandom(seed);
+      }
+      break;
+
+    default: {
+      static const uint8_t kBursts[] = {0x1D, 0x11, 0x0D, 0x14, 0x9D, 0x91};
+      uint8_t code = kBursts[(value >> 16) % sizeof(kBursts)];
+      memset(buffer + offset, code, run);
+      offset += run;
+      break;
+    }
+    }
+  }
+
+  return length;
+}
+
+/**
+ * Reports a failing input, writing it out to be checked again if there
+ * were not too many already.
+ */
+static void SFTFuzzBenchmarkReport(const uint8_t *data, size_t size,
+                                   const char *reason, size_t failures) {
+  fprintf(stderr, "Mismatch: %s\n", reason);
+  if (failures > kMaximumReproducers) {
+    return;
+  }
+
+  const char *directory = getenv("TMPDIR");
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/RetroTermFuzz-%d-%zu.bin",
+           (directory != NULL) ? directory : "/tmp", (int)getpid(), failures);
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return;
+  }
+  fwrite(data, 1, size, file);
+  fclose(file);
+  fprintf(stderr, "Reproducer written to %s\n", path);
+}
+
+/**
+ * Checks a single raw input, accounting for it in the given results.
+ */
+static void SFTFuzzBenchmarkCheckInput(const uint8_t *data, size_t size,
+                                       SFTFuzzBenchmarkResult *result) {
+  SFTBenchmarkFuzzInput input;
+  char reason[256];
+
+  if (!SFTBenchmarkFuzzDecode(data, size, &input)) {
+    return;
+  }
+
+  uint64_t start = SFTBenchmarkNow();
+  bool matched = SFTBenchmarkFuzzCheck(&input, NULL, reason, sizeof(reason));
+  result->time += SFTBenchmarkNow() - start;
+  result->inputs++;
+  result->bytes += input.length;
+
+  if (!matched) {
+    result->mismatches++;
+    SFTFuzzBenchmarkReport(data, size, reason, result->mismatches);
+  }
+}
+
+static void SFTFuzzBenchmarkRunRandom(const SFTFuzzBenchmarkOptions *options,
+                                      SFTFuzzBenchmarkResult *result) {
+  uint8_t *buffer =
+      (uint8_t *)malloc(options->maximumLength + SFTBenchmarkFuzzHeaderSize);
+  if (buffer == NULL) {
+    fprintf(stderr, "Cannot allocate the input buffer\n");
+    result->mismatches++;
+    return;
+  }
+
+  uint64_t seed = options->seed;
+  for (size_t index = 0; index < options->inputs; index++) {
+    size_t size =
+        SFTFuzzBenchmarkGenerate(&seed, buffer, options->maximumLength);
+    SFTFuzzBenchmarkCheckInput(buffer, size, result);
+  }
+
+  free(buffer);
+}
+
+/**
+ * Checks a capture whole, as it would be seen on a 40 or 80 columns screen
+ * in either mode, then in random slices with random headers.
+ */
+static void SFTFuzzBenchmarkRunCapture(const SFTFuzzBenchmarkOptions *options,
+                                       const SFTBenchmarkWorkload *workload,
+                                       SFTFuzzBenchmarkResult *result) {
+  uint8_t *buffer =
+      (uint8_t *)malloc(workload->length + SFTBenchmarkFuzzHeaderSize);
+  if (buffer == NULL) {
+    fprintf(stderr, "Cannot allocate the input buffer\n");
+    result->mismatches++;
+    return;
+  }
+
+  uint64_t seed = options->seed;
+  for (uint8_t header = 0; header < 8; header++) {
+    buffer[0] = header & 0x07;
+    buffer[1] = (uint8_t)SFTBenchmarkRandom(&seed);
+    memcpy(buffer + SFTBenchmarkFuzzHeaderSize, workload->bytes,
+           workload->length);
+    SFTFuzzBenchmarkCheckInput(
+        buffer, workload->length + SFTBenchmarkFuzzHeaderSize, result);
+  }
+
+  for (size_t slice = 0; (slice < kCaptureSlices) && (workload->length > 0);
+       slice++) {
+    size_t offset = (size_t)(SFTBenchmarkRandom(&seed) % workload->length);
+    size_t length =
+        (size_t)(SFTBenchmarkRandom(&seed) % (options->maximumLength + 1));
+    if (length > workload->length - offset) {
+      length = workload->length - offset;
+    }
+    buffer[0] = (uint8_t)SFTBenchmarkRandom(&seed);
+    buffer[1] = (uint8_t)SFTBenchmarkRandom(&seed);
+    memmove(buffer + SFTBenchmarkFuzzHeaderSize, workload->bytes + offset,
+            length);
+    SFTFuzzBenchmarkCheckInput(buffer, length + SFTBenchmarkFuzzHeaderSize,
+                               result);
+  }
+
+  free(buffer);
+}
+
+static void SFTFuzzBenchmarkPrintResult(const char *name,
+                                        const SFTFuzzBenchmarkResult *result) {
+  double seconds = (double)result->time / 1e9;
+  printf("%-20s %10zu %12zu %12.0f %10zu %8s\n", name, result->inputs,
+         result->bytes, (seconds > 0) ? (double)result->inputs / seconds : 0,
+         result->mismatches, (result->mismatches == 0) ? "OK" : "FAILED");
+}
+
+int SFTFuzzBenchmarkMain(int argc, char *argv[]) {
+  SFTFuzzBenchmarkOptions options = {.inputs = kDefaultInputs,
+                                     .maximumLength = kDefaultMaximumLength,
+                                     .seed = UINT64_C(0x5F7E2D4C3B2A1908),
+                                     .inputPath = NULL};
+  int option;
+
+  while ((option = getopt(argc, argv, "n:l:s:i:h")) != -1) {
+    switch (option) {
+    case 'n':
+      options.inputs = (size_t)strtoull(optarg, NULL, 10);
+      break;
+    case 'l':
+      options.maximumLength = (size_t)strtoull(optarg, NULL, 10);
+      break;
+    case 's':
+      options.seed = strtoull(optarg, NULL, 0);
+      break;
+    case 'i':
+      options.inputPath = optarg;
+      break;
+    default:
+      SFTFuzzBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (options.seed == 0) {
+    options.seed = 1;
+  }
+
+  printf("%-20s %10s %12s %12s %10s %8s\n", "source", "inputs", "bytes",
+         "inputs/s", "mismatches", "result");
+
+  bool succeeded = true;
+
+  if (options.inputPath != NULL) {
+    SFTBenchmarkWorkload workload;
+    SFTFuzzBenchmarkResult result;
+    if (!SFTBenchmarkLoadWorkload(options.inputPath, &workload)) {
+      fprintf(stderr, "Cannot load input %s\n", options.inputPath);
+      return EXIT_FAILURE;
+    }
+    memset(&result, 0, sizeof(result));
+    SFTFuzzBenchmarkCheckInput(workload.bytes, workload.length, &result);
+    if (result.inputs == 0) {
+      fprintf(stderr, "Input too short: %s\n", options.inputPath);
+      result.mismatches++;
+    }
+    SFTFuzzBenchmarkPrintResult(workload.name, &result);
+    succeeded = result.mismatches == 0;
+    SFTBenchmarkReleaseWorkload(&workload);
+    return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  SFTFuzzBenchmarkResult result;
+  memset(&result, 0, sizeof(result));
+  SFTFuzzBenchmarkRunRandom(&options, &result);
+  SFTFuzzBenchmarkPrintResult("random", &result);
+  succeeded = result.mismatches == 0;
+
+  for (int index = optind; index < argc; index++) {
+    SFTBenchmarkWorkload workload;
+    if (!SFTBenchmarkLoadWorkload(argv[index], &workload)) {
+      fprintf(stderr, "Cannot load capture %s\n", argv[index]);
+      succeeded = false;
+      continue;
+    }
+    memset(&result, 0, sizeof(result));
+    SFTFuzzBenchmarkRunCapture(&options, &workload, &result);
+    SFTFuzzBenchmarkPrintResult(workload.name, &result);
+    succeeded = succeeded && (result.mismatches == 0);
+    SFTBenchmarkReleaseWorkload(&workload);
+  }
+
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
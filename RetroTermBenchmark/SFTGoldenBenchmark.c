@@ -0,0 +1,413 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Runs the fuzz benchmark's check on every input in RetroTermBenchmark/Golden,
+ * which doubles as a seed corpus for libFuzzer, then compares the screen left
+ * at the end with the dump stored next to it: state, visible text and every
+ * cell in hexadecimal.  After a change meant to alter what ends up on screen,
+ * -u rewrites the dumps, to be reviewed before committing them.
+ */
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreEmulator.h"
+
+static const char *kDefaultDirectory = "RetroTermBenchmark/Golden";
+static const char *kInputExtension = ".bin";
+static const char *kScreenExtension = ".screen";
+static const size_t kSyntheticSize = 16 * 1024;
+static const size_t kMaximumInputs = 256;
+
+/**
+ * Header synthetic workloads are stored with: ASCII mode, upper case, 40x25
+ * screen, chunks of up to one byte, as every other benchmark parses them.
+ */
+static const uint8_t kSyntheticHeader[SFTBenchmarkFuzzHeaderSize] = {0x01,
+                                                                      0x00};
+
+typedef struct {
+  const char *directory;
+  bool update;
+} SFTGoldenBenchmarkOptions;
+
+/**
+ * Growable text buffer screen dumps are built into.
+ */
+typedef struct {
+  char *text;
+  size_t length;
+  size_t capacity;
+} SFTGoldenBenchmarkDump;
+
+static void SFTGoldenBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s golden [-d directory] [-u]\n"
+          "\n"
+          "Parses every fuzzer input in the golden directory, %s by "
+          "default, checking\nthat both parser implementations agree on it, "
+          "and compares the screen left\nat the end with the dump stored "
+          "next to it.  With -u the dumps are written\ninstead, along with "
+          "inputs for the synthetic workloads if missing.\n",
+          name, kDefaultDirectory);
+}
+
+static bool SFTGoldenBenchmarkAppend(SFTGoldenBenchmarkDump *dump,
+                                     const char *format, ...) {
+  while (true) {
+    va_list arguments;
+    va_start(arguments, format);
+    int written = vsnprintf(dump->text + dump->length,
+                            dump->capacity - dump->length, format, arguments);
+    va_end(arguments);
+    if (written < 0) {
+      return false;
+    }
+    if ((size_t)written < dump->capacity - dump->length) {
+      dump->length += (size_t)written;
+      return true;
+    }
+
+    size_t capacity = (dump->capacity * 2) + (size_t)written;
+    char *text = (char *)realloc(dump->text, capacity);
+    if (text == NULL) {
+      return false;
+    }
+    dump->text = text;
+    dump->capacity = capacity;
+  }
+}
+
+/**
+ * Converts a font index into the character it looks like, for the text
+ * half of the dump.  Graphic characters become dots.
+ */
+static char SFTGoldenBenchmarkGlyph(SFTTerminalEmulatorCell cell,
+                                    bool lowerCase) {
+  uint8_t index = (uint8_t)(cell & 0x7F);
+
+  if (index < 0x20) {
+    char character = (char)('@' + index);
+    return (lowerCase && (index > 0)) ? (char)(character + 0x20) : character;
+  }
+  if (index < 0x40) {
+    return (char)index;
+  }
+  if (lowerCase && (index >= 0x41) && (index <= 0x5A)) {
+    return (char)('A' + (index - 0x41));
+  }
+
+  return '.';
+}
+
+/**
+ * Dumps the given screen as text: the emulator state first, then every
+ * visible row as it looks, then every visible row's cells in hexadecimal.
+ */
+static bool SFTGoldenBenchmarkDumpScreen(const SFTBenchmarkFuzzScreen *screen,
+                                         SFTGoldenBenchmarkDump *dump) {
+  const SFTCoreEmulatorState *state = &screen->state;
+  SFTTerminalEmulatorCell visible[SFTBenchmarkFuzzMaximumCells];
+  bool lowerCase = state->useLowerCase || state->isInASCIIMode;
+
+  SFTCoreEmulatorCopyContents(state, screen->cells, visible);
+
+  bool succeeded =
+      SFTGoldenBenchmarkAppend(dump, "size %zux%zu\n", state->width,
+                               state->height) &&
+      SFTGoldenBenchmarkAppend(dump, "cursor %zu,%zu\n", state->column,
+                               state->row) &&
+      SFTGoldenBenchmarkAppend(dump, "mode %s %s\n",
+                               state->isInASCIIMode ? "ascii" : "petscii",
+                               state->useLowerCase ? "lower" : "upper") &&
+      SFTGoldenBenchmarkAppend(dump, "colours %u on %u%s\n",
+                               state->foreground, state->background,
+                               state->reverseVideo ? " reverse" : "") &&
+      SFTGoldenBenchmarkAppend(dump, "bells %zu\n", screen->bells) &&
+      SFTGoldenBenchmarkAppend(dump, "links");
+
+  for (size_t row = 0; succeeded && (row < state->height); row++) {
+    if (SFTCoreEmulatorIsRowLinked(state,
+                                   SFTCoreEmulatorPhysicalRow(state, row))) {
+      succeeded = SFTGoldenBenchmarkAppend(dump, " %zu", row);
+    }
+  }
+  succeeded = succeeded && SFTGoldenBenchmarkAppend(dump, "\n");
+
+  for (size_t row = 0; succeeded && (row < state->height); row++) {
+    succeeded = SFTGoldenBenchmarkAppend(dump, "|");
+    for (size_t column = 0; succeeded && (column < state->width); column++) {
+      succeeded = SFTGoldenBenchmarkAppend(
+          dump, "%c",
+          SFTGoldenBenchmarkGlyph(visible[(row * state->width) + column],
+                                  lowerCase));
+    }
+    succeeded = succeeded && SFTGoldenBenchmarkAppend(dump, "|\n");
+  }
+
+  for (size_t row = 0; succeeded && (row < state->height); row++) {
+    succeeded = SFTGoldenBenchmarkAppend(dump, "%02zu:", row);
+    for (size_t column = 0; succeeded && (column < state->width); column++) {
+      succeeded = SFTGoldenBenchmarkAppend(
+          dump, " %05x", (unsigned)visible[(row * state->width) + column]);
+    }
+    succeeded = succeeded && SFTGoldenBenchmarkAppend(dump, "\n");
+  }
+
+  return succeeded;
+}
+
+static bool SFTGoldenBenchmarkWriteFile(const char *path, const void *bytes,
+                                        size_t length) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "Cannot write %s\n", path);
+    return false;
+  }
+
+  bool written = fwrite(bytes, 1, length, file) == length;
+  written = (fclose(file) == 0) && written;
+  if (!written) {
+    fprintf(stderr, "Cannot write %s\n", path);
+  }
+  return written;
+}
+
+/**
+ * Writes an input for every synthetic workload not in the directory yet.
+ */
+static bool
+SFTGoldenBenchmarkWriteSynthetic(const SFTGoldenBenchmarkOptions *options) {
+  for (SFTBenchmarkProfile profile = 0; profile < SFTBenchmarkProfilesCount;
+       profile++) {
+    SFTBenchmarkWorkload workload;
+    if (!SFTBenchmarkGenerateWorkload(profile, kSyntheticSize, &workload)) {
+      fprintf(stderr, "Cannot generate synthetic workload\n");
+      return false;
+    }
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s%s", options->directory, workload.name,
+             kInputExtension);
+    FILE *existing = fopen(path, "rb");
+    if (existing != NULL) {
+      fclose(existing);
+      SFTBenchmarkReleaseWorkload(&workload);
+      continue;
+    }
+
+    uint8_t *bytes =
+        (uint8_t *)malloc(workload.length + sizeof(kSyntheticHeader));
+    bool written = false;
+    if (bytes != NULL) {
+      memcpy(bytes, kSyntheticHeader, sizeof(kSyntheticHeader));
+      memcpy(bytes + sizeof(kSyntheticHeader), workload.bytes,
+             workload.length);
+      written = SFTGoldenBenchmarkWriteFile(
+          path, bytes, workload.length + sizeof(kSyntheticHeader));
+      free(bytes);
+    }
+    SFTBenchmarkReleaseWorkload(&workload);
+    if (!written) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static int SFTGoldenBenchmarkCompareNames(const void *first,
+                                          const void *second) {
+  return strcmp(*(const char *const *)first, *(const char *const *)second);
+}
+
+/**
+ * Collects the names of every input in the directory, in order.
+ *
+ * @return the amount of inputs found, or SIZE_MAX if the directory cannot
+ * be read.
+ */
+static size_t
+SFTGoldenBenchmarkListInputs(const SFTGoldenBenchmarkOptions *options,
+                             char **names) {
+  DIR *directory = opendir(options->directory);
+  if (directory == NULL) {
+    fprintf(stderr, "Cannot open %s\n", options->directory);
+    return SIZE_MAX;
+  }
+
+  size_t count = 0;
+  size_t extension = strlen(kInputExtension);
+  struct dirent *entry;
+  while (((entry = readdir(directory)) != NULL) && (count < kMaximumInputs)) {
+    size_t length = strlen(entry->d_name);
+    if ((length > extension) &&
+        (strcmp(entry->d_name + length - extension, kInputExtension) == 0)) {
+      names[count] = strdup(entry->d_name);
+      if (names[count] != NULL) {
+        count++;
+      }
+    }
+  }
+  closedir(directory);
+
+  qsort(names, count, sizeof(char *), SFTGoldenBenchmarkCompareNames);
+  return count;
+}
+
+/**
+ * Returns the line the two texts first differ on, starting from 1.
+ */
+static size_t SFTGoldenBenchmarkFirstDifference(const char *expected,
+                                                size_t expectedLength,
+                                                const char *actual,
+                                                size_t actualLength) {
+  size_t line = 1;
+  for (size_t index = 0;
+       (index < expectedLength) && (index < actualLength); index++) {
+    if (expected[index] != actual[index]) {
+      break;
+    }
+    if (expected[index] == '\n') {
+      line++;
+    }
+  }
+  return line;
+}
+
+/**
+ * Checks a single input against its golden dump, or writes the dump.
+ *
+ * @return true if the input passed, false otherwise.
+ */
+static bool SFTGoldenBenchmarkCheck(const SFTGoldenBenchmarkOptions *options,
+                                    const char *name) {
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/%s", options->directory, name);
+
+  SFTBenchmarkWorkload workload;
+  SFTBenchmarkFuzzInput input;
+  if (!SFTBenchmarkLoadWorkload(path, &workload)) {
+    fprintf(stderr, "Cannot load input %s\n", path);
+    return false;
+  }
+  if (!SFTBenchmarkFuzzDecode(workload.bytes, workload.length, &input)) {
+    fprintf(stderr, "Input too short: %s\n", path);
+    SFTBenchmarkReleaseWorkload(&workload);
+    return false;
+  }
+
+  SFTBenchmarkFuzzScreen *screen =
+      (SFTBenchmarkFuzzScreen *)malloc(sizeof(SFTBenchmarkFuzzScreen));
+  SFTGoldenBenchmarkDump dump = {.text = NULL, .length = 0, .capacity = 0};
+  char reason[256];
+  const char *status = "OK";
+
+  if (screen == NULL) {
+    status = "FAILED";
+  } else if (!SFTBenchmarkFuzzCheck(&input, screen, reason, sizeof(reason))) {
+    fprintf(stderr, "%s: parsers disagree, %s\n", name, reason);
+    status = "MISMATCH";
+  } else if (!SFTGoldenBenchmarkDumpScreen(screen, &dump)) {
+    status = "FAILED";
+  } else {
+    // The dump goes next to the input, with the screen extension instead.
+    size_t length = strlen(path) - strlen(kInputExtension);
+    snprintf(path + length, sizeof(path) - length, "%s", kScreenExtension);
+
+    if (options->update) {
+      status = SFTGoldenBenchmarkWriteFile(path, dump.text, dump.length)
+                   ? "UPDATED"
+                   : "FAILED";
+    } else {
+      SFTBenchmarkWorkload golden;
+      if (!SFTBenchmarkLoadWorkload(path, &golden)) {
+        fprintf(stderr, "Cannot load golden dump %s\n", path);
+        status = "MISSING";
+      } else {
+        if ((golden.length != dump.length) ||
+            (memcmp(golden.bytes, dump.text, dump.length) != 0)) {
+          fprintf(stderr, "%s: screen differs from line %zu\n", name,
+                  SFTGoldenBenchmarkFirstDifference(
+                      (const char *)golden.bytes, golden.length, dump.text,
+                      dump.length));
+          status = "DIFFERS";
+        }
+        SFTBenchmarkReleaseWorkload(&golden);
+      }
+    }
+  }
+
+  printf("%-32s %8zu %7zux%-3zu %10s\n", name, input.length, input.width,
+         input.height, status);
+
+  free(dump.text);
+  free(screen);
+  SFTBenchmarkReleaseWorkload(&workload);
+  return (strcmp(status, "OK") == 0) || (strcmp(status, "UPDATED") == 0);
+}
+
+int SFTGoldenBenchmarkMain(int argc, char *argv[]) {
+  SFTGoldenBenchmarkOptions options = {.directory = kDefaultDirectory,
+                                       .update = false};
+  int option;
+
+  while ((option = getopt(argc, argv, "d:uh")) != -1) {
+    switch (option) {
+    case 'd':
+      options.directory = optarg;
+      break;
+    case 'u':
+      options.update = true;
+      break;
+    default:
+      SFTGoldenBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (options.update && !SFTGoldenBenchmarkWriteSynthetic(&options)) {
+    return EXIT_FAILURE;
+  }
+
+  char *names[kMaximumInputs];
+  size_t count = SFTGoldenBenchmarkListInputs(&options, names);
+  if (count == SIZE_MAX) {
+    return EXIT_FAILURE;
+  }
+
+  printf("%-32s %8s %11s %10s\n", "input", "bytes", "screen", "result");
+
+  bool succeeded = count > 0;
+  for (size_t index = 0; index < count; index++) {
+    succeeded = SFTGoldenBenchmarkCheck(&options, names[index]) && succeeded;
+    free(names[index]);
+  }
+
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
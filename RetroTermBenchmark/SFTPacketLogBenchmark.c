@@ -0,0 +1,220 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Appends packets to the bounded log backing the data flow inspector, and
+ * checks that exactly the most recent ones are kept, intact and within the byte
+ * budget.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCorePacketLog.h"
+
+static const uint64_t kDefaultPackets = 10 * 1000 * 1000;
+static const size_t kDefaultBudget = 1024 * 1024;
+static const size_t kDefaultMaximumPacketSize = 1460;
+
+/**
+ * Packets appended between two consistency checks.
+ */
+static const uint64_t kCheckInterval = 1000 * 1000;
+
+typedef struct {
+  uint64_t packets;
+  size_t budget;
+  size_t maximumPacketSize;
+} SFTPacketLogBenchmarkOptions;
+
+static void SFTPacketLogBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s packetlog [-n packets] [-b byte budget] "
+          "[-m maximum packet size]\n"
+          "\n"
+          "Appends packets of random sizes to a bounded packet log, "
+          "periodically checking\nthat exactly the most recent ones are "
+          "kept, in order and intact, within the\nbyte budget.\n",
+          name);
+}
+
+static uint64_t SFTPacketLogBenchmarkMix(uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xFF51AFD7ED558CCDULL;
+  value ^= value >> 33;
+  return value;
+}
+
+/**
+ * Derives a packet's length and contents from its sequence number, so that
+ * retained packets can be checked without keeping a copy.
+ */
+static size_t
+SFTPacketLogBenchmarkPacket(const SFTPacketLogBenchmarkOptions *options,
+                            const uint8_t *source, uint64_t sequence,
+                            const uint8_t **bytes) {
+  uint64_t mixed = SFTPacketLogBenchmarkMix(sequence);
+  *bytes = source + (mixed >> 40) % options->maximumPacketSize;
+  return 1 + (size_t)(mixed % options->maximumPacketSize);
+}
+
+static bool
+SFTPacketLogBenchmarkCheck(const SFTCorePacketLog *log,
+                           const SFTPacketLogBenchmarkOptions *options,
+                           const uint8_t *source) {
+  if ((log->count > log->recordsCapacity) ||
+      (log->appended - log->evicted != log->count)) {
+    fprintf(stderr, "Packet count mismatch\n");
+    return false;
+  }
+
+  size_t retained = 0;
+  for (size_t index = 0; index < log->count; index++) {
+    uint64_t sequence = log->evicted + index;
+    const uint8_t *expected;
+    size_t length =
+        SFTPacketLogBenchmarkPacket(options, source, sequence, &expected);
+    if (length > log->arenaCapacity) {
+      length = log->arenaCapacity;
+    }
+
+    const uint8_t *payload;
+    const SFTCorePacketLogRecord *record =
+        SFTCorePacketLogGet(log, index, &payload);
+    if ((record->timestamp != sequence) ||
+        (SFTCorePacketLogRecordIsInbound(record) != ((sequence & 1) == 0)) ||
+        (SFTCorePacketLogRecordLength(record) != length) ||
+        (memcmp(payload, expected, length) != 0)) {
+      fprintf(stderr, "Packet %llu is corrupted\n",
+              (unsigned long long)sequence);
+      return false;
+    }
+    retained += length;
+  }
+
+  if (retained > log->arenaCapacity) {
+    fprintf(stderr, "Byte budget exceeded\n");
+    return false;
+  }
+
+  // Only the newest packets are kept: the next older one must not have fit.
+  if ((log->evicted > 0) && (log->count < log->recordsCapacity)) {
+    const uint8_t *bytes;
+    size_t length =
+        SFTPacketLogBenchmarkPacket(options, source, log->evicted - 1, &bytes);
+    if (retained + length <= log->arenaCapacity / 2) {
+      fprintf(stderr, "Packet %llu evicted too early\n",
+              (unsigned long long)(log->evicted - 1));
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int SFTPacketLogBenchmarkMain(int argc, char *argv[]) {
+  SFTPacketLogBenchmarkOptions options = {
+      .packets = kDefaultPackets,
+      .budget = kDefaultBudget,
+      .maximumPacketSize = kDefaultMaximumPacketSize};
+
+  int option;
+  while ((option = getopt(argc, argv, "n:b:m:")) != -1) {
+    switch (option) {
+    case 'n':
+      options.packets = strtoull(optarg, NULL, 0);
+      break;
+
+    case 'b':
+      options.budget = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'm':
+      options.maximumPacketSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    default:
+      SFTPacketLogBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if ((options.packets == 0) || (options.maximumPacketSize == 0)) {
+    SFTPacketLogBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  SFTCorePacketLog log;
+  if (!SFTCorePacketLogInitialise(&log, options.budget)) {
+    SFTPacketLogBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  uint8_t *source = (uint8_t *)malloc(options.maximumPacketSize * 2);
+  if (source == NULL) {
+    fprintf(stderr, "Cannot allocate packet source\n");
+    SFTCorePacketLogRelease(&log);
+    return EXIT_FAILURE;
+  }
+  for (size_t index = 0; index < options.maximumPacketSize * 2; index++) {
+    source[index] = (uint8_t)SFTPacketLogBenchmarkMix(index);
+  }
+
+  printf("%12s %12s %10s %10s %10s %10s  %s\n", "packets", "budget",
+         "records", "ns/packet", "MB/s", "retained", "result");
+
+  bool succeeded = true;
+  uint64_t elapsed = 0;
+  uint64_t bytes = 0;
+  for (uint64_t sequence = 0; succeeded && (sequence < options.packets);) {
+    uint64_t end = sequence + kCheckInterval;
+    if (end > options.packets) {
+      end = options.packets;
+    }
+
+    uint64_t start = SFTBenchmarkNow();
+    for (; sequence < end; sequence++) {
+      const uint8_t *packet;
+      size_t length =
+          SFTPacketLogBenchmarkPacket(&options, source, sequence, &packet);
+      SFTCorePacketLogAppend(&log, sequence, (sequence & 1) == 0, packet,
+                             length);
+      bytes += length;
+    }
+    elapsed += SFTBenchmarkNow() - start;
+
+    succeeded = SFTPacketLogBenchmarkCheck(&log, &options, source);
+  }
+
+  printf("%12llu %12zu %10zu %10.2f %10.2f %10zu  %s\n",
+         (unsigned long long)options.packets, options.budget,
+         log.recordsCapacity, (double)elapsed / (double)options.packets,
+         (double)bytes * 1000.0 / (double)elapsed, log.count,
+         succeeded ? "OK" : "FAILED");
+
+  free(source);
+  SFTCorePacketLogRelease(&log);
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,259 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Feeds each workload through the emulator core a chunk at a time, with both
+ * the reference and the fast parser unless one is chosen, and reports the best
+ * throughput out of a few iterations on a screen of the given size.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreCellKernels.h"
+#include "SFTCoreEmulator.h"
+
+static const size_t kDefaultChunkSize = 512;
+static const size_t kDefaultSyntheticSize = 4 * 1024 * 1024;
+static const unsigned int kDefaultIterations = 5;
+static const size_t kDefaultWidth = 40;
+static const size_t kDefaultHeight = 25;
+
+typedef struct {
+  const char *name;
+  SFTCoreEmulatorParserMode mode;
+} SFTParserBenchmarkMode;
+
+static const SFTParserBenchmarkMode kModes[] = {
+    {"reference", SFTCoreEmulatorParserModeReference},
+    {"fast", SFTCoreEmulatorParserModeFast}};
+
+static const size_t kModesCount = sizeof(kModes) / sizeof(kModes[0]);
+
+typedef struct {
+  size_t chunkSize;
+  size_t width;
+  size_t height;
+  unsigned int iterations;
+  const SFTParserBenchmarkMode *mode;
+} SFTParserBenchmarkOptions;
+
+static void SFTParserBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s parser [-c chunk] [-i iterations] [-s synthetic bytes] "
+          "[-w width] [-h height] [-m reference|fast] [capture ...]\n"
+          "\n"
+          "Feeds each capture through the emulator core, %zu bytes at a time "
+          "by default,\nreporting throughput. Synthetic workloads are used "
+          "when no capture is given.\nAll parser modes are measured unless "
+          "one is chosen.\n",
+          name, kDefaultChunkSize);
+}
+
+static void SFTParserBenchmarkRun(const SFTBenchmarkWorkload *workload,
+                                  const SFTParserBenchmarkOptions *options,
+                                  SFTTerminalEmulatorCell *cells,
+                                  SFTTerminalEmulatorCell *screen) {
+  uint64_t best = UINT64_MAX;
+  uint64_t total = 0;
+  uint64_t checksum = 0;
+  size_t redraws = 0;
+  size_t uploaded = 0;
+
+  for (unsigned int iteration = 0; iteration < options->iterations;
+       iteration++) {
+    SFTCoreEmulatorState state;
+    SFTCoreEmulatorStateInitialise(&state, options->width, options->height, 0,
+                                   14, true, false);
+    SFTCoreEmulatorClearScreen(&state, cells);
+    state.parserMode = options->mode->mode;
+    SFTCoreEmulatorClearDirtyRows(&state);
+    redraws = 0;
+    uploaded = 0;
+
+    uint64_t start = SFTBenchmarkNow();
+    for (size_t offset = 0; offset < workload->length;
+         offset += options->chunkSize) {
+      size_t length = workload->length - offset;
+      if (length > options->chunkSize) {
+        length = options->chunkSize;
+      }
+
+      if (SFTCoreEmulatorProcessIncomingData(&state, cells,
+                                             workload->bytes + offset,
+                                             length)) {
+        redraws++;
+      }
+
+      // Account for what a GPU upload of the damaged rows would cost.
+      size_t count = 0;
+      for (size_t row = SFTCoreEmulatorNextDirtyRows(&state, 0, &count);
+           row < state.height;
+           row = SFTCoreEmulatorNextDirtyRows(&state, row + count, &count)) {
+        uploaded += count * state.width * sizeof(SFTTerminalEmulatorCell);
+      }
+      SFTCoreEmulatorClearDirtyRows(&state);
+    }
+    uint64_t elapsed = SFTBenchmarkNow() - start;
+
+    total += elapsed;
+    if (elapsed < best) {
+      best = elapsed;
+    }
+
+    SFTCoreEmulatorCopyContents(&state, cells, screen);
+    checksum = SFTBenchmarkHash(screen,
+                                options->width * options->height *
+                                    sizeof(SFTTerminalEmulatorCell),
+                                0);
+    checksum = SFTBenchmarkHash(&state.row, sizeof(state.row), checksum);
+    checksum = SFTBenchmarkHash(&state.column, sizeof(state.column), checksum);
+  }
+
+  double bytes = (double)workload->length;
+  double mean = (double)total / (double)options->iterations;
+
+  printf("%-24s %-10s %12zu %10.2f %10.2f %10.3f %8zu %10zu  %016llx\n",
+         workload->name, options->mode->name, workload->length,
+         (bytes * 1000.0) / (double)best, (bytes * 1000.0) / mean,
+         (double)best / bytes, redraws,
+         redraws > 0 ? uploaded / redraws : 0, (unsigned long long)checksum);
+}
+
+static void SFTParserBenchmarkRunAllModes(
+    const SFTBenchmarkWorkload *workload, SFTParserBenchmarkOptions *options,
+    SFTTerminalEmulatorCell *cells, SFTTerminalEmulatorCell *screen) {
+  if (options->mode != NULL) {
+    SFTParserBenchmarkRun(workload, options, cells, screen);
+    return;
+  }
+
+  for (size_t index = 0; index < kModesCount; index++) {
+    options->mode = &kModes[index];
+    SFTParserBenchmarkRun(workload, options, cells, screen);
+  }
+  options->mode = NULL;
+}
+
+/**
+ * Options and buffers shared by every workload.
+ */
+typedef struct {
+  SFTParserBenchmarkOptions *options;
+  SFTTerminalEmulatorCell *cells;
+  SFTTerminalEmulatorCell *screen;
+} SFTParserBenchmarkContext;
+
+static bool SFTParserBenchmarkRunWorkload(const SFTBenchmarkWorkload *workload,
+                                          void *userData) {
+  SFTParserBenchmarkContext *context = (SFTParserBenchmarkContext *)userData;
+  SFTParserBenchmarkRunAllModes(workload, context->options, context->cells,
+                                context->screen);
+  return true;
+}
+
+int SFTParserBenchmarkMain(int argc, char *argv[]) {
+  SFTParserBenchmarkOptions options = {.chunkSize = kDefaultChunkSize,
+                                       .width = kDefaultWidth,
+                                       .height = kDefaultHeight,
+                                       .iterations = kDefaultIterations,
+                                       .mode = NULL};
+  size_t syntheticSize = kDefaultSyntheticSize;
+
+  int option;
+  while ((option = getopt(argc, argv, "c:i:s:w:h:m:")) != -1) {
+    switch (option) {
+    case 'c':
+      options.chunkSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'i':
+      options.iterations = (unsigned int)strtoul(optarg, NULL, 0);
+      break;
+
+    case 's':
+      syntheticSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'w':
+      options.width = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'h':
+      options.height = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'm':
+      for (size_t index = 0; index < kModesCount; index++) {
+        if (strcmp(optarg, kModes[index].name) == 0) {
+          options.mode = &kModes[index];
+        }
+      }
+      if (options.mode == NULL) {
+        SFTParserBenchmarkUsage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      break;
+
+    default:
+      SFTParserBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  SFTCoreEmulatorState probe;
+  if ((options.chunkSize == 0) || (options.iterations == 0) ||
+      !SFTCoreEmulatorStateInitialise(&probe, options.width, options.height, 0,
+                                      0, false, false)) {
+    SFTParserBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  SFTTerminalEmulatorCell *cells = (SFTTerminalEmulatorCell *)calloc(
+      options.width * options.height, sizeof(SFTTerminalEmulatorCell));
+  SFTTerminalEmulatorCell *screen = (SFTTerminalEmulatorCell *)calloc(
+      options.width * options.height, sizeof(SFTTerminalEmulatorCell));
+  if ((cells == NULL) || (screen == NULL)) {
+    fprintf(stderr, "Cannot allocate cell buffer\n");
+    free(cells);
+    free(screen);
+    return EXIT_FAILURE;
+  }
+
+  printf("Cell kernels: %s\n\n", SFTCoreCellKernelsInstructionSet);
+  printf("%-24s %-10s %12s %10s %10s %10s %8s %10s  %s\n", "workload",
+         "parser", "bytes", "MB/s best", "MB/s mean", "ns/byte", "redraws",
+         "B/redraw", "checksum");
+
+  SFTParserBenchmarkContext context = {
+      .options = &options, .cells = cells, .screen = screen};
+  int result =
+      SFTBenchmarkRunWorkloads(argc, argv, optind, syntheticSize,
+                               SFTParserBenchmarkRunWorkload, &context);
+
+  free(screen);
+  free(cells);
+  return result;
+}
@@ -0,0 +1,271 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Reads the same escaped data through the pipeline of stages every connection
+ * goes through, made of the Telnet filter followed by an increasing number of
+ * stages.  Each stage must see exactly what the emulator gets, and the cost of
+ * every added stage is reported per read.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCorePipeline.h"
+#include "SFTCoreTelnet.h"
+
+static const size_t kDefaultSyntheticSize = 4 * 1024 * 1024;
+static const size_t kDefaultRounds = 5;
+
+/**
+ * Bytes read from the transport at a time, as large as the application's
+ * input ring.
+ */
+static const size_t kReadBufferSize = 64 * 1024;
+
+/**
+ * Stage counts timed for each workload, past the Telnet filter.
+ */
+static const size_t kObserverCounts[] = {0, 1, 2, 4,
+                                         SFTCorePipelineMaximumStages - 1};
+
+/**
+ * Observer stage state: bytes seen in each direction and, when checking
+ * rather than timing, their hash.
+ */
+typedef struct {
+  size_t bytes[SFTCorePipelineDirectionsCount];
+  bool hashing;
+  uint64_t hash;
+} SFTPipelineBenchmarkObserver;
+
+static void SFTPipelineBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s pipeline [-s synthetic bytes] [-r rounds] "
+          "[capture ...]\n"
+          "\n"
+          "Reads each raw capture, escaped as a Telnet server would send "
+          "it, through a\npipeline made of the Telnet filter and an "
+          "increasing number of stages looking\nat every span, checking "
+          "what each stage sees and timing each pipeline\nagainst plain "
+          "copies of the same reads.  Synthetic workloads are used when no "
+          "capture\nis given.\n",
+          name);
+}
+
+static size_t SFTPipelineBenchmarkObserve(SFTCorePipeline *pipeline,
+                                          size_t stage,
+                                          SFTCorePipelineDirection direction,
+                                          uint8_t *bytes, size_t length) {
+  SFTPipelineBenchmarkObserver *observer =
+      (SFTPipelineBenchmarkObserver *)SFTCorePipelineContext(pipeline, stage);
+  observer->bytes[direction] += length;
+  if (observer->hashing) {
+    observer->hash = SFTBenchmarkHash(bytes, length, observer->hash);
+  }
+  return length;
+}
+
+/**
+ * Reads the given stream through a pipeline in kReadBufferSize chunks.
+ *
+ * @param[in] stream the bytes to read.
+ * @param[in] length the stream length, in bytes.
+ * @param[in] observers the amount of observer stages past the filter, or
+ * SIZE_MAX to only copy the stream.
+ * @param[in] hashing whether observer stages hash what they see.
+ * @param[out] states the observer stages' state.
+ * @param[out] buffer scratch space, kReadBufferSize bytes long.
+ * @param[out] delivered the amount of bytes left by the pipeline.
+ *
+ * @return the time taken, in nanoseconds.
+ */
+static uint64_t SFTPipelineBenchmarkRead(const uint8_t *stream, size_t length,
+                                         size_t observers, bool hashing,
+                                         SFTPipelineBenchmarkObserver *states,
+                                         uint8_t *buffer, size_t *delivered) {
+  SFTCorePipeline pipeline;
+  SFTCorePipelineInitialise(&pipeline);
+  SFTCoreTelnet telnet;
+  SFTCoreTelnetInitialise(&telnet, 40, 25, "PETSCII");
+
+  if (observers != SIZE_MAX) {
+    SFTCorePipelineAppend(&pipeline, SFTCoreTelnetProcess, &telnet);
+    for (size_t index = 0; index < observers; index++) {
+      memset(&states[index], 0, sizeof(SFTPipelineBenchmarkObserver));
+      states[index].hashing = hashing;
+      SFTCorePipelineAppend(&pipeline, SFTPipelineBenchmarkObserve,
+                            &states[index]);
+    }
+  }
+
+  *delivered = 0;
+  uint64_t start = SFTBenchmarkNow();
+  for (size_t offset = 0; offset < length; offset += kReadBufferSize) {
+    size_t chunk = length - offset < kReadBufferSize ? length - offset
+                                                     : kReadBufferSize;
+    memcpy(buffer, stream + offset, chunk);
+    *delivered += SFTCorePipelineRun(
+        &pipeline, SFTCorePipelineDirectionInbound, buffer, chunk);
+  }
+
+  return SFTBenchmarkNow() - start;
+}
+
+static bool SFTPipelineBenchmarkRun(const SFTBenchmarkWorkload *workload,
+                                    size_t rounds, uint8_t *buffer) {
+  uint8_t *escaped = (uint8_t *)malloc(workload->length * 2);
+  if (escaped == NULL) {
+    fprintf(stderr, "Cannot allocate the escaped workload\n");
+    return false;
+  }
+
+  size_t length = 0;
+  for (size_t index = 0; index < workload->length; index++) {
+    escaped[length++] = workload->bytes[index];
+    if (workload->bytes[index] == SFTCoreTelnetIAC) {
+      escaped[length++] = SFTCoreTelnetIAC;
+    }
+  }
+
+  SFTPipelineBenchmarkObserver states[SFTCorePipelineMaximumStages];
+  uint64_t expectedHash =
+      SFTBenchmarkHash(workload->bytes, workload->length, 0);
+  bool succeeded = true;
+  size_t delivered;
+
+  uint64_t copyTime = UINT64_MAX;
+  for (size_t round = 0; round < rounds; round++) {
+    uint64_t elapsed = SFTPipelineBenchmarkRead(
+        escaped, length, SIZE_MAX, false, states, buffer, &delivered);
+    copyTime = elapsed < copyTime ? elapsed : copyTime;
+  }
+
+  double megabytes = (double)length / (1024.0 * 1024.0);
+  double chunks = (double)((length + kReadBufferSize - 1) / kReadBufferSize);
+  printf("%-24s %8.2f %7s %9.2f %10s %9s  %s\n", workload->name, megabytes,
+         "copy", (double)length / (double)copyTime, "", "", "OK");
+
+  uint64_t previousTime = copyTime;
+  for (size_t count = 0;
+       count < sizeof(kObserverCounts) / sizeof(kObserverCounts[0]);
+       count++) {
+    size_t observers = kObserverCounts[count];
+    // Every stage past the filter sees exactly what the emulator gets.
+    SFTPipelineBenchmarkRead(escaped, length, observers, true, states, buffer,
+                             &delivered);
+    bool matched = delivered == workload->length;
+    for (size_t index = 0; index < observers; index++) {
+      matched = matched &&
+                (states[index].bytes[SFTCorePipelineDirectionInbound] ==
+                 workload->length) &&
+                (states[index].bytes[SFTCorePipelineDirectionOutbound] == 0) &&
+                (states[index].hash == expectedHash);
+    }
+
+    uint64_t best = UINT64_MAX;
+    for (size_t round = 0; round < rounds; round++) {
+      uint64_t elapsed = SFTPipelineBenchmarkRead(
+          escaped, length, observers, false, states, buffer, &delivered);
+      best = elapsed < best ? elapsed : best;
+      matched = matched && (delivered == workload->length);
+    }
+
+    char stages[16];
+    snprintf(stages, sizeof(stages), "%zu", observers + 1);
+    printf("%-24s %8s %7s %9.2f %10.1f %+8.1f%%  %s\n", "", "", stages,
+           (double)length / (double)best,
+           ((double)best - (double)copyTime) / chunks,
+           (((double)best - (double)previousTime) * 100.0) /
+               (double)copyTime,
+           matched ? "OK" : "FAILED");
+    previousTime = best;
+    succeeded = succeeded && matched;
+  }
+
+  free(escaped);
+  return succeeded;
+}
+
+/**
+ * Options and buffers shared by every workload.
+ */
+typedef struct {
+  size_t rounds;
+  uint8_t *buffer;
+} SFTPipelineBenchmarkContext;
+
+static bool
+SFTPipelineBenchmarkRunWorkload(const SFTBenchmarkWorkload *workload,
+                                void *userData) {
+  const SFTPipelineBenchmarkContext *context =
+      (const SFTPipelineBenchmarkContext *)userData;
+  return SFTPipelineBenchmarkRun(workload, context->rounds, context->buffer);
+}
+
+int SFTPipelineBenchmarkMain(int argc, char *argv[]) {
+  size_t syntheticSize = kDefaultSyntheticSize;
+  size_t rounds = kDefaultRounds;
+
+  int option;
+  while ((option = getopt(argc, argv, "s:r:")) != -1) {
+    switch (option) {
+    case 's':
+      syntheticSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'r':
+      rounds = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    default:
+      SFTPipelineBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if ((syntheticSize == 0) || (rounds == 0)) {
+    SFTPipelineBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  uint8_t *buffer = (uint8_t *)malloc(kReadBufferSize);
+  if (buffer == NULL) {
+    fprintf(stderr, "Cannot allocate buffers\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("%-24s %8s %7s %9s %10s %9s  %s\n", "workload", "MB", "stages",
+         "GB/s", "ns/read", "added", "result");
+
+  SFTPipelineBenchmarkContext context = {.rounds = rounds, .buffer = buffer};
+  int result = SFTBenchmarkRunWorkloads(argc, argv, optind, syntheticSize,
+                                        SFTPipelineBenchmarkRunWorkload,
+                                        &context);
+
+  free(buffer);
+  return result;
+}
@@ -0,0 +1,522 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Parses each workload a frame at a time and draws every frame with the
+ * software renderer.  The first frames are compared pixel by pixel with a
+ * straight port of the fragment shader, covering reverse video, selection, the
+ * cursor and both charset halves.  Frames per second are then reported both
+ * when redrawing the whole screen and when only drawing the cells that changed.
+ * Every checked frame is also compared with a port of the per-cell shaders.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreCellKernels.h"
+#include "SFTCoreEmulator.h"
+#include "SFTCoreRenderer.h"
+
+static const size_t kDefaultSyntheticSize = 1024 * 1024;
+static const size_t kDefaultWidth = 40;
+static const size_t kDefaultHeight = 25;
+
+/**
+ * Bytes parsed between two frames.
+ */
+static const size_t kDefaultFrameBytes = 512;
+
+/**
+ * Frames compared against the reference renderer, for each workload.
+ */
+static const size_t kCheckedFrames = 256;
+
+/**
+ * Minimum time spent redrawing the whole screen, in nanoseconds.
+ */
+static const uint64_t kFullRedrawTime = 500000000;
+
+/**
+ * Charset texture size, in texels, as seen by the fragment shader.
+ */
+#define SFTRenderBenchmarkTextureWidth 256
+#define SFTRenderBenchmarkTextureHeight 128
+
+/**
+ * The shader's palette, as written there.
+ */
+static const float kShaderPalette[16][3] = {
+    {0.000000f, 0.000000f, 0.000000f}, {1.000000f, 1.000000f, 1.000000f},
+    {0.533333f, 0.000000f, 0.000000f}, {0.666667f, 1.000000f, 0.933333f},
+    {0.800000f, 0.266667f, 0.800000f}, {0.000000f, 0.800000f, 0.333333f},
+    {0.000000f, 0.000000f, 0.666667f}, {0.933333f, 0.933333f, 0.466667f},
+    {0.866667f, 0.533333f, 0.333333f}, {0.400000f, 0.266667f, 0.000000f},
+    {1.000000f, 0.466667f, 0.466667f}, {0.200000f, 0.200000f, 0.200000f},
+    {0.466667f, 0.466667f, 0.466667f}, {0.666667f, 1.000000f, 0.400000f},
+    {0.000000f, 0.533333f, 1.000000f}, {0.733333f, 0.733333f, 0.733333f}};
+
+typedef struct {
+  size_t width;
+  size_t height;
+  size_t frameBytes;
+} SFTRenderBenchmarkOptions;
+
+/**
+ * Reference renderer state: the charset texture as loaded on the GPU, bottom
+ * row first, and the palette as framebuffer pixels.
+ */
+typedef struct {
+  uint8_t texels[SFTRenderBenchmarkTextureHeight]
+                [SFTRenderBenchmarkTextureWidth];
+  uint32_t palette[16];
+} SFTRenderBenchmarkReference;
+
+/**
+ * A cell as resolved by the per cell vertex function: the texel holding its
+ * glyph's top left pixel, and its colours once reversed if needed.
+ */
+typedef struct {
+  size_t originX;
+  size_t originY;
+  uint32_t foreground;
+  uint32_t background;
+} SFTRenderBenchmarkCell;
+
+static void SFTRenderBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s render [-s synthetic bytes] [-b bytes per frame] "
+          "[-w width] [-h height]\n       [capture ...]\n"
+          "\n"
+          "Parses each raw capture a frame at a time, drawing every frame "
+          "with the\nsoftware renderer and checking the first ones pixel by "
+          "pixel against a\nper-pixel port of the fragment shader, and "
+          "against a port of the per-cell\nshaders, then reports frame "
+          "rates for full redraws and for frames only\ndrawing what "
+          "changed.  Synthetic workloads are used when no capture is\n"
+          "given.\n",
+          name);
+}
+
+static void
+SFTRenderBenchmarkPrepareReference(SFTRenderBenchmarkReference *reference) {
+  // The texture is made of two halves of 8 rows of 32 glyphs each, and is
+  // loaded with its origin at the bottom left.
+  for (size_t glyph = 0; glyph < SFTCoreRendererGlyphsCount; glyph++) {
+    size_t top = ((glyph / 256) * 64) + (((glyph % 256) / 32) * 8);
+    size_t left = (glyph % 32) * 8;
+    for (size_t row = 0; row < SFTCoreRendererCellSize; row++) {
+      for (size_t column = 0; column < SFTCoreRendererCellSize; column++) {
+        reference->texels[SFTRenderBenchmarkTextureHeight - 1 - (top + row)]
+                         [left + column] =
+            (SFTCoreRendererGlyphs[glyph][row] >> (7 - column)) & 0x01;
+      }
+    }
+  }
+
+  for (size_t index = 0; index < 16; index++) {
+    uint8_t bytes[4];
+    for (size_t channel = 0; channel < 3; channel++) {
+      bytes[channel] =
+          (uint8_t)((kShaderPalette[index][channel] * 255.0f) + 0.5f);
+    }
+    bytes[3] = 0xFF;
+    memcpy(&reference->palette[index], bytes, sizeof(uint32_t));
+  }
+}
+
+/**
+ * Computes one pixel the way the fragment shader does, sampling at the
+ * pixel's centre.
+ */
+static uint32_t
+SFTRenderBenchmarkReferencePixel(const SFTRenderBenchmarkReference *reference,
+                                 const SFTTerminalEmulatorCell *cells,
+                                 const SFTRenderBenchmarkOptions *options,
+                                 size_t baseRow,
+                                 const SFTCoreRendererContext *context,
+                                 size_t x, size_t y) {
+  float scaledX = ((float)x + 0.5f) / (float)SFTCoreRendererCellSize;
+  float scaledY = ((float)y + 0.5f) / (float)SFTCoreRendererCellSize;
+  uint32_t currentX = (uint32_t)scaledX;
+  uint32_t currentY = (uint32_t)scaledY;
+  uint32_t index = (uint32_t)((currentY * options->width) + currentX);
+
+  size_t row = currentY + baseRow;
+  if (row >= options->height) {
+    row -= options->height;
+  }
+  uint32_t data = cells[(row * options->width) + currentX];
+
+  uint32_t character = data & 0xFF;
+  uint32_t foreground = (data >> 8) & 0x0F;
+  uint32_t background = (data >> 12) & 0x0F;
+  if ((data >> 16) & 0x01) {
+    character += 128;
+  }
+
+  uint32_t du = (uint32_t)(int)((scaledX - (float)currentX) * 8.0f);
+  uint32_t dv = 1 + (uint32_t)(int)((scaledY - (float)currentY) * 8.0f);
+  float u = (float)(du + ((character % 32) * 8)) / 256.0f;
+  float v = 1.0f - ((float)(dv + ((character / 32) * 8)) / 128.0f);
+  if (context->flags & SFTCoreRendererFlagLowerCase) {
+    v -= 0.5f;
+  }
+
+  // Nearest filtering, with zero outside of the texture.
+  uint8_t texel = 0;
+  if ((u >= 0.0f) && (u < 1.0f) && (v >= 0.0f) && (v < 1.0f)) {
+    texel = reference->texels[(size_t)(v * SFTRenderBenchmarkTextureHeight)]
+                             [(size_t)(u * SFTRenderBenchmarkTextureWidth)];
+  }
+
+  bool reversed = (context->selectionEnd >= index) &&
+                  (context->selectionStart <= index) &&
+                  (context->selectionEnd > context->selectionStart);
+  if ((context->flags & SFTCoreRendererFlagCursor) &&
+      (currentX == context->cursorColumn) &&
+      (currentY == context->cursorRow)) {
+    reversed = !reversed;
+  }
+
+  if (reversed) {
+    return reference->palette[texel ? background : foreground];
+  }
+  return reference->palette[texel ? foreground : background];
+}
+
+/**
+ * Resolves every visible cell the way the per cell vertex function does.
+ */
+static void
+SFTRenderBenchmarkResolveCells(const SFTRenderBenchmarkReference *reference,
+                               const SFTTerminalEmulatorCell *cells,
+                               const SFTRenderBenchmarkOptions *options,
+                               size_t baseRow,
+                               const SFTCoreRendererContext *context,
+                               SFTRenderBenchmarkCell *resolved) {
+  for (uint32_t instance = 0;
+       instance < (uint32_t)(options->width * options->height); instance++) {
+    uint32_t row = instance / (uint32_t)options->width;
+    uint32_t column = instance - (row * (uint32_t)options->width);
+
+    size_t physical = row + baseRow;
+    if (physical >= options->height) {
+      physical -= options->height;
+    }
+    uint32_t data = cells[(physical * options->width) + column];
+
+    uint32_t glyph =
+        (data & 0xFF) + (((data >> 16) & 0x01) * 128) +
+        ((context->flags & SFTCoreRendererFlagLowerCase) ? 256 : 0);
+    if (glyph >= 512) {
+      glyph = 32;
+    }
+
+    bool reversed = (context->selectionEnd >= instance) &&
+                    (context->selectionStart <= instance) &&
+                    (context->selectionEnd > context->selectionStart);
+    if ((context->flags & SFTCoreRendererFlagCursor) &&
+        (column == context->cursorColumn) && (row == context->cursorRow)) {
+      reversed = !reversed;
+    }
+
+    uint32_t foreground = reference->palette[(data >> 8) & 0x0F];
+    uint32_t background = reference->palette[(data >> 12) & 0x0F];
+    resolved[instance] = (SFTRenderBenchmarkCell){
+        .originX = (glyph % 32) * 8,
+        .originY = 127 - ((glyph / 32) * 8),
+        .foreground = reversed ? background : foreground,
+        .background = reversed ? foreground : background};
+  }
+}
+
+/**
+ * Computes one pixel the way the per cell fragment function does, from
+ * cells resolved by SFTRenderBenchmarkResolveCells.
+ */
+static uint32_t
+SFTRenderBenchmarkCellPixel(const SFTRenderBenchmarkReference *reference,
+                            const SFTRenderBenchmarkCell *resolved,
+                            const SFTRenderBenchmarkOptions *options,
+                            size_t x, size_t y) {
+  size_t column = x / SFTCoreRendererCellSize;
+  size_t row = y / SFTCoreRendererCellSize;
+  const SFTRenderBenchmarkCell *cell =
+      &resolved[(row * options->width) + column];
+
+  // Position within the cell as interpolated from the quad's corners.
+  float cellX = (((float)x + 0.5f) / (float)SFTCoreRendererCellSize) -
+                (float)column;
+  float cellY =
+      (((float)y + 0.5f) / (float)SFTCoreRendererCellSize) - (float)row;
+  size_t offsetX = (size_t)(cellX * 8.0f);
+  size_t offsetY = (size_t)(cellY * 8.0f);
+  offsetX = offsetX < 7 ? offsetX : 7;
+  offsetY = offsetY < 7 ? offsetY : 7;
+
+  return reference->texels[cell->originY - offsetY][cell->originX + offsetX]
+             ? cell->foreground
+             : cell->background;
+}
+
+/**
+ * Compares the renderer's framebuffer with the reference renderer's output,
+ * then the per cell shaders' output with the reference renderer's.
+ *
+ * @param[in] resolved scratch space for width * height resolved cells.
+ * @param[out] cellMismatches the amount of pixels the per cell shaders get
+ * wrong.
+ *
+ * @return the amount of mismatching pixels.
+ */
+static size_t
+SFTRenderBenchmarkCompare(const SFTRenderBenchmarkReference *reference,
+                          const SFTCoreRenderer *renderer,
+                          const SFTTerminalEmulatorCell *cells,
+                          const SFTRenderBenchmarkOptions *options,
+                          size_t baseRow,
+                          const SFTCoreRendererContext *context,
+                          SFTRenderBenchmarkCell *resolved,
+                          size_t *cellMismatches) {
+  SFTRenderBenchmarkResolveCells(reference, cells, options, baseRow, context,
+                                 resolved);
+
+  size_t stride = SFTCoreRendererStride(renderer);
+  size_t mismatches = 0;
+  for (size_t y = 0; y < options->height * SFTCoreRendererCellSize; y++) {
+    for (size_t x = 0; x < stride; x++) {
+      uint32_t expected = SFTRenderBenchmarkReferencePixel(
+          reference, cells, options, baseRow, context, x, y);
+      if (renderer->pixels[(y * stride) + x] != expected) {
+        mismatches++;
+      }
+      if (SFTRenderBenchmarkCellPixel(reference, resolved, options, x, y) !=
+          expected) {
+        ++*cellMismatches;
+      }
+    }
+  }
+  return mismatches;
+}
+
+/**
+ * Picks a deterministic context for the given frame, with selections,
+ * cursor blinks and charset switches happening every now and then.
+ */
+static void
+SFTRenderBenchmarkPickContext(SFTCoreRendererContext *context,
+                              const SFTRenderBenchmarkOptions *options,
+                              const SFTCoreEmulatorState *state,
+                              size_t frame) {
+  uint64_t random = SFTBenchmarkHash(&frame, sizeof(frame), 0);
+  size_t cells = options->width * options->height;
+
+  // The cursor blinks every 16 frames and the charset is switched every 64,
+  // which is far more often than on a real session.
+  context->cursorRow = (uint32_t)state->row;
+  context->cursorColumn = (uint32_t)state->column;
+  context->flags = (uint8_t)((((frame / 16) & 0x01) != 0
+                                  ? SFTCoreRendererFlagCursor
+                                  : 0) |
+                             (((frame / 64) & 0x01) != 0
+                                  ? SFTCoreRendererFlagLowerCase
+                                  : 0));
+  if ((random & 0x07) == 0) {
+    context->selectionStart = (uint32_t)((random >> 16) % cells);
+    context->selectionEnd = (uint32_t)((random >> 32) % cells);
+  } else {
+    context->selectionStart = 0;
+    context->selectionEnd = 0;
+  }
+}
+
+static bool SFTRenderBenchmarkRun(const SFTBenchmarkWorkload *workload,
+                                  const SFTRenderBenchmarkOptions *options,
+                                  const SFTRenderBenchmarkReference *reference,
+                                  SFTTerminalEmulatorCell *cells) {
+  SFTCoreRenderer renderer;
+  if (!SFTCoreRendererInitialise(&renderer, options->width,
+                                 options->height)) {
+    fprintf(stderr, "Cannot allocate the framebuffer\n");
+    return false;
+  }
+  SFTRenderBenchmarkCell *resolved = (SFTRenderBenchmarkCell *)calloc(
+      options->width * options->height, sizeof(SFTRenderBenchmarkCell));
+  if (resolved == NULL) {
+    fprintf(stderr, "Cannot allocate the framebuffer\n");
+    SFTCoreRendererRelease(&renderer);
+    return false;
+  }
+
+  SFTCoreEmulatorState state;
+  SFTCoreEmulatorStateInitialise(&state, options->width, options->height, 0,
+                                 14, false, false);
+  SFTCoreEmulatorClearScreen(&state, cells);
+
+  // Frames only drawing what changed, checking the first ones.
+  SFTCoreRendererContext context;
+  size_t frames = 0;
+  size_t mismatches = 0;
+  size_t cellMismatches = 0;
+  uint64_t drawTime = 0;
+  for (size_t offset = 0; offset < workload->length;
+       offset += options->frameBytes) {
+    size_t length = workload->length - offset;
+    SFTCoreEmulatorProcessIncomingData(&state, cells, workload->bytes + offset,
+                                       length < options->frameBytes
+                                           ? length
+                                           : options->frameBytes);
+    SFTRenderBenchmarkPickContext(&context, options, &state, frames);
+
+    uint64_t start = SFTBenchmarkNow();
+    SFTCoreRendererDraw(&renderer, cells, state.baseRow, &context);
+    drawTime += SFTBenchmarkNow() - start;
+
+    if (frames < kCheckedFrames) {
+      mismatches += SFTRenderBenchmarkCompare(
+          reference, &renderer, cells, options, state.baseRow, &context,
+          resolved, &cellMismatches);
+    }
+    frames++;
+  }
+  uint64_t cellsDrawn = renderer.cellsDrawn;
+
+  // Whole screen redraws of the final screen contents.
+  size_t redraws = 0;
+  uint64_t start = SFTBenchmarkNow();
+  uint64_t redrawTime;
+  do {
+    SFTCoreRendererInvalidate(&renderer);
+    SFTCoreRendererDraw(&renderer, cells, state.baseRow, &context);
+    redraws++;
+    redrawTime = SFTBenchmarkNow() - start;
+  } while (redrawTime < kFullRedrawTime);
+  mismatches +=
+      SFTRenderBenchmarkCompare(reference, &renderer, cells, options,
+                                state.baseRow, &context, resolved,
+                                &cellMismatches);
+
+  bool passed = (mismatches == 0) && (cellMismatches == 0);
+  printf("%-24s %8zu %11.0f %11.0f %11.1f  %s\n", workload->name, frames,
+         ((double)redraws * 1e9) / (double)redrawTime,
+         ((double)frames * 1e9) / (double)(drawTime > 0 ? drawTime : 1),
+         (double)cellsDrawn / (double)frames, passed ? "OK" : "FAILED");
+  if (mismatches != 0) {
+    fprintf(stderr, "%zu pixels differ from the reference\n", mismatches);
+  }
+  if (cellMismatches != 0) {
+    fprintf(stderr, "%zu pixels drawn per cell differ from the reference\n",
+            cellMismatches);
+  }
+
+  free(resolved);
+  SFTCoreRendererRelease(&renderer);
+  return passed;
+}
+
+/**
+ * Options and buffers shared by every workload.
+ */
+typedef struct {
+  const SFTRenderBenchmarkOptions *options;
+  const SFTRenderBenchmarkReference *reference;
+  SFTTerminalEmulatorCell *cells;
+} SFTRenderBenchmarkContext;
+
+static bool SFTRenderBenchmarkRunWorkload(const SFTBenchmarkWorkload *workload,
+                                          void *userData) {
+  const SFTRenderBenchmarkContext *context =
+      (const SFTRenderBenchmarkContext *)userData;
+  return SFTRenderBenchmarkRun(workload, context->options, context->reference,
+                               context->cells);
+}
+
+int SFTRenderBenchmarkMain(int argc, char *argv[]) {
+  SFTRenderBenchmarkOptions options = {.width = kDefaultWidth,
+                                       .height = kDefaultHeight,
+                                       .frameBytes = kDefaultFrameBytes};
+  size_t syntheticSize = kDefaultSyntheticSize;
+
+  int option;
+  while ((option = getopt(argc, argv, "s:b:w:h:")) != -1) {
+    switch (option) {
+    case 's':
+      syntheticSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'b':
+      options.frameBytes = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'w':
+      options.width = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'h':
+      options.height = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    default:
+      SFTRenderBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  SFTCoreEmulatorState probe;
+  if ((syntheticSize == 0) || (options.frameBytes == 0) ||
+      !SFTCoreEmulatorStateInitialise(&probe, options.width, options.height, 0,
+                                      0, false, false)) {
+    SFTRenderBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  SFTRenderBenchmarkReference *reference =
+      (SFTRenderBenchmarkReference *)malloc(
+          sizeof(SFTRenderBenchmarkReference));
+  SFTTerminalEmulatorCell *cells = (SFTTerminalEmulatorCell *)calloc(
+      options.width * options.height, sizeof(SFTTerminalEmulatorCell));
+  if ((reference == NULL) || (cells == NULL)) {
+    fprintf(stderr, "Cannot allocate buffers\n");
+    free(reference);
+    free(cells);
+    return EXIT_FAILURE;
+  }
+  SFTRenderBenchmarkPrepareReference(reference);
+
+  printf("Cell kernels: %s\n\n", SFTCoreCellKernelsInstructionSet);
+  printf("%-24s %8s %11s %11s %11s  %s\n", "workload", "frames", "full fps",
+         "delta fps", "cells/frame", "result");
+
+  SFTRenderBenchmarkContext context = {
+      .options = &options, .reference = reference, .cells = cells};
+  int result = SFTBenchmarkRunWorkloads(argc, argv, optind, syntheticSize,
+                                        SFTRenderBenchmarkRunWorkload,
+                                        &context);
+
+  free(reference);
+  free(cells);
+  return result;
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Measures how long raw captures take to index, to replay and to seek into,
+ * checking a number of seeks against a parse from the start of the capture.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreEmulator.h"
+#include "SFTCoreReplay.h"
+
+static const size_t kDefaultSyntheticSize = 8 * 1024 * 1024;
+static const size_t kDefaultSeeks = 1000;
+static const size_t kDefaultWidth = 40;
+static const size_t kDefaultHeight = 25;
+
+/**
+ * Amount of seeks checked against a parse from the start of the capture.
+ */
+static const size_t kVerifiedSeeks = 16;
+
+typedef struct {
+  size_t width;
+  size_t height;
+  size_t interval;
+  size_t seeks;
+} SFTReplayBenchmarkOptions;
+
+static void SFTReplayBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s replay [-n seeks] [-k checkpoint interval] "
+          "[-s synthetic bytes] [-w width] [-h height] [capture ...]\n"
+          "\n"
+          "Indexes each capture, replays it unthrottled and then seeks to "
+          "random offsets,\nchecking some of them against a parse from the "
+          "start.  Synthetic workloads are\nused when no capture is given.\n",
+          name);
+}
+
+static uint64_t
+SFTReplayBenchmarkScreenHash(const SFTCoreEmulatorState *state,
+                             const SFTTerminalEmulatorCell *cells,
+                             SFTTerminalEmulatorCell *screen) {
+  SFTCoreEmulatorCopyContents(state, cells, screen);
+  uint64_t hash = SFTBenchmarkHash(
+      screen, state->width * state->height * sizeof(SFTTerminalEmulatorCell),
+      0);
+  hash = SFTBenchmarkHash(&state->row, sizeof(state->row), hash);
+  return SFTBenchmarkHash(&state->column, sizeof(state->column), hash);
+}
+
+static void
+SFTReplayBenchmarkStartState(const SFTReplayBenchmarkOptions *options,
+                             SFTCoreEmulatorState *state,
+                             SFTTerminalEmulatorCell *cells) {
+  SFTCoreEmulatorStateInitialise(state, options->width, options->height, 0, 14,
+                                 true, false);
+  SFTCoreEmulatorClearScreen(state, cells);
+}
+
+static bool SFTReplayBenchmarkRun(const SFTBenchmarkWorkload *workload,
+                                  const SFTReplayBenchmarkOptions *options,
+                                  SFTTerminalEmulatorCell *cells,
+                                  SFTTerminalEmulatorCell *reference,
+                                  SFTTerminalEmulatorCell *screen) {
+  SFTCoreReplay replay;
+  SFTCoreReplayOpenMemory(&replay, workload->bytes, workload->length);
+
+  SFTCoreEmulatorState state;
+  SFTReplayBenchmarkStartState(options, &state, cells);
+
+  uint64_t start = SFTBenchmarkNow();
+  if (!SFTCoreReplayBuildCheckpoints(&replay, &state, cells,
+                                     options->interval)) {
+    fprintf(stderr, "Cannot build checkpoints for %s\n", workload->name);
+    SFTCoreReplayClose(&replay);
+    return false;
+  }
+  uint64_t indexing = SFTBenchmarkNow() - start;
+
+  // Unthrottled replay: everything in one go, as the application does when
+  // no speed limit is chosen.
+  start = SFTBenchmarkNow();
+  SFTCoreReplaySetSpeed(&replay, 0, start);
+  const uint8_t *bytes;
+  size_t length;
+  while ((length = SFTCoreReplayNextBatch(&replay, 0, SIZE_MAX, &bytes)) > 0) {
+    SFTCoreEmulatorProcessIncomingData(&state, cells, bytes, length);
+    SFTCoreReplayConsume(&replay, length);
+  }
+  uint64_t unthrottled = SFTBenchmarkNow() - start;
+
+  // Throttled replay: one simulated second at 2400 bps, sliced at 60Hz.
+  SFTCoreReplaySetSpeed(&replay, 2400, 0);
+  replay.position = 0;
+  size_t delivered = 0;
+  for (uint64_t tick = 1; tick <= 60; tick++) {
+    length = SFTCoreReplayNextBatch(&replay, tick * 1000000000ULL / 60, 4096,
+                                    &bytes);
+    SFTCoreReplayConsume(&replay, length);
+    delivered += length;
+  }
+
+  uint64_t seed = 0x2545F4914F6CDD1DULL;
+  uint64_t seeking = 0;
+  uint64_t slowest = 0;
+  bool matches = true;
+  for (size_t index = 0; index < options->seeks; index++) {
+    uint64_t random = SFTBenchmarkRandom(&seed);
+    size_t offset = (workload->length > 0)
+                        ? (size_t)(random % (workload->length + 1))
+                        : 0;
+
+    start = SFTBenchmarkNow();
+    SFTCoreReplaySeek(&replay, &state, cells, offset);
+    uint64_t elapsed = SFTBenchmarkNow() - start;
+    seeking += elapsed;
+    if (elapsed > slowest) {
+      slowest = elapsed;
+    }
+
+    if (index < kVerifiedSeeks) {
+      SFTCoreEmulatorState linear;
+      SFTReplayBenchmarkStartState(options, &linear, reference);
+      SFTCoreEmulatorProcessIncomingData(&linear, reference, workload->bytes,
+                                         offset);
+      if (SFTReplayBenchmarkScreenHash(&state, cells, screen) !=
+          SFTReplayBenchmarkScreenHash(&linear, reference, screen)) {
+        fprintf(stderr, "Seek to %zu in %s does not match\n", offset,
+                workload->name);
+        matches = false;
+      }
+    }
+  }
+
+  printf("%-24s %12zu %11zu %10.2f %10.2f %10zu %10.2f %10.2f  %s\n",
+         workload->name, workload->length, replay.checkpointsCount,
+         (double)indexing / 1e6, (double)unthrottled / 1e6, delivered,
+         (double)seeking / (double)options->seeks / 1e3,
+         (double)slowest / 1e3, matches ? "OK" : "FAILED");
+
+  SFTCoreReplayClose(&replay);
+  return matches;
+}
+
+/**
+ * Options and buffers shared by every workload.
+ */
+typedef struct {
+  const SFTReplayBenchmarkOptions *options;
+  SFTTerminalEmulatorCell *cells;
+  SFTTerminalEmulatorCell *reference;
+  SFTTerminalEmulatorCell *screen;
+} SFTReplayBenchmarkContext;
+
+static bool SFTReplayBenchmarkRunWorkload(const SFTBenchmarkWorkload *workload,
+                                          void *userData) {
+  const SFTReplayBenchmarkContext *context =
+      (const SFTReplayBenchmarkContext *)userData;
+  return SFTReplayBenchmarkRun(workload, context->options, context->cells,
+                               context->reference, context->screen);
+}
+
+int SFTReplayBenchmarkMain(int argc, char *argv[]) {
+  SFTReplayBenchmarkOptions options = {
+      .width = kDefaultWidth,
+      .height = kDefaultHeight,
+      .interval = SFTCoreReplayDefaultCheckpointInterval,
+      .seeks = kDefaultSeeks};
+  size_t syntheticSize = kDefaultSyntheticSize;
+
+  int option;
+  while ((option = getopt(argc, argv, "n:k:s:w:h:")) != -1) {
+    switch (option) {
+    case 'n':
+      options.seeks = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'k':
+      options.interval = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 's':
+      syntheticSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'w':
+      options.width = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'h':
+      options.height = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    default:
+      SFTReplayBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  SFTCoreEmulatorState probe;
+  if ((options.seeks == 0) || (options.interval == 0) ||
+      !SFTCoreEmulatorStateInitialise(&probe, options.width, options.height, 0,
+                                      0, false, false)) {
+    SFTReplayBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  size_t screenSize = options.width * options.height;
+  SFTTerminalEmulatorCell *cells = (SFTTerminalEmulatorCell *)calloc(
+      screenSize, sizeof(SFTTerminalEmulatorCell));
+  SFTTerminalEmulatorCell *reference = (SFTTerminalEmulatorCell *)calloc(
+      screenSize, sizeof(SFTTerminalEmulatorCell));
+  SFTTerminalEmulatorCell *screen = (SFTTerminalEmulatorCell *)calloc(
+      screenSize, sizeof(SFTTerminalEmulatorCell));
+  if ((cells == NULL) || (reference == NULL) || (screen == NULL)) {
+    fprintf(stderr, "Cannot allocate cell buffer\n");
+    free(cells);
+    free(reference);
+    free(screen);
+    return EXIT_FAILURE;
+  }
+
+  printf("%-24s %12s %11s %10s %10s %10s %10s %10s  %s\n", "workload", "bytes",
+         "checkpoints", "index ms", "full ms", "B@2400/s", "seek us",
+         "seek max", "result");
+
+  SFTReplayBenchmarkContext context = {.options = &options,
+                                       .cells = cells,
+                                       .reference = reference,
+                                       .screen = screen};
+  int result = SFTBenchmarkRunWorkloads(argc, argv, optind, syntheticSize,
+                                        SFTReplayBenchmarkRunWorkload,
+                                        &context);
+
+  free(screen);
+  free(reference);
+  free(cells);
+  return result;
+}
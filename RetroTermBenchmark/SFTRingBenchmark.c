@@ -0,0 +1,253 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Pushes data through the lock-free ring that carries incoming bytes from the
+ * network thread to the emulator, with a producer and a consumer thread running
+ * at once.  The run fails if any byte arrives out of order, or if a producer
+ * suspended on a full ring is never woken up.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreByteRing.h"
+
+static const uint64_t kDefaultTotalBytes = 1ULL * 1024 * 1024 * 1024;
+static const size_t kDefaultRingCapacity = 256 * 1024;
+static const size_t kDefaultMaximumChunk = 4096;
+
+typedef struct {
+  SFTCoreByteRing ring;
+  uint64_t totalBytes;
+  size_t maximumChunk;
+
+  pthread_mutex_t wakeLock;
+  pthread_cond_t wakeCondition;
+  bool wakeSignalled;
+
+  uint64_t suspensions;
+  uint64_t stalls;
+  uint64_t mismatchOffset;
+  bool mismatch;
+} SFTRingBenchmarkContext;
+
+/**
+ * Expected byte at the given stream offset, cheap to compute but not
+ * periodic over any power of two short enough to hide ordering errors.
+ */
+static inline uint8_t SFTRingBenchmarkExpectedByte(uint64_t offset) {
+  return (uint8_t)(offset ^ (offset >> 8) ^ (offset >> 19) ^ (offset >> 31));
+}
+
+static void SFTRingBenchmarkWaitForWake(SFTRingBenchmarkContext *context) {
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += 1;
+
+  pthread_mutex_lock(&context->wakeLock);
+  while (!context->wakeSignalled) {
+    if (pthread_cond_timedwait(&context->wakeCondition, &context->wakeLock,
+                               &deadline) == ETIMEDOUT) {
+      // Nobody woke us up within a second: the resume hand-off was lost.
+      context->stalls++;
+      break;
+    }
+  }
+  context->wakeSignalled = false;
+  pthread_mutex_unlock(&context->wakeLock);
+}
+
+static void *SFTRingBenchmarkProducer(void *argument) {
+  SFTRingBenchmarkContext *context = (SFTRingBenchmarkContext *)argument;
+  uint64_t random = 0x9E3779B97F4A7C15ULL;
+  uint64_t offset = 0;
+
+  while (offset < context->totalBytes) {
+    uint8_t *span;
+    size_t length = SFTCoreByteRingWritableSpan(&context->ring, &span);
+    if (length == 0) {
+      if (SFTCoreByteRingSuspendProducer(&context->ring)) {
+        context->suspensions++;
+        SFTRingBenchmarkWaitForWake(context);
+      }
+      continue;
+    }
+
+    size_t chunk =
+        (size_t)(SFTBenchmarkRandom(&random) % context->maximumChunk) + 1;
+    if (chunk > length) {
+      chunk = length;
+    }
+    if (chunk > context->totalBytes - offset) {
+      chunk = (size_t)(context->totalBytes - offset);
+    }
+
+    for (size_t index = 0; index < chunk; index++) {
+      span[index] = SFTRingBenchmarkExpectedByte(offset + index);
+    }
+    SFTCoreByteRingCommitWrite(&context->ring, chunk);
+    offset += chunk;
+  }
+
+  return NULL;
+}
+
+static void SFTRingBenchmarkConsume(SFTRingBenchmarkContext *context) {
+  uint64_t random = 0xD1B54A32D192ED03ULL;
+  uint64_t offset = 0;
+
+  while (offset < context->totalBytes) {
+    const uint8_t *span;
+    size_t length = SFTCoreByteRingReadableSpan(&context->ring, &span);
+    if (length == 0) {
+      // Let the producer run when both threads share a single core.
+      sched_yield();
+      continue;
+    }
+
+    size_t chunk =
+        (size_t)(SFTBenchmarkRandom(&random) % context->maximumChunk) + 1;
+    if (chunk > length) {
+      chunk = length;
+    }
+
+    if (!context->mismatch) {
+      for (size_t index = 0; index < chunk; index++) {
+        if (span[index] != SFTRingBenchmarkExpectedByte(offset + index)) {
+          context->mismatch = true;
+          context->mismatchOffset = offset + index;
+          break;
+        }
+      }
+    }
+
+    SFTCoreByteRingCommitRead(&context->ring, chunk);
+    offset += chunk;
+
+    if (SFTCoreByteRingResumeProducer(&context->ring)) {
+      pthread_mutex_lock(&context->wakeLock);
+      context->wakeSignalled = true;
+      pthread_cond_signal(&context->wakeCondition);
+      pthread_mutex_unlock(&context->wakeLock);
+    }
+  }
+}
+
+static void SFTRingBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s ring [-b bytes] [-r ring capacity] [-c maximum chunk]\n"
+          "\n"
+          "Pushes bytes through the single producer, single consumer ring "
+          "as fast as\npossible from two threads, checking ordering and byte "
+          "counts on the way out.\n",
+          name);
+}
+
+int SFTRingBenchmarkMain(int argc, char *argv[]) {
+  uint64_t totalBytes = kDefaultTotalBytes;
+  size_t capacity = kDefaultRingCapacity;
+  size_t maximumChunk = kDefaultMaximumChunk;
+
+  int option;
+  while ((option = getopt(argc, argv, "b:r:c:")) != -1) {
+    switch (option) {
+    case 'b':
+      totalBytes = (uint64_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'r':
+      capacity = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'c':
+      maximumChunk = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    default:
+      SFTRingBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if ((totalBytes == 0) || (capacity == 0) || (maximumChunk == 0)) {
+    SFTRingBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  SFTRingBenchmarkContext context;
+  memset(&context, 0, sizeof(context));
+  context.totalBytes = totalBytes;
+  context.maximumChunk = maximumChunk;
+  pthread_mutex_init(&context.wakeLock, NULL);
+  pthread_cond_init(&context.wakeCondition, NULL);
+
+  if (!SFTCoreByteRingInitialise(&context.ring, capacity)) {
+    fprintf(stderr, "Cannot allocate ring buffer\n");
+    return EXIT_FAILURE;
+  }
+
+  uint64_t start = SFTBenchmarkNow();
+
+  pthread_t producer;
+  if (pthread_create(&producer, NULL, SFTRingBenchmarkProducer, &context) !=
+      0) {
+    fprintf(stderr, "Cannot start producer thread\n");
+    SFTCoreByteRingRelease(&context.ring);
+    return EXIT_FAILURE;
+  }
+  SFTRingBenchmarkConsume(&context);
+  pthread_join(producer, NULL);
+
+  uint64_t elapsed = SFTBenchmarkNow() - start;
+  size_t leftover = SFTCoreByteRingAvailable(&context.ring);
+
+  printf("%-12s %16s %10s %12s %8s  %s\n", "capacity", "bytes", "GB/s",
+         "suspensions", "stalls", "result");
+  bool failed = context.mismatch || (context.stalls > 0) || (leftover != 0);
+  printf("%-12zu %16llu %10.3f %12llu %8llu  %s\n", context.ring.capacity,
+         (unsigned long long)totalBytes,
+         (double)totalBytes / (double)elapsed,
+         (unsigned long long)context.suspensions,
+         (unsigned long long)context.stalls, failed ? "FAILED" : "OK");
+
+  if (context.mismatch) {
+    fprintf(stderr, "Unexpected byte at offset %llu\n",
+            (unsigned long long)context.mismatchOffset);
+  }
+  if (leftover != 0) {
+    fprintf(stderr, "%zu bytes left in the ring\n", leftover);
+  }
+
+  SFTCoreByteRingRelease(&context.ring);
+  pthread_cond_destroy(&context.wakeCondition);
+  pthread_mutex_destroy(&context.wakeLock);
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,340 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Pushes 100,000 rows scrolled off the screen into a scrollback history,
+ * reporting the memory it takes and how long single rows and whole screens take
+ * to read back.  Every row kept is checked against an uncompressed copy.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreEmulator.h"
+#include "SFTCoreScrollback.h"
+
+static const size_t kDefaultLines = 100 * 1000;
+static const size_t kDefaultHotRows = 1024;
+static const size_t kDefaultMemoryCap = 64 * 1024 * 1024;
+static const size_t kDefaultSyntheticSize = 1024 * 1024;
+static const size_t kDefaultWidth = 40;
+static const size_t kDefaultHeight = 25;
+
+/**
+ * Bytes parsed at a time while collecting history rows, so that no more
+ * rows than needed are scrolled off the screen.
+ */
+static const size_t kCollectChunkSize = 256;
+
+/**
+ * Amount of random history lines and viewports read back.
+ */
+static const size_t kRandomReads = 1000 * 1000;
+static const size_t kRandomViewports = 10 * 1000;
+
+typedef struct {
+  size_t lines;
+  size_t hotRows;
+  size_t memoryCap;
+  size_t width;
+  size_t height;
+} SFTScrollbackBenchmarkOptions;
+
+static void SFTScrollbackBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s scrollback [-n lines] [-r hot rows] [-m memory cap] "
+          "[-s synthetic bytes] [-w width] [-h height] [capture ...]\n"
+          "\n"
+          "Collects history rows by parsing each raw capture over and over, "
+          "then pushes\nthem into a scrollback history, reporting memory "
+          "used and access times, and\nchecking every retained row and some "
+          "viewports against an uncompressed copy.\nSynthetic workloads "
+          "are used when no capture is given.\n",
+          name);
+}
+
+/**
+ * Parses the workload until the given amount of rows scrolled off the
+ * screen, collecting them uncompressed.
+ *
+ * @return true if enough rows were collected, false otherwise.
+ */
+static bool
+SFTScrollbackBenchmarkCollect(const SFTBenchmarkWorkload *workload,
+                              const SFTScrollbackBenchmarkOptions *options,
+                              SFTCoreScrollback *collected,
+                              SFTCoreEmulatorState *state,
+                              SFTTerminalEmulatorCell *cells) {
+  SFTCoreEmulatorStateInitialise(state, options->width, options->height, 0,
+                                 14, true, false);
+  SFTCoreEmulatorClearScreen(state, cells);
+  state->scrollback = collected;
+
+  while (collected->pushed < options->lines) {
+    uint64_t before = collected->pushed;
+    for (size_t offset = 0; (offset < workload->length) &&
+                            (collected->pushed < options->lines);
+         offset += kCollectChunkSize) {
+      size_t length = workload->length - offset;
+      SFTCoreEmulatorProcessIncomingData(
+          state, cells, workload->bytes + offset,
+          (length < kCollectChunkSize) ? length : kCollectChunkSize);
+    }
+
+    if (collected->pushed == before) {
+      return false;
+    }
+  }
+
+  state->scrollback = NULL;
+  return true;
+}
+
+static bool SFTScrollbackBenchmarkRun(
+    const SFTBenchmarkWorkload *workload,
+    const SFTScrollbackBenchmarkOptions *options, SFTCoreScrollback *collected,
+    SFTTerminalEmulatorCell *cells, SFTTerminalEmulatorCell *line,
+    SFTTerminalEmulatorCell *viewport) {
+  SFTCoreEmulatorState state;
+  SFTCoreScrollbackClear(collected);
+  collected->pushed = 0;
+  if (!SFTScrollbackBenchmarkCollect(workload, options, collected, &state,
+                                     cells)) {
+    printf("%-24s %10s\n", workload->name, "no scrolling");
+    return true;
+  }
+
+  size_t rowSize = options->width * sizeof(SFTTerminalEmulatorCell);
+  const SFTTerminalEmulatorCell *rows = collected->hot;
+
+  SFTCoreScrollback scrollback;
+  if (!SFTCoreScrollbackInitialise(&scrollback, options->width,
+                                   options->hotRows, options->memoryCap)) {
+    fprintf(stderr, "Cannot allocate scrollback\n");
+    return false;
+  }
+
+  uint64_t start = SFTBenchmarkNow();
+  for (size_t index = 0; index < options->lines; index++) {
+    SFTCoreScrollbackPush(&scrollback, rows + (index * options->width));
+  }
+  uint64_t pushTime = SFTBenchmarkNow() - start;
+
+  size_t retained = SFTCoreScrollbackCount(&scrollback);
+  size_t memoryUsed = SFTCoreScrollbackMemoryUsed(&scrollback);
+  bool succeeded = (scrollback.dropped + retained == options->lines) &&
+                   (memoryUsed <= options->memoryCap);
+  if (!succeeded) {
+    fprintf(stderr, "%s: %zu rows kept in %zu bytes\n", workload->name,
+            retained, memoryUsed);
+  }
+
+  // Only the oldest rows may have been dropped.
+  for (size_t index = 0; succeeded && (index < retained); index++) {
+    succeeded =
+        SFTCoreScrollbackCopyLine(&scrollback, index, line) &&
+        (memcmp(line, rows + ((scrollback.dropped + index) * options->width),
+                rowSize) == 0);
+    if (!succeeded) {
+      fprintf(stderr, "%s: history row %zu is corrupted\n", workload->name,
+              index);
+    }
+  }
+
+  uint64_t seed = 0x9E3779B97F4A7C15ULL;
+  uint64_t hash = 0;
+  start = SFTBenchmarkNow();
+  for (size_t index = 0; index < kRandomReads; index++) {
+    size_t target = (size_t)(SFTBenchmarkRandom(&seed) % retained);
+    SFTCoreScrollbackCopyLine(&scrollback, target, line);
+    hash ^= line[target % options->width];
+  }
+  uint64_t readTime = SFTBenchmarkNow() - start;
+
+  start = SFTBenchmarkNow();
+  for (size_t index = 0; index < kRandomViewports; index++) {
+    size_t target = (size_t)(SFTBenchmarkRandom(&seed) %
+                             (retained + options->height));
+    SFTCoreScrollbackCopyViewport(&scrollback, &state, cells, target,
+                                  viewport);
+    hash ^= viewport[target % options->width];
+  }
+  uint64_t viewportTime = SFTBenchmarkNow() - start;
+
+  // The bottommost viewport straddles history and screen.
+  size_t top = (retained > options->height / 2)
+                   ? retained - options->height / 2
+                   : 0;
+  top = SFTCoreScrollbackCopyViewport(&scrollback, &state, cells, top,
+                                      viewport);
+  for (size_t row = 0; succeeded && (row < options->height); row++) {
+    size_t target = top + row;
+    const SFTTerminalEmulatorCell *expected =
+        (target < retained)
+            ? rows + ((scrollback.dropped + target) * options->width)
+            : cells + (options->width *
+                       SFTCoreEmulatorPhysicalRow(&state, target - retained));
+    succeeded = memcmp(viewport + (row * options->width), expected,
+                       rowSize) == 0;
+    if (!succeeded) {
+      fprintf(stderr, "%s: viewport row %zu is corrupted\n", workload->name,
+              row);
+    }
+  }
+
+  double rawSize = (double)retained * (double)rowSize;
+  printf("%-24s %9zu %9zu %10.2f %9.2f %9.2f %8.2f %9.2f %8.2f  %s\n",
+         workload->name, options->lines, retained,
+         (double)memoryUsed / (1024.0 * 1024.0),
+         (double)memoryUsed / (double)retained, rawSize / (double)memoryUsed,
+         (double)pushTime / (double)options->lines,
+         (double)readTime / (double)kRandomReads,
+         (double)viewportTime / (1000.0 * (double)kRandomViewports),
+         succeeded ? "OK" : "FAILED");
+
+  if (hash == UINT64_MAX) {
+    printf("%llx\n", (unsigned long long)hash);
+  }
+
+  SFTCoreScrollbackRelease(&scrollback);
+  return succeeded;
+}
+
+/**
+ * Options and buffers shared by every workload.
+ */
+typedef struct {
+  const SFTScrollbackBenchmarkOptions *options;
+  SFTCoreScrollback *collected;
+  SFTTerminalEmulatorCell *cells;
+  SFTTerminalEmulatorCell *line;
+  SFTTerminalEmulatorCell *viewport;
+} SFTScrollbackBenchmarkContext;
+
+static bool
+SFTScrollbackBenchmarkRunWorkload(const SFTBenchmarkWorkload *workload,
+                                  void *userData) {
+  const SFTScrollbackBenchmarkContext *context =
+      (const SFTScrollbackBenchmarkContext *)userData;
+  return SFTScrollbackBenchmarkRun(workload, context->options,
+                                   context->collected, context->cells,
+                                   context->line, context->viewport);
+}
+
+int SFTScrollbackBenchmarkMain(int argc, char *argv[]) {
+  SFTScrollbackBenchmarkOptions options = {.lines = kDefaultLines,
+                                           .hotRows = kDefaultHotRows,
+                                           .memoryCap = kDefaultMemoryCap,
+                                           .width = kDefaultWidth,
+                                           .height = kDefaultHeight};
+  size_t syntheticSize = kDefaultSyntheticSize;
+
+  int option;
+  while ((option = getopt(argc, argv, "n:r:m:s:w:h:")) != -1) {
+    switch (option) {
+    case 'n':
+      options.lines = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'r':
+      options.hotRows = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'm':
+      options.memoryCap = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 's':
+      syntheticSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'w':
+      options.width = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'h':
+      options.height = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    default:
+      SFTScrollbackBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  SFTCoreEmulatorState probe;
+  if ((options.lines == 0) || (syntheticSize == 0) ||
+      !SFTCoreEmulatorStateInitialise(&probe, options.width, options.height, 0,
+                                      0, false, false)) {
+    SFTScrollbackBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // Rows are collected uncompressed, with room for a whole chunk of
+  // newlines past the requested amount.
+  SFTCoreScrollback collected;
+  if (!SFTCoreScrollbackInitialise(&collected, options.width,
+                                   options.lines + kCollectChunkSize,
+                                   SIZE_MAX)) {
+    fprintf(stderr, "Cannot allocate history rows\n");
+    return EXIT_FAILURE;
+  }
+
+  size_t screenSize = options.width * options.height;
+  SFTTerminalEmulatorCell *cells = (SFTTerminalEmulatorCell *)calloc(
+      screenSize, sizeof(SFTTerminalEmulatorCell));
+  SFTTerminalEmulatorCell *viewport = (SFTTerminalEmulatorCell *)calloc(
+      screenSize, sizeof(SFTTerminalEmulatorCell));
+  SFTTerminalEmulatorCell *line = (SFTTerminalEmulatorCell *)calloc(
+      options.width, sizeof(SFTTerminalEmulatorCell));
+  if ((cells == NULL) || (viewport == NULL) || (line == NULL)) {
+    fprintf(stderr, "Cannot allocate cell buffer\n");
+    free(cells);
+    free(viewport);
+    free(line);
+    SFTCoreScrollbackRelease(&collected);
+    return EXIT_FAILURE;
+  }
+
+  printf("%-24s %9s %9s %10s %9s %9s %8s %9s %8s  %s\n", "workload", "lines",
+         "kept", "memory MB", "B/line", "ratio", "push ns", "line ns",
+         "view us", "result");
+
+  SFTScrollbackBenchmarkContext context = {.options = &options,
+                                           .collected = &collected,
+                                           .cells = cells,
+                                           .line = line,
+                                           .viewport = viewport};
+  int result = SFTBenchmarkRunWorkloads(argc, argv, optind, syntheticSize,
+                                        SFTScrollbackBenchmarkRunWorkload,
+                                        &context);
+
+  free(line);
+  free(viewport);
+  free(cells);
+  SFTCoreScrollbackRelease(&collected);
+  return result;
+}
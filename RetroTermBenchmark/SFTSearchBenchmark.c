@@ -0,0 +1,391 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Indexes a scrollback history as rows scroll off the screen, then looks up
+ * strings taken from random rows with their case flipped.  Each string must be
+ * found where it was taken from, and the index must find as much as a full scan
+ * does.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreEmulator.h"
+#include "SFTCoreScrollback.h"
+#include "SFTCoreSearch.h"
+
+static const size_t kDefaultLines = 100 * 1000;
+static const size_t kDefaultQueries = 1000;
+static const size_t kDefaultQueryLength = 8;
+static const size_t kDefaultMemoryCap = 64 * 1024 * 1024;
+static const size_t kDefaultSyntheticSize = 1024 * 1024;
+static const size_t kDefaultWidth = 40;
+
+/**
+ * Recent history rows kept uncompressed, as in the application.
+ */
+static const size_t kHotRows = 1024;
+static const size_t kDefaultHeight = 25;
+
+/**
+ * Bytes parsed at a time while collecting history rows, so that no more
+ * rows than needed are scrolled off the screen.
+ */
+static const size_t kCollectChunkSize = 256;
+
+/**
+ * Amount of queries whose hits are checked against a full scan.
+ */
+static const size_t kVerifiedQueries = 32;
+
+static const size_t kMaximumHits = 65536;
+
+typedef struct {
+  size_t lines;
+  size_t queries;
+  size_t queryLength;
+  size_t memoryCap;
+  size_t width;
+  size_t height;
+} SFTSearchBenchmarkOptions;
+
+static void SFTSearchBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s search [-n lines] [-q queries] [-l query length] "
+          "[-m memory cap] [-s synthetic bytes] [-w width] [-h height] "
+          "[capture ...]\n"
+          "\n"
+          "Builds a scrollback history by parsing each raw capture over "
+          "and over, then\nindexes it again to time the index alone, and "
+          "looks up strings taken from random\nrows with their case "
+          "flipped, checking that each is found where it was taken\nfrom "
+          "and that some queries find as much as a full scan.  Synthetic "
+          "workloads\nare used when no capture is given.\n",
+          name);
+}
+
+/**
+ * Parses the workload until the given amount of rows scrolled off the
+ * screen, collecting them uncompressed.
+ *
+ * @return true if enough rows were collected, false otherwise.
+ */
+static bool SFTSearchBenchmarkCollect(const SFTBenchmarkWorkload *workload,
+                                      const SFTSearchBenchmarkOptions *options,
+                                      SFTCoreScrollback *collected,
+                                      SFTCoreEmulatorState *state,
+                                      SFTTerminalEmulatorCell *cells) {
+  SFTCoreEmulatorStateInitialise(state, options->width, options->height, 0,
+                                 14, true, false);
+  SFTCoreEmulatorClearScreen(state, cells);
+  state->scrollback = collected;
+
+  while (collected->pushed < options->lines) {
+    uint64_t before = collected->pushed;
+    for (size_t offset = 0; (offset < workload->length) &&
+                            (collected->pushed < options->lines);
+         offset += kCollectChunkSize) {
+      size_t length = workload->length - offset;
+      SFTCoreEmulatorProcessIncomingData(
+          state, cells, workload->bytes + offset,
+          (length < kCollectChunkSize) ? length : kCollectChunkSize);
+    }
+
+    if (collected->pushed == before) {
+      return false;
+    }
+  }
+
+  state->scrollback = NULL;
+  return true;
+}
+
+/**
+ * Pushes the collected rows into a history, with or without an index.
+ *
+ * @return the time taken, in nanoseconds.
+ */
+static uint64_t SFTSearchBenchmarkPush(const SFTTerminalEmulatorCell *rows,
+                                       const SFTSearchBenchmarkOptions *options,
+                                       SFTCoreScrollback *scrollback,
+                                       SFTCoreSearchIndex *index) {
+  SFTCoreScrollbackInitialise(scrollback, options->width, kHotRows,
+                              options->memoryCap);
+  scrollback->searchIndex = index;
+
+  uint64_t start = SFTBenchmarkNow();
+  for (size_t line = 0; line < options->lines; line++) {
+    SFTCoreScrollbackPush(scrollback, rows + (line * options->width));
+  }
+  return SFTBenchmarkNow() - start;
+}
+
+/**
+ * Picks a query from a random history row, flipping the case of its
+ * letters, and skipping rows where it would be all blank.
+ */
+static void SFTSearchBenchmarkQuery(const SFTCoreScrollback *scrollback,
+                                    const SFTSearchBenchmarkOptions *options,
+                                    uint64_t *seed,
+                                    SFTTerminalEmulatorCell *row,
+                                    uint8_t *query, size_t *line,
+                                    size_t *column) {
+  bool blank = true;
+  while (blank) {
+    *line = (size_t)(SFTBenchmarkRandom(seed) %
+                     SFTCoreScrollbackCount(scrollback));
+    *column = (size_t)(SFTBenchmarkRandom(seed) %
+                       (options->width - options->queryLength + 1));
+    SFTCoreScrollbackCopyLine(scrollback, *line, row);
+
+    for (size_t index = 0; index < options->queryLength; index++) {
+      uint8_t glyph = SFTCoreSearchCanonicalGlyph(
+          SFTTerminalEmulatorCellGetCharacter(row[*column + index]));
+      if ((glyph >= 0x01) && (glyph <= 0x1A) &&
+          ((SFTBenchmarkRandom(seed) & 1) != 0)) {
+        glyph += 0x40;
+      }
+      query[index] = glyph;
+      blank = blank && (glyph == 0x20);
+    }
+  }
+}
+
+static bool SFTSearchBenchmarkRun(const SFTBenchmarkWorkload *workload,
+                                  const SFTSearchBenchmarkOptions *options,
+                                  SFTCoreScrollback *collected,
+                                  SFTTerminalEmulatorCell *cells,
+                                  SFTTerminalEmulatorCell *row,
+                                  uint8_t *query, SFTCoreSearchHit *hits) {
+  SFTCoreEmulatorState state;
+  SFTCoreScrollbackClear(collected);
+  collected->pushed = 0;
+  if (!SFTSearchBenchmarkCollect(workload, options, collected, &state,
+                                 cells)) {
+    printf("%-24s %10s\n", workload->name, "no scrolling");
+    return true;
+  }
+
+  SFTCoreScrollback scrollback;
+  uint64_t plainTime =
+      SFTSearchBenchmarkPush(collected->hot, options, &scrollback, NULL);
+  SFTCoreScrollbackRelease(&scrollback);
+
+  SFTCoreSearchIndex index;
+  if (!SFTCoreSearchIndexInitialise(&index)) {
+    fprintf(stderr, "Cannot allocate search index\n");
+    return false;
+  }
+  uint64_t indexedTime =
+      SFTSearchBenchmarkPush(collected->hot, options, &scrollback, &index);
+  size_t retained = SFTCoreScrollbackCount(&scrollback);
+
+  uint64_t seed = 0x9E3779B97F4A7C15ULL;
+  uint64_t queryTime = 0;
+  uint64_t scanTime = 0;
+  size_t totalHits = 0;
+  bool succeeded = true;
+  for (size_t count = 0; succeeded && (count < options->queries); count++) {
+    size_t line;
+    size_t column;
+    SFTSearchBenchmarkQuery(&scrollback, options, &seed, row, query, &line,
+                            &column);
+
+    uint64_t start = SFTBenchmarkNow();
+    size_t found =
+        SFTCoreSearchFind(&scrollback, &state, cells, query,
+                          options->queryLength, hits, kMaximumHits);
+    queryTime += SFTBenchmarkNow() - start;
+    totalHits += found;
+
+    bool present = false;
+    for (size_t hit = 0; !present && (hit < found); hit++) {
+      present = (hits[hit].line == line) && (hits[hit].column == column);
+    }
+    if (!present) {
+      fprintf(stderr, "%s: query %zu not found at %zu:%zu\n", workload->name,
+              count, line, column);
+      succeeded = false;
+    }
+
+    if (count < kVerifiedQueries) {
+      scrollback.searchIndex = NULL;
+      start = SFTBenchmarkNow();
+      size_t scanned =
+          SFTCoreSearchFind(&scrollback, &state, cells, query,
+                            options->queryLength, hits, kMaximumHits);
+      scanTime += SFTBenchmarkNow() - start;
+      scrollback.searchIndex = &index;
+
+      if (scanned != found) {
+        fprintf(stderr, "%s: query %zu found %zu times, scan found %zu\n",
+                workload->name, count, found, scanned);
+        succeeded = false;
+      }
+    }
+  }
+
+  size_t indexSize = SFTCoreSearchIndexMemoryUsed(&index);
+  size_t verified = (options->queries < kVerifiedQueries) ? options->queries
+                                                          : kVerifiedQueries;
+  printf("%-24s %9zu %9.2f %8.2f %9.2f %9.2f %9.2f %8.2f  %s\n",
+         workload->name, retained, (double)indexSize / (1024.0 * 1024.0),
+         (double)indexSize / (double)retained,
+         ((double)indexedTime - (double)plainTime) / (double)options->lines,
+         (double)queryTime / (1000.0 * (double)options->queries),
+         (double)scanTime / (1000.0 * (double)verified),
+         (double)totalHits / (double)options->queries,
+         succeeded ? "OK" : "FAILED");
+
+  SFTCoreScrollbackRelease(&scrollback);
+  SFTCoreSearchIndexRelease(&index);
+  return succeeded;
+}
+
+/**
+ * Options and buffers shared by every workload.
+ */
+typedef struct {
+  const SFTSearchBenchmarkOptions *options;
+  SFTCoreScrollback *collected;
+  SFTTerminalEmulatorCell *cells;
+  SFTTerminalEmulatorCell *row;
+  uint8_t *query;
+  SFTCoreSearchHit *hits;
+} SFTSearchBenchmarkContext;
+
+static bool SFTSearchBenchmarkRunWorkload(const SFTBenchmarkWorkload *workload,
+                                          void *userData) {
+  const SFTSearchBenchmarkContext *context =
+      (const SFTSearchBenchmarkContext *)userData;
+  return SFTSearchBenchmarkRun(workload, context->options, context->collected,
+                               context->cells, context->row, context->query,
+                               context->hits);
+}
+
+int SFTSearchBenchmarkMain(int argc, char *argv[]) {
+  SFTSearchBenchmarkOptions options = {.lines = kDefaultLines,
+                                       .queries = kDefaultQueries,
+                                       .queryLength = kDefaultQueryLength,
+                                       .memoryCap = kDefaultMemoryCap,
+                                       .width = kDefaultWidth,
+                                       .height = kDefaultHeight};
+  size_t syntheticSize = kDefaultSyntheticSize;
+
+  int option;
+  while ((option = getopt(argc, argv, "n:q:l:m:s:w:h:")) != -1) {
+    switch (option) {
+    case 'n':
+      options.lines = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'q':
+      options.queries = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'l':
+      options.queryLength = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'm':
+      options.memoryCap = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 's':
+      syntheticSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'w':
+      options.width = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'h':
+      options.height = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    default:
+      SFTSearchBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  SFTCoreEmulatorState probe;
+  if ((options.lines == 0) || (options.queries == 0) ||
+      (options.queryLength == 0) || (options.queryLength > options.width) ||
+      (syntheticSize == 0) ||
+      !SFTCoreEmulatorStateInitialise(&probe, options.width, options.height, 0,
+                                      0, false, false)) {
+    SFTSearchBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  SFTCoreScrollback collected;
+  if (!SFTCoreScrollbackInitialise(&collected, options.width,
+                                   options.lines + kCollectChunkSize,
+                                   SIZE_MAX)) {
+    fprintf(stderr, "Cannot allocate history rows\n");
+    return EXIT_FAILURE;
+  }
+
+  SFTTerminalEmulatorCell *cells = (SFTTerminalEmulatorCell *)calloc(
+      options.width * options.height, sizeof(SFTTerminalEmulatorCell));
+  SFTTerminalEmulatorCell *row = (SFTTerminalEmulatorCell *)calloc(
+      options.width, sizeof(SFTTerminalEmulatorCell));
+  uint8_t *query = (uint8_t *)calloc(options.queryLength, sizeof(uint8_t));
+  SFTCoreSearchHit *hits =
+      (SFTCoreSearchHit *)calloc(kMaximumHits, sizeof(SFTCoreSearchHit));
+  if ((cells == NULL) || (row == NULL) || (query == NULL) || (hits == NULL)) {
+    fprintf(stderr, "Cannot allocate buffers\n");
+    free(cells);
+    free(row);
+    free(query);
+    free(hits);
+    SFTCoreScrollbackRelease(&collected);
+    return EXIT_FAILURE;
+  }
+
+  printf("%-24s %9s %9s %8s %9s %9s %9s %8s  %s\n", "workload", "lines",
+         "index MB", "B/line", "index ns", "query us", "scan us", "hits",
+         "result");
+
+  SFTSearchBenchmarkContext context = {.options = &options,
+                                       .collected = &collected,
+                                       .cells = cells,
+                                       .row = row,
+                                       .query = query,
+                                       .hits = hits};
+  int result = SFTBenchmarkRunWorkloads(argc, argv, optind, syntheticSize,
+                                        SFTSearchBenchmarkRunWorkload,
+                                        &context);
+
+  free(hits);
+  free(query);
+  free(row);
+  free(cells);
+  SFTCoreScrollbackRelease(&collected);
+  return result;
+}
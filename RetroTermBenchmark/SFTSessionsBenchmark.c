@@ -0,0 +1,348 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Replays each workload on 1, 2, 4 and more sessions at once, up to one per
+ * processor unless -n says otherwise, each parsing on its own thread with its
+ * own emulator state, scrollback and search index.  The aggregate throughput is
+ * reported against that of a single session, and every session must end up with
+ * the same screen as one replayed on its own.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreEmulator.h"
+#include "SFTCoreScrollback.h"
+#include "SFTCoreSearch.h"
+
+static const size_t kDefaultChunkSize = 512;
+static const size_t kDefaultSyntheticSize = 4 * 1024 * 1024;
+static const size_t kMaximumSessions = 64;
+
+#define SESSION_WIDTH 40
+#define SESSION_HEIGHT 25
+
+static const size_t kWidth = SESSION_WIDTH;
+static const size_t kHeight = SESSION_HEIGHT;
+static const size_t kHotRows = 1024;
+static const size_t kScrollbackMemoryCap = 8 * 1024 * 1024;
+
+/**
+ * A session as the application keeps it: emulator state, private cell
+ * buffer, scrollback history and its search index, sharing nothing with
+ * the other sessions but the read-only workload.  Cells are kept inline so
+ * that sessions are far enough apart in memory not to share cache lines.
+ */
+typedef struct {
+  const SFTBenchmarkWorkload *workload;
+  size_t chunkSize;
+  SFTCoreEmulatorState state;
+  SFTCoreScrollback scrollback;
+  SFTCoreSearchIndex searchIndex;
+  SFTTerminalEmulatorCell cells[SESSION_WIDTH * SESSION_HEIGHT];
+  SFTTerminalEmulatorCell screen[SESSION_WIDTH * SESSION_HEIGHT];
+  uint64_t elapsed;
+  uint64_t checksum;
+  bool initialised;
+} SFTSessionsBenchmarkSession;
+
+static void SFTSessionsBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s sessions [-n sessions] [-c chunk] [-s synthetic bytes] "
+          "[capture ...]\n"
+          "\n"
+          "Replays each capture on 1, 2, 4... sessions at once, each parsing "
+          "on its own\nthread with its own emulator state, up to one session "
+          "per processor unless\n-n says otherwise, reporting how aggregate "
+          "throughput scales. Every session\nmust end up with the same "
+          "screen as a single one. Synthetic workloads are used\nwhen no "
+          "capture is given.\n",
+          name);
+}
+
+static bool
+SFTSessionsBenchmarkInitialise(SFTSessionsBenchmarkSession *session,
+                               const SFTBenchmarkWorkload *workload,
+                               size_t chunkSize) {
+  memset(session, 0, sizeof(SFTSessionsBenchmarkSession));
+  session->workload = workload;
+  session->chunkSize = chunkSize;
+
+  if (!SFTCoreEmulatorStateInitialise(&session->state, kWidth, kHeight, 0, 14,
+                                      true, false)) {
+    return false;
+  }
+  if (!SFTCoreScrollbackInitialise(&session->scrollback, kWidth, kHotRows,
+                                   kScrollbackMemoryCap)) {
+    return false;
+  }
+  if (!SFTCoreSearchIndexInitialise(&session->searchIndex)) {
+    SFTCoreScrollbackRelease(&session->scrollback);
+    return false;
+  }
+  session->scrollback.searchIndex = &session->searchIndex;
+  session->state.scrollback = &session->scrollback;
+  SFTCoreEmulatorClearScreen(&session->state, session->cells);
+  SFTCoreEmulatorClearDirtyRows(&session->state);
+  session->initialised = true;
+  return true;
+}
+
+static void SFTSessionsBenchmarkRelease(SFTSessionsBenchmarkSession *session) {
+  if (!session->initialised) {
+    return;
+  }
+
+  SFTCoreScrollbackRelease(&session->scrollback);
+  SFTCoreSearchIndexRelease(&session->searchIndex);
+  session->initialised = false;
+}
+
+static void *SFTSessionsBenchmarkReplay(void *context) {
+  SFTSessionsBenchmarkSession *session = (SFTSessionsBenchmarkSession *)context;
+  const SFTBenchmarkWorkload *workload = session->workload;
+
+  uint64_t start = SFTBenchmarkNow();
+  for (size_t offset = 0; offset < workload->length;
+       offset += session->chunkSize) {
+    size_t length = workload->length - offset;
+    if (length > session->chunkSize) {
+      length = session->chunkSize;
+    }
+
+    SFTCoreEmulatorProcessIncomingData(&session->state, session->cells,
+                                       workload->bytes + offset, length);
+
+    // Publishing a frame only needs the dirty rows, copied elsewhere.
+    size_t count = 0;
+    for (size_t row = SFTCoreEmulatorNextDirtyRows(&session->state, 0, &count);
+         row < session->state.height;
+         row = SFTCoreEmulatorNextDirtyRows(&session->state, row + count,
+                                            &count)) {
+      memcpy(session->screen + (row * session->state.width),
+             session->cells + (row * session->state.width),
+             count * session->state.width * sizeof(SFTTerminalEmulatorCell));
+    }
+    SFTCoreEmulatorClearDirtyRows(&session->state);
+  }
+  session->elapsed = SFTBenchmarkNow() - start;
+
+  SFTCoreEmulatorCopyContents(&session->state, session->cells,
+                              session->screen);
+  session->checksum =
+      SFTBenchmarkHash(session->screen, sizeof(session->screen), 0);
+  session->checksum = SFTBenchmarkHash(
+      &session->state.row, sizeof(session->state.row), session->checksum);
+  session->checksum =
+      SFTBenchmarkHash(&session->state.column, sizeof(session->state.column),
+                       session->checksum);
+  session->checksum = SFTBenchmarkHash(&session->scrollback.pushed,
+                                       sizeof(session->scrollback.pushed),
+                                       session->checksum);
+  return NULL;
+}
+
+/**
+ * Replays the workload on the given amount of sessions at once.
+ *
+ * @return the wall clock time taken by all sessions, or 0 on failure.
+ */
+static uint64_t
+SFTSessionsBenchmarkRunSessions(const SFTBenchmarkWorkload *workload,
+                                size_t chunkSize,
+                                SFTSessionsBenchmarkSession *sessions,
+                                size_t count, uint64_t expected,
+                                bool *matches) {
+  pthread_t threads[kMaximumSessions];
+  size_t started = 0;
+  uint64_t elapsed = 0;
+
+  *matches = true;
+  for (size_t index = 0; index < count; index++) {
+    if (!SFTSessionsBenchmarkInitialise(&sessions[index], workload,
+                                        chunkSize)) {
+      fprintf(stderr, "Cannot initialise session %zu\n", index);
+      goto release;
+    }
+  }
+
+  uint64_t start = SFTBenchmarkNow();
+  for (; started < count; started++) {
+    if (pthread_create(&threads[started], NULL, SFTSessionsBenchmarkReplay,
+                       &sessions[started]) != 0) {
+      fprintf(stderr, "Cannot start session %zu\n", started);
+      break;
+    }
+  }
+  for (size_t index = 0; index < started; index++) {
+    pthread_join(threads[index], NULL);
+  }
+  elapsed = SFTBenchmarkNow() - start;
+
+  if (started < count) {
+    elapsed = 0;
+    goto release;
+  }
+  for (size_t index = 0; index < count; index++) {
+    if (sessions[index].checksum != expected) {
+      *matches = false;
+    }
+  }
+
+release:
+  for (size_t index = 0; index < count; index++) {
+    SFTSessionsBenchmarkRelease(&sessions[index]);
+  }
+  return elapsed;
+}
+
+static bool SFTSessionsBenchmarkRun(const SFTBenchmarkWorkload *workload,
+                                    size_t chunkSize, size_t maximumSessions,
+                                    size_t processors,
+                                    SFTSessionsBenchmarkSession *sessions) {
+  // The expected screen comes from a session replayed on its own first.
+  if (!SFTSessionsBenchmarkInitialise(&sessions[0], workload, chunkSize)) {
+    fprintf(stderr, "Cannot initialise session\n");
+    return false;
+  }
+  SFTSessionsBenchmarkReplay(&sessions[0]);
+  uint64_t expected = sessions[0].checksum;
+  SFTSessionsBenchmarkRelease(&sessions[0]);
+
+  bool succeeded = true;
+  double single = 0.0;
+  size_t count = 1;
+  while (true) {
+    bool matches;
+    uint64_t elapsed = SFTSessionsBenchmarkRunSessions(
+        workload, chunkSize, sessions, count, expected, &matches);
+    if (elapsed == 0) {
+      return false;
+    }
+
+    double throughput =
+        ((double)workload->length * (double)count * 1000.0) / (double)elapsed;
+    if (count == 1) {
+      single = throughput;
+    }
+    double speedup = throughput / single;
+    size_t parallel = (count < processors) ? count : processors;
+
+    printf("%-24s %8zu %12.2f %12.2f %8.2fx %8.1f%%  %s\n", workload->name,
+           count, throughput, throughput / (double)count, speedup,
+           (speedup * 100.0) / (double)parallel, matches ? "OK" : "FAILED");
+    succeeded = succeeded && matches;
+
+    if (count == maximumSessions) {
+      break;
+    }
+    count = (count * 2 < maximumSessions) ? count * 2 : maximumSessions;
+  }
+
+  return succeeded;
+}
+
+/**
+ * Options and buffers shared by every workload.
+ */
+typedef struct {
+  size_t chunkSize;
+  size_t maximumSessions;
+  size_t processors;
+  SFTSessionsBenchmarkSession *sessions;
+} SFTSessionsBenchmarkContext;
+
+static bool
+SFTSessionsBenchmarkRunWorkload(const SFTBenchmarkWorkload *workload,
+                                void *userData) {
+  const SFTSessionsBenchmarkContext *context =
+      (const SFTSessionsBenchmarkContext *)userData;
+  return SFTSessionsBenchmarkRun(workload, context->chunkSize,
+                                 context->maximumSessions, context->processors,
+                                 context->sessions);
+}
+
+int SFTSessionsBenchmarkMain(int argc, char *argv[]) {
+  size_t chunkSize = kDefaultChunkSize;
+  size_t syntheticSize = kDefaultSyntheticSize;
+  size_t maximumSessions = 0;
+
+  int option;
+  while ((option = getopt(argc, argv, "n:c:s:")) != -1) {
+    switch (option) {
+    case 'n':
+      maximumSessions = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'c':
+      chunkSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 's':
+      syntheticSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    default:
+      SFTSessionsBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t processors = (online > 0) ? (size_t)online : 1;
+  if (maximumSessions == 0) {
+    maximumSessions = processors;
+  }
+  if ((chunkSize == 0) || (maximumSessions > kMaximumSessions)) {
+    SFTSessionsBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  SFTSessionsBenchmarkSession *sessions =
+      (SFTSessionsBenchmarkSession *)calloc(
+          maximumSessions, sizeof(SFTSessionsBenchmarkSession));
+  if (sessions == NULL) {
+    fprintf(stderr, "Cannot allocate sessions\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("Processors: %zu\n\n", processors);
+  printf("%-24s %8s %12s %12s %9s %9s  %s\n", "workload", "sessions",
+         "MB/s total", "MB/s each", "speedup", "scaling", "result");
+
+  SFTSessionsBenchmarkContext context = {.chunkSize = chunkSize,
+                                         .maximumSessions = maximumSessions,
+                                         .processors = processors,
+                                         .sessions = sessions};
+  int result = SFTBenchmarkRunWorkloads(argc, argv, optind, syntheticSize,
+                                        SFTSessionsBenchmarkRunWorkload,
+                                        &context);
+
+  free(sessions);
+  return result;
+}
@@ -0,0 +1,278 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Parses each workload on one thread, publishing a snapshot of the screen after
+ * every chunk, while another thread keeps picking up the latest one and
+ * updating its own copy with just the rows that changed, as the application
+ * does before drawing.  Every snapshot picked up, and the copy, must match a
+ * screen that was actually published.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreEmulator.h"
+#include "SFTCoreSnapshot.h"
+
+static const size_t kDefaultChunkSize = 256;
+static const size_t kDefaultSyntheticSize = 1024 * 1024;
+
+#define SCREEN_WIDTH 40
+#define SCREEN_HEIGHT 25
+
+static const size_t kWidth = SCREEN_WIDTH;
+static const size_t kHeight = SCREEN_HEIGHT;
+
+typedef struct {
+  const SFTBenchmarkWorkload *workload;
+  size_t chunkSize;
+  SFTCoreSnapshotBuffer buffer;
+
+  /**
+   * Hash of the screen published with each sequence number, written by the
+   * parsing thread before the snapshot goes out.
+   */
+  uint64_t *hashes;
+
+  _Atomic uint64_t lastSequence;
+  _Atomic bool finished;
+
+  /**
+   * Parsing thread results.
+   */
+  uint64_t published;
+  uint64_t publishTime;
+
+  /**
+   * Rendering thread results.
+   */
+  uint64_t acquired;
+  uint64_t mismatched;
+  uint64_t rowsUploaded;
+} SFTSnapshotBenchmarkRun;
+
+static void SFTSnapshotBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s snapshot [-c chunk] [-s synthetic bytes] [capture ...]\n"
+          "\n"
+          "Parses each capture %zu bytes at a time on one thread, publishing "
+          "a screen\nsnapshot after every chunk, while another thread picks "
+          "up the latest\nsnapshot and keeps its own copy up to date with "
+          "the rows that changed.\nEvery snapshot picked up must match a "
+          "published screen exactly, as must the\ncopy. Synthetic workloads "
+          "are used when no capture is given.\n",
+          name, kDefaultChunkSize);
+}
+
+static uint64_t SFTSnapshotBenchmarkHash(const SFTTerminalEmulatorCell *cells,
+                                         size_t baseRow, size_t row,
+                                         size_t column, bool useLowerCase) {
+  uint64_t hash = SFTBenchmarkHash(
+      cells, kWidth * kHeight * sizeof(SFTTerminalEmulatorCell), 0);
+  hash = SFTBenchmarkHash(&baseRow, sizeof(baseRow), hash);
+  hash = SFTBenchmarkHash(&row, sizeof(row), hash);
+  hash = SFTBenchmarkHash(&column, sizeof(column), hash);
+  return SFTBenchmarkHash(&useLowerCase, sizeof(useLowerCase), hash);
+}
+
+static void *SFTSnapshotBenchmarkParse(void *context) {
+  SFTSnapshotBenchmarkRun *run = (SFTSnapshotBenchmarkRun *)context;
+  const SFTBenchmarkWorkload *workload = run->workload;
+  SFTTerminalEmulatorCell cells[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+  SFTCoreEmulatorState state;
+  SFTCoreEmulatorStateInitialise(&state, kWidth, kHeight, 0, 14, true, false);
+  SFTCoreEmulatorClearScreen(&state, cells);
+
+  for (size_t offset = 0; offset <= workload->length;
+       offset += run->chunkSize) {
+    size_t length = workload->length - offset;
+    if (length > run->chunkSize) {
+      length = run->chunkSize;
+    }
+    if (length > 0) {
+      SFTCoreEmulatorProcessIncomingData(&state, cells,
+                                         workload->bytes + offset, length);
+    }
+
+    run->hashes[run->buffer.sequence + 1] =
+        SFTSnapshotBenchmarkHash(cells, state.baseRow, state.row,
+                                 state.column, state.useLowerCase);
+    uint64_t start = SFTBenchmarkNow();
+    bool published = SFTCoreSnapshotBufferPublish(&run->buffer, &state, cells);
+    run->publishTime += SFTBenchmarkNow() - start;
+    if (published) {
+      run->published++;
+    }
+  }
+
+  atomic_store(&run->lastSequence, run->buffer.sequence);
+  atomic_store(&run->finished, true);
+  return NULL;
+}
+
+static void *SFTSnapshotBenchmarkRender(void *context) {
+  SFTSnapshotBenchmarkRun *run = (SFTSnapshotBenchmarkRun *)context;
+  SFTTerminalEmulatorCell uploaded[SCREEN_WIDTH * SCREEN_HEIGHT];
+  uint64_t sequence = 0;
+  memset(uploaded, 0, sizeof(uploaded));
+
+  while (true) {
+    bool finished = atomic_load(&run->finished);
+    const SFTCoreSnapshot *snapshot =
+        SFTCoreSnapshotBufferAcquire(&run->buffer);
+
+    if (snapshot->sequence != sequence) {
+      run->acquired++;
+
+      // Only the rows that changed are copied, as they would be uploaded.
+      for (size_t row = 0; row < kHeight; row++) {
+        if (snapshot->rowSequences[row] > sequence) {
+          memcpy(uploaded + (row * kWidth), snapshot->cells + (row * kWidth),
+                 kWidth * sizeof(SFTTerminalEmulatorCell));
+          run->rowsUploaded++;
+        }
+      }
+      sequence = snapshot->sequence;
+
+      uint64_t expected = run->hashes[sequence];
+      if ((SFTSnapshotBenchmarkHash(snapshot->cells, snapshot->baseRow,
+                                    snapshot->row, snapshot->column,
+                                    snapshot->useLowerCase) != expected) ||
+          (SFTSnapshotBenchmarkHash(uploaded, snapshot->baseRow,
+                                    snapshot->row, snapshot->column,
+                                    snapshot->useLowerCase) != expected)) {
+        run->mismatched++;
+      }
+    } else if (finished && (sequence == atomic_load(&run->lastSequence))) {
+      break;
+    } else {
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+static bool
+SFTSnapshotBenchmarkRunWorkload(const SFTBenchmarkWorkload *workload,
+                                void *userData) {
+  size_t chunkSize = *(const size_t *)userData;
+  SFTSnapshotBenchmarkRun run;
+  memset(&run, 0, sizeof(run));
+  run.workload = workload;
+  run.chunkSize = chunkSize;
+  atomic_init(&run.lastSequence, 0);
+  atomic_init(&run.finished, false);
+
+  if (!SFTCoreSnapshotBufferInitialise(&run.buffer, kWidth, kHeight)) {
+    fprintf(stderr, "Cannot allocate snapshots\n");
+    return false;
+  }
+  run.hashes = (uint64_t *)calloc((workload->length / chunkSize) + 3,
+                                  sizeof(uint64_t));
+  if (run.hashes == NULL) {
+    fprintf(stderr, "Cannot allocate screen hashes\n");
+    SFTCoreSnapshotBufferRelease(&run.buffer);
+    return false;
+  }
+
+  // Snapshots start as a blank screen, sequence 0.
+  SFTTerminalEmulatorCell blank[SCREEN_WIDTH * SCREEN_HEIGHT];
+  memset(blank, 0, sizeof(blank));
+  run.hashes[0] = SFTSnapshotBenchmarkHash(blank, 0, 0, 0, false);
+
+  pthread_t parser;
+  pthread_t renderer;
+  uint64_t start = SFTBenchmarkNow();
+  if (pthread_create(&renderer, NULL, SFTSnapshotBenchmarkRender, &run) != 0) {
+    fprintf(stderr, "Cannot start rendering thread\n");
+    free(run.hashes);
+    SFTCoreSnapshotBufferRelease(&run.buffer);
+    return false;
+  }
+  if (pthread_create(&parser, NULL, SFTSnapshotBenchmarkParse, &run) != 0) {
+    fprintf(stderr, "Cannot start parsing thread\n");
+    exit(EXIT_FAILURE);
+  }
+  pthread_join(parser, NULL);
+  pthread_join(renderer, NULL);
+  uint64_t elapsed = SFTBenchmarkNow() - start;
+
+  bool succeeded = (run.mismatched == 0) && (run.acquired > 0);
+  printf("%-24s %10llu %10llu %10llu %12.3f %12.2f %10.2f  %s\n",
+         workload->name, (unsigned long long)run.published,
+         (unsigned long long)run.acquired,
+         (unsigned long long)(run.published - run.acquired),
+         run.published > 0
+             ? ((double)run.publishTime / 1000.0) / (double)run.published
+             : 0.0,
+         run.acquired > 0 ? (double)run.rowsUploaded / (double)run.acquired
+                          : 0.0,
+         ((double)workload->length * 1000.0) / (double)elapsed,
+         succeeded ? "OK" : "FAILED");
+
+  free(run.hashes);
+  SFTCoreSnapshotBufferRelease(&run.buffer);
+  return succeeded;
+}
+
+int SFTSnapshotBenchmarkMain(int argc, char *argv[]) {
+  size_t chunkSize = kDefaultChunkSize;
+  size_t syntheticSize = kDefaultSyntheticSize;
+
+  int option;
+  while ((option = getopt(argc, argv, "c:s:")) != -1) {
+    switch (option) {
+    case 'c':
+      chunkSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 's':
+      syntheticSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    default:
+      SFTSnapshotBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (chunkSize == 0) {
+    SFTSnapshotBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  printf("%-24s %10s %10s %10s %12s %12s %10s  %s\n", "workload",
+         "published", "rendered", "skipped", "us/publish", "rows/render",
+         "MB/s", "result");
+
+  return SFTBenchmarkRunWorkloads(argc, argv, optind, syntheticSize,
+                                  SFTSnapshotBenchmarkRunWorkload, &chunkSize);
+}
@@ -0,0 +1,756 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Runs sessions against a local fake Telnet server, checking that every
+ * negotiation is stripped and answered as expected: binary transmission,
+ * suppress go ahead and echo are accepted, the window size is reported as 40x25
+ * and the terminal type as PETSCII.  The same data and replies must come out
+ * however commands are split across reads.  Bulk transfers are then timed with
+ * and without the filter, both in memory and over the socket.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreTelnet.h"
+
+static const size_t kDefaultSyntheticSize = 4 * 1024 * 1024;
+static const size_t kDefaultRounds = 3;
+
+/**
+ * Bytes read from the socket at a time, as large as the application's
+ * input ring.
+ */
+static const size_t kReadBufferSize = 64 * 1024;
+
+/**
+ * Window size and terminal type reported, as in the application.
+ */
+static const uint16_t kWidth = 40;
+static const uint16_t kHeight = 25;
+static const char *kTerminalType = "PETSCII";
+
+/**
+ * Workload bytes between two commands in the split sequences check.
+ */
+static const size_t kCommandInterval = 509;
+
+/**
+ * Chunk sizes the split sequences check feeds the filter with.
+ */
+static const size_t kSplitSizes[] = {1, 2, 3, 5, 64, 4093};
+
+/**
+ * How long the fake server waits for each batch of replies.
+ */
+static const int kReplyTimeoutMilliseconds = 5000;
+
+/**
+ * Negotiation the fake server opens each checked session with: everything
+ * the filter accepts, a few options it must refuse, and a repeated request
+ * that must not be answered again.
+ */
+static const uint8_t kNegotiation[] = {
+    SFTCoreTelnetIAC,  SFTCoreTelnetDO,   SFTCoreTelnetOptionTerminalType,
+    SFTCoreTelnetIAC,  SFTCoreTelnetDO,   SFTCoreTelnetOptionWindowSize,
+    SFTCoreTelnetIAC,  SFTCoreTelnetWILL, SFTCoreTelnetOptionEcho,
+    SFTCoreTelnetIAC,  SFTCoreTelnetWILL, SFTCoreTelnetOptionSuppressGoAhead,
+    SFTCoreTelnetIAC,  SFTCoreTelnetDO,   SFTCoreTelnetOptionSuppressGoAhead,
+    SFTCoreTelnetIAC,  SFTCoreTelnetWILL, SFTCoreTelnetOptionBinary,
+    SFTCoreTelnetIAC,  SFTCoreTelnetDO,   SFTCoreTelnetOptionBinary,
+    SFTCoreTelnetIAC,  SFTCoreTelnetDO,   39,
+    SFTCoreTelnetIAC,  SFTCoreTelnetWILL, 5,
+    SFTCoreTelnetIAC,  SFTCoreTelnetDO,   SFTCoreTelnetOptionEcho,
+    SFTCoreTelnetIAC,  SFTCoreTelnetWILL, SFTCoreTelnetOptionSuppressGoAhead,
+    SFTCoreTelnetIAC,  241};
+
+static const uint8_t kNegotiationReplies[] = {
+    SFTCoreTelnetIAC, SFTCoreTelnetWILL, SFTCoreTelnetOptionTerminalType,
+    SFTCoreTelnetIAC, SFTCoreTelnetWILL, SFTCoreTelnetOptionWindowSize,
+    SFTCoreTelnetIAC, SFTCoreTelnetSB,   SFTCoreTelnetOptionWindowSize,
+    0,                40,                0,
+    25,               SFTCoreTelnetIAC,  SFTCoreTelnetSE,
+    SFTCoreTelnetIAC, SFTCoreTelnetDO,   SFTCoreTelnetOptionEcho,
+    SFTCoreTelnetIAC, SFTCoreTelnetDO,   SFTCoreTelnetOptionSuppressGoAhead,
+    SFTCoreTelnetIAC, SFTCoreTelnetWILL, SFTCoreTelnetOptionSuppressGoAhead,
+    SFTCoreTelnetIAC, SFTCoreTelnetDO,   SFTCoreTelnetOptionBinary,
+    SFTCoreTelnetIAC, SFTCoreTelnetWILL, SFTCoreTelnetOptionBinary,
+    SFTCoreTelnetIAC, SFTCoreTelnetWONT, 39,
+    SFTCoreTelnetIAC, SFTCoreTelnetDONT, 5,
+    SFTCoreTelnetIAC, SFTCoreTelnetWONT, SFTCoreTelnetOptionEcho};
+
+static const uint8_t kTerminalTypeRequest[] = {
+    SFTCoreTelnetIAC, SFTCoreTelnetSB, SFTCoreTelnetOptionTerminalType, 1,
+    SFTCoreTelnetIAC, SFTCoreTelnetSE};
+
+static const uint8_t kTerminalTypeReply[] = {
+    SFTCoreTelnetIAC, SFTCoreTelnetSB, SFTCoreTelnetOptionTerminalType,
+    0,                'P',             'E',
+    'T',              'S',             'C',
+    'I',              'I',             SFTCoreTelnetIAC,
+    SFTCoreTelnetSE};
+
+typedef struct {
+  int listener;
+
+  /**
+   * Data sent once the negotiation is over, rounds times.
+   */
+  const uint8_t *bytes;
+  size_t length;
+  size_t rounds;
+
+  /**
+   * Whether to negotiate and check the replies before sending data.
+   */
+  bool negotiate;
+
+  bool succeeded;
+} SFTTelnetBenchmarkServer;
+
+typedef struct {
+  /**
+   * Filtered bytes received and their hash.
+   */
+  size_t received;
+  uint64_t hash;
+
+  /**
+   * Time from connecting to the end of the stream, in nanoseconds.
+   */
+  uint64_t elapsed;
+} SFTTelnetBenchmarkSession;
+
+static void SFTTelnetBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s telnet [-s synthetic bytes] [-r rounds] [capture ...]\n"
+          "\n"
+          "Checks that the Telnet filter answers a fake server's "
+          "negotiation as expected,\ngives the same results however "
+          "commands are split across reads, and escapes\noutgoing data "
+          "once negotiated.  It then times bulk transfers from the fake\n"
+          "server with and without the filter.  Synthetic workloads are "
+          "used when no\ncapture is given.\n",
+          name);
+}
+
+/**
+ * Doubles every IAC byte in the given workload, as a server sending it
+ * would.
+ *
+ * @param[in] workload the workload to escape.
+ * @param[out] length the escaped workload length, in bytes.
+ *
+ * @return the escaped workload, or NULL if it could not be allocated.
+ */
+static uint8_t *SFTTelnetBenchmarkEscape(const SFTBenchmarkWorkload *workload,
+                                         size_t *length) {
+  uint8_t *escaped = (uint8_t *)malloc(workload->length * 2);
+  if (escaped == NULL) {
+    return NULL;
+  }
+
+  size_t output = 0;
+  for (size_t index = 0; index < workload->length; index++) {
+    escaped[output++] = workload->bytes[index];
+    if (workload->bytes[index] == SFTCoreTelnetIAC) {
+      escaped[output++] = SFTCoreTelnetIAC;
+    }
+  }
+
+  *length = output;
+  return escaped;
+}
+
+/**
+ * Builds a session interleaving the workload with commands every
+ * kCommandInterval bytes, after the opening negotiation.
+ *
+ * @param[in] workload the workload to interleave commands with.
+ * @param[out] session the session bytes, to be freed by the caller.
+ * @param[out] sessionLength the session length, in bytes.
+ * @param[out] expected the data the session must be filtered down to, to be
+ * freed by the caller.
+ * @param[out] expectedLength the expected data length, in bytes.
+ *
+ * @return true if the session was built, false otherwise.
+ */
+static bool SFTTelnetBenchmarkInterleave(const SFTBenchmarkWorkload *workload,
+                                         uint8_t **session,
+                                         size_t *sessionLength,
+                                         uint8_t **expected,
+                                         size_t *expectedLength) {
+  static const uint8_t kCommands[][10] = {
+      {2, SFTCoreTelnetIAC, 241},
+      {2, SFTCoreTelnetIAC, SFTCoreTelnetIAC},
+      {3, SFTCoreTelnetIAC, SFTCoreTelnetWILL,
+       SFTCoreTelnetOptionSuppressGoAhead},
+      {9, SFTCoreTelnetIAC, SFTCoreTelnetSB, SFTCoreTelnetOptionWindowSize, 1,
+       SFTCoreTelnetIAC, SFTCoreTelnetIAC, 3, SFTCoreTelnetIAC,
+       SFTCoreTelnetSE},
+      {6, SFTCoreTelnetIAC, SFTCoreTelnetSB, SFTCoreTelnetOptionTerminalType,
+       1, SFTCoreTelnetIAC, SFTCoreTelnetSE}};
+  static const size_t kCommandsCount = sizeof(kCommands) / sizeof(kCommands[0]);
+
+  size_t commands = (workload->length / kCommandInterval) + 1;
+  *session = (uint8_t *)malloc(sizeof(kNegotiation) + (workload->length * 2) +
+                               (commands * sizeof(kCommands[0])));
+  *expected = (uint8_t *)malloc(workload->length + commands);
+  if ((*session == NULL) || (*expected == NULL)) {
+    free(*session);
+    free(*expected);
+    return false;
+  }
+
+  memcpy(*session, kNegotiation, sizeof(kNegotiation));
+  size_t output = sizeof(kNegotiation);
+  size_t data = 0;
+
+  for (size_t index = 0; index < workload->length; index++) {
+    if ((index % kCommandInterval) == 0) {
+      const uint8_t *command =
+          kCommands[(index / kCommandInterval) % kCommandsCount];
+      memcpy(*session + output, command + 1, command[0]);
+      output += command[0];
+      if (command[2] == SFTCoreTelnetIAC) {
+        (*expected)[data++] = SFTCoreTelnetIAC;
+      }
+    }
+
+    (*session)[output++] = workload->bytes[index];
+    if (workload->bytes[index] == SFTCoreTelnetIAC) {
+      (*session)[output++] = SFTCoreTelnetIAC;
+    }
+    (*expected)[data++] = workload->bytes[index];
+  }
+
+  *sessionLength = output;
+  *expectedLength = data;
+  return true;
+}
+
+/**
+ * Filters the given session in chunks of the given size, checking the
+ * filtered data and returning a hash of the replies.
+ *
+ * @param[in] session the session to filter.
+ * @param[in] length the session length, in bytes.
+ * @param[in] chunkSize the amount of bytes filtered at a time.
+ * @param[in] expected the data the session must be filtered down to.
+ * @param[in] expectedLength the expected data length, in bytes.
+ * @param[out] buffer scratch space, at least chunkSize bytes long.
+ * @param[out] repliesHash a hash of every reply sent.
+ *
+ * @return true if the filtered data matched, false otherwise.
+ */
+static bool SFTTelnetBenchmarkFilterSplit(const uint8_t *session,
+                                          size_t length, size_t chunkSize,
+                                          const uint8_t *expected,
+                                          size_t expectedLength,
+                                          uint8_t *buffer,
+                                          uint64_t *repliesHash) {
+  SFTCoreTelnet telnet;
+  SFTCoreTelnetInitialise(&telnet, kWidth, kHeight, kTerminalType);
+  *repliesHash = 0;
+  size_t data = 0;
+
+  for (size_t offset = 0; offset < length; offset += chunkSize) {
+    size_t chunk = length - offset < chunkSize ? length - offset : chunkSize;
+    memcpy(buffer, session + offset, chunk);
+    size_t filtered = SFTCoreTelnetFilter(&telnet, buffer, chunk);
+    if ((filtered > expectedLength - data) ||
+        (memcmp(buffer, expected + data, filtered) != 0)) {
+      return false;
+    }
+    data += filtered;
+
+    *repliesHash =
+        SFTBenchmarkHash(telnet.replies, telnet.repliesLength, *repliesHash);
+    SFTCoreTelnetConsumeReplies(&telnet, telnet.repliesLength);
+  }
+
+  return (data == expectedLength) &&
+         (telnet.state == SFTCoreTelnetParserStateData);
+}
+
+/**
+ * Sends the given workload through a pipeline holding a Telnet stage, the
+ * way the I/O processor does, checking what reaches the transport.
+ *
+ * @param[in] workload the workload to send.
+ * @param[in] negotiate whether the server negotiates first.
+ * @param[in] expected the bytes the transport must be handed.
+ * @param[in] expectedLength the expected bytes length.
+ * @param[out] buffer scratch space, at least kReadBufferSize bytes long.
+ *
+ * @return true if the transport got the expected bytes, false otherwise.
+ */
+static bool SFTTelnetBenchmarkCheckOutbound(
+    const SFTBenchmarkWorkload *workload, bool negotiate,
+    const uint8_t *expected, size_t expectedLength, uint8_t *buffer) {
+  SFTCoreTelnet telnet;
+  SFTCoreTelnetInitialise(&telnet, kWidth, kHeight, kTerminalType);
+  SFTCorePipeline pipeline;
+  SFTCorePipelineInitialise(&pipeline);
+  SFTCorePipelineAppend(&pipeline, SFTCoreTelnetProcess, &telnet);
+
+  if (negotiate) {
+    memcpy(buffer, kNegotiation, sizeof(kNegotiation));
+    SFTCorePipelineRun(&pipeline, SFTCorePipelineDirectionInbound, buffer,
+                       sizeof(kNegotiation));
+    SFTCorePipelineConsumeInjected(&pipeline, SFTCorePipelineDirectionOutbound,
+                                   SFTCorePipelineInjectionCapacity);
+  }
+
+  size_t sent = 0;
+  for (size_t offset = 0; offset < workload->length;) {
+    size_t chunk = workload->length - offset;
+    if (chunk > SFTCoreTelnetOutboundSpanCapacity) {
+      chunk = SFTCoreTelnetOutboundSpanCapacity;
+    }
+    memcpy(buffer, workload->bytes + offset, chunk);
+    offset += chunk;
+
+    size_t kept = SFTCorePipelineRun(
+        &pipeline, SFTCorePipelineDirectionOutbound, buffer, chunk);
+    const SFTCorePipelineInjection *injected =
+        SFTCorePipelineInjected(&pipeline, SFTCorePipelineDirectionOutbound);
+    if ((kept + injected->length > expectedLength - sent) ||
+        (memcmp(buffer, expected + sent, kept) != 0) ||
+        (memcmp(injected->bytes, expected + sent + kept, injected->length) !=
+         0)) {
+      return false;
+    }
+    sent += kept + injected->length;
+    SFTCorePipelineConsumeInjected(&pipeline, SFTCorePipelineDirectionOutbound,
+                                   injected->length);
+  }
+
+  return sent == expectedLength;
+}
+
+static bool SFTTelnetBenchmarkCheckSplits(const SFTBenchmarkWorkload *workload,
+                                          uint8_t *buffer) {
+  uint8_t *session;
+  size_t sessionLength;
+  uint8_t *expected;
+  size_t expectedLength;
+  if (!SFTTelnetBenchmarkInterleave(workload, &session, &sessionLength,
+                                    &expected, &expectedLength)) {
+    fprintf(stderr, "Cannot allocate the interleaved session\n");
+    return false;
+  }
+
+  uint64_t wholeReplies;
+  bool succeeded = SFTTelnetBenchmarkFilterSplit(
+      session, sessionLength, kReadBufferSize, expected, expectedLength,
+      buffer, &wholeReplies);
+
+  for (size_t index = 0;
+       succeeded && (index < sizeof(kSplitSizes) / sizeof(kSplitSizes[0]));
+       index++) {
+    uint64_t replies;
+    succeeded = SFTTelnetBenchmarkFilterSplit(
+                    session, sessionLength, kSplitSizes[index], expected,
+                    expectedLength, buffer, &replies) &&
+                (replies == wholeReplies);
+  }
+
+  free(expected);
+  free(session);
+  return succeeded;
+}
+
+static bool SFTTelnetBenchmarkSendAll(int descriptor, const uint8_t *bytes,
+                                      size_t length) {
+  while (length > 0) {
+    ssize_t written = write(descriptor, bytes, length);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+
+    bytes += written;
+    length -= (size_t)written;
+  }
+
+  return true;
+}
+
+static bool SFTTelnetBenchmarkExpect(int descriptor, const uint8_t *expected,
+                                     size_t length) {
+  uint8_t received[64];
+  size_t offset = 0;
+
+  while (offset < length) {
+    struct pollfd poller = {.fd = descriptor, .events = POLLIN};
+    if (poll(&poller, 1, kReplyTimeoutMilliseconds) <= 0) {
+      return false;
+    }
+
+    ssize_t bytesRead = read(descriptor, received, length - offset);
+    if (bytesRead <= 0) {
+      return false;
+    }
+
+    if (memcmp(received, expected + offset, (size_t)bytesRead) != 0) {
+      return false;
+    }
+    offset += (size_t)bytesRead;
+  }
+
+  return true;
+}
+
+static void *SFTTelnetBenchmarkServe(void *context) {
+  SFTTelnetBenchmarkServer *server = (SFTTelnetBenchmarkServer *)context;
+
+  int descriptor = accept(server->listener, NULL, NULL);
+  if (descriptor < 0) {
+    return NULL;
+  }
+
+  if (server->negotiate &&
+      (!SFTTelnetBenchmarkSendAll(descriptor, kNegotiation,
+                                  sizeof(kNegotiation)) ||
+       !SFTTelnetBenchmarkExpect(descriptor, kNegotiationReplies,
+                                 sizeof(kNegotiationReplies)) ||
+       !SFTTelnetBenchmarkSendAll(descriptor, kTerminalTypeRequest,
+                                  sizeof(kTerminalTypeRequest)) ||
+       !SFTTelnetBenchmarkExpect(descriptor, kTerminalTypeReply,
+                                 sizeof(kTerminalTypeReply)))) {
+    close(descriptor);
+    return NULL;
+  }
+
+  for (size_t round = 0; round < server->rounds; round++) {
+    if (!SFTTelnetBenchmarkSendAll(descriptor, server->bytes,
+                                   server->length)) {
+      close(descriptor);
+      return NULL;
+    }
+  }
+
+  close(descriptor);
+  server->succeeded = true;
+  return NULL;
+}
+
+static int SFTTelnetBenchmarkListen(uint16_t *port) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0) {
+    return -1;
+  }
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = 0;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if ((bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0) ||
+      (listen(listener, 1) != 0) ||
+      (getsockname(listener, (struct sockaddr *)&address, &length) != 0)) {
+    close(listener);
+    return -1;
+  }
+
+  *port = ntohs(address.sin_port);
+  return listener;
+}
+
+static int SFTTelnetBenchmarkConnect(uint16_t port) {
+  int descriptor = socket(AF_INET, SOCK_STREAM, 0);
+  if (descriptor < 0) {
+    return -1;
+  }
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(descriptor, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    close(descriptor);
+    return -1;
+  }
+
+  return descriptor;
+}
+
+/**
+ * Runs a session against the fake server, reading until the server closes
+ * the connection and answering negotiations as the application does.
+ *
+ * @param[in,out] server the fake server description.
+ * @param[in] port the fake server port.
+ * @param[in] telnet the filter to use, or NULL to read raw bytes.
+ * @param[in] hashData whether to hash the filtered data.
+ * @param[out] buffer scratch space, kReadBufferSize bytes long.
+ * @param[out] session the session results.
+ *
+ * @return true if both ends of the session succeeded, false otherwise.
+ */
+static bool SFTTelnetBenchmarkRunSession(SFTTelnetBenchmarkServer *server,
+                                         uint16_t port, SFTCoreTelnet *telnet,
+                                         bool hashData, uint8_t *buffer,
+                                         SFTTelnetBenchmarkSession *session) {
+  memset(session, 0, sizeof(SFTTelnetBenchmarkSession));
+  server->succeeded = false;
+
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, SFTTelnetBenchmarkServe, server) != 0) {
+    return false;
+  }
+
+  bool succeeded = false;
+  uint64_t start = SFTBenchmarkNow();
+  int descriptor = SFTTelnetBenchmarkConnect(port);
+
+  for (;;) {
+    if (descriptor < 0) {
+      break;
+    }
+
+    ssize_t bytesRead = read(descriptor, buffer, kReadBufferSize);
+    if (bytesRead < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    if (bytesRead == 0) {
+      succeeded = true;
+      break;
+    }
+
+    size_t length = (size_t)bytesRead;
+    if (telnet != NULL) {
+      length = SFTCoreTelnetFilter(telnet, buffer, length);
+      if (telnet->repliesLength > 0) {
+        if (!SFTTelnetBenchmarkSendAll(descriptor, telnet->replies,
+                                       telnet->repliesLength)) {
+          break;
+        }
+        SFTCoreTelnetConsumeReplies(telnet, telnet->repliesLength);
+      }
+    }
+
+    if (hashData) {
+      session->hash = SFTBenchmarkHash(buffer, length, session->hash);
+    }
+    session->received += length;
+  }
+
+  session->elapsed = SFTBenchmarkNow() - start;
+  if (descriptor >= 0) {
+    close(descriptor);
+  }
+  pthread_join(thread, NULL);
+  return succeeded && server->succeeded;
+}
+
+static bool SFTTelnetBenchmarkRun(const SFTBenchmarkWorkload *workload,
+                                  size_t rounds, int listener, uint16_t port,
+                                  uint8_t *buffer) {
+  size_t escapedLength;
+  uint8_t *escaped = SFTTelnetBenchmarkEscape(workload, &escapedLength);
+  if (escaped == NULL) {
+    fprintf(stderr, "Cannot allocate the escaped workload\n");
+    return false;
+  }
+
+  // Outgoing data is only escaped for servers that speak Telnet.
+  bool succeeded =
+      SFTTelnetBenchmarkCheckSplits(workload, buffer) &&
+      SFTTelnetBenchmarkCheckOutbound(workload, false, workload->bytes,
+                                      workload->length, buffer) &&
+      SFTTelnetBenchmarkCheckOutbound(workload, true, escaped, escapedLength,
+                                      buffer);
+
+  // A checked session: negotiation, then data hashed on arrival.
+  SFTTelnetBenchmarkServer server = {.listener = listener,
+                                     .bytes = escaped,
+                                     .length = escapedLength,
+                                     .rounds = 1,
+                                     .negotiate = true};
+  SFTCoreTelnet telnet;
+  SFTCoreTelnetInitialise(&telnet, kWidth, kHeight, kTerminalType);
+  SFTTelnetBenchmarkSession session;
+  succeeded = SFTTelnetBenchmarkRunSession(&server, port, &telnet, true,
+                                           buffer, &session) &&
+              succeeded && (session.received == workload->length) &&
+              (session.hash ==
+               SFTBenchmarkHash(workload->bytes, workload->length, 0));
+
+  // In memory, every read is a copy into the input ring, followed by a pass
+  // of the filter over the same bytes while they are still in the cache.
+  uint64_t copyTime = UINT64_MAX;
+  uint64_t filterTime = UINT64_MAX;
+  for (size_t round = 0; round < rounds * 2; round++) {
+    bool filter = (round % 2) == 1;
+    SFTCoreTelnetInitialise(&telnet, kWidth, kHeight, kTerminalType);
+    size_t filtered = 0;
+    uint64_t start = SFTBenchmarkNow();
+    for (size_t offset = 0; offset < escapedLength;
+         offset += kReadBufferSize) {
+      size_t chunk = escapedLength - offset < kReadBufferSize
+                         ? escapedLength - offset
+                         : kReadBufferSize;
+      memcpy(buffer, escaped + offset, chunk);
+      filtered +=
+          filter ? SFTCoreTelnetFilter(&telnet, buffer, chunk) : chunk;
+    }
+    uint64_t elapsed = SFTBenchmarkNow() - start;
+
+    if (filter) {
+      succeeded = succeeded && (filtered == workload->length);
+      filterTime = elapsed < filterTime ? elapsed : filterTime;
+    } else {
+      copyTime = elapsed < copyTime ? elapsed : copyTime;
+    }
+  }
+
+  // Bulk transfers, best of each.
+  server.negotiate = false;
+  server.rounds = rounds;
+  uint64_t rawTime = UINT64_MAX;
+  uint64_t telnetTime = UINT64_MAX;
+  for (size_t round = 0; round < rounds; round++) {
+    succeeded = SFTTelnetBenchmarkRunSession(&server, port, NULL, false,
+                                             buffer, &session) &&
+                succeeded &&
+                (session.received == escapedLength * rounds);
+    rawTime = session.elapsed < rawTime ? session.elapsed : rawTime;
+
+    SFTCoreTelnetInitialise(&telnet, kWidth, kHeight, kTerminalType);
+    succeeded = SFTTelnetBenchmarkRunSession(&server, port, &telnet, false,
+                                             buffer, &session) &&
+                succeeded &&
+                (session.received == workload->length * rounds);
+    telnetTime = session.elapsed < telnetTime ? session.elapsed : telnetTime;
+  }
+
+  double megabytes = (double)escapedLength / (1024.0 * 1024.0);
+  double streamed = megabytes * (double)rounds;
+  printf("%-24s %8.2f %9.2f %9.2f %+7.1f%% %9.1f %9.1f %+7.1f%%  %s\n",
+         workload->name, megabytes,
+         ((double)escapedLength / (double)copyTime),
+         ((double)escapedLength / (double)filterTime),
+         (((double)filterTime - (double)copyTime) * 100.0) / (double)copyTime,
+         streamed / ((double)rawTime / 1e9),
+         streamed / ((double)telnetTime / 1e9),
+         (((double)telnetTime - (double)rawTime) * 100.0) / (double)rawTime,
+         succeeded ? "OK" : "FAILED");
+
+  free(escaped);
+  return succeeded;
+}
+
+/**
+ * Options and buffers shared by every workload.
+ */
+typedef struct {
+  size_t rounds;
+  int listener;
+  uint16_t port;
+  uint8_t *buffer;
+} SFTTelnetBenchmarkContext;
+
+static bool SFTTelnetBenchmarkRunWorkload(const SFTBenchmarkWorkload *workload,
+                                          void *userData) {
+  const SFTTelnetBenchmarkContext *context =
+      (const SFTTelnetBenchmarkContext *)userData;
+  return SFTTelnetBenchmarkRun(workload, context->rounds, context->listener,
+                               context->port, context->buffer);
+}
+
+int SFTTelnetBenchmarkMain(int argc, char *argv[]) {
+  size_t syntheticSize = kDefaultSyntheticSize;
+  size_t rounds = kDefaultRounds;
+
+  int option;
+  while ((option = getopt(argc, argv, "s:r:")) != -1) {
+    switch (option) {
+    case 's':
+      syntheticSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'r':
+      rounds = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    default:
+      SFTTelnetBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if ((syntheticSize == 0) || (rounds == 0)) {
+    SFTTelnetBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+
+  uint16_t port;
+  int listener = SFTTelnetBenchmarkListen(&port);
+  if (listener < 0) {
+    fprintf(stderr, "Cannot open the fake server socket\n");
+    return EXIT_FAILURE;
+  }
+
+  uint8_t *buffer = (uint8_t *)malloc(kReadBufferSize);
+  if (buffer == NULL) {
+    fprintf(stderr, "Cannot allocate buffers\n");
+    close(listener);
+    return EXIT_FAILURE;
+  }
+
+  printf("%-24s %8s %9s %9s %8s %9s %9s %8s  %s\n", "workload", "MB",
+         "read GB/s", "filt GB/s", "cost", "raw MB/s", "tel MB/s", "cost",
+         "result");
+
+  SFTTelnetBenchmarkContext context = {
+      .rounds = rounds, .listener = listener, .port = port, .buffer = buffer};
+  int result = SFTBenchmarkRunWorkloads(argc, argv, optind, syntheticSize,
+                                        SFTTelnetBenchmarkRunWorkload,
+                                        &context);
+
+  free(buffer);
+  close(listener);
+  return result;
+}
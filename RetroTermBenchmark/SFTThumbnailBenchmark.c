@@ -0,0 +1,369 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Writes a session capture for each of 500 address book entries, alternating
+ * timestamped and raw ones, then turns every capture into a PNG thumbnail
+ * without any window: first one at a time, then on a pool of worker threads,
+ * one per processor unless -t says otherwise.  Each thumbnail must match one
+ * drawn from the same bytes parsed directly.
+ *
+ * Thumbnails are drawn at half size unless -x picks another scale.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SFTBenchmark.h"
+#include "SFTCoreCapture.h"
+#include "SFTCoreEmulator.h"
+#include "SFTCoreThumbnail.h"
+
+static const size_t kDefaultSyntheticSize = 1024 * 1024;
+static const size_t kDefaultEntries = 500;
+static const size_t kDefaultCaptureSize = 32 * 1024;
+static const float kDefaultScale = 0.5f;
+static const size_t kWidth = 40;
+static const size_t kHeight = 25;
+
+/**
+ * Bytes per record in timestamped captures.
+ */
+static const size_t kPacketSize = 1024;
+
+typedef struct {
+  size_t entries;
+  size_t captureSize;
+  size_t workers;
+  float scale;
+  const char *directory;
+} SFTThumbnailBenchmarkOptions;
+
+static void SFTThumbnailBenchmarkUsage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s thumbnail [-n entries] [-c capture bytes] [-x scale] "
+          "[-t workers]\n       [-s synthetic bytes] [-d directory] "
+          "[capture ...]\n"
+          "\n"
+          "Writes a session capture for each of a number of address book "
+          "entries, every\nother one timestamped, taken from different "
+          "parts of each raw capture, then\nturns all of them into PNG "
+          "thumbnails one at a time and on a pool of workers.\nEach "
+          "thumbnail is checked against one drawn from the same bytes "
+          "parsed\ndirectly.  Synthetic workloads are used when no capture "
+          "is given.\n",
+          name);
+}
+
+static void SFTThumbnailBenchmarkStartState(SFTCoreEmulatorState *state,
+                                            SFTTerminalEmulatorCell *cells) {
+  SFTCoreEmulatorStateInitialise(state, kWidth, kHeight, 0, 14, false, false);
+  SFTCoreEmulatorClearScreen(state, cells);
+}
+
+static bool SFTThumbnailBenchmarkWrite(const char *path, const uint8_t *bytes,
+                                       size_t length, bool timestamped,
+                                       SFTTerminalEmulatorCell *cells) {
+  if (!timestamped) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+      return false;
+    }
+    bool written = fwrite(bytes, 1, length, file) == length;
+    return (fclose(file) == 0) && written;
+  }
+
+  SFTCoreEmulatorState state;
+  SFTThumbnailBenchmarkStartState(&state, cells);
+
+  SFTCoreCaptureWriter writer;
+  uint64_t now = 1500000000ULL * 1000000000ULL;
+  if (!SFTCoreCaptureWriterOpen(&writer, path, &state, cells,
+                                SFTCoreCaptureDefaultCheckpointInterval,
+                                now)) {
+    return false;
+  }
+
+  bool succeeded = true;
+  for (size_t offset = 0; succeeded && (offset < length);
+       offset += kPacketSize) {
+    now += 1000000;
+    succeeded = SFTCoreCaptureWriterAppend(
+        &writer, now, SFTCoreCaptureRecordInbound, bytes + offset,
+        length - offset < kPacketSize ? length - offset : kPacketSize);
+  }
+
+  return SFTCoreCaptureWriterClose(&writer) && succeeded;
+}
+
+/**
+ * Checks the PNG signature and every chunk's CRC.
+ */
+static bool SFTThumbnailBenchmarkCheckPNG(const uint8_t *png, size_t length) {
+  static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G',
+                                        '\r', '\n', 0x1A, '\n'};
+  if ((length < sizeof(kSignature)) ||
+      (memcmp(png, kSignature, sizeof(kSignature)) != 0)) {
+    return false;
+  }
+
+  size_t offset = sizeof(kSignature);
+  bool ended = false;
+  while (!ended && (offset + 12 <= length)) {
+    uint32_t chunk = ((uint32_t)png[offset] << 24) |
+                     ((uint32_t)png[offset + 1] << 16) |
+                     ((uint32_t)png[offset + 2] << 8) | png[offset + 3];
+    if (chunk > length - offset - 12) {
+      return false;
+    }
+
+    uint32_t crc = 0xFFFFFFFFU;
+    for (size_t index = offset + 4; index < offset + 8 + chunk; index++) {
+      crc ^= png[index];
+      for (size_t bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x01) ? 0xEDB88320U ^ (crc >> 1) : crc >> 1;
+      }
+    }
+    crc ^= 0xFFFFFFFFU;
+
+    const uint8_t *stored = png + offset + 8 + chunk;
+    if (crc != (((uint32_t)stored[0] << 24) | ((uint32_t)stored[1] << 16) |
+                ((uint32_t)stored[2] << 8) | stored[3])) {
+      return false;
+    }
+
+    ended = memcmp(png + offset + 4, "IEND", 4) == 0;
+    offset += chunk + 12;
+  }
+
+  return ended && (offset == length);
+}
+
+static void SFTThumbnailBenchmarkRelease(SFTCoreThumbnailJob *jobs,
+                                         size_t count) {
+  for (size_t index = 0; index < count; index++) {
+    free(jobs[index].png);
+    jobs[index].png = NULL;
+  }
+}
+
+static bool
+SFTThumbnailBenchmarkRun(const SFTBenchmarkWorkload *workload,
+                         const SFTThumbnailBenchmarkOptions *options,
+                         char (*paths)[1024], SFTCoreThumbnailJob *jobs,
+                         SFTCoreThumbnailJob *expected,
+                         SFTTerminalEmulatorCell *cells) {
+  size_t captureSize = options->captureSize < workload->length
+                           ? options->captureSize
+                           : workload->length;
+  size_t span = workload->length - captureSize + 1;
+  SFTCoreRendererContext context = {.flags = SFTCoreRendererFlagCursor};
+  bool succeeded = true;
+  size_t written = 0;
+
+  for (; written < options->entries; written++) {
+    // Entries start at scattered offsets so that every screen differs.
+    size_t offset = (written * 7919 * 131) % span;
+    const uint8_t *bytes = workload->bytes + offset;
+    snprintf(paths[written], sizeof(paths[written]),
+             "%s/SFTThumbnailBenchmark-%d-%zu.sftcapture", options->directory,
+             (int)getpid(), written);
+    if (!SFTThumbnailBenchmarkWrite(paths[written], bytes, captureSize,
+                                    (written % 2) != 0, cells)) {
+      fprintf(stderr, "Cannot write capture %s\n", paths[written]);
+      succeeded = false;
+      break;
+    }
+
+    SFTCoreEmulatorState state;
+    SFTThumbnailBenchmarkStartState(&state, cells);
+    SFTCoreEmulatorProcessIncomingData(&state, cells, bytes, captureSize);
+    expected[written] = (SFTCoreThumbnailJob){
+        .cells = cells,
+        .baseRow = state.baseRow,
+        .width = kWidth,
+        .height = kHeight,
+        .context = context,
+        .scale = options->scale};
+    expected[written].context.cursorRow = (uint32_t)state.row;
+    expected[written].context.cursorColumn = (uint32_t)state.column;
+    succeeded = succeeded && SFTCoreThumbnailRender(&expected[written]);
+
+    jobs[written] = (SFTCoreThumbnailJob){.path = paths[written],
+                                          .width = kWidth,
+                                          .height = kHeight,
+                                          .background = 0,
+                                          .foreground = 14,
+                                          .asciiMode = false,
+                                          .context = context,
+                                          .scale = options->scale};
+  }
+
+  size_t pngBytes = 0;
+  uint64_t sequential = 0;
+  uint64_t pooled = 0;
+  if (succeeded) {
+    uint64_t start = SFTBenchmarkNow();
+    size_t rendered = SFTCoreThumbnailRenderBatch(jobs, written, 1);
+    sequential = SFTBenchmarkNow() - start;
+    SFTThumbnailBenchmarkRelease(jobs, written);
+
+    start = SFTBenchmarkNow();
+    rendered += SFTCoreThumbnailRenderBatch(jobs, written, options->workers);
+    pooled = SFTBenchmarkNow() - start;
+    succeeded = rendered == written * 2;
+
+    for (size_t index = 0; succeeded && (index < written); index++) {
+      succeeded = (jobs[index].pngLength == expected[index].pngLength) &&
+                  (memcmp(jobs[index].png, expected[index].png,
+                          jobs[index].pngLength) == 0) &&
+                  SFTThumbnailBenchmarkCheckPNG(jobs[index].png,
+                                                jobs[index].pngLength);
+      pngBytes += jobs[index].pngLength;
+    }
+  }
+
+  for (size_t index = 0; index < written; index++) {
+    unlink(paths[index]);
+  }
+  SFTThumbnailBenchmarkRelease(jobs, written);
+  SFTThumbnailBenchmarkRelease(expected, written);
+
+  size_t fullSize = kWidth * kHeight * SFTCoreRendererCellSize *
+                    SFTCoreRendererCellSize * sizeof(uint32_t);
+  printf("%-24s %8zu %12.0f %12.0f %9.2f %9.2f %9.1f  %s\n", workload->name,
+         written, ((double)written * 1e9) / (double)(sequential + 1),
+         ((double)written * 1e9) / (double)(pooled + 1),
+         (double)pooled / 1e9,
+         written > 0 ? (double)pngBytes / (double)written / 1024.0 : 0.0,
+         (double)fullSize / 1024.0, succeeded ? "OK" : "FAILED");
+  return succeeded;
+}
+
+/**
+ * Options and buffers shared by every workload.
+ */
+typedef struct {
+  const SFTThumbnailBenchmarkOptions *options;
+  char (*paths)[1024];
+  SFTCoreThumbnailJob *jobs;
+  SFTCoreThumbnailJob *expected;
+  SFTTerminalEmulatorCell *cells;
+} SFTThumbnailBenchmarkContext;
+
+static bool
+SFTThumbnailBenchmarkRunWorkload(const SFTBenchmarkWorkload *workload,
+                                 void *userData) {
+  const SFTThumbnailBenchmarkContext *context =
+      (const SFTThumbnailBenchmarkContext *)userData;
+  return SFTThumbnailBenchmarkRun(workload, context->options, context->paths,
+                                  context->jobs, context->expected,
+                                  context->cells);
+}
+
+int SFTThumbnailBenchmarkMain(int argc, char *argv[]) {
+  const char *directory = getenv("TMPDIR");
+  SFTThumbnailBenchmarkOptions options = {
+      .entries = kDefaultEntries,
+      .captureSize = kDefaultCaptureSize,
+      .workers = 0,
+      .scale = kDefaultScale,
+      .directory = (directory != NULL) ? directory : "/tmp"};
+  size_t syntheticSize = kDefaultSyntheticSize;
+
+  int option;
+  while ((option = getopt(argc, argv, "n:c:x:t:s:d:")) != -1) {
+    switch (option) {
+    case 'n':
+      options.entries = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'c':
+      options.captureSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'x':
+      options.scale = strtof(optarg, NULL);
+      break;
+
+    case 't':
+      options.workers = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 's':
+      syntheticSize = (size_t)strtoull(optarg, NULL, 0);
+      break;
+
+    case 'd':
+      options.directory = optarg;
+      break;
+
+    default:
+      SFTThumbnailBenchmarkUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if ((options.entries == 0) || (options.captureSize == 0) ||
+      (options.scale <= 0.0f) || (syntheticSize == 0)) {
+    SFTThumbnailBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  char(*paths)[1024] = (char(*)[1024])malloc(options.entries * 1024);
+  SFTCoreThumbnailJob *jobs = (SFTCoreThumbnailJob *)calloc(
+      options.entries, sizeof(SFTCoreThumbnailJob));
+  SFTCoreThumbnailJob *expected = (SFTCoreThumbnailJob *)calloc(
+      options.entries, sizeof(SFTCoreThumbnailJob));
+  SFTTerminalEmulatorCell *cells = (SFTTerminalEmulatorCell *)calloc(
+      kWidth * kHeight, sizeof(SFTTerminalEmulatorCell));
+  if ((paths == NULL) || (jobs == NULL) || (expected == NULL) ||
+      (cells == NULL)) {
+    fprintf(stderr, "Cannot allocate buffers\n");
+    free(paths);
+    free(jobs);
+    free(expected);
+    free(cells);
+    return EXIT_FAILURE;
+  }
+
+  printf("%-24s %8s %12s %12s %9s %9s %9s  %s\n", "workload", "entries",
+         "serial/s", "pooled/s", "pooled s", "PNG KB", "RGBA KB", "result");
+
+  SFTThumbnailBenchmarkContext context = {.options = &options,
+                                          .paths = paths,
+                                          .jobs = jobs,
+                                          .expected = expected,
+                                          .cells = cells};
+  int result = SFTBenchmarkRunWorkloads(argc, argv, optind, syntheticSize,
+                                        SFTThumbnailBenchmarkRunWorkload,
+                                        &context);
+
+  free(paths);
+  free(jobs);
+  free(expected);
+  free(cells);
+  return result;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTBenchmark.h"
+
+typedef struct {
+  const char *name;
+  const char *description;
+  int (*main)(int argc, char *argv[]);
+} SFTBenchmarkCommand;
+
+static const SFTBenchmarkCommand kCommands[] = {
+    {"parser", "emulator core parsing throughput", SFTParserBenchmarkMain},
+    {"ring", "input byte ring stress test", SFTRingBenchmarkMain},
+    {"eventloop", "shared event loop against a thread per session",
+     SFTEventLoopBenchmarkMain},
+    {"replay", "capture indexing, unthrottled replay and seeking",
+     SFTReplayBenchmarkMain},
+    {"capture", "timestamped capture writing, timed replay and seeking",
+     SFTCaptureBenchmarkMain},
+    {"packetlog", "bounded packet log appends and eviction",
+     SFTPacketLogBenchmarkMain},
+    {"scrollback", "compressed scrollback history memory and access times",
+     SFTScrollbackBenchmarkMain},
+    {"search", "scrollback search index updates and queries",
+     SFTSearchBenchmarkMain},
+    {"telnet", "Telnet negotiation filter checks and overhead",
+     SFTTelnetBenchmarkMain},
+    {"pipeline", "I/O pipeline stage overhead on bulk reads",
+     SFTPipelineBenchmarkMain},
+    {"render", "software renderer accuracy and frame rates",
+     SFTRenderBenchmarkMain},
+    {"thumbnail", "headless capture thumbnails on a worker pool",
+     SFTThumbnailBenchmarkMain},
+    {"sessions", "concurrent sessions parsing on their own threads",
+     SFTSessionsBenchmarkMain},
+    {"snapshot", "screen snapshots handed from parsing to rendering",
+     SFTSnapshotBenchmarkMain},
+    {"fuzz", "differential fuzzing of both parser implementations",
+     SFTFuzzBenchmarkMain},
+    {"golden", "end-of-session screens against golden dumps",
+     SFTGoldenBenchmarkMain},
+    {"geometry", "parsing throughput on 40 and 80 column screens",
+     SFTGeometryBenchmarkMain},
+};
+
+static void SFTBenchmarkUsage(const char *name) {
+  fprintf(stderr, "Usage: %s <benchmark> [options]\n\nBenchmarks:\n", name);
+  for (size_t index = 0; index < sizeof(kCommands) / sizeof(kCommands[0]);
+       index++) {
+    fprintf(stderr, "  %-12s %s\n", kCommands[index].name,
+            kCommands[index].description);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    SFTBenchmarkUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  for (size_t index = 0; index < sizeof(kCommands) / sizeof(kCommands[0]);
+       index++) {
+    if (strcmp(argv[1], kCommands[index].name) == 0) {
+      argv[1] = argv[0];
+      return kCommands[index].main(argc - 1, argv + 1);
+    }
+  }
+
+  SFTBenchmarkUsage(argv[0]);
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTCoreByteRing.h"
+
+bool SFTCoreByteRingInitialise(SFTCoreByteRing *ring, size_t capacity) {
+  memset(ring, 0, sizeof(SFTCoreByteRing));
+
+  size_t rounded = 1;
+  while (rounded < capacity) {
+    if (rounded > (SIZE_MAX / 2)) {
+      return false;
+    }
+    rounded <<= 1;
+  }
+
+  ring->bytes = (uint8_t *)malloc(rounded);
+  if (ring->bytes == NULL) {
+    return false;
+  }
+
+  ring->capacity = rounded;
+  ring->mask = rounded - 1;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->producerWaiting, false);
+  ring->cachedHead = 0;
+  ring->cachedTail = 0;
+
+  return true;
+}
+
+void SFTCoreByteRingRelease(SFTCoreByteRing *ring) {
+  free(ring->bytes);
+  ring->bytes = NULL;
+  ring->capacity = 0;
+  ring->mask = 0;
+}
+
+size_t SFTCoreByteRingAvailable(SFTCoreByteRing *ring) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  return head - tail;
+}
+
+size_t SFTCoreByteRingWritableSpan(SFTCoreByteRing *ring, uint8_t **span) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t offset = head & ring->mask;
+  size_t contiguous = ring->capacity - offset;
+
+  // Only touch the consumer's cache line when the cached value is limiting.
+  size_t space = ring->capacity - (head - ring->cachedTail);
+  if (space < contiguous) {
+    ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    space = ring->capacity - (head - ring->cachedTail);
+  }
+
+  *span = ring->bytes + offset;
+  return space < contiguous ? space : contiguous;
+}
+
+void SFTCoreByteRingCommitWrite(SFTCoreByteRing *ring, size_t count) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  atomic_store_explicit(&ring->head, head + count, memory_order_release);
+}
+
+size_t SFTCoreByteRingWrite(SFTCoreByteRing *ring, const uint8_t *bytes,
+                            size_t length) {
+  size_t written = 0;
+
+  // At most two spans: up to the end of the storage, then from its start.
+  for (int pass = 0; (pass < 2) && (written < length); pass++) {
+    uint8_t *span;
+    size_t available = SFTCoreByteRingWritableSpan(ring, &span);
+    if (available == 0) {
+      break;
+    }
+
+    size_t count = length - written;
+    if (count > available) {
+      count = available;
+    }
+    memcpy(span, bytes + written, count);
+    SFTCoreByteRingCommitWrite(ring, count);
+    written += count;
+  }
+
+  return written;
+}
+
+bool SFTCoreByteRingSuspendProducer(SFTCoreByteRing *ring) {
+  atomic_store_explicit(&ring->producerWaiting, true, memory_order_seq_cst);
+
+  // The consumer may have drained everything before seeing the flag.
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_seq_cst);
+  if (head - tail < ring->capacity) {
+    atomic_store_explicit(&ring->producerWaiting, false, memory_order_relaxed);
+    return false;
+  }
+
+  return true;
+}
+
+size_t SFTCoreByteRingReadableSpan(SFTCoreByteRing *ring,
+                                   const uint8_t **span) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  size_t offset = tail & ring->mask;
+  size_t contiguous = ring->capacity - offset;
+
+  // Only touch the producer's cache line when the cached value is limiting.
+  size_t used = ring->cachedHead - tail;
+  if (used < contiguous) {
+    ring->cachedHead = atomic_load_explicit(&ring->head, memory_order_acquire);
+    used = ring->cachedHead - tail;
+  }
+
+  *span = ring->bytes + offset;
+  return used < contiguous ? used : contiguous;
+}
+
+void SFTCoreByteRingCommitRead(SFTCoreByteRing *ring, size_t count) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  atomic_store_explicit(&ring->tail, tail + count, memory_order_seq_cst);
+}
+
+size_t SFTCoreByteRingDiscard(SFTCoreByteRing *ring) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  ring->cachedHead = head;
+  atomic_store_explicit(&ring->tail, head, memory_order_seq_cst);
+  return head - tail;
+}
+
+bool SFTCoreByteRingResumeProducer(SFTCoreByteRing *ring) {
+  if (!atomic_load_explicit(&ring->producerWaiting, memory_order_seq_cst)) {
+    return false;
+  }
+
+  return atomic_exchange_explicit(&ring->producerWaiting, false,
+                                  memory_order_seq_cst);
+}
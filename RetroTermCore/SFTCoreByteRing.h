@@ -0,0 +1,182 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreByteRing_h
+#define SFTCoreByteRing_h
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Assumed cache line size, used to keep producer and consumer indices apart.
+ */
+#define SFTCoreByteRingCacheLineSize 64
+
+/**
+ * Lock-free single producer, single consumer ring buffer of bytes.
+ *
+ * Exactly one thread may call the producer functions and exactly one thread
+ * may call the consumer functions at any given time; they can be different
+ * threads.  Indices grow monotonically and are masked on access, so the
+ * capacity is always a power of two.
+ */
+typedef struct {
+  uint8_t *bytes;
+  size_t capacity;
+  size_t mask;
+
+  /**
+   * Total bytes written so far, only ever stored by the producer.
+   */
+  _Alignas(SFTCoreByteRingCacheLineSize) _Atomic size_t head;
+
+  /**
+   * Producer's last known value of tail.
+   */
+  size_t cachedTail;
+
+  /**
+   * Total bytes read so far, only ever stored by the consumer.
+   */
+  _Alignas(SFTCoreByteRingCacheLineSize) _Atomic size_t tail;
+
+  /**
+   * Consumer's last known value of head.
+   */
+  size_t cachedHead;
+
+  /**
+   * Set by the producer when it stopped because the ring was full.
+   */
+  _Alignas(SFTCoreByteRingCacheLineSize) _Atomic bool producerWaiting;
+} SFTCoreByteRing;
+
+/**
+ * Initialises the given ring, allocating its storage.
+ *
+ * @param[out] ring the ring to initialise.
+ * @param[in] capacity the minimum capacity, rounded up to a power of two.
+ *
+ * @return true if the ring was initialised, false otherwise.
+ */
+bool SFTCoreByteRingInitialise(SFTCoreByteRing *ring, size_t capacity);
+
+/**
+ * Releases the storage held by the given ring.
+ *
+ * @param[in,out] ring the ring to release.
+ */
+void SFTCoreByteRingRelease(SFTCoreByteRing *ring);
+
+/**
+ * Returns the amount of bytes waiting to be read, can be called from any
+ * thread although the value may be stale by the time it is used.
+ *
+ * @param[in] ring the ring to inspect.
+ *
+ * @return the amount of readable bytes.
+ */
+size_t SFTCoreByteRingAvailable(SFTCoreByteRing *ring);
+
+/**
+ * Producer: returns the largest contiguous writable span.
+ *
+ * @param[in,out] ring the ring to write to.
+ * @param[out] span the start of the writable span.
+ *
+ * @return the span length in bytes, zero if the ring is full.
+ */
+size_t SFTCoreByteRingWritableSpan(SFTCoreByteRing *ring, uint8_t **span);
+
+/**
+ * Producer: publishes bytes written into the span previously returned by
+ * SFTCoreByteRingWritableSpan.
+ *
+ * @param[in,out] ring the ring written to.
+ * @param[in] count the amount of bytes written, at most the span length.
+ */
+void SFTCoreByteRingCommitWrite(SFTCoreByteRing *ring, size_t count);
+
+/**
+ * Producer: copies as many of the given bytes as fit into the ring.
+ *
+ * @param[in,out] ring the ring to write to.
+ * @param[in] bytes the bytes to write.
+ * @param[in] length the amount of bytes to write.
+ *
+ * @return the amount of bytes actually written.
+ */
+size_t SFTCoreByteRingWrite(SFTCoreByteRing *ring, const uint8_t *bytes,
+                            size_t length);
+
+/**
+ * Producer: flags that the producer stopped because the ring is full.
+ *
+ * @param[in,out] ring the full ring.
+ *
+ * @return true if the producer should wait for the consumer to resume it,
+ * false if space became available in the meantime and it should retry.
+ */
+bool SFTCoreByteRingSuspendProducer(SFTCoreByteRing *ring);
+
+/**
+ * Consumer: returns the largest contiguous readable span.
+ *
+ * @param[in,out] ring the ring to read from.
+ * @param[out] span the start of the readable span.
+ *
+ * @return the span length in bytes, zero if the ring is empty.
+ */
+size_t SFTCoreByteRingReadableSpan(SFTCoreByteRing *ring,
+                                   const uint8_t **span);
+
+/**
+ * Consumer: releases bytes read from the span previously returned by
+ * SFTCoreByteRingReadableSpan.
+ *
+ * @param[in,out] ring the ring read from.
+ * @param[in] count the amount of bytes consumed, at most the span length.
+ */
+void SFTCoreByteRingCommitRead(SFTCoreByteRing *ring, size_t count);
+
+/**
+ * Consumer: drops every byte currently waiting in the ring.
+ *
+ * @param[in,out] ring the ring to empty.
+ *
+ * @return the amount of bytes dropped.
+ */
+size_t SFTCoreByteRingDiscard(SFTCoreByteRing *ring);
+
+/**
+ * Consumer: checks whether a suspended producer has to be woken up, after
+ * some bytes were consumed.
+ *
+ * @param[in,out] ring the ring read from.
+ *
+ * @return true if the producer was suspended and needs to be resumed.
+ */
+bool SFTCoreByteRingResumeProducer(SFTCoreByteRing *ring);
+
+#endif /* SFTCoreByteRing_h */
@@ -0,0 +1,819 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SFTCoreCapture.h"
+#include "SFTCoreScrollback.h"
+
+static const uint8_t kCaptureMagic[8] = {'S', 'F', 'T', 'C',
+                                         'A', 'P', 'T', '1'};
+static const uint8_t kIndexMagic[8] = {'S', 'F', 'T', 'C', 'I', 'D', 'X', '1'};
+
+#define kCaptureHeaderSize 16
+#define kIndexEntrySize 24
+#define kFooterSize 48
+#define kMaximumVarintSize 10
+
+/**
+ * Checkpoint header fields: width, height, row, column, background,
+ * foreground and flags.
+ */
+#define kCheckpointFieldsCount 7
+
+#define kCheckpointFlagASCII 0x01
+#define kCheckpointFlagLowerCase 0x02
+#define kCheckpointFlagReverse 0x04
+
+/**
+ * Size of the line links bitmap following the cells in a checkpoint, one bit
+ * per visible row.  Checkpoints written before line links existed end with
+ * the cells.
+ */
+#define SFTCoreCaptureLinksSize(height) (((height) + 7) / 8)
+
+/**
+ * Writer buffering, so that small packets do not turn into system calls.
+ */
+static const size_t kWriterBufferSize = 64 * 1024;
+
+static void SFTCoreCaptureStore64(uint8_t *buffer, uint64_t value) {
+  for (size_t index = 0; index < 8; index++) {
+    buffer[index] = (uint8_t)(value >> (index * 8));
+  }
+}
+
+static uint64_t SFTCoreCaptureLoad64(const uint8_t *buffer) {
+  uint64_t value = 0;
+  for (size_t index = 0; index < 8; index++) {
+    value |= (uint64_t)buffer[index] << (index * 8);
+  }
+  return value;
+}
+
+static size_t SFTCoreCaptureEncodeVarint(uint8_t *buffer, uint64_t value) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    buffer[length++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  buffer[length++] = (uint8_t)value;
+  return length;
+}
+
+static bool SFTCoreCaptureDecodeVarint(const uint8_t *bytes, size_t end,
+                                       size_t *offset, uint64_t *value) {
+  uint64_t result = 0;
+  for (size_t index = 0; index < kMaximumVarintSize; index++) {
+    if (*offset >= end) {
+      return false;
+    }
+
+    uint8_t byte = bytes[(*offset)++];
+    result |= (uint64_t)(byte & 0x7F) << (index * 7);
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool SFTCoreCaptureWriterAddEntry(SFTCoreCaptureIndexEntry **entries,
+                                         size_t *count, size_t *capacity,
+                                         uint64_t offset, uint64_t timestamp,
+                                         uint64_t inboundOffset) {
+  if (*count == *capacity) {
+    size_t newCapacity = (*capacity > 0) ? *capacity * 2 : 64;
+    SFTCoreCaptureIndexEntry *newEntries = (SFTCoreCaptureIndexEntry *)realloc(
+        *entries, newCapacity * sizeof(SFTCoreCaptureIndexEntry));
+    if (newEntries == NULL) {
+      return false;
+    }
+    *entries = newEntries;
+    *capacity = newCapacity;
+  }
+
+  (*entries)[*count].offset = offset;
+  (*entries)[*count].timestamp = timestamp;
+  (*entries)[*count].inboundOffset = inboundOffset;
+  (*count)++;
+  return true;
+}
+
+static void SFTCoreCaptureWriterPut(SFTCoreCaptureWriter *writer,
+                                    const uint8_t *bytes, size_t length) {
+  if (writer->failed) {
+    return;
+  }
+
+  if (fwrite(bytes, 1, length, writer->file) != length) {
+    writer->failed = true;
+    return;
+  }
+  writer->offset += length;
+}
+
+static void SFTCoreCaptureWriterPutRecord(SFTCoreCaptureWriter *writer,
+                                          uint64_t timestamp,
+                                          SFTCoreCaptureRecordKind kind,
+                                          const uint8_t *payload,
+                                          size_t length) {
+  uint8_t header[kMaximumVarintSize * 2];
+  size_t headerLength = SFTCoreCaptureEncodeVarint(
+      header, timestamp - writer->lastTimestamp);
+  headerLength += SFTCoreCaptureEncodeVarint(
+      header + headerLength, ((uint64_t)length << 2) | (uint64_t)kind);
+
+  SFTCoreCaptureWriterPut(writer, header, headerLength);
+  SFTCoreCaptureWriterPut(writer, payload, length);
+  writer->lastTimestamp = timestamp;
+}
+
+static uint64_t
+SFTCoreCaptureWriterTimestamp(const SFTCoreCaptureWriter *writer,
+                              uint64_t now) {
+  // Wall clock adjustments must not make time go backwards in the capture.
+  uint64_t timestamp =
+      (now > writer->startTime) ? (now - writer->startTime) / 1000 : 0;
+  return (timestamp > writer->lastTimestamp) ? timestamp
+                                             : writer->lastTimestamp;
+}
+
+static void SFTCoreCaptureWriterPutCheckpoint(SFTCoreCaptureWriter *writer,
+                                              uint64_t timestamp) {
+  if (!SFTCoreCaptureWriterAddEntry(
+          &writer->checkpoints, &writer->checkpointsCount,
+          &writer->checkpointsCapacity, writer->offset, timestamp,
+          writer->inboundLength)) {
+    writer->failed = true;
+    return;
+  }
+
+  const SFTCoreEmulatorState *state = &writer->state;
+  uint64_t fields[kCheckpointFieldsCount] = {
+      state->width,
+      state->height,
+      state->row,
+      state->column,
+      state->background,
+      state->foreground,
+      (state->isInASCIIMode ? kCheckpointFlagASCII : 0) |
+          (state->useLowerCase ? kCheckpointFlagLowerCase : 0) |
+          (state->reverseVideo ? kCheckpointFlagReverse : 0)};
+
+  uint8_t *buffer = writer->checkpointBuffer;
+  size_t length = 0;
+  for (size_t index = 0; index < kCheckpointFieldsCount; index++) {
+    length += SFTCoreCaptureEncodeVarint(buffer + length, fields[index]);
+  }
+
+  // Rows are stored in visible order, so that checkpoints do not depend on
+  // where the cell buffer ring happened to start.
+  for (size_t row = 0; row < state->height; row++) {
+    const SFTTerminalEmulatorCell *cells =
+        writer->cells + (SFTCoreEmulatorPhysicalRow(state, row) * state->width);
+    for (size_t column = 0; column < state->width; column++) {
+      uint32_t cell = cells[column];
+      buffer[length++] = (uint8_t)cell;
+      buffer[length++] = (uint8_t)(cell >> 8);
+      buffer[length++] = (uint8_t)(cell >> 16);
+      buffer[length++] = (uint8_t)(cell >> 24);
+    }
+  }
+
+  uint8_t *links = buffer + length;
+  memset(links, 0, SFTCoreCaptureLinksSize(state->height));
+  for (size_t row = 0; row < state->height; row++) {
+    if (SFTCoreEmulatorIsRowLinked(state,
+                                   SFTCoreEmulatorPhysicalRow(state, row))) {
+      links[row / 8] |= (uint8_t)(1 << (row % 8));
+    }
+  }
+  length += SFTCoreCaptureLinksSize(state->height);
+
+  SFTCoreCaptureWriterPutRecord(writer, timestamp,
+                                SFTCoreCaptureRecordCheckpoint, buffer,
+                                length);
+}
+
+static void SFTCoreCaptureWriterRelease(SFTCoreCaptureWriter *writer) {
+  free(writer->packets);
+  free(writer->checkpoints);
+  free(writer->cells);
+  free(writer->checkpointBuffer);
+  memset(writer, 0, sizeof(SFTCoreCaptureWriter));
+}
+
+bool SFTCoreCaptureWriterOpen(SFTCoreCaptureWriter *writer, const char *path,
+                              const SFTCoreEmulatorState *state,
+                              const SFTTerminalEmulatorCell *cells,
+                              size_t interval, uint64_t now) {
+  memset(writer, 0, sizeof(SFTCoreCaptureWriter));
+  if (interval == 0) {
+    return false;
+  }
+
+  size_t screenSize = state->width * state->height;
+  writer->cells = (SFTTerminalEmulatorCell *)malloc(
+      screenSize * sizeof(SFTTerminalEmulatorCell));
+  writer->checkpointBuffer = (uint8_t *)malloc(
+      (kCheckpointFieldsCount * kMaximumVarintSize) +
+      (screenSize * sizeof(SFTTerminalEmulatorCell)) +
+      SFTCoreCaptureLinksSize(state->height));
+  if ((writer->cells == NULL) || (writer->checkpointBuffer == NULL)) {
+    SFTCoreCaptureWriterRelease(writer);
+    return false;
+  }
+
+  writer->file = fopen(path, "wb");
+  if (writer->file == NULL) {
+    SFTCoreCaptureWriterRelease(writer);
+    return false;
+  }
+  setvbuf(writer->file, NULL, _IOFBF, kWriterBufferSize);
+
+  writer->state = *state;
+  writer->state.bellCallback = NULL;
+  writer->state.userData = NULL;
+  writer->state.scrollback = NULL;
+  memcpy(writer->cells, cells, screenSize * sizeof(SFTTerminalEmulatorCell));
+  writer->startTime = now;
+  writer->checkpointInterval = interval;
+  writer->nextCheckpoint = interval;
+
+  uint8_t header[kCaptureHeaderSize];
+  memcpy(header, kCaptureMagic, sizeof(kCaptureMagic));
+  SFTCoreCaptureStore64(header + sizeof(kCaptureMagic), now / 1000);
+  SFTCoreCaptureWriterPut(writer, header, sizeof(header));
+  SFTCoreCaptureWriterPutCheckpoint(writer, 0);
+
+  if (writer->failed) {
+    fclose(writer->file);
+    SFTCoreCaptureWriterRelease(writer);
+    return false;
+  }
+
+  return true;
+}
+
+bool SFTCoreCaptureWriterAppend(SFTCoreCaptureWriter *writer, uint64_t now,
+                                SFTCoreCaptureRecordKind kind,
+                                const uint8_t *bytes, size_t length) {
+  if ((writer->file == NULL) || writer->failed ||
+      (kind == SFTCoreCaptureRecordCheckpoint)) {
+    return false;
+  }
+
+  if (length == 0) {
+    return true;
+  }
+
+  uint64_t timestamp = SFTCoreCaptureWriterTimestamp(writer, now);
+  if (((writer->dataRecordsCount % SFTCoreCaptureIndexStride) == 0) &&
+      !SFTCoreCaptureWriterAddEntry(&writer->packets, &writer->packetsCount,
+                                    &writer->packetsCapacity, writer->offset,
+                                    timestamp, writer->inboundLength)) {
+    writer->failed = true;
+    return false;
+  }
+
+  SFTCoreCaptureWriterPutRecord(writer, timestamp, kind, bytes, length);
+  writer->dataRecordsCount++;
+
+  if (kind == SFTCoreCaptureRecordInbound) {
+    SFTCoreEmulatorProcessIncomingData(&writer->state, writer->cells, bytes,
+                                       length);
+    writer->inboundLength += length;
+    if (writer->inboundLength >= writer->nextCheckpoint) {
+      SFTCoreCaptureWriterPutCheckpoint(writer, timestamp);
+      writer->nextCheckpoint =
+          writer->inboundLength + writer->checkpointInterval;
+    }
+  }
+
+  return !writer->failed;
+}
+
+static void
+SFTCoreCaptureWriterPutEntries(SFTCoreCaptureWriter *writer,
+                               const SFTCoreCaptureIndexEntry *entries,
+                               size_t count) {
+  for (size_t index = 0; index < count; index++) {
+    uint8_t buffer[kIndexEntrySize];
+    SFTCoreCaptureStore64(buffer, entries[index].offset);
+    SFTCoreCaptureStore64(buffer + 8, entries[index].timestamp);
+    SFTCoreCaptureStore64(buffer + 16, entries[index].inboundOffset);
+    SFTCoreCaptureWriterPut(writer, buffer, sizeof(buffer));
+  }
+}
+
+bool SFTCoreCaptureWriterClose(SFTCoreCaptureWriter *writer) {
+  if (writer->file == NULL) {
+    SFTCoreCaptureWriterRelease(writer);
+    return false;
+  }
+
+  uint64_t indexOffset = writer->offset;
+  SFTCoreCaptureWriterPutEntries(writer, writer->packets,
+                                 writer->packetsCount);
+  SFTCoreCaptureWriterPutEntries(writer, writer->checkpoints,
+                                 writer->checkpointsCount);
+
+  uint8_t footer[kFooterSize];
+  SFTCoreCaptureStore64(footer, indexOffset);
+  SFTCoreCaptureStore64(footer + 8, writer->packetsCount);
+  SFTCoreCaptureStore64(footer + 16, writer->checkpointsCount);
+  SFTCoreCaptureStore64(footer + 24, writer->inboundLength);
+  SFTCoreCaptureStore64(footer + 32, writer->lastTimestamp);
+  memcpy(footer + 40, kIndexMagic, sizeof(kIndexMagic));
+  SFTCoreCaptureWriterPut(writer, footer, sizeof(footer));
+
+  bool succeeded = !writer->failed;
+  if (fclose(writer->file) != 0) {
+    succeeded = false;
+  }
+
+  SFTCoreCaptureWriterRelease(writer);
+  return succeeded;
+}
+
+static bool SFTCoreCaptureReaderDecode(const SFTCoreCaptureReader *reader,
+                                       size_t offset, uint64_t timestamp,
+                                       uint64_t inboundOffset,
+                                       SFTCoreCaptureRecord *record) {
+  size_t cursor = offset;
+  uint64_t delta;
+  uint64_t tag;
+  if (!SFTCoreCaptureDecodeVarint(reader->bytes, reader->recordsEnd, &cursor,
+                                  &delta) ||
+      !SFTCoreCaptureDecodeVarint(reader->bytes, reader->recordsEnd, &cursor,
+                                  &tag) ||
+      ((tag & 0x03) > SFTCoreCaptureRecordCheckpoint) ||
+      ((tag >> 2) > reader->recordsEnd - cursor)) {
+    return false;
+  }
+
+  record->offset = offset;
+  record->timestamp = timestamp + delta;
+  record->inboundOffset = inboundOffset;
+  record->kind = (SFTCoreCaptureRecordKind)(tag & 0x03);
+  record->payload = reader->bytes + cursor;
+  record->length = (size_t)(tag >> 2);
+  return true;
+}
+
+static bool
+SFTCoreCaptureReaderDecodeEntry(const SFTCoreCaptureReader *reader,
+                                const SFTCoreCaptureIndexEntry *entry,
+                                SFTCoreCaptureRecord *record) {
+  if ((entry->offset < kCaptureHeaderSize) ||
+      !SFTCoreCaptureReaderDecode(reader, (size_t)entry->offset, 0,
+                                  entry->inboundOffset, record)) {
+    return false;
+  }
+
+  record->timestamp = entry->timestamp;
+  return true;
+}
+
+bool SFTCoreCaptureReaderNextRecord(const SFTCoreCaptureReader *reader,
+                                    const SFTCoreCaptureRecord *previous,
+                                    SFTCoreCaptureRecord *record) {
+  if (previous == NULL) {
+    return SFTCoreCaptureReaderDecode(reader, kCaptureHeaderSize, 0, 0, record);
+  }
+
+  size_t offset =
+      (size_t)(previous->payload - reader->bytes) + previous->length;
+  uint64_t inboundOffset =
+      previous->inboundOffset +
+      ((previous->kind == SFTCoreCaptureRecordInbound) ? previous->length : 0);
+  return SFTCoreCaptureReaderDecode(reader, offset, previous->timestamp,
+                                    inboundOffset, record);
+}
+
+static void SFTCoreCaptureReaderSetEndCursor(SFTCoreCaptureReader *reader) {
+  reader->cursor.offset = reader->recordsEnd;
+  reader->cursor.timestamp = reader->duration;
+  reader->cursor.inboundOffset = reader->inboundLength;
+  reader->cursor.kind = SFTCoreCaptureRecordInbound;
+  reader->cursor.payload = reader->bytes + reader->recordsEnd;
+  reader->cursor.length = 0;
+  reader->cursorConsumed = 0;
+}
+
+static bool SFTCoreCaptureReaderLoadIndex(SFTCoreCaptureReader *reader) {
+  if (reader->length < kCaptureHeaderSize + kFooterSize) {
+    return false;
+  }
+
+  const uint8_t *footer = reader->bytes + reader->length - kFooterSize;
+  if (memcmp(footer + 40, kIndexMagic, sizeof(kIndexMagic)) != 0) {
+    return false;
+  }
+
+  uint64_t indexOffset = SFTCoreCaptureLoad64(footer);
+  uint64_t packetsCount = SFTCoreCaptureLoad64(footer + 8);
+  uint64_t checkpointsCount = SFTCoreCaptureLoad64(footer + 16);
+  uint64_t indexLimit = reader->length / kIndexEntrySize;
+  if ((indexOffset < kCaptureHeaderSize) || (packetsCount > indexLimit) ||
+      (checkpointsCount > indexLimit) ||
+      (indexOffset + ((packetsCount + checkpointsCount) * kIndexEntrySize) !=
+       reader->length - kFooterSize)) {
+    return false;
+  }
+
+  reader->packets = (SFTCoreCaptureIndexEntry *)calloc(
+      (size_t)packetsCount + 1, sizeof(SFTCoreCaptureIndexEntry));
+  reader->checkpoints = (SFTCoreCaptureIndexEntry *)calloc(
+      (size_t)checkpointsCount + 1, sizeof(SFTCoreCaptureIndexEntry));
+  if ((reader->packets == NULL) || (reader->checkpoints == NULL)) {
+    return false;
+  }
+
+  const uint8_t *entry = reader->bytes + indexOffset;
+  for (size_t index = 0; index < packetsCount; index++) {
+    reader->packets[index].offset = SFTCoreCaptureLoad64(entry);
+    reader->packets[index].timestamp = SFTCoreCaptureLoad64(entry + 8);
+    reader->packets[index].inboundOffset = SFTCoreCaptureLoad64(entry + 16);
+    entry += kIndexEntrySize;
+  }
+  for (size_t index = 0; index < checkpointsCount; index++) {
+    reader->checkpoints[index].offset = SFTCoreCaptureLoad64(entry);
+    reader->checkpoints[index].timestamp = SFTCoreCaptureLoad64(entry + 8);
+    reader->checkpoints[index].inboundOffset =
+        SFTCoreCaptureLoad64(entry + 16);
+    entry += kIndexEntrySize;
+  }
+
+  reader->packetsCount = (size_t)packetsCount;
+  reader->checkpointsCount = (size_t)checkpointsCount;
+  reader->recordsEnd = (size_t)indexOffset;
+  reader->inboundLength = SFTCoreCaptureLoad64(footer + 24);
+  reader->duration = SFTCoreCaptureLoad64(footer + 32);
+  return true;
+}
+
+static bool SFTCoreCaptureReaderRebuildIndex(SFTCoreCaptureReader *reader) {
+  size_t packetsCapacity = 0;
+  size_t checkpointsCapacity = 0;
+  size_t dataRecordsCount = 0;
+
+  reader->recordsEnd = reader->length;
+  size_t end = kCaptureHeaderSize;
+  SFTCoreCaptureRecord record;
+  bool found = SFTCoreCaptureReaderNextRecord(reader, NULL, &record);
+  while (found) {
+    bool added = true;
+    if (record.kind == SFTCoreCaptureRecordCheckpoint) {
+      added = SFTCoreCaptureWriterAddEntry(
+          &reader->checkpoints, &reader->checkpointsCount,
+          &checkpointsCapacity, record.offset, record.timestamp,
+          record.inboundOffset);
+    } else if ((dataRecordsCount++ % SFTCoreCaptureIndexStride) == 0) {
+      added = SFTCoreCaptureWriterAddEntry(
+          &reader->packets, &reader->packetsCount, &packetsCapacity,
+          record.offset, record.timestamp, record.inboundOffset);
+    }
+    if (!added) {
+      return false;
+    }
+
+    end = (size_t)(record.payload - reader->bytes) + record.length;
+    reader->duration = record.timestamp;
+    reader->inboundLength =
+        record.inboundOffset +
+        ((record.kind == SFTCoreCaptureRecordInbound) ? record.length : 0);
+
+    SFTCoreCaptureRecord next;
+    found = SFTCoreCaptureReaderNextRecord(reader, &record, &next);
+    record = next;
+  }
+
+  // A partially written record is dropped along with anything after it.
+  reader->recordsEnd = end;
+  return true;
+}
+
+static void SFTCoreCaptureReaderReleaseIndex(SFTCoreCaptureReader *reader) {
+  free(reader->packets);
+  free(reader->checkpoints);
+  reader->packets = NULL;
+  reader->checkpoints = NULL;
+  reader->packetsCount = 0;
+  reader->checkpointsCount = 0;
+}
+
+static bool SFTCoreCaptureReaderLoad(SFTCoreCaptureReader *reader) {
+  if ((reader->length < kCaptureHeaderSize) ||
+      (memcmp(reader->bytes, kCaptureMagic, sizeof(kCaptureMagic)) != 0)) {
+    return false;
+  }
+
+  reader->startTime = SFTCoreCaptureLoad64(reader->bytes + 8);
+  if (!SFTCoreCaptureReaderLoadIndex(reader)) {
+    SFTCoreCaptureReaderReleaseIndex(reader);
+    if (!SFTCoreCaptureReaderRebuildIndex(reader)) {
+      SFTCoreCaptureReaderReleaseIndex(reader);
+      return false;
+    }
+  }
+
+  if (!SFTCoreCaptureReaderNextRecord(reader, NULL, &reader->cursor)) {
+    SFTCoreCaptureReaderSetEndCursor(reader);
+  }
+  reader->cursorConsumed = 0;
+  return true;
+}
+
+bool SFTCoreCaptureReaderOpen(SFTCoreCaptureReader *reader, const char *path) {
+  memset(reader, 0, sizeof(SFTCoreCaptureReader));
+
+  int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) {
+    return false;
+  }
+
+  struct stat information;
+  if ((fstat(descriptor, &information) != 0) ||
+      (information.st_size < kCaptureHeaderSize)) {
+    close(descriptor);
+    return false;
+  }
+
+  void *bytes = mmap(NULL, (size_t)information.st_size, PROT_READ,
+                     MAP_PRIVATE, descriptor, 0);
+  close(descriptor);
+  if (bytes == MAP_FAILED) {
+    return false;
+  }
+
+  reader->bytes = (const uint8_t *)bytes;
+  reader->length = (size_t)information.st_size;
+  reader->isMapped = true;
+  if (!SFTCoreCaptureReaderLoad(reader)) {
+    SFTCoreCaptureReaderClose(reader);
+    return false;
+  }
+
+  return true;
+}
+
+bool SFTCoreCaptureReaderOpenMemory(SFTCoreCaptureReader *reader,
+                                    const uint8_t *bytes, size_t length) {
+  memset(reader, 0, sizeof(SFTCoreCaptureReader));
+  reader->bytes = bytes;
+  reader->length = length;
+  if (!SFTCoreCaptureReaderLoad(reader)) {
+    SFTCoreCaptureReaderClose(reader);
+    return false;
+  }
+
+  return true;
+}
+
+void SFTCoreCaptureReaderClose(SFTCoreCaptureReader *reader) {
+  if (reader->isMapped) {
+    munmap((void *)reader->bytes, reader->length);
+  }
+
+  SFTCoreCaptureReaderReleaseIndex(reader);
+  memset(reader, 0, sizeof(SFTCoreCaptureReader));
+}
+
+/**
+ * Returns the index of the last entry whose field is not past the given
+ * value, entries being sorted by both timestamp and inbound offset.
+ */
+static size_t SFTCoreCaptureFindEntry(const SFTCoreCaptureIndexEntry *entries,
+                                      size_t count, uint64_t value,
+                                      bool byTimestamp) {
+  size_t low = 0;
+  size_t high = count;
+  while (low < high) {
+    size_t middle = low + ((high - low) / 2);
+    uint64_t key = byTimestamp ? entries[middle].timestamp
+                               : entries[middle].inboundOffset;
+    if (key <= value) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return (low > 0) ? low - 1 : count;
+}
+
+uint64_t SFTCoreCaptureReaderOffsetAtTime(const SFTCoreCaptureReader *reader,
+                                          uint64_t timestamp) {
+  size_t index = SFTCoreCaptureFindEntry(reader->packets,
+                                         reader->packetsCount, timestamp, true);
+
+  SFTCoreCaptureRecord record;
+  bool found = (index < reader->packetsCount)
+                   ? SFTCoreCaptureReaderDecodeEntry(
+                         reader, &reader->packets[index], &record)
+                   : SFTCoreCaptureReaderNextRecord(reader, NULL, &record);
+  while (found) {
+    if (record.timestamp >= timestamp) {
+      return record.inboundOffset;
+    }
+
+    SFTCoreCaptureRecord next;
+    found = SFTCoreCaptureReaderNextRecord(reader, &record, &next);
+    record = next;
+  }
+
+  return reader->inboundLength;
+}
+
+static bool SFTCoreCaptureRestoreCheckpoint(const SFTCoreCaptureRecord *record,
+                                            SFTCoreEmulatorState *state,
+                                            SFTTerminalEmulatorCell *cells) {
+  uint64_t fields[kCheckpointFieldsCount];
+  size_t offset = 0;
+  for (size_t index = 0; index < kCheckpointFieldsCount; index++) {
+    if (!SFTCoreCaptureDecodeVarint(record->payload, record->length, &offset,
+                                    &fields[index])) {
+      return false;
+    }
+  }
+
+  size_t screenSize =
+      state->width * state->height * sizeof(SFTTerminalEmulatorCell);
+  size_t payloadSize = record->length - offset;
+  if ((fields[0] != state->width) || (fields[1] != state->height) ||
+      (fields[2] >= state->height) || (fields[3] >= state->width) ||
+      ((payloadSize != screenSize) &&
+       (payloadSize !=
+        screenSize + SFTCoreCaptureLinksSize(state->height)))) {
+    return false;
+  }
+
+  state->row = (size_t)fields[2];
+  state->column = (size_t)fields[3];
+  state->baseRow = 0;
+  state->background = (uint8_t)fields[4];
+  state->foreground = (uint8_t)fields[5];
+  state->isInASCIIMode = (fields[6] & kCheckpointFlagASCII) != 0;
+  state->useLowerCase = (fields[6] & kCheckpointFlagLowerCase) != 0;
+  state->reverseVideo = (fields[6] & kCheckpointFlagReverse) != 0;
+
+  const uint8_t *bytes = record->payload + offset;
+  for (size_t index = 0; index < state->width * state->height; index++) {
+    cells[index] = (SFTTerminalEmulatorCell)bytes[0] |
+                   ((SFTTerminalEmulatorCell)bytes[1] << 8) |
+                   ((SFTTerminalEmulatorCell)bytes[2] << 16) |
+                   ((SFTTerminalEmulatorCell)bytes[3] << 24);
+    bytes += sizeof(SFTTerminalEmulatorCell);
+  }
+
+  memset(state->linkedRows, 0, sizeof(state->linkedRows));
+  if (payloadSize > screenSize) {
+    for (size_t row = 0; row < state->height; row++) {
+      if ((bytes[row / 8] & (1 << (row % 8))) != 0) {
+        state->linkedRows[row / 64] |= UINT64_C(1) << (row % 64);
+      }
+    }
+  }
+
+  return true;
+}
+
+bool SFTCoreCaptureReaderSeek(SFTCoreCaptureReader *reader,
+                              SFTCoreEmulatorState *state,
+                              SFTTerminalEmulatorCell *cells, uint64_t offset) {
+  if (offset > reader->inboundLength) {
+    offset = reader->inboundLength;
+  }
+
+  size_t index = SFTCoreCaptureFindEntry(
+      reader->checkpoints, reader->checkpointsCount, offset, false);
+  SFTCoreCaptureRecord record;
+  if ((index >= reader->checkpointsCount) ||
+      !SFTCoreCaptureReaderDecodeEntry(reader, &reader->checkpoints[index],
+                                       &record) ||
+      (record.kind != SFTCoreCaptureRecordCheckpoint)) {
+    return false;
+  }
+
+  SFTCoreEmulatorState restored = *state;
+  restored.bellCallback = NULL;
+  restored.userData = NULL;
+  restored.scrollback = NULL;
+  if (!SFTCoreCaptureRestoreCheckpoint(&record, &restored, cells)) {
+    return false;
+  }
+
+  SFTCoreCaptureReaderSetEndCursor(reader);
+  SFTCoreCaptureRecord next;
+  while (SFTCoreCaptureReaderNextRecord(reader, &record, &next)) {
+    record = next;
+    if (record.kind != SFTCoreCaptureRecordInbound) {
+      continue;
+    }
+
+    if (record.inboundOffset + record.length > offset) {
+      size_t count = (size_t)(offset - record.inboundOffset);
+      SFTCoreEmulatorProcessIncomingData(&restored, cells, record.payload,
+                                         count);
+      reader->cursor = record;
+      reader->cursorConsumed = count;
+      break;
+    }
+
+    SFTCoreEmulatorProcessIncomingData(&restored, cells, record.payload,
+                                       record.length);
+  }
+
+  restored.bellCallback = state->bellCallback;
+  restored.userData = state->userData;
+  restored.scrollback = state->scrollback;
+  if (restored.scrollback != NULL) {
+    // History before the checkpoint is unknown, so it is not kept at all.
+    SFTCoreScrollbackClear(restored.scrollback);
+  }
+  *state = restored;
+  SFTCoreEmulatorMarkAllRowsDirty(state);
+  return true;
+}
+
+void SFTCoreCaptureReaderStartClock(SFTCoreCaptureReader *reader,
+                                    uint64_t now) {
+  reader->clockOrigin = now;
+  reader->clockTimestamp = reader->cursor.timestamp;
+}
+
+static void SFTCoreCaptureReaderAdvance(SFTCoreCaptureReader *reader) {
+  SFTCoreCaptureRecord next;
+  if (!SFTCoreCaptureReaderNextRecord(reader, &reader->cursor, &next)) {
+    SFTCoreCaptureReaderSetEndCursor(reader);
+    return;
+  }
+
+  // Long pauses are shortened by moving the clock past them.
+  uint64_t gap = next.timestamp - reader->cursor.timestamp;
+  if ((reader->maximumGap > 0) && (gap > reader->maximumGap)) {
+    reader->clockTimestamp += gap - reader->maximumGap;
+  }
+
+  reader->cursor = next;
+  reader->cursorConsumed = 0;
+}
+
+size_t SFTCoreCaptureReaderNextBatch(SFTCoreCaptureReader *reader,
+                                     uint64_t now, const uint8_t **bytes) {
+  while (!SFTCoreCaptureReaderIsFinished(reader)) {
+    const SFTCoreCaptureRecord *cursor = &reader->cursor;
+    if ((cursor->timestamp > reader->clockTimestamp) &&
+        ((now < reader->clockOrigin) ||
+         ((now - reader->clockOrigin) / 1000 <
+          cursor->timestamp - reader->clockTimestamp))) {
+      return 0;
+    }
+
+    if ((cursor->kind != SFTCoreCaptureRecordInbound) ||
+        (reader->cursorConsumed >= cursor->length)) {
+      SFTCoreCaptureReaderAdvance(reader);
+      continue;
+    }
+
+    *bytes = cursor->payload + reader->cursorConsumed;
+    return cursor->length - reader->cursorConsumed;
+  }
+
+  return 0;
+}
+
+void SFTCoreCaptureReaderConsume(SFTCoreCaptureReader *reader, size_t count) {
+  reader->cursorConsumed += count;
+  if (reader->cursorConsumed >= reader->cursor.length) {
+    SFTCoreCaptureReaderAdvance(reader);
+  }
+}
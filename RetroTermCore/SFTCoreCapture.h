@@ -0,0 +1,395 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreCapture_h
+#define SFTCoreCapture_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "SFTCoreCell.h"
+#include "SFTCoreEmulator.h"
+
+/*
+ * Session capture file layout, all integers being little endian:
+ *
+ * - header: the "SFTCAPT1" magic, followed by the capture start time as a
+ *   64 bits count of microseconds since the Unix epoch.
+ * - records, one after the other: a varint with the microseconds elapsed
+ *   since the previous record, a varint holding the payload length shifted
+ *   left by two bits ORed with the record kind, and then the payload.
+ * - index, written when the capture is closed: the packet index entries,
+ *   the checkpoint index entries, and a footer holding the index offset,
+ *   both entry counts, the inbound bytes count, the capture duration and
+ *   the "SFTCIDX1" magic, each as a 64 bits integer.
+ *
+ * Captures whose writer never got to close them have no index, which is then
+ * rebuilt by scanning every complete record.
+ */
+
+/**
+ * Default amount of inbound bytes between two screen checkpoints.
+ */
+#define SFTCoreCaptureDefaultCheckpointInterval (64 * 1024)
+
+/**
+ * Data records between two packet index entries.
+ */
+#define SFTCoreCaptureIndexStride 64
+
+/**
+ * Kind of a capture record.
+ */
+typedef enum {
+  /**
+   * Bytes received from the remote end.
+   */
+  SFTCoreCaptureRecordInbound = 0,
+
+  /**
+   * Bytes sent to the remote end.
+   */
+  SFTCoreCaptureRecordOutbound,
+
+  /**
+   * Serialised emulator state, screen contents and line links.
+   */
+  SFTCoreCaptureRecordCheckpoint
+} SFTCoreCaptureRecordKind;
+
+/**
+ * A decoded capture record, pointing into the capture contents.
+ */
+typedef struct {
+  /**
+   * Record offset in the capture file.
+   */
+  size_t offset;
+
+  /**
+   * Microseconds elapsed since the capture start.
+   */
+  uint64_t timestamp;
+
+  /**
+   * Inbound bytes recorded before this record.
+   */
+  uint64_t inboundOffset;
+
+  SFTCoreCaptureRecordKind kind;
+  const uint8_t *payload;
+  size_t length;
+} SFTCoreCaptureRecord;
+
+/**
+ * Capture index entry, locating a record without scanning from the start.
+ */
+typedef struct {
+  uint64_t offset;
+  uint64_t timestamp;
+  uint64_t inboundOffset;
+} SFTCoreCaptureIndexEntry;
+
+/**
+ * Append-only capture writer.
+ *
+ * Inbound bytes are also fed to a private emulator, whose state is written
+ * as a checkpoint record every checkpointInterval inbound bytes.  Only the
+ * index is kept in memory until the capture is closed.
+ */
+typedef struct {
+  FILE *file;
+
+  /**
+   * Time the capture started at, in nanoseconds since the Unix epoch.
+   */
+  uint64_t startTime;
+
+  /**
+   * Timestamp of the last record written, in microseconds.
+   */
+  uint64_t lastTimestamp;
+
+  /**
+   * Bytes written so far, that is the offset of the next record.
+   */
+  uint64_t offset;
+
+  uint64_t inboundLength;
+  size_t dataRecordsCount;
+
+  SFTCoreCaptureIndexEntry *packets;
+  size_t packetsCount;
+  size_t packetsCapacity;
+
+  SFTCoreCaptureIndexEntry *checkpoints;
+  size_t checkpointsCount;
+  size_t checkpointsCapacity;
+
+  SFTCoreEmulatorState state;
+  SFTTerminalEmulatorCell *cells;
+  uint8_t *checkpointBuffer;
+  size_t checkpointInterval;
+  uint64_t nextCheckpoint;
+
+  /**
+   * Whether a write failed, after which nothing else is recorded.
+   */
+  bool failed;
+} SFTCoreCaptureWriter;
+
+/**
+ * Capture being read, either memory mapped from disk or borrowed from
+ * memory, with a cursor delivering inbound bytes with their original timing.
+ */
+typedef struct {
+  const uint8_t *bytes;
+  size_t length;
+
+  /**
+   * Whether bytes were mapped by SFTCoreCaptureReaderOpen.
+   */
+  bool isMapped;
+
+  /**
+   * Time the capture started at, in microseconds since the Unix epoch.
+   */
+  uint64_t startTime;
+
+  /**
+   * Offset right past the last complete record.
+   */
+  size_t recordsEnd;
+
+  uint64_t inboundLength;
+
+  /**
+   * Timestamp of the last record, in microseconds.
+   */
+  uint64_t duration;
+
+  SFTCoreCaptureIndexEntry *packets;
+  size_t packetsCount;
+  SFTCoreCaptureIndexEntry *checkpoints;
+  size_t checkpointsCount;
+
+  /**
+   * Record being delivered, with length zero and offset recordsEnd once the
+   * capture is over.
+   */
+  SFTCoreCaptureRecord cursor;
+
+  /**
+   * Cursor payload bytes already delivered.
+   */
+  size_t cursorConsumed;
+
+  /**
+   * Time, in nanoseconds, at which clockTimestamp is due.
+   */
+  uint64_t clockOrigin;
+  uint64_t clockTimestamp;
+
+  /**
+   * Longest pause kept when delivering, in microseconds, zero keeping every
+   * pause as recorded.
+   */
+  uint64_t maximumGap;
+} SFTCoreCaptureReader;
+
+/**
+ * Creates a capture file and records the given screen as its first
+ * checkpoint.
+ *
+ * @param[out] writer the writer to initialise.
+ * @param[in] path the capture file path, truncated if it already exists.
+ * @param[in] state the emulator state the session starts from.
+ * @param[in] cells the screen contents the session starts from.
+ * @param[in] interval inbound bytes between two checkpoints.
+ * @param[in] now the current time, in nanoseconds since the Unix epoch.
+ *
+ * @return true if the capture was created, false otherwise.
+ */
+bool SFTCoreCaptureWriterOpen(SFTCoreCaptureWriter *writer, const char *path,
+                              const SFTCoreEmulatorState *state,
+                              const SFTTerminalEmulatorCell *cells,
+                              size_t interval, uint64_t now);
+
+/**
+ * Appends a data record to the capture.
+ *
+ * @param[in,out] writer the writer to append to.
+ * @param[in] now the current time, in nanoseconds since the Unix epoch.
+ * @param[in] kind either SFTCoreCaptureRecordInbound or
+ * SFTCoreCaptureRecordOutbound.
+ * @param[in] bytes the packet contents.
+ * @param[in] length the packet length, in bytes.
+ *
+ * @return true if the record was written, false otherwise.
+ */
+bool SFTCoreCaptureWriterAppend(SFTCoreCaptureWriter *writer, uint64_t now,
+                                SFTCoreCaptureRecordKind kind,
+                                const uint8_t *bytes, size_t length);
+
+/**
+ * Writes the index and closes the capture file.
+ *
+ * @param[in,out] writer the writer to close.
+ *
+ * @return true if the capture was completely written, false otherwise.
+ */
+bool SFTCoreCaptureWriterClose(SFTCoreCaptureWriter *writer);
+
+/**
+ * Opens the given capture file, mapping it in memory.
+ *
+ * @param[out] reader the reader to initialise.
+ * @param[in] path the capture file path.
+ *
+ * @return true if the file is a capture, false otherwise.
+ */
+bool SFTCoreCaptureReaderOpen(SFTCoreCaptureReader *reader, const char *path);
+
+/**
+ * Initialises a reader over a capture already in memory, which must outlive
+ * the reader.
+ *
+ * @param[out] reader the reader to initialise.
+ * @param[in] bytes the capture contents.
+ * @param[in] length the capture length, in bytes.
+ *
+ * @return true if the contents are a capture, false otherwise.
+ */
+bool SFTCoreCaptureReaderOpenMemory(SFTCoreCaptureReader *reader,
+                                    const uint8_t *bytes, size_t length);
+
+/**
+ * Releases everything held by the given reader.
+ *
+ * @param[in,out] reader the reader to close.
+ */
+void SFTCoreCaptureReaderClose(SFTCoreCaptureReader *reader);
+
+/**
+ * Decodes the record following the given one.
+ *
+ * @param[in] reader the reader to decode from.
+ * @param[in] previous the previous record, or NULL for the first record.
+ * @param[out] record the decoded record.
+ *
+ * @return true if a record was decoded, false at the end of the capture.
+ */
+bool SFTCoreCaptureReaderNextRecord(const SFTCoreCaptureReader *reader,
+                                    const SFTCoreCaptureRecord *previous,
+                                    SFTCoreCaptureRecord *record);
+
+/**
+ * Finds the first inbound byte recorded at or after the given time.
+ *
+ * @param[in] reader the reader to search.
+ * @param[in] timestamp microseconds since the capture start.
+ *
+ * @return the inbound byte offset.
+ */
+uint64_t SFTCoreCaptureReaderOffsetAtTime(const SFTCoreCaptureReader *reader,
+                                          uint64_t timestamp);
+
+/**
+ * Rebuilds the screen as it was after the given amount of inbound bytes,
+ * starting from the nearest checkpoint, and moves the cursor there.
+ *
+ * The bell callback, its user data and the parser mode are left untouched,
+ * and the bell is not rung while catching up.
+ *
+ * @param[in,out] reader the reader to seek.
+ * @param[in,out] state the emulator state to overwrite.
+ * @param[out] cells the screen contents to overwrite.
+ * @param[in] offset the inbound byte offset, clamped to the inbound length.
+ *
+ * @return true if the screen was rebuilt, false if the capture has no
+ * usable checkpoint for the given screen size.
+ */
+bool SFTCoreCaptureReaderSeek(SFTCoreCaptureReader *reader,
+                              SFTCoreEmulatorState *state,
+                              SFTTerminalEmulatorCell *cells, uint64_t offset);
+
+/**
+ * Makes the record under the cursor due at the given time.
+ *
+ * @param[in,out] reader the reader to change.
+ * @param[in] now the current time, in nanoseconds.
+ */
+void SFTCoreCaptureReaderStartClock(SFTCoreCaptureReader *reader,
+                                    uint64_t now);
+
+/**
+ * Returns the inbound bytes due for delivery by now, as a span into the
+ * capture never crossing a record boundary.
+ *
+ * @param[in,out] reader the reader to read from.
+ * @param[in] now the current time, in nanoseconds.
+ * @param[out] bytes the start of the span.
+ *
+ * @return the span length, zero if nothing is due or the capture is over.
+ */
+size_t SFTCoreCaptureReaderNextBatch(SFTCoreCaptureReader *reader,
+                                     uint64_t now, const uint8_t **bytes);
+
+/**
+ * Marks the given amount of bytes returned by SFTCoreCaptureReaderNextBatch
+ * as delivered.
+ *
+ * @param[in,out] reader the reader read from.
+ * @param[in] count the amount of bytes delivered.
+ */
+void SFTCoreCaptureReaderConsume(SFTCoreCaptureReader *reader, size_t count);
+
+/**
+ * Returns the amount of inbound bytes delivered so far.
+ *
+ * @param[in] reader the reader to check.
+ *
+ * @return the inbound offset of the next byte to deliver.
+ */
+static inline uint64_t
+SFTCoreCaptureReaderPosition(const SFTCoreCaptureReader *reader) {
+  return reader->cursor.inboundOffset +
+         ((reader->cursor.kind == SFTCoreCaptureRecordInbound)
+              ? reader->cursorConsumed
+              : 0);
+}
+
+/**
+ * Checks whether every inbound byte in the capture was delivered.
+ *
+ * @param[in] reader the reader to check.
+ *
+ * @return true if the capture is over, false otherwise.
+ */
+static inline bool
+SFTCoreCaptureReaderIsFinished(const SFTCoreCaptureReader *reader) {
+  return SFTCoreCaptureReaderPosition(reader) >= reader->inboundLength;
+}
+
+#endif /* SFTCoreCapture_h */
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreCell_h
+#define SFTCoreCell_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * A single screen cell, packed as follows:
+ *
+ * - bits  0..7:  font index.
+ * - bits  8..11: foreground colour.
+ * - bits 12..15: background colour.
+ * - bit  16:     reverse video flag.
+ */
+typedef uint32_t SFTTerminalEmulatorCell;
+
+#define SFTTerminalEmulatorCellMake(character, foreground, background,         \
+                                    reverse)                                   \
+  (SFTTerminalEmulatorCell)(((character)&0xFF) + (((foreground)&0x0F) << 8) +  \
+                            (((background)&0x0F) << 12) +                      \
+                            (((reverse)&0x01) << 16))
+#define SFTTerminalEmulatorCellGetCharacter(cell) ((uint8_t)((cell)&0xFF))
+#define SFTTerminalEmulatorCellGetForeground(cell)                             \
+  ((uint8_t)(((cell) >> 8) & 0x0F))
+#define SFTTerminalEmulatorCellGetBackground(cell)                             \
+  ((uint8_t)(((cell) >> 12) & 0x0F))
+#define SFTTerminalEmulatorCellGetReverse(cell) ((bool)(((cell) >> 16) & 0x01))
+
+#endif /* SFTCoreCell_h */
@@ -0,0 +1,282 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "SFTCoreCellKernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SFT_CORE_CELL_KERNELS_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SFT_CORE_CELL_KERNELS_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SFT_CORE_CELL_KERNELS_NEON 1
+#endif
+
+#if defined(SFT_CORE_CELL_KERNELS_AVX2)
+
+const char *const SFTCoreCellKernelsInstructionSet = "avx2";
+
+void SFTCoreCellFill(SFTTerminalEmulatorCell *cells, size_t count,
+                     SFTTerminalEmulatorCell cell) {
+  __m256i value = _mm256_set1_epi32((int)cell);
+  size_t index = 0;
+
+  for (; index + 16 <= count; index += 16) {
+    _mm256_storeu_si256((__m256i *)(cells + index), value);
+    _mm256_storeu_si256((__m256i *)(cells + index + 8), value);
+  }
+  if (index + 8 <= count) {
+    _mm256_storeu_si256((__m256i *)(cells + index), value);
+    index += 8;
+  }
+  for (; index < count; index++) {
+    cells[index] = cell;
+  }
+}
+
+void SFTCoreCellPack(SFTTerminalEmulatorCell *cells, const uint8_t *glyphs,
+                     size_t count, SFTTerminalEmulatorCell attributes) {
+  __m256i value = _mm256_set1_epi32((int)attributes);
+  size_t index = 0;
+
+  for (; index + 16 <= count; index += 16) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)(glyphs + index));
+    __m256i low = _mm256_cvtepu8_epi32(bytes);
+    __m256i high = _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8));
+    _mm256_storeu_si256((__m256i *)(cells + index),
+                        _mm256_or_si256(low, value));
+    _mm256_storeu_si256((__m256i *)(cells + index + 8),
+                        _mm256_or_si256(high, value));
+  }
+  if (index + 8 <= count) {
+    __m128i bytes = _mm_loadl_epi64((const __m128i *)(glyphs + index));
+    _mm256_storeu_si256((__m256i *)(cells + index),
+                        _mm256_or_si256(_mm256_cvtepu8_epi32(bytes), value));
+    index += 8;
+  }
+  for (; index < count; index++) {
+    cells[index] = attributes | glyphs[index];
+  }
+}
+
+void SFTCoreCellExpandGlyph(uint32_t *pixels, size_t stride,
+                            const uint8_t *rows, uint32_t foreground,
+                            uint32_t background) {
+  // Each lane tests its own bit, and picks either colour without branching.
+  const __m256i bits = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04,
+                                         0x02, 0x01);
+  __m256i back = _mm256_set1_epi32((int)background);
+  __m256i difference = _mm256_set1_epi32((int)(foreground ^ background));
+
+  for (size_t row = 0; row < 8; row++) {
+    __m256i value = _mm256_set1_epi32(rows[row]);
+    __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(value, bits), bits);
+    _mm256_storeu_si256(
+        (__m256i *)(pixels + (row * stride)),
+        _mm256_xor_si256(back, _mm256_and_si256(difference, mask)));
+  }
+}
+
+#elif defined(SFT_CORE_CELL_KERNELS_SSE2)
+
+const char *const SFTCoreCellKernelsInstructionSet = "sse2";
+
+void SFTCoreCellFill(SFTTerminalEmulatorCell *cells, size_t count,
+                     SFTTerminalEmulatorCell cell) {
+  __m128i value = _mm_set1_epi32((int)cell);
+  size_t index = 0;
+
+  for (; index + 16 <= count; index += 16) {
+    _mm_storeu_si128((__m128i *)(cells + index), value);
+    _mm_storeu_si128((__m128i *)(cells + index + 4), value);
+    _mm_storeu_si128((__m128i *)(cells + index + 8), value);
+    _mm_storeu_si128((__m128i *)(cells + index + 12), value);
+  }
+  for (; index + 4 <= count; index += 4) {
+    _mm_storeu_si128((__m128i *)(cells + index), value);
+  }
+  for (; index < count; index++) {
+    cells[index] = cell;
+  }
+}
+
+void SFTCoreCellPack(SFTTerminalEmulatorCell *cells, const uint8_t *glyphs,
+                     size_t count, SFTTerminalEmulatorCell attributes) {
+  __m128i value = _mm_set1_epi32((int)attributes);
+  __m128i zero = _mm_setzero_si128();
+  size_t index = 0;
+
+  for (; index + 16 <= count; index += 16) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)(glyphs + index));
+    __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    _mm_storeu_si128((__m128i *)(cells + index),
+                     _mm_or_si128(_mm_unpacklo_epi16(low, zero), value));
+    _mm_storeu_si128((__m128i *)(cells + index + 4),
+                     _mm_or_si128(_mm_unpackhi_epi16(low, zero), value));
+    _mm_storeu_si128((__m128i *)(cells + index + 8),
+                     _mm_or_si128(_mm_unpacklo_epi16(high, zero), value));
+    _mm_storeu_si128((__m128i *)(cells + index + 12),
+                     _mm_or_si128(_mm_unpackhi_epi16(high, zero), value));
+  }
+  if (index + 8 <= count) {
+    __m128i bytes = _mm_loadl_epi64((const __m128i *)(glyphs + index));
+    __m128i words = _mm_unpacklo_epi8(bytes, zero);
+    _mm_storeu_si128((__m128i *)(cells + index),
+                     _mm_or_si128(_mm_unpacklo_epi16(words, zero), value));
+    _mm_storeu_si128((__m128i *)(cells + index + 4),
+                     _mm_or_si128(_mm_unpackhi_epi16(words, zero), value));
+    index += 8;
+  }
+  for (; index < count; index++) {
+    cells[index] = attributes | glyphs[index];
+  }
+}
+
+void SFTCoreCellExpandGlyph(uint32_t *pixels, size_t stride,
+                            const uint8_t *rows, uint32_t foreground,
+                            uint32_t background) {
+  // Each lane tests its own bit, and picks either colour without branching.
+  const __m128i left = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+  const __m128i right = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+  __m128i back = _mm_set1_epi32((int)background);
+  __m128i difference = _mm_set1_epi32((int)(foreground ^ background));
+
+  for (size_t row = 0; row < 8; row++) {
+    __m128i value = _mm_set1_epi32(rows[row]);
+    __m128i leftMask = _mm_cmpeq_epi32(_mm_and_si128(value, left), left);
+    __m128i rightMask = _mm_cmpeq_epi32(_mm_and_si128(value, right), right);
+    uint32_t *line = pixels + (row * stride);
+    _mm_storeu_si128((__m128i *)line,
+                     _mm_xor_si128(back, _mm_and_si128(difference, leftMask)));
+    _mm_storeu_si128(
+        (__m128i *)(line + 4),
+        _mm_xor_si128(back, _mm_and_si128(difference, rightMask)));
+  }
+}
+
+#elif defined(SFT_CORE_CELL_KERNELS_NEON)
+
+const char *const SFTCoreCellKernelsInstructionSet = "neon";
+
+void SFTCoreCellFill(SFTTerminalEmulatorCell *cells, size_t count,
+                     SFTTerminalEmulatorCell cell) {
+  uint32x4_t value = vdupq_n_u32(cell);
+  size_t index = 0;
+
+  for (; index + 16 <= count; index += 16) {
+    vst1q_u32(cells + index, value);
+    vst1q_u32(cells + index + 4, value);
+    vst1q_u32(cells + index + 8, value);
+    vst1q_u32(cells + index + 12, value);
+  }
+  for (; index + 4 <= count; index += 4) {
+    vst1q_u32(cells + index, value);
+  }
+  for (; index < count; index++) {
+    cells[index] = cell;
+  }
+}
+
+void SFTCoreCellPack(SFTTerminalEmulatorCell *cells, const uint8_t *glyphs,
+                     size_t count, SFTTerminalEmulatorCell attributes) {
+  uint32x4_t value = vdupq_n_u32(attributes);
+  size_t index = 0;
+
+  for (; index + 16 <= count; index += 16) {
+    uint8x16_t bytes = vld1q_u8(glyphs + index);
+    uint16x8_t low = vmovl_u8(vget_low_u8(bytes));
+    uint16x8_t high = vmovl_u8(vget_high_u8(bytes));
+    vst1q_u32(cells + index,
+              vorrq_u32(vmovl_u16(vget_low_u16(low)), value));
+    vst1q_u32(cells + index + 4,
+              vorrq_u32(vmovl_u16(vget_high_u16(low)), value));
+    vst1q_u32(cells + index + 8,
+              vorrq_u32(vmovl_u16(vget_low_u16(high)), value));
+    vst1q_u32(cells + index + 12,
+              vorrq_u32(vmovl_u16(vget_high_u16(high)), value));
+  }
+  if (index + 8 <= count) {
+    uint16x8_t words = vmovl_u8(vld1_u8(glyphs + index));
+    vst1q_u32(cells + index,
+              vorrq_u32(vmovl_u16(vget_low_u16(words)), value));
+    vst1q_u32(cells + index + 4,
+              vorrq_u32(vmovl_u16(vget_high_u16(words)), value));
+    index += 8;
+  }
+  for (; index < count; index++) {
+    cells[index] = attributes | glyphs[index];
+  }
+}
+
+void SFTCoreCellExpandGlyph(uint32_t *pixels, size_t stride,
+                            const uint8_t *rows, uint32_t foreground,
+                            uint32_t background) {
+  // Each lane tests its own bit, and picks either colour without branching.
+  static const uint32_t kLeft[4] = {0x80, 0x40, 0x20, 0x10};
+  static const uint32_t kRight[4] = {0x08, 0x04, 0x02, 0x01};
+  uint32x4_t left = vld1q_u32(kLeft);
+  uint32x4_t right = vld1q_u32(kRight);
+  uint32x4_t fore = vdupq_n_u32(foreground);
+  uint32x4_t back = vdupq_n_u32(background);
+
+  for (size_t row = 0; row < 8; row++) {
+    uint32x4_t value = vdupq_n_u32(rows[row]);
+    uint32_t *line = pixels + (row * stride);
+    vst1q_u32(line, vbslq_u32(vtstq_u32(value, left), fore, back));
+    vst1q_u32(line + 4, vbslq_u32(vtstq_u32(value, right), fore, back));
+  }
+}
+
+#else
+
+const char *const SFTCoreCellKernelsInstructionSet = "scalar";
+
+void SFTCoreCellFill(SFTTerminalEmulatorCell *cells, size_t count,
+                     SFTTerminalEmulatorCell cell) {
+  for (size_t index = 0; index < count; index++) {
+    cells[index] = cell;
+  }
+}
+
+void SFTCoreCellPack(SFTTerminalEmulatorCell *cells, const uint8_t *glyphs,
+                     size_t count, SFTTerminalEmulatorCell attributes) {
+  for (size_t index = 0; index < count; index++) {
+    cells[index] = attributes | glyphs[index];
+  }
+}
+
+void SFTCoreCellExpandGlyph(uint32_t *pixels, size_t stride,
+                            const uint8_t *rows, uint32_t foreground,
+                            uint32_t background) {
+  for (size_t row = 0; row < 8; row++) {
+    uint32_t *line = pixels + (row * stride);
+    for (size_t column = 0; column < 8; column++) {
+      line[column] =
+          ((rows[row] << column) & 0x80) ? foreground : background;
+    }
+  }
+}
+
+#endif
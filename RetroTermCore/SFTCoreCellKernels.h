@@ -0,0 +1,73 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreCellKernels_h
+#define SFTCoreCellKernels_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SFTCoreCell.h"
+
+/**
+ * Name of the instruction set the cell kernels were built for, either
+ * "avx2", "sse2", "neon", or "scalar".
+ */
+extern const char *const SFTCoreCellKernelsInstructionSet;
+
+/**
+ * Fills the given cell span with copies of the same cell.
+ *
+ * @param[out] cells the cells to fill.
+ * @param[in] count the amount of cells to fill.
+ * @param[in] cell the cell value to store.
+ */
+void SFTCoreCellFill(SFTTerminalEmulatorCell *cells, size_t count,
+                     SFTTerminalEmulatorCell cell);
+
+/**
+ * Packs a span of font indices into cells sharing the same attributes.
+ *
+ * @param[out] cells the cells to write.
+ * @param[in] glyphs the font indices to pack, one per cell.
+ * @param[in] count the amount of cells to write.
+ * @param[in] attributes a cell with the colours and reverse video flag to
+ * apply, and a zero font index.
+ */
+void SFTCoreCellPack(SFTTerminalEmulatorCell *cells, const uint8_t *glyphs,
+                     size_t count, SFTTerminalEmulatorCell attributes);
+
+/**
+ * Expands an 8x8 glyph into pixels, each glyph byte becoming a row of eight
+ * pixels with its most significant bit leftmost.
+ *
+ * @param[out] pixels the top left pixel of the glyph.
+ * @param[in] stride the distance between two pixel rows, in pixels.
+ * @param[in] rows the glyph rows, top to bottom, eight of them.
+ * @param[in] foreground the pixel value for set bits.
+ * @param[in] background the pixel value for clear bits.
+ */
+void SFTCoreCellExpandGlyph(uint32_t *pixels, size_t stride,
+                            const uint8_t *rows, uint32_t foreground,
+                            uint32_t background);
+
+#endif /* SFTCoreCellKernels_h */
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "SFTCoreCharacterSet.h"
+
+#define RSTP SFTPETSCIIControlCodeRunStop
+#define BELL SFTPETSCIIControlCodeBell
+#define SHDI SFTPETSCIIControlCodeShiftDisable
+#define SHEN SFTPETSCIIControlCodeShiftEnable
+#define CRTN SFTPETSCIIControlCodeCarriageReturn
+#define LNFD SFTPETSCIIControlCodeLineFeed
+#define HOME SFTPETSCIIControlCodeHome
+#define CLER SFTPETSCIIControlCodeClear
+#define INSR SFTPETSCIIControlCodeInsert
+#define DELT SFTPETSCIIControlCodeDelete
+#define CRUP SFTPETSCIIControlCodeCursorUp
+#define CRDN SFTPETSCIIControlCodeCursorDown
+#define CRLT SFTPETSCIIControlCodeCursorLeft
+#define CRRT SFTPETSCIIControlCodeCursorRight
+#define RVON SFTPETSCIIControlCodeReverseOn
+#define RVOF SFTPETSCIIControlCodeReverseOff
+#define TEXT SFTPETSCIIControlCodeTextMode
+#define GRPH SFTPETSCIIControlCodeGraphicsMode
+#define CBLK SFTPETSCIIControlCodeColourBlack
+#define CWHT SFTPETSCIIControlCodeColourWhite
+#define CRED SFTPETSCIIControlCodeColourRed
+#define CCYN SFTPETSCIIControlCodeColourCyan
+#define CPRP SFTPETSCIIControlCodeColourPurple
+#define CGRN SFTPETSCIIControlCodeColourGreen
+#define CBLU SFTPETSCIIControlCodeColourBlue
+#define CYLW SFTPETSCIIControlCodeColourYellow
+#define CORG SFTPETSCIIControlCodeColourOrange
+#define CBRN SFTPETSCIIControlCodeColourBrown
+#define CLTR SFTPETSCIIControlCodeColourLightRed
+#define CDGR SFTPETSCIIControlCodeColourDarkGray
+#define CMGR SFTPETSCIIControlCodeColourMiddleGray
+#define CLGN SFTPETSCIIControlCodeColourLightGreen
+#define CLBL SFTPETSCIIControlCodeColourLightBlue
+#define CLGR SFTPETSCIIControlCodeColourLightGray
+#define CFK1 SFTPETSCIIControlCodeF1
+#define CFK2 SFTPETSCIIControlCodeF2
+#define CFK3 SFTPETSCIIControlCodeF3
+#define CFK4 SFTPETSCIIControlCodeF4
+#define CFK5 SFTPETSCIIControlCodeF5
+#define CFK6 SFTPETSCIIControlCodeF6
+#define CFK7 SFTPETSCIIControlCodeF7
+#define CFK8 SFTPETSCIIControlCodeF8
+
+#define CBEL SFTASCIIControlCodeBell
+#define CBSP SFTASCIIControlCodeBackspace
+#define CNLN SFTASCIIControlCodeNewLine
+#define CCRN SFTASCIIControlCodeCarriageReturn
+#define CIGN SFTASCIIControlCodeIgnore
+
+/**
+ * Marks printable PETSCII ranges with no ASCII counterpart.
+ */
+#define NONE 0xFFFF
+
+// clang-format off
+
+/*
+ * The character set is declared once, here, and every lookup table is
+ * generated from it by the preprocessor: nothing below the mappings needs
+ * to be touched when a character is added or moved.
+ */
+
+/**
+ * Printable PETSCII ranges: first and last PETSCII code, font index of the
+ * first code, and ASCII character the first code stands for when using the
+ * lower case set, if any.
+ *
+ * When more than one range stands for the same ASCII characters, the first
+ * one is picked when converting from ASCII.
+ */
+#define SFTCharacterSetPrintables(X, code)                                     \
+  X(code, 0x20, 0x3F, 0x20, 0x20) /* Punctuation and digits. */               \
+  X(code, 0x40, 0x40, 0x00, 0x40) /* At sign. */                              \
+  X(code, 0x41, 0x5A, 0x01, 0x61) /* Lower case letters. */                   \
+  X(code, 0x5B, 0x5B, 0x1B, 0x5B) /* Left square bracket. */                  \
+  X(code, 0x5C, 0x5C, 0x1C, NONE) /* Pound sign. */                           \
+  X(code, 0x5D, 0x5D, 0x1D, 0x5D) /* Right square bracket. */                 \
+  X(code, 0x5E, 0x5F, 0x1E, NONE) /* Up and left arrows. */                   \
+  X(code, 0x60, 0x60, 0x40, NONE) /* Horizontal line. */                      \
+  X(code, 0x61, 0x7A, 0x41, 0x41) /* Upper case letters. */                   \
+  X(code, 0x7B, 0x7F, 0x5B, NONE) /* Graphics. */                             \
+  X(code, 0xA0, 0xBF, 0x60, NONE) /* Graphics. */                             \
+  X(code, 0xC0, 0xC0, 0x40, NONE) /* Horizontal line, again. */               \
+  X(code, 0xC1, 0xDA, 0x41, 0x41) /* Upper case letters, again. */            \
+  X(code, 0xDB, 0xDF, 0x5B, NONE) /* Graphics, again. */                      \
+  X(code, 0xE0, 0xFE, 0x60, NONE) /* Graphics, again. */                      \
+  X(code, 0xFF, 0xFF, 0x5E, NONE) /* Pi. */
+
+/**
+ * PETSCII control codes.
+ */
+#define SFTCharacterSetPETSCIIControls(X, code)                                \
+  X(code, 0x03, RSTP) X(code, 0x05, CWHT) X(code, 0x07, BELL)                 \
+  X(code, 0x08, SHDI) X(code, 0x09, SHEN) X(code, 0x0D, CRTN)                 \
+  X(code, 0x0E, TEXT) X(code, 0x11, CRDN) X(code, 0x12, RVON)                 \
+  X(code, 0x13, HOME) X(code, 0x14, DELT) X(code, 0x1C, CRED)                 \
+  X(code, 0x1D, CRRT) X(code, 0x1E, CGRN) X(code, 0x1F, CBLU)                 \
+  X(code, 0x81, CORG) X(code, 0x85, CFK1) X(code, 0x86, CFK3)                 \
+  X(code, 0x87, CFK5) X(code, 0x88, CFK7) X(code, 0x89, CFK2)                 \
+  X(code, 0x8A, CFK4) X(code, 0x8B, CFK6) X(code, 0x8C, CFK8)                 \
+  X(code, 0x8D, LNFD) X(code, 0x8E, GRPH) X(code, 0x90, CBLK)                 \
+  X(code, 0x91, CRUP) X(code, 0x92, RVOF) X(code, 0x93, CLER)                 \
+  X(code, 0x94, INSR) X(code, 0x95, CBRN) X(code, 0x96, CLTR)                 \
+  X(code, 0x97, CDGR) X(code, 0x98, CMGR) X(code, 0x99, CLGN)                 \
+  X(code, 0x9A, CLBL) X(code, 0x9B, CLGR) X(code, 0x9C, CPRP)                 \
+  X(code, 0x9D, CRLT) X(code, 0x9E, CYLW) X(code, 0x9F, CCYN)
+
+/**
+ * ASCII control codes.
+ */
+#define SFTCharacterSetASCIIControls(X, code)                                  \
+  X(code, 0x07, CBEL) X(code, 0x08, CBSP) X(code, 0x0A, CNLN)                 \
+  X(code, 0x0D, CCRN) X(code, 0x1B, CIGN)
+
+/*
+ * Table generation: each table entry is a constant expression picking the
+ * first mapping its code falls into, or the unmapped marker.
+ */
+
+#define SFTControlToValue(code, control, value)                                \
+  ((code) == (control)) ? (uint16_t)(value) :
+
+#define SFTPETSCIIToFontIndexValue(code, first, last, font, ascii)             \
+  (((code) >= (first)) && ((code) <= (last)))                                  \
+      ? (uint16_t)((font) + ((code) - (first))) :
+
+#define SFTPETSCIIToASCIIValue(code, first, last, font, ascii)                 \
+  (((code) >= (first)) && ((code) <= (last)) && ((ascii) != NONE))             \
+      ? (uint16_t)((ascii) + ((code) - (first))) :
+
+#define SFTASCIIToFontIndexValue(code, first, last, font, ascii)               \
+  (((code) >= (ascii)) && ((code) <= (ascii) + ((last) - (first))))            \
+      ? (uint16_t)((font) + ((code) - (ascii))) :
+
+#define SFTASCIIToPETSCIIValue(code, first, last, font, ascii)                 \
+  (((code) >= (ascii)) && ((code) <= (ascii) + ((last) - (first))))            \
+      ? (uint16_t)((first) + ((code) - (ascii))) :
+
+#define SFTPETSCIIToFontIndexEntry(code)                                       \
+  (SFTCharacterSetPETSCIIControls(SFTControlToValue, code)                     \
+   SFTCharacterSetPrintables(SFTPETSCIIToFontIndexValue, code)                 \
+   SFTUnmappedPETSCIICharacter)
+
+#define SFTPETSCIIToASCIIEntry(code)                                           \
+  (SFTCharacterSetPrintables(SFTPETSCIIToASCIIValue, code)                     \
+   SFTUnmappedASCIICharacter)
+
+#define SFTASCIIToLowerCaseFontIndexEntry(code)                                \
+  (SFTCharacterSetASCIIControls(SFTControlToValue, code)                       \
+   SFTCharacterSetPrintables(SFTASCIIToFontIndexValue, code)                   \
+   SFTUnmappedASCIICharacter)
+
+#define SFTASCIIToPETSCIIEntry(code)                                           \
+  (SFTCharacterSetPrintables(SFTASCIIToPETSCIIValue, code)                     \
+   SFTUnmappedPETSCIICharacter)
+
+#define SFTCharacterSetRow(F, row)                                             \
+  F((row) + 0x0), F((row) + 0x1), F((row) + 0x2), F((row) + 0x3),              \
+  F((row) + 0x4), F((row) + 0x5), F((row) + 0x6), F((row) + 0x7),              \
+  F((row) + 0x8), F((row) + 0x9), F((row) + 0xA), F((row) + 0xB),              \
+  F((row) + 0xC), F((row) + 0xD), F((row) + 0xE), F((row) + 0xF)
+
+#define SFTCharacterSetTable(F)                                                \
+  SFTCharacterSetRow(F, 0x00), SFTCharacterSetRow(F, 0x10),                    \
+  SFTCharacterSetRow(F, 0x20), SFTCharacterSetRow(F, 0x30),                    \
+  SFTCharacterSetRow(F, 0x40), SFTCharacterSetRow(F, 0x50),                    \
+  SFTCharacterSetRow(F, 0x60), SFTCharacterSetRow(F, 0x70),                    \
+  SFTCharacterSetRow(F, 0x80), SFTCharacterSetRow(F, 0x90),                    \
+  SFTCharacterSetRow(F, 0xA0), SFTCharacterSetRow(F, 0xB0),                    \
+  SFTCharacterSetRow(F, 0xC0), SFTCharacterSetRow(F, 0xD0),                    \
+  SFTCharacterSetRow(F, 0xE0), SFTCharacterSetRow(F, 0xF0)
+
+// clang-format on
+
+const uint16_t SFTPETSCIIToFontIndex[256] = {
+    SFTCharacterSetTable(SFTPETSCIIToFontIndexEntry)};
+
+const uint16_t SFTPETSCIIToASCII[256] = {
+    SFTCharacterSetTable(SFTPETSCIIToASCIIEntry)};
+
+const uint16_t SFTASCIIToLowerCaseFontIndex[256] = {
+    SFTCharacterSetTable(SFTASCIIToLowerCaseFontIndexEntry)};
+
+const uint16_t SFTASCIIToPETSCII[256] = {
+    SFTCharacterSetTable(SFTASCIIToPETSCIIEntry)};
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreCharacterSet_h
+#define SFTCoreCharacterSet_h
+
+#include <stdint.h>
+
+typedef uint16_t SFTPETSCIIControlCode;
+
+enum {
+  SFTPETSCIIControlCodeFirstControlCode = 0x0100,
+  SFTPETSCIIControlCodeRunStop,
+  SFTPETSCIIControlCodeBell,
+  SFTPETSCIIControlCodeShiftDisable,
+  SFTPETSCIIControlCodeShiftEnable,
+  SFTPETSCIIControlCodeCarriageReturn,
+  SFTPETSCIIControlCodeLineFeed,
+  SFTPETSCIIControlCodeHome,
+  SFTPETSCIIControlCodeClear,
+  SFTPETSCIIControlCodeInsert,
+  SFTPETSCIIControlCodeDelete,
+  SFTPETSCIIControlCodeCursorUp,
+  SFTPETSCIIControlCodeCursorDown,
+  SFTPETSCIIControlCodeCursorLeft,
+  SFTPETSCIIControlCodeCursorRight,
+  SFTPETSCIIControlCodeReverseOn,
+  SFTPETSCIIControlCodeReverseOff,
+  SFTPETSCIIControlCodeTextMode,
+  SFTPETSCIIControlCodeGraphicsMode,
+  SFTPETSCIIControlCodeColourBlack,
+  SFTPETSCIIControlCodeColourWhite,
+  SFTPETSCIIControlCodeColourRed,
+  SFTPETSCIIControlCodeColourCyan,
+  SFTPETSCIIControlCodeColourPurple,
+  SFTPETSCIIControlCodeColourGreen,
+  SFTPETSCIIControlCodeColourBlue,
+  SFTPETSCIIControlCodeColourYellow,
+  SFTPETSCIIControlCodeColourOrange,
+  SFTPETSCIIControlCodeColourBrown,
+  SFTPETSCIIControlCodeColourLightRed,
+  SFTPETSCIIControlCodeColourDarkGray,
+  SFTPETSCIIControlCodeColourMiddleGray,
+  SFTPETSCIIControlCodeColourLightGreen,
+  SFTPETSCIIControlCodeColourLightBlue,
+  SFTPETSCIIControlCodeColourLightGray,
+  SFTPETSCIIControlCodeF1,
+  SFTPETSCIIControlCodeF2,
+  SFTPETSCIIControlCodeF3,
+  SFTPETSCIIControlCodeF4,
+  SFTPETSCIIControlCodeF5,
+  SFTPETSCIIControlCodeF6,
+  SFTPETSCIIControlCodeF7,
+  SFTPETSCIIControlCodeF8,
+  SFTUnmappedPETSCIICharacter = 0xFFFF
+};
+
+typedef uint16_t SFTASCIIControlCode;
+
+enum {
+  SFTASCIIControlCodeBell = 0x0200,
+  SFTASCIIControlCodeBackspace = 0x0201,
+  SFTASCIIControlCodeNewLine = 0x0202,
+  SFTASCIIControlCodeCarriageReturn = 0x0203,
+  SFTASCIIControlCodeIgnore = 0x0208,
+  SFTUnmappedASCIICharacter = 0xFFFF
+};
+
+/**
+ * Space character font index, used to blank out cells.
+ */
+#define SFTCharacterSetSpace 0x20
+
+/**
+ * PETSCII to font index lookup table.
+ *
+ * Values up to 0xFF are font indices, values above
+ * SFTPETSCIIControlCodeFirstControlCode are control codes.
+ */
+extern const uint16_t SFTPETSCIIToFontIndex[256];
+
+/**
+ * ASCII to lower case font index lookup table.
+ *
+ * Values up to 0xFF are font indices, values starting from
+ * SFTASCIIControlCodeBell are control codes.
+ */
+extern const uint16_t SFTASCIIToLowerCaseFontIndex[256];
+
+/**
+ * PETSCII to ASCII lookup table, for printable characters in the lower case
+ * set.
+ *
+ * Characters with no ASCII counterpart and control codes are mapped to
+ * SFTUnmappedASCIICharacter.
+ */
+extern const uint16_t SFTPETSCIIToASCII[256];
+
+/**
+ * ASCII to PETSCII lookup table, for printable characters in the lower case
+ * set.
+ *
+ * Characters with no PETSCII counterpart and control codes are mapped to
+ * SFTUnmappedPETSCIICharacter.
+ */
+extern const uint16_t SFTASCIIToPETSCII[256];
+
+#endif /* SFTCoreCharacterSet_h */
@@ -0,0 +1,956 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "SFTCoreCellKernels.h"
+#include "SFTCoreCharacterSet.h"
+#include "SFTCoreEmulator.h"
+#include "SFTCoreScrollback.h"
+
+/**
+ * How many font indices are collected before being packed into cells.
+ */
+#define SFTCoreEmulatorGlyphBlockSize 64
+
+/**
+ * Runs shorter than this are packed inline, as typical in PETSCII art where
+ * colour changes every few characters.
+ */
+#define SFTCoreEmulatorShortRunLength 8
+
+typedef enum {
+  SFTCoreEmulatorProcessResultForceRedraw,
+  SFTCoreEmulatorProcessResultDoNotRedraw,
+  SFTCoreEmulatorProcessResultSwitchToPetscii,
+  SFTCoreEmulatorProcessResultRedrawAndSwitchToPetscii
+} SFTCoreEmulatorProcessResult;
+
+#define SFTCoreEmulatorBlankCell(state)                                        \
+  SFTTerminalEmulatorCellMake(SFTCharacterSetSpace, (state)->foreground,       \
+                              (state)->background, (state)->reverseVideo)
+
+#define SFTCoreEmulatorCell(state, character)                                  \
+  SFTTerminalEmulatorCellMake((character), (state)->foreground,                \
+                              (state)->background, (state)->reverseVideo)
+
+static void SFTCoreEmulatorRingBell(const SFTCoreEmulatorState *state) {
+  if (state->bellCallback != NULL) {
+    state->bellCallback(state->userData);
+  }
+}
+
+static inline void
+SFTCoreEmulatorPackGlyphs(SFTTerminalEmulatorCell *cells, const uint8_t *glyphs,
+                          size_t count, SFTTerminalEmulatorCell attributes) {
+  if (count < SFTCoreEmulatorShortRunLength) {
+    for (size_t index = 0; index < count; index++) {
+      cells[index] = attributes | glyphs[index];
+    }
+  } else {
+    SFTCoreCellPack(cells, glyphs, count, attributes);
+  }
+}
+
+#define SFTCoreEmulatorMarkRowDirty(state, physicalRow)                        \
+  (state)->dirtyRows[(physicalRow) / 64] |= UINT64_C(1) << ((physicalRow) % 64)
+
+#define SFTCoreEmulatorLinkRow(state, physicalRow)                             \
+  (state)->linkedRows[(physicalRow) / 64] |= UINT64_C(1) << ((physicalRow) % 64)
+
+#define SFTCoreEmulatorUnlinkRow(state, physicalRow)                           \
+  (state)->linkedRows[(physicalRow) / 64] &=                                   \
+      ~(UINT64_C(1) << ((physicalRow) % 64))
+
+/**
+ * Converts a visible row index into a row index in the cell buffer, for the
+ * given base row rather than the one stored in the state.
+ */
+static inline size_t SFTCoreEmulatorRingRow(const SFTCoreEmulatorState *state,
+                                            size_t baseRow, size_t row) {
+  size_t physical = baseRow + row;
+  return (physical >= state->height) ? physical - state->height : physical;
+}
+
+/**
+ * Scrolls the ring of rows up by one: the topmost physical row is moved to
+ * the scrollback history if any, then blanked to become the last visible row.
+ *
+ * @return the new base row.
+ */
+static size_t SFTCoreEmulatorScrollRing(SFTCoreEmulatorState *state,
+                                        SFTTerminalEmulatorCell *cells,
+                                        size_t baseRow,
+                                        SFTTerminalEmulatorCell blank) {
+  if (state->scrollback != NULL) {
+    SFTCoreScrollbackPush(state->scrollback,
+                          SFTCoreEmulatorRowCells(state, cells, baseRow));
+  }
+  SFTCoreCellFill(SFTCoreEmulatorRowCells(state, cells, baseRow), state->width,
+                  blank);
+  SFTCoreEmulatorMarkRowDirty(state, baseRow);
+  SFTCoreEmulatorUnlinkRow(state, baseRow);
+
+  // The new topmost row cannot continue a line that scrolled away.
+  size_t topRow = (baseRow + 1 < state->height) ? baseRow + 1 : 0;
+  SFTCoreEmulatorUnlinkRow(state, topRow);
+  return topRow;
+}
+
+/**
+ * Updates the links of the visible row printing just wrapped onto: it
+ * continues the row above unless that one was a continuation itself, and
+ * the row below starts a logical line of its own either way, so that no
+ * logical line ever spans more than two rows.
+ *
+ * @param[in,out] state the emulator state.
+ * @param[in] baseRow the current base row.
+ * @param[in] row the visible row printing wrapped onto.
+ * @param[in] link whether the row continues the one above.
+ */
+static void SFTCoreEmulatorLinkWrappedRow(SFTCoreEmulatorState *state,
+                                          size_t baseRow, size_t row,
+                                          bool link) {
+  size_t physicalRow = SFTCoreEmulatorRingRow(state, baseRow, row);
+  if (link && (row > 0)) {
+    SFTCoreEmulatorLinkRow(state, physicalRow);
+  } else {
+    SFTCoreEmulatorUnlinkRow(state, physicalRow);
+  }
+
+  if (row + 1 < state->height) {
+    SFTCoreEmulatorUnlinkRow(state,
+                             SFTCoreEmulatorRingRow(state, baseRow, row + 1));
+  }
+}
+
+/**
+ * Returns the visible row a carriage return moves the cursor to from the
+ * given one: the first row of the next logical line, skipping the row
+ * continuing the current one if there is any.  The row returned can be
+ * right past the bottom of the screen, but never further.
+ */
+static size_t SFTCoreEmulatorNextLogicalLine(const SFTCoreEmulatorState *state,
+                                             size_t baseRow, size_t row) {
+  ++row;
+  if ((row < state->height) &&
+      SFTCoreEmulatorIsRowLinked(
+          state, SFTCoreEmulatorRingRow(state, baseRow, row))) {
+    ++row;
+  }
+  return row;
+}
+
+/**
+ * Checks whether the visible row below the given one continues its logical
+ * line.
+ */
+static bool SFTCoreEmulatorContinuesBelow(const SFTCoreEmulatorState *state,
+                                          size_t baseRow, size_t row) {
+  return (row + 1 < state->height) &&
+         SFTCoreEmulatorIsRowLinked(
+             state, SFTCoreEmulatorRingRow(state, baseRow, row + 1));
+}
+
+/**
+ * Handles INST: the logical line is shifted right by one cell from the
+ * cursor onwards, and a blank cell takes the cursor's place.  The cursor
+ * does not move.
+ *
+ * Unlike the Commodore screen editor, a logical line whose last cell is in
+ * use is left alone rather than grown by a row, so that no more than two
+ * rows are ever touched.
+ *
+ * @return true if the cell buffer changed, false otherwise.
+ */
+static bool SFTCoreEmulatorInsertCharacter(SFTCoreEmulatorState *state,
+                                           SFTTerminalEmulatorCell *cells,
+                                           size_t baseRow, size_t row,
+                                           size_t column,
+                                           SFTTerminalEmulatorCell blank) {
+  size_t width = state->width;
+  size_t physicalRow = SFTCoreEmulatorRingRow(state, baseRow, row);
+  SFTTerminalEmulatorCell *current =
+      SFTCoreEmulatorRowCells(state, cells, physicalRow);
+  SFTTerminalEmulatorCell *last = current;
+
+  if (SFTCoreEmulatorContinuesBelow(state, baseRow, row)) {
+    size_t nextRow = SFTCoreEmulatorRingRow(state, baseRow, row + 1);
+    last = SFTCoreEmulatorRowCells(state, cells, nextRow);
+    if ((SFTTerminalEmulatorCellGetCharacter(last[width - 1]) !=
+         SFTCharacterSetSpace) ||
+        SFTTerminalEmulatorCellGetReverse(last[width - 1])) {
+      return false;
+    }
+    memmove(last + 1, last, (width - 1) * sizeof(SFTTerminalEmulatorCell));
+    last[0] = current[width - 1];
+    SFTCoreEmulatorMarkRowDirty(state, nextRow);
+  } else if ((SFTTerminalEmulatorCellGetCharacter(last[width - 1]) !=
+              SFTCharacterSetSpace) ||
+             SFTTerminalEmulatorCellGetReverse(last[width - 1])) {
+    return false;
+  }
+
+  memmove(current + column + 1, current + column,
+          (width - column - 1) * sizeof(SFTTerminalEmulatorCell));
+  current[column] = blank;
+  SFTCoreEmulatorMarkRowDirty(state, physicalRow);
+  return true;
+}
+
+/**
+ * Handles DEL: the cursor moves back by one cell, wrapping to the end of
+ * the row above when on the first column, and the logical line is shifted
+ * left by one cell from there onwards, ending with a blank cell.
+ *
+ * @return true if the cell buffer changed, false otherwise.
+ */
+static bool SFTCoreEmulatorDeleteCharacter(SFTCoreEmulatorState *state,
+                                           SFTTerminalEmulatorCell *cells,
+                                           size_t baseRow, size_t *row,
+                                           size_t *column,
+                                           SFTTerminalEmulatorCell blank) {
+  size_t width = state->width;
+
+  if (*column > 0) {
+    --*column;
+  } else if (*row > 0) {
+    --*row;
+    *column = width - 1;
+  } else {
+    return false;
+  }
+
+  size_t physicalRow = SFTCoreEmulatorRingRow(state, baseRow, *row);
+  SFTTerminalEmulatorCell *current =
+      SFTCoreEmulatorRowCells(state, cells, physicalRow);
+  memmove(current + *column, current + *column + 1,
+          (width - *column - 1) * sizeof(SFTTerminalEmulatorCell));
+  SFTCoreEmulatorMarkRowDirty(state, physicalRow);
+
+  if (SFTCoreEmulatorContinuesBelow(state, baseRow, *row)) {
+    size_t nextRow = SFTCoreEmulatorRingRow(state, baseRow, *row + 1);
+    SFTTerminalEmulatorCell *next =
+        SFTCoreEmulatorRowCells(state, cells, nextRow);
+    current[width - 1] = next[0];
+    memmove(next, next + 1, (width - 1) * sizeof(SFTTerminalEmulatorCell));
+    SFTCoreEmulatorMarkRowDirty(state, nextRow);
+    current = next;
+  }
+
+  current[width - 1] = blank;
+  return true;
+}
+
+bool SFTCoreEmulatorStateInitialise(SFTCoreEmulatorState *state, size_t width,
+                                    size_t height, uint8_t background,
+                                    uint8_t foreground, bool asciiMode,
+                                    bool lowerCase) {
+  memset(state, 0, sizeof(SFTCoreEmulatorState));
+
+  if ((width == 0) || (height == 0) || (width > SFTCoreEmulatorMaximumWidth) ||
+      (height > SFTCoreEmulatorMaximumHeight)) {
+    return false;
+  }
+
+  state->width = width;
+  state->height = height;
+  for (size_t row = 0; row < height; row++) {
+    state->rowStarts[row] = width * row;
+  }
+  state->background = background;
+  state->foreground = foreground;
+  state->isInASCIIMode = asciiMode;
+  state->useLowerCase = lowerCase;
+  state->reverseVideo = false;
+  state->parserMode = SFTCoreEmulatorParserModeFast;
+  state->row = 0;
+  state->column = 0;
+  state->baseRow = 0;
+  state->bellCallback = NULL;
+  state->userData = NULL;
+  state->scrollback = NULL;
+  SFTCoreEmulatorMarkAllRowsDirty(state);
+
+  return true;
+}
+
+void SFTCoreEmulatorClearScreen(SFTCoreEmulatorState *state,
+                                SFTTerminalEmulatorCell *cells) {
+  SFTCoreCellFill(cells, state->width * state->height,
+                  SFTCoreEmulatorBlankCell(state));
+
+  state->row = 0;
+  state->column = 0;
+  state->baseRow = 0;
+  memset(state->linkedRows, 0, sizeof(state->linkedRows));
+  SFTCoreEmulatorMarkAllRowsDirty(state);
+}
+
+void SFTCoreEmulatorScrollContentsUp(SFTCoreEmulatorState *state,
+                                     SFTTerminalEmulatorCell *cells) {
+  state->baseRow = SFTCoreEmulatorScrollRing(state, cells, state->baseRow,
+                                             SFTCoreEmulatorBlankCell(state));
+}
+
+size_t SFTCoreEmulatorNextDirtyRows(const SFTCoreEmulatorState *state,
+                                    size_t from, size_t *count) {
+  size_t row = from;
+  while ((row < state->height) && !SFTCoreEmulatorIsRowDirty(state, row)) {
+    row++;
+  }
+
+  size_t end = row;
+  while ((end < state->height) && SFTCoreEmulatorIsRowDirty(state, end)) {
+    end++;
+  }
+
+  *count = end - row;
+  return row;
+}
+
+void SFTCoreEmulatorClearDirtyRows(SFTCoreEmulatorState *state) {
+  memset(state->dirtyRows, 0, sizeof(state->dirtyRows));
+}
+
+void SFTCoreEmulatorMarkAllRowsDirty(SFTCoreEmulatorState *state) {
+  for (size_t row = 0; row < state->height; row++) {
+    SFTCoreEmulatorMarkRowDirty(state, row);
+  }
+}
+
+void SFTCoreEmulatorCopyContents(const SFTCoreEmulatorState *state,
+                                 const SFTTerminalEmulatorCell *cells,
+                                 SFTTerminalEmulatorCell *destination) {
+  size_t split = (state->height - state->baseRow) * state->width;
+
+  memcpy(destination, cells + (state->baseRow * state->width),
+         split * sizeof(SFTTerminalEmulatorCell));
+  memcpy(destination + split, cells,
+         state->baseRow * state->width * sizeof(SFTTerminalEmulatorCell));
+}
+
+static SFTCoreEmulatorProcessResult
+SFTCoreEmulatorReferenceProcessASCII(SFTCoreEmulatorState *state,
+                                     SFTTerminalEmulatorCell *cells,
+                                     const uint8_t *bytes, size_t length,
+                                     size_t *consumed) {
+  bool shouldRedraw = false;
+
+  for (size_t index = 0; index < length; index++) {
+
+    uint16_t mapped = SFTASCIIToLowerCaseFontIndex[bytes[index]];
+
+    switch (mapped) {
+    case SFTASCIIControlCodeBell:
+      SFTCoreEmulatorRingBell(state);
+      continue;
+
+    case SFTASCIIControlCodeBackspace:
+      state->column = state->column > 0 ? state->column - 1 : 0;
+      continue;
+
+    case SFTASCIIControlCodeNewLine:
+      ++state->row;
+      if (state->row >= state->height) {
+        SFTCoreEmulatorScrollContentsUp(state, cells);
+        state->row = state->height - 1;
+        shouldRedraw = true;
+      }
+      continue;
+
+    case SFTASCIIControlCodeCarriageReturn:
+      state->column = 0;
+      continue;
+
+    case SFTASCIIControlCodeIgnore:
+      continue;
+
+    case SFTUnmappedASCIICharacter:
+      state->isInASCIIMode = false;
+      *consumed = index;
+      return shouldRedraw
+                 ? SFTCoreEmulatorProcessResultRedrawAndSwitchToPetscii
+                 : SFTCoreEmulatorProcessResultSwitchToPetscii;
+
+    default: {
+      shouldRedraw = true;
+      size_t physicalRow = SFTCoreEmulatorPhysicalRow(state, state->row);
+      SFTCoreEmulatorMarkRowDirty(state, physicalRow);
+      SFTCoreEmulatorRowCells(state, cells, physicalRow)[state->column] =
+          SFTCoreEmulatorCell(state, (uint8_t)(mapped & 0xFF));
+      ++state->column;
+      if (state->column >= state->width) {
+        state->column = 0;
+        ++state->row;
+        if (state->row >= state->height) {
+          SFTCoreEmulatorScrollContentsUp(state, cells);
+          state->row = state->height - 1;
+        }
+      }
+    }
+    }
+  }
+
+  *consumed = length;
+  return shouldRedraw ? SFTCoreEmulatorProcessResultForceRedraw
+                      : SFTCoreEmulatorProcessResultDoNotRedraw;
+}
+
+static SFTCoreEmulatorProcessResult
+SFTCoreEmulatorReferenceProcessPETSCII(SFTCoreEmulatorState *state,
+                                       SFTTerminalEmulatorCell *cells,
+                                       const uint8_t *bytes, size_t length) {
+  bool shouldRedraw = false;
+
+  for (size_t index = 0; index < length; index++) {
+    uint16_t mapped = SFTPETSCIIToFontIndex[bytes[index]];
+
+    if (mapped > SFTPETSCIIControlCodeFirstControlCode) {
+      switch (mapped) {
+      case SFTPETSCIIControlCodeBell:
+        SFTCoreEmulatorRingBell(state);
+        continue;
+
+      case SFTPETSCIIControlCodeCarriageReturn:
+      case SFTPETSCIIControlCodeLineFeed:
+        state->column = 0;
+        state->row =
+            SFTCoreEmulatorNextLogicalLine(state, state->baseRow, state->row);
+        if (state->row >= state->height) {
+          SFTCoreEmulatorScrollContentsUp(state, cells);
+          state->row = state->height - 1;
+          shouldRedraw = true;
+        }
+        state->reverseVideo = false;
+        continue;
+
+      case SFTPETSCIIControlCodeHome:
+        state->row = 0;
+        state->column = 0;
+        continue;
+
+      case SFTPETSCIIControlCodeClear:
+        SFTCoreEmulatorClearScreen(state, cells);
+        shouldRedraw = true;
+        continue;
+
+      case SFTPETSCIIControlCodeInsert:
+        if (SFTCoreEmulatorInsertCharacter(state, cells, state->baseRow,
+                                           state->row, state->column,
+                                           SFTCoreEmulatorBlankCell(state))) {
+          shouldRedraw = true;
+        }
+        continue;
+
+      case SFTPETSCIIControlCodeDelete:
+        if (SFTCoreEmulatorDeleteCharacter(state, cells, state->baseRow,
+                                           &state->row, &state->column,
+                                           SFTCoreEmulatorBlankCell(state))) {
+          shouldRedraw = true;
+        }
+        continue;
+
+      case SFTPETSCIIControlCodeCursorDown:
+        ++state->row;
+        if (state->row >= state->height) {
+          SFTCoreEmulatorScrollContentsUp(state, cells);
+          state->row = state->height - 1;
+          shouldRedraw = true;
+        }
+        state->reverseVideo = false;
+        continue;
+
+      case SFTPETSCIIControlCodeCursorUp:
+        if (state->row > 0) {
+          --state->row;
+        }
+        continue;
+
+      case SFTPETSCIIControlCodeCursorLeft:
+        if (state->column > 0) {
+          --state->column;
+        }
+        continue;
+
+      case SFTPETSCIIControlCodeCursorRight:
+        ++state->column;
+        if (state->column >= state->width) {
+          state->column = 0;
+          ++state->row;
+          if (state->row >= state->height) {
+            SFTCoreEmulatorScrollContentsUp(state, cells);
+            state->row = state->height - 1;
+            shouldRedraw = true;
+          }
+        }
+        state->reverseVideo = false;
+        continue;
+
+      case SFTPETSCIIControlCodeReverseOn:
+        state->reverseVideo = true;
+        continue;
+
+      case SFTPETSCIIControlCodeReverseOff:
+        state->reverseVideo = false;
+        continue;
+
+      case SFTPETSCIIControlCodeTextMode:
+        state->useLowerCase = true;
+        continue;
+
+      case SFTPETSCIIControlCodeGraphicsMode:
+        state->useLowerCase = false;
+        continue;
+
+      case SFTPETSCIIControlCodeColourBlack:
+      case SFTPETSCIIControlCodeColourWhite:
+      case SFTPETSCIIControlCodeColourRed:
+      case SFTPETSCIIControlCodeColourCyan:
+      case SFTPETSCIIControlCodeColourPurple:
+      case SFTPETSCIIControlCodeColourGreen:
+      case SFTPETSCIIControlCodeColourBlue:
+      case SFTPETSCIIControlCodeColourYellow:
+      case SFTPETSCIIControlCodeColourOrange:
+      case SFTPETSCIIControlCodeColourBrown:
+      case SFTPETSCIIControlCodeColourLightRed:
+      case SFTPETSCIIControlCodeColourDarkGray:
+      case SFTPETSCIIControlCodeColourMiddleGray:
+      case SFTPETSCIIControlCodeColourLightGreen:
+      case SFTPETSCIIControlCodeColourLightBlue:
+      case SFTPETSCIIControlCodeColourLightGray:
+        state->foreground =
+            (uint8_t)(mapped - SFTPETSCIIControlCodeColourBlack);
+        continue;
+
+      default:
+        continue;
+      }
+    } else {
+      shouldRedraw = true;
+      size_t physicalRow = SFTCoreEmulatorPhysicalRow(state, state->row);
+      SFTCoreEmulatorMarkRowDirty(state, physicalRow);
+      SFTCoreEmulatorRowCells(state, cells, physicalRow)[state->column] =
+          SFTCoreEmulatorCell(state, (uint8_t)(mapped & 0xFF));
+      ++state->column;
+      if (state->column >= state->width) {
+        bool link = !SFTCoreEmulatorIsRowLinked(state, physicalRow);
+        state->column = 0;
+        ++state->row;
+        if (state->row >= state->height) {
+          SFTCoreEmulatorScrollContentsUp(state, cells);
+          state->row = state->height - 1;
+          state->reverseVideo = false;
+        }
+        SFTCoreEmulatorLinkWrappedRow(state, state->baseRow, state->row, link);
+      }
+    }
+  }
+
+  return shouldRedraw ? SFTCoreEmulatorProcessResultForceRedraw
+                      : SFTCoreEmulatorProcessResultDoNotRedraw;
+}
+
+/*
+ * The fast parsers below must leave state and cell buffer exactly as the
+ * reference ones would, for any input split into any chunk sizes.  Runs of
+ * printable characters are clamped to the end of the current row, so that
+ * wrapping and scrolling are only ever checked once per run.
+ */
+
+static SFTCoreEmulatorProcessResult
+SFTCoreEmulatorFastProcessASCII(SFTCoreEmulatorState *state,
+                                SFTTerminalEmulatorCell *cells,
+                                const uint8_t *bytes, size_t length,
+                                size_t *consumed) {
+  const size_t width = state->width;
+  const size_t height = state->height;
+  const SFTTerminalEmulatorCell attributes = SFTCoreEmulatorCell(state, 0);
+  const SFTTerminalEmulatorCell blank = SFTCoreEmulatorBlankCell(state);
+  size_t row = state->row;
+  size_t column = state->column;
+  size_t baseRow = state->baseRow;
+  bool shouldRedraw = false;
+
+  size_t index = 0;
+  while (index < length) {
+    uint16_t mapped = SFTASCIIToLowerCaseFontIndex[bytes[index]];
+
+    if (mapped <= 0xFF) {
+      size_t physicalRow = baseRow + row;
+      if (physicalRow >= height) {
+        physicalRow -= height;
+      }
+
+      SFTCoreEmulatorMarkRowDirty(state, physicalRow);
+      SFTTerminalEmulatorCell *target =
+          SFTCoreEmulatorRowCells(state, cells, physicalRow) + column;
+      size_t limit = width - column;
+      if (limit > length - index) {
+        limit = length - index;
+      }
+
+      size_t count = 0;
+      bool inRun = true;
+      while (inRun) {
+        uint8_t glyphs[SFTCoreEmulatorGlyphBlockSize];
+        size_t collected = 0;
+        do {
+          glyphs[collected++] = (uint8_t)mapped;
+          if (count + collected == limit) {
+            inRun = false;
+            break;
+          }
+          mapped =
+              SFTASCIIToLowerCaseFontIndex[bytes[index + count + collected]];
+          if (mapped > 0xFF) {
+            inRun = false;
+            break;
+          }
+        } while (collected < SFTCoreEmulatorGlyphBlockSize);
+
+        SFTCoreEmulatorPackGlyphs(target + count, glyphs, collected,
+                                  attributes);
+        count += collected;
+      }
+
+      index += count;
+      column += count;
+      shouldRedraw = true;
+      if (column >= width) {
+        column = 0;
+        ++row;
+        if (row >= height) {
+          baseRow = SFTCoreEmulatorScrollRing(state, cells, baseRow, blank);
+          row = height - 1;
+        }
+      }
+      continue;
+    }
+
+    switch (mapped) {
+    case SFTASCIIControlCodeBell:
+      SFTCoreEmulatorRingBell(state);
+      break;
+
+    case SFTASCIIControlCodeBackspace:
+      column = column > 0 ? column - 1 : 0;
+      break;
+
+    case SFTASCIIControlCodeNewLine:
+      ++row;
+      if (row >= height) {
+        baseRow = SFTCoreEmulatorScrollRing(state, cells, baseRow, blank);
+        row = height - 1;
+        shouldRedraw = true;
+      }
+      break;
+
+    case SFTASCIIControlCodeCarriageReturn:
+      column = 0;
+      break;
+
+    case SFTUnmappedASCIICharacter:
+      state->row = row;
+      state->column = column;
+      state->baseRow = baseRow;
+      state->isInASCIIMode = false;
+      *consumed = index;
+      return shouldRedraw
+                 ? SFTCoreEmulatorProcessResultRedrawAndSwitchToPetscii
+                 : SFTCoreEmulatorProcessResultSwitchToPetscii;
+
+    default:
+      break;
+    }
+
+    index++;
+  }
+
+  state->row = row;
+  state->column = column;
+  state->baseRow = baseRow;
+  *consumed = length;
+  return shouldRedraw ? SFTCoreEmulatorProcessResultForceRedraw
+                      : SFTCoreEmulatorProcessResultDoNotRedraw;
+}
+
+static SFTCoreEmulatorProcessResult
+SFTCoreEmulatorFastProcessPETSCII(SFTCoreEmulatorState *state,
+                                  SFTTerminalEmulatorCell *cells,
+                                  const uint8_t *bytes, size_t length) {
+  const size_t width = state->width;
+  const size_t height = state->height;
+  const uint8_t background = state->background;
+  uint8_t foreground = state->foreground;
+  bool reverseVideo = state->reverseVideo;
+  SFTTerminalEmulatorCell attributes =
+      SFTTerminalEmulatorCellMake(0, foreground, background, reverseVideo);
+  size_t row = state->row;
+  size_t column = state->column;
+  size_t baseRow = state->baseRow;
+  bool shouldRedraw = false;
+
+#define SFTCoreEmulatorUpdateAttributes()                                      \
+  attributes =                                                                 \
+      SFTTerminalEmulatorCellMake(0, foreground, background, reverseVideo)
+
+#define SFTCoreEmulatorScrollIfNeeded()                                        \
+  if (row >= height) {                                                         \
+    baseRow = SFTCoreEmulatorScrollRing(state, cells, baseRow,                 \
+                                        attributes | SFTCharacterSetSpace);    \
+    row = height - 1;                                                          \
+    shouldRedraw = true;                                                       \
+  }
+
+  size_t index = 0;
+  while (index < length) {
+    uint16_t mapped = SFTPETSCIIToFontIndex[bytes[index]];
+
+    if (mapped <= SFTPETSCIIControlCodeFirstControlCode) {
+      size_t physicalRow = baseRow + row;
+      if (physicalRow >= height) {
+        physicalRow -= height;
+      }
+
+      SFTCoreEmulatorMarkRowDirty(state, physicalRow);
+      SFTTerminalEmulatorCell *target =
+          SFTCoreEmulatorRowCells(state, cells, physicalRow) + column;
+      size_t limit = width - column;
+      if (limit > length - index) {
+        limit = length - index;
+      }
+
+      size_t count = 0;
+      bool inRun = true;
+      while (inRun) {
+        uint8_t glyphs[SFTCoreEmulatorGlyphBlockSize];
+        size_t collected = 0;
+        do {
+          glyphs[collected++] = (uint8_t)(mapped & 0xFF);
+          if (count + collected == limit) {
+            inRun = false;
+            break;
+          }
+          mapped = SFTPETSCIIToFontIndex[bytes[index + count + collected]];
+          if (mapped > SFTPETSCIIControlCodeFirstControlCode) {
+            inRun = false;
+            break;
+          }
+        } while (collected < SFTCoreEmulatorGlyphBlockSize);
+
+        SFTCoreEmulatorPackGlyphs(target + count, glyphs, collected,
+                                  attributes);
+        count += collected;
+      }
+
+      index += count;
+      column += count;
+      shouldRedraw = true;
+      if (column >= width) {
+        bool link = !SFTCoreEmulatorIsRowLinked(state, physicalRow);
+        column = 0;
+        ++row;
+        if (row >= height) {
+          SFTCoreEmulatorScrollIfNeeded();
+          reverseVideo = false;
+          SFTCoreEmulatorUpdateAttributes();
+        }
+        SFTCoreEmulatorLinkWrappedRow(state, baseRow, row, link);
+      }
+      continue;
+    }
+
+    index++;
+
+    switch (mapped) {
+    case SFTPETSCIIControlCodeBell:
+      SFTCoreEmulatorRingBell(state);
+      break;
+
+    case SFTPETSCIIControlCodeCarriageReturn:
+    case SFTPETSCIIControlCodeLineFeed:
+      column = 0;
+      row = SFTCoreEmulatorNextLogicalLine(state, baseRow, row);
+      SFTCoreEmulatorScrollIfNeeded();
+      reverseVideo = false;
+      SFTCoreEmulatorUpdateAttributes();
+      break;
+
+    case SFTPETSCIIControlCodeHome:
+      row = 0;
+      column = 0;
+      break;
+
+    case SFTPETSCIIControlCodeClear:
+      SFTCoreCellFill(cells, width * height,
+                      attributes | SFTCharacterSetSpace);
+      row = 0;
+      column = 0;
+      baseRow = 0;
+      memset(state->linkedRows, 0, sizeof(state->linkedRows));
+      SFTCoreEmulatorMarkAllRowsDirty(state);
+      shouldRedraw = true;
+      break;
+
+    case SFTPETSCIIControlCodeInsert:
+      if (SFTCoreEmulatorInsertCharacter(state, cells, baseRow, row, column,
+                                         attributes | SFTCharacterSetSpace)) {
+        shouldRedraw = true;
+      }
+      break;
+
+    case SFTPETSCIIControlCodeDelete:
+      if (SFTCoreEmulatorDeleteCharacter(state, cells, baseRow, &row, &column,
+                                         attributes | SFTCharacterSetSpace)) {
+        shouldRedraw = true;
+      }
+      break;
+
+    case SFTPETSCIIControlCodeCursorDown:
+      ++row;
+      SFTCoreEmulatorScrollIfNeeded();
+      reverseVideo = false;
+      SFTCoreEmulatorUpdateAttributes();
+      break;
+
+    case SFTPETSCIIControlCodeCursorUp:
+      if (row > 0) {
+        --row;
+      }
+      break;
+
+    case SFTPETSCIIControlCodeCursorLeft:
+      if (column > 0) {
+        --column;
+      }
+      break;
+
+    case SFTPETSCIIControlCodeCursorRight:
+      ++column;
+      if (column >= width) {
+        column = 0;
+        ++row;
+        SFTCoreEmulatorScrollIfNeeded();
+      }
+      reverseVideo = false;
+      SFTCoreEmulatorUpdateAttributes();
+      break;
+
+    case SFTPETSCIIControlCodeReverseOn:
+      reverseVideo = true;
+      SFTCoreEmulatorUpdateAttributes();
+      break;
+
+    case SFTPETSCIIControlCodeReverseOff:
+      reverseVideo = false;
+      SFTCoreEmulatorUpdateAttributes();
+      break;
+
+    case SFTPETSCIIControlCodeTextMode:
+      state->useLowerCase = true;
+      break;
+
+    case SFTPETSCIIControlCodeGraphicsMode:
+      state->useLowerCase = false;
+      break;
+
+    case SFTPETSCIIControlCodeColourBlack:
+    case SFTPETSCIIControlCodeColourWhite:
+    case SFTPETSCIIControlCodeColourRed:
+    case SFTPETSCIIControlCodeColourCyan:
+    case SFTPETSCIIControlCodeColourPurple:
+    case SFTPETSCIIControlCodeColourGreen:
+    case SFTPETSCIIControlCodeColourBlue:
+    case SFTPETSCIIControlCodeColourYellow:
+    case SFTPETSCIIControlCodeColourOrange:
+    case SFTPETSCIIControlCodeColourBrown:
+    case SFTPETSCIIControlCodeColourLightRed:
+    case SFTPETSCIIControlCodeColourDarkGray:
+    case SFTPETSCIIControlCodeColourMiddleGray:
+    case SFTPETSCIIControlCodeColourLightGreen:
+    case SFTPETSCIIControlCodeColourLightBlue:
+    case SFTPETSCIIControlCodeColourLightGray:
+      foreground = (uint8_t)(mapped - SFTPETSCIIControlCodeColourBlack);
+      SFTCoreEmulatorUpdateAttributes();
+      break;
+
+    default:
+      break;
+    }
+  }
+
+#undef SFTCoreEmulatorScrollIfNeeded
+#undef SFTCoreEmulatorUpdateAttributes
+
+  state->row = row;
+  state->column = column;
+  state->baseRow = baseRow;
+  state->foreground = foreground;
+  state->reverseVideo = reverseVideo;
+
+  return shouldRedraw ? SFTCoreEmulatorProcessResultForceRedraw
+                      : SFTCoreEmulatorProcessResultDoNotRedraw;
+}
+
+bool SFTCoreEmulatorProcessIncomingData(SFTCoreEmulatorState *state,
+                                        SFTTerminalEmulatorCell *cells,
+                                        const uint8_t *bytes, size_t length) {
+  bool fast = state->parserMode == SFTCoreEmulatorParserModeFast;
+  size_t consumed = 0;
+  SFTCoreEmulatorProcessResult result;
+
+  if (state->isInASCIIMode) {
+    result = fast ? SFTCoreEmulatorFastProcessASCII(state, cells, bytes,
+                                                    length, &consumed)
+                  : SFTCoreEmulatorReferenceProcessASCII(state, cells, bytes,
+                                                         length, &consumed);
+  } else {
+    result = fast ? SFTCoreEmulatorFastProcessPETSCII(state, cells, bytes,
+                                                      length)
+                  : SFTCoreEmulatorReferenceProcessPETSCII(state, cells,
+                                                           bytes, length);
+  }
+
+  switch (result) {
+  case SFTCoreEmulatorProcessResultDoNotRedraw:
+    return false;
+
+  case SFTCoreEmulatorProcessResultForceRedraw:
+    return true;
+
+  case SFTCoreEmulatorProcessResultSwitchToPetscii:
+  case SFTCoreEmulatorProcessResultRedrawAndSwitchToPetscii: {
+    // The byte that made the switch is the first one parsed as PETSCII.
+    bool redrawn =
+        result == SFTCoreEmulatorProcessResultRedrawAndSwitchToPetscii;
+    result = fast ? SFTCoreEmulatorFastProcessPETSCII(state, cells,
+                                                      bytes + consumed,
+                                                      length - consumed)
+                  : SFTCoreEmulatorReferenceProcessPETSCII(
+                        state, cells, bytes + consumed, length - consumed);
+    return redrawn || (result == SFTCoreEmulatorProcessResultForceRedraw);
+  }
+  }
+
+  return false;
+}
@@ -0,0 +1,304 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreEmulator_h
+#define SFTCoreEmulator_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SFTCoreCell.h"
+
+/**
+ * Maximum screen width, in cells, that the emulator accepts.
+ */
+#define SFTCoreEmulatorMaximumWidth 1024
+
+/**
+ * Maximum screen height, in cells, that the emulator can track.
+ */
+#define SFTCoreEmulatorMaximumHeight 256
+
+/**
+ * Amount of 64 bits words making up the dirty rows bitmap.
+ */
+#define SFTCoreEmulatorDirtyRowsWords (SFTCoreEmulatorMaximumHeight / 64)
+
+/**
+ * Callback invoked when the incoming data stream rings the terminal bell.
+ *
+ * @param[in] userData the opaque pointer stored in the emulator state.
+ */
+typedef void (*SFTCoreEmulatorBellCallback)(void *userData);
+
+struct SFTCoreScrollback;
+
+/**
+ * Available incoming data parser implementations.
+ */
+typedef enum {
+  /**
+   * Straightforward byte by byte parser, kept as a behavioural reference.
+   */
+  SFTCoreEmulatorParserModeReference = 0,
+
+  /**
+   * Parser writing runs of printable characters as a single block, keeping
+   * the cursor state in locals for the whole buffer.
+   */
+  SFTCoreEmulatorParserModeFast
+} SFTCoreEmulatorParserMode;
+
+/**
+ * Terminal emulator state, independent from any user interface.
+ *
+ * The core keeps no state of its own outside of this structure, so any
+ * amount of sessions can parse at once on different threads, as long as
+ * each state, its cell buffer and its scrollback are only used by one
+ * thread at a time.
+ */
+typedef struct {
+  /**
+   * Screen content width, in cells.
+   */
+  size_t width;
+
+  /**
+   * Screen content height, in cells.
+   */
+  size_t height;
+
+  size_t row;
+  size_t column;
+
+  /**
+   * Physical row in the cell buffer holding the topmost visible row.
+   *
+   * The cell buffer is a ring of rows, so that scrolling only needs to blank
+   * one row and move this index forward.
+   */
+  size_t baseRow;
+
+  /**
+   * Offset of the first cell of every cell buffer row, indexed by physical
+   * row, so that finding a row never needs a multiplication whatever the
+   * screen width.
+   */
+  size_t rowStarts[SFTCoreEmulatorMaximumHeight];
+
+  /**
+   * Bitmap of cell buffer rows written to since the last time it was
+   * cleared, indexed by physical row.
+   */
+  uint64_t dirtyRows[SFTCoreEmulatorDirtyRowsWords];
+
+  /**
+   * Bitmap of cell buffer rows continuing the logical line started on the
+   * visible row above them, indexed by physical row.
+   *
+   * As on the Commodore screen editor, a row gets linked to the one above
+   * when printing wraps past its end, so logical lines span at most two
+   * rows.  Carriage returns move past a logical line as a whole, and INST
+   * and DEL shift the rest of it by one cell.  The topmost visible row is
+   * never linked.
+   */
+  uint64_t linkedRows[SFTCoreEmulatorDirtyRowsWords];
+
+  uint8_t background;
+  uint8_t foreground;
+
+  bool isInASCIIMode;
+  bool useLowerCase;
+  bool reverseVideo;
+
+  /**
+   * Parser implementation to use, both produce the same screen contents.
+   */
+  SFTCoreEmulatorParserMode parserMode;
+
+  /**
+   * Bell notification callback, can be NULL.
+   */
+  SFTCoreEmulatorBellCallback bellCallback;
+
+  /**
+   * Opaque pointer passed back to the bell notification callback.
+   */
+  void *userData;
+
+  /**
+   * History receiving every row scrolled off the top of the screen, can be
+   * NULL.
+   */
+  struct SFTCoreScrollback *scrollback;
+} SFTCoreEmulatorState;
+
+/**
+ * Initialises the given emulator state.
+ *
+ * @param[out] state the state to initialise.
+ * @param[in] width screen width, in cells.
+ * @param[in] height screen height, in cells.
+ * @param[in] background currently chosen background colour.
+ * @param[in] foreground currently chosen foreground colour.
+ * @param[in] asciiMode flag indicating whether to start in ASCII or PETSCII
+ * mode.
+ * @param[in] lowerCase flag indicating whether to start using upper or lower
+ * case characters for PETSCII.
+ *
+ * @return true if the state was initialised, false if the given screen size
+ * is not supported: up to SFTCoreEmulatorMaximumWidth by
+ * SFTCoreEmulatorMaximumHeight cells.
+ */
+bool SFTCoreEmulatorStateInitialise(SFTCoreEmulatorState *state, size_t width,
+                                    size_t height, uint8_t background,
+                                    uint8_t foreground, bool asciiMode,
+                                    bool lowerCase);
+
+/**
+ * Fills the whole cell buffer with blank cells and homes the cursor.
+ *
+ * @param[in,out] state the emulator state.
+ * @param[out] cells the cell buffer, width * height cells long.
+ */
+void SFTCoreEmulatorClearScreen(SFTCoreEmulatorState *state,
+                                SFTTerminalEmulatorCell *cells);
+
+/**
+ * Scrolls the cell buffer up by one row, blanking the last row.
+ *
+ * @param[in,out] state the emulator state.
+ * @param[in,out] cells the cell buffer, width * height cells long.
+ */
+void SFTCoreEmulatorScrollContentsUp(SFTCoreEmulatorState *state,
+                                     SFTTerminalEmulatorCell *cells);
+
+/**
+ * Converts a visible row index into a row index in the cell buffer.
+ *
+ * @param[in] state the emulator state.
+ * @param[in] row the visible row, from 0 to height - 1.
+ *
+ * @return the physical row holding the given visible row.
+ */
+static inline size_t
+SFTCoreEmulatorPhysicalRow(const SFTCoreEmulatorState *state, size_t row) {
+  size_t physical = state->baseRow + row;
+  return (physical >= state->height) ? physical - state->height : physical;
+}
+
+/**
+ * Returns the first cell of the given cell buffer row.
+ *
+ * @param[in] state the emulator state.
+ * @param[in] cells the cell buffer, width * height cells long.
+ * @param[in] physicalRow the physical row, from 0 to height - 1.
+ *
+ * @return the row's first cell.
+ */
+static inline SFTTerminalEmulatorCell *
+SFTCoreEmulatorRowCells(const SFTCoreEmulatorState *state,
+                        SFTTerminalEmulatorCell *cells, size_t physicalRow) {
+  return cells + state->rowStarts[physicalRow];
+}
+
+/**
+ * Copies the cell buffer contents in visible order, topmost row first.
+ *
+ * @param[in] state the emulator state.
+ * @param[in] cells the cell buffer, width * height cells long.
+ * @param[out] destination the buffer to fill, width * height cells long.
+ */
+void SFTCoreEmulatorCopyContents(const SFTCoreEmulatorState *state,
+                                 const SFTTerminalEmulatorCell *cells,
+                                 SFTTerminalEmulatorCell *destination);
+
+/**
+ * Parses the given incoming bytes, updating state and cell buffer.
+ *
+ * @param[in,out] state the emulator state.
+ * @param[in,out] cells the cell buffer, width * height cells long.
+ * @param[in] bytes the incoming data.
+ * @param[in] length the incoming data length, in bytes.
+ *
+ * @return true if the cell buffer needs to be redrawn, false otherwise.
+ */
+bool SFTCoreEmulatorProcessIncomingData(SFTCoreEmulatorState *state,
+                                        SFTTerminalEmulatorCell *cells,
+                                        const uint8_t *bytes, size_t length);
+
+/**
+ * Checks whether the given cell buffer row was written to.
+ *
+ * @param[in] state the emulator state.
+ * @param[in] row the physical row to check.
+ *
+ * @return true if the row is dirty, false otherwise.
+ */
+static inline bool SFTCoreEmulatorIsRowDirty(const SFTCoreEmulatorState *state,
+                                             size_t row) {
+  return (state->dirtyRows[row / 64] & (UINT64_C(1) << (row % 64))) != 0;
+}
+
+/**
+ * Checks whether the given cell buffer row continues the logical line
+ * started on the visible row above it.
+ *
+ * @param[in] state the emulator state.
+ * @param[in] row the physical row to check.
+ *
+ * @return true if the row is linked, false otherwise.
+ */
+static inline bool
+SFTCoreEmulatorIsRowLinked(const SFTCoreEmulatorState *state, size_t row) {
+  return (state->linkedRows[row / 64] & (UINT64_C(1) << (row % 64))) != 0;
+}
+
+/**
+ * Finds the next run of consecutive dirty cell buffer rows.
+ *
+ * @param[in] state the emulator state.
+ * @param[in] from the physical row to start searching from.
+ * @param[out] count the amount of consecutive dirty rows found.
+ *
+ * @return the first dirty physical row at or after the given one, or the
+ * screen height if there are none left.
+ */
+size_t SFTCoreEmulatorNextDirtyRows(const SFTCoreEmulatorState *state,
+                                    size_t from, size_t *count);
+
+/**
+ * Marks all cell buffer rows as clean.
+ *
+ * @param[in,out] state the emulator state.
+ */
+void SFTCoreEmulatorClearDirtyRows(SFTCoreEmulatorState *state);
+
+/**
+ * Marks all cell buffer rows as dirty.
+ *
+ * @param[in,out] state the emulator state.
+ */
+void SFTCoreEmulatorMarkAllRowsDirty(SFTCoreEmulatorState *state);
+
+#endif /* SFTCoreEmulator_h */
@@ -0,0 +1,386 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define SFTCoreEventLoopUsesEpoll 1
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) ||    \
+    defined(__DragonFly__)
+#include <sys/event.h>
+#define SFTCoreEventLoopUsesKqueue 1
+#else
+#error "No supported event notification interface available."
+#endif
+
+#include "SFTCoreEventLoop.h"
+
+/**
+ * Maximum amount of ready sources collected by a single wait.
+ */
+#define SFTCoreEventLoopBatchSize 64
+
+static bool SFTCoreEventLoopMakeNonBlocking(int descriptor) {
+  int flags = fcntl(descriptor, F_GETFL);
+  if ((flags < 0) || (fcntl(descriptor, F_SETFL, flags | O_NONBLOCK) < 0)) {
+    return false;
+  }
+
+  return fcntl(descriptor, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+#if defined(SFTCoreEventLoopUsesEpoll)
+
+static uint32_t SFTCoreEventLoopEpollEvents(uint32_t interest) {
+  uint32_t events = 0;
+  if (interest & SFTCoreEventReadable) {
+    events |= EPOLLIN;
+  }
+  if (interest & SFTCoreEventWritable) {
+    events |= EPOLLOUT;
+  }
+  return events;
+}
+
+static bool SFTCoreEventLoopRegister(SFTCoreEventLoop *loop,
+                                     SFTCoreEventSource *source,
+                                     uint32_t interest, bool isNew) {
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = SFTCoreEventLoopEpollEvents(interest);
+  event.data.ptr = source;
+
+  return epoll_ctl(loop->queue, isNew ? EPOLL_CTL_ADD : EPOLL_CTL_MOD,
+                   source->descriptor, &event) == 0;
+}
+
+static void SFTCoreEventLoopUnregister(SFTCoreEventLoop *loop,
+                                       SFTCoreEventSource *source) {
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  epoll_ctl(loop->queue, EPOLL_CTL_DEL, source->descriptor, &event);
+}
+
+#else
+
+static bool SFTCoreEventLoopRegister(SFTCoreEventLoop *loop,
+                                     SFTCoreEventSource *source,
+                                     uint32_t interest, bool isNew) {
+  struct kevent changes[2];
+  int count = 0;
+
+  // Both filters stay registered for the source's whole life, and are only
+  // enabled or disabled afterwards.
+  if (isNew || ((interest ^ source->interest) & SFTCoreEventReadable)) {
+    EV_SET(&changes[count++], source->descriptor, EVFILT_READ,
+           (isNew ? EV_ADD : 0) |
+               ((interest & SFTCoreEventReadable) ? EV_ENABLE : EV_DISABLE),
+           0, 0, source);
+  }
+  if (isNew || ((interest ^ source->interest) & SFTCoreEventWritable)) {
+    EV_SET(&changes[count++], source->descriptor, EVFILT_WRITE,
+           (isNew ? EV_ADD : 0) |
+               ((interest & SFTCoreEventWritable) ? EV_ENABLE : EV_DISABLE),
+           0, 0, source);
+  }
+
+  return (count == 0) ||
+         (kevent(loop->queue, changes, count, NULL, 0, NULL) == 0);
+}
+
+static void SFTCoreEventLoopUnregister(SFTCoreEventLoop *loop,
+                                       SFTCoreEventSource *source) {
+  struct kevent changes[2];
+  EV_SET(&changes[0], source->descriptor, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+  EV_SET(&changes[1], source->descriptor, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+  kevent(loop->queue, changes, 2, NULL, 0, NULL);
+}
+
+#endif
+
+static void SFTCoreEventLoopDrainWakeUps(SFTCoreEventSource *source,
+                                         uint32_t events) {
+  (void)events;
+
+  uint8_t buffer[64];
+  while (read(source->descriptor, buffer, sizeof(buffer)) > 0) {
+  }
+}
+
+static void SFTCoreEventLoopWakeUp(SFTCoreEventLoop *loop) {
+  uint8_t byte = 0;
+  while ((write(loop->wakeDescriptors[1], &byte, 1) < 0) && (errno == EINTR)) {
+  }
+}
+
+static void SFTCoreEventLoopRunTasks(SFTCoreEventLoop *loop) {
+  // Clearing the flag before taking the queue ensures tasks queued from now
+  // on write a new wake-up byte.
+  atomic_store(&loop->wakePending, false);
+
+  pthread_mutex_lock(&loop->lock);
+  SFTCoreEventLoopTaskEntry *tasks = loop->pendingTasks;
+  size_t count = loop->pendingTasksCount;
+  size_t capacity = loop->pendingTasksCapacity;
+  loop->pendingTasks = loop->runningTasks;
+  loop->pendingTasksCapacity = loop->runningTasksCapacity;
+  loop->pendingTasksCount = 0;
+  loop->runningTasks = tasks;
+  loop->runningTasksCapacity = capacity;
+  pthread_mutex_unlock(&loop->lock);
+
+  for (size_t index = 0; index < count; index++) {
+    tasks[index].task(tasks[index].context);
+  }
+}
+
+static void *SFTCoreEventLoopThread(void *argument) {
+  SFTCoreEventLoop *loop = (SFTCoreEventLoop *)argument;
+
+#if defined(SFTCoreEventLoopUsesEpoll)
+  struct epoll_event events[SFTCoreEventLoopBatchSize];
+#else
+  struct kevent events[SFTCoreEventLoopBatchSize];
+#endif
+
+  while (atomic_load(&loop->running)) {
+#if defined(SFTCoreEventLoopUsesEpoll)
+    int count = epoll_wait(loop->queue, events, SFTCoreEventLoopBatchSize, -1);
+#else
+    int count =
+        kevent(loop->queue, NULL, 0, events, SFTCoreEventLoopBatchSize, NULL);
+#endif
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    bool woken = false;
+    for (int index = 0; index < count; index++) {
+#if defined(SFTCoreEventLoopUsesEpoll)
+      SFTCoreEventSource *source = (SFTCoreEventSource *)events[index].data.ptr;
+      uint32_t ready = 0;
+      if (events[index].events & EPOLLIN) {
+        ready |= SFTCoreEventReadable;
+      }
+      if (events[index].events & EPOLLOUT) {
+        ready |= SFTCoreEventWritable;
+      }
+      if (events[index].events & (EPOLLHUP | EPOLLERR)) {
+        // Let the owner find out about the details when reading.
+        ready |= SFTCoreEventHangUp | SFTCoreEventReadable;
+      }
+#else
+      SFTCoreEventSource *source = (SFTCoreEventSource *)events[index].udata;
+      uint32_t ready = (events[index].filter == EVFILT_WRITE)
+                           ? SFTCoreEventWritable
+                           : SFTCoreEventReadable;
+      if (events[index].flags & (EV_EOF | EV_ERROR)) {
+        ready |= SFTCoreEventHangUp;
+      }
+#endif
+
+      if (source == &loop->wakeSource) {
+        woken = true;
+      }
+
+      // Sources removed by an earlier callback in this batch are skipped.
+      if (source->descriptor >= 0) {
+        source->callback(source, ready);
+      }
+    }
+
+    if (woken) {
+      SFTCoreEventLoopRunTasks(loop);
+    }
+  }
+
+  return NULL;
+}
+
+bool SFTCoreEventLoopInitialise(SFTCoreEventLoop *loop) {
+  memset(loop, 0, sizeof(SFTCoreEventLoop));
+  loop->wakeDescriptors[0] = -1;
+  loop->wakeDescriptors[1] = -1;
+  atomic_init(&loop->running, false);
+  atomic_init(&loop->wakePending, false);
+
+  if (pthread_mutex_init(&loop->lock, NULL) != 0) {
+    return false;
+  }
+
+#if defined(SFTCoreEventLoopUsesEpoll)
+  loop->queue = epoll_create1(EPOLL_CLOEXEC);
+#else
+  loop->queue = kqueue();
+#endif
+  if (loop->queue < 0) {
+    SFTCoreEventLoopRelease(loop);
+    return false;
+  }
+
+  if ((pipe(loop->wakeDescriptors) != 0) ||
+      !SFTCoreEventLoopMakeNonBlocking(loop->wakeDescriptors[0]) ||
+      !SFTCoreEventLoopMakeNonBlocking(loop->wakeDescriptors[1])) {
+    SFTCoreEventLoopRelease(loop);
+    return false;
+  }
+
+  loop->wakeSource.descriptor = loop->wakeDescriptors[0];
+  loop->wakeSource.callback = SFTCoreEventLoopDrainWakeUps;
+  loop->wakeSource.userData = loop;
+  if (!SFTCoreEventLoopRegister(loop, &loop->wakeSource, SFTCoreEventReadable,
+                                true)) {
+    SFTCoreEventLoopRelease(loop);
+    return false;
+  }
+  loop->wakeSource.interest = SFTCoreEventReadable;
+
+  return true;
+}
+
+bool SFTCoreEventLoopStart(SFTCoreEventLoop *loop) {
+  if (loop->started) {
+    return true;
+  }
+
+  atomic_store(&loop->running, true);
+  if (pthread_create(&loop->thread, NULL, SFTCoreEventLoopThread, loop) != 0) {
+    atomic_store(&loop->running, false);
+    return false;
+  }
+
+  loop->started = true;
+  return true;
+}
+
+void SFTCoreEventLoopStop(SFTCoreEventLoop *loop) {
+  if (!loop->started) {
+    return;
+  }
+
+  atomic_store(&loop->running, false);
+  SFTCoreEventLoopWakeUp(loop);
+  pthread_join(loop->thread, NULL);
+  loop->started = false;
+}
+
+void SFTCoreEventLoopRelease(SFTCoreEventLoop *loop) {
+  pthread_mutex_destroy(&loop->lock);
+
+  for (int index = 0; index < 2; index++) {
+    if (loop->wakeDescriptors[index] >= 0) {
+      close(loop->wakeDescriptors[index]);
+      loop->wakeDescriptors[index] = -1;
+    }
+  }
+
+  if (loop->queue >= 0) {
+    close(loop->queue);
+    loop->queue = -1;
+  }
+
+  free(loop->pendingTasks);
+  free(loop->runningTasks);
+  loop->pendingTasks = NULL;
+  loop->runningTasks = NULL;
+  loop->pendingTasksCapacity = 0;
+  loop->runningTasksCapacity = 0;
+}
+
+bool SFTCoreEventLoopPerform(SFTCoreEventLoop *loop, SFTCoreEventLoopTask task,
+                             void *context) {
+  pthread_mutex_lock(&loop->lock);
+  if (loop->pendingTasksCount == loop->pendingTasksCapacity) {
+    size_t capacity =
+        (loop->pendingTasksCapacity > 0) ? loop->pendingTasksCapacity * 2 : 16;
+    SFTCoreEventLoopTaskEntry *tasks = (SFTCoreEventLoopTaskEntry *)realloc(
+        loop->pendingTasks, capacity * sizeof(SFTCoreEventLoopTaskEntry));
+    if (tasks == NULL) {
+      pthread_mutex_unlock(&loop->lock);
+      return false;
+    }
+    loop->pendingTasks = tasks;
+    loop->pendingTasksCapacity = capacity;
+  }
+
+  loop->pendingTasks[loop->pendingTasksCount].task = task;
+  loop->pendingTasks[loop->pendingTasksCount].context = context;
+  loop->pendingTasksCount++;
+  pthread_mutex_unlock(&loop->lock);
+
+  if (!atomic_exchange(&loop->wakePending, true)) {
+    SFTCoreEventLoopWakeUp(loop);
+  }
+
+  return true;
+}
+
+bool SFTCoreEventLoopIsCurrentThread(const SFTCoreEventLoop *loop) {
+  return loop->started && pthread_equal(pthread_self(), loop->thread);
+}
+
+bool SFTCoreEventLoopAddSource(SFTCoreEventLoop *loop,
+                               SFTCoreEventSource *source, uint32_t interest) {
+  if (!SFTCoreEventLoopMakeNonBlocking(source->descriptor) ||
+      !SFTCoreEventLoopRegister(loop, source, interest, true)) {
+    return false;
+  }
+
+  source->interest = interest;
+  loop->sourcesCount++;
+  return true;
+}
+
+bool SFTCoreEventLoopSetInterest(SFTCoreEventLoop *loop,
+                                 SFTCoreEventSource *source,
+                                 uint32_t interest) {
+  if (source->interest == interest) {
+    return true;
+  }
+
+  if (!SFTCoreEventLoopRegister(loop, source, interest, false)) {
+    return false;
+  }
+
+  source->interest = interest;
+  return true;
+}
+
+void SFTCoreEventLoopRemoveSource(SFTCoreEventLoop *loop,
+                                  SFTCoreEventSource *source) {
+  if (source->descriptor < 0) {
+    return;
+  }
+
+  SFTCoreEventLoopUnregister(loop, source);
+  source->descriptor = -1;
+  source->interest = 0;
+  loop->sourcesCount--;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreEventLoop_h
+#define SFTCoreEventLoop_h
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Readiness conditions reported to, and requested by, event sources.
+ */
+typedef enum {
+  SFTCoreEventReadable = 1 << 0,
+  SFTCoreEventWritable = 1 << 1,
+
+  /**
+   * The peer went away or the descriptor is in error, only ever reported.
+   */
+  SFTCoreEventHangUp = 1 << 2
+} SFTCoreEvent;
+
+struct SFTCoreEventSource;
+
+/**
+ * Callback invoked on the loop thread when a source becomes ready.
+ *
+ * @param[in] source the ready source.
+ * @param[in] events the SFTCoreEvent conditions being reported.
+ */
+typedef void (*SFTCoreEventSourceCallback)(struct SFTCoreEventSource *source,
+                                           uint32_t events);
+
+/**
+ * Non-blocking descriptor watched by an event loop.
+ *
+ * Sources are owned by their users; once removed, a source's memory must
+ * stay valid until the current loop iteration ends, which is guaranteed
+ * when releasing it from a task queued with SFTCoreEventLoopPerform.
+ */
+typedef struct SFTCoreEventSource {
+  /**
+   * The watched descriptor, -1 once the source was removed.
+   */
+  int descriptor;
+
+  /**
+   * SFTCoreEvent conditions currently being watched for.
+   */
+  uint32_t interest;
+
+  SFTCoreEventSourceCallback callback;
+
+  /**
+   * Opaque pointer for the callback's own use.
+   */
+  void *userData;
+} SFTCoreEventSource;
+
+/**
+ * Function run on the loop thread on behalf of another thread.
+ *
+ * @param[in] context the opaque pointer given when queueing the task.
+ */
+typedef void (*SFTCoreEventLoopTask)(void *context);
+
+typedef struct {
+  SFTCoreEventLoopTask task;
+  void *context;
+} SFTCoreEventLoopTaskEntry;
+
+/**
+ * Single thread multiplexing any number of sources, on top of kqueue on
+ * BSD-derived systems and epoll on Linux.
+ *
+ * Sources can only be added, changed, and removed on the loop thread, or
+ * before the loop is started; other threads have to queue a task doing that
+ * for them.
+ */
+typedef struct {
+  /**
+   * The kqueue or epoll descriptor.
+   */
+  int queue;
+
+  /**
+   * Self-pipe used to wake the loop up when tasks are queued.
+   */
+  int wakeDescriptors[2];
+  SFTCoreEventSource wakeSource;
+
+  pthread_t thread;
+  bool started;
+  _Atomic bool running;
+
+  /**
+   * Set while a wake-up byte is in the pipe, to avoid writing more.
+   */
+  _Atomic bool wakePending;
+
+  /**
+   * Tasks queued by other threads, protected by lock.
+   */
+  pthread_mutex_t lock;
+  SFTCoreEventLoopTaskEntry *pendingTasks;
+  size_t pendingTasksCount;
+  size_t pendingTasksCapacity;
+
+  /**
+   * Tasks being run by the loop thread, swapped with pendingTasks.
+   */
+  SFTCoreEventLoopTaskEntry *runningTasks;
+  size_t runningTasksCapacity;
+
+  /**
+   * Amount of sources added by users, loop thread only.
+   */
+  size_t sourcesCount;
+} SFTCoreEventLoop;
+
+/**
+ * Initialises the given event loop, without starting its thread.
+ *
+ * @param[out] loop the loop to initialise.
+ *
+ * @return true if the loop was initialised, false otherwise.
+ */
+bool SFTCoreEventLoopInitialise(SFTCoreEventLoop *loop);
+
+/**
+ * Starts the loop thread.
+ *
+ * @param[in,out] loop the loop to start.
+ *
+ * @return true if the thread was started, false otherwise.
+ */
+bool SFTCoreEventLoopStart(SFTCoreEventLoop *loop);
+
+/**
+ * Stops the loop thread and waits for it to exit, must not be called from
+ * the loop thread itself.  Tasks still queued are not run.
+ *
+ * @param[in,out] loop the loop to stop.
+ */
+void SFTCoreEventLoopStop(SFTCoreEventLoop *loop);
+
+/**
+ * Releases the resources held by a stopped event loop.
+ *
+ * @param[in,out] loop the loop to release.
+ */
+void SFTCoreEventLoopRelease(SFTCoreEventLoop *loop);
+
+/**
+ * Queues a task to be run on the loop thread, can be called from any thread.
+ *
+ * Tasks run in queueing order, after the current batch of ready sources was
+ * dispatched.
+ *
+ * @param[in,out] loop the loop to run the task on.
+ * @param[in] task the function to run.
+ * @param[in] context the opaque pointer to pass to the task.
+ *
+ * @return true if the task was queued, false if it could not be stored.
+ */
+bool SFTCoreEventLoopPerform(SFTCoreEventLoop *loop, SFTCoreEventLoopTask task,
+                             void *context);
+
+/**
+ * Checks whether the caller is running on the loop thread.
+ *
+ * @param[in] loop the loop to check.
+ *
+ * @return true if called from the loop thread, false otherwise.
+ */
+bool SFTCoreEventLoopIsCurrentThread(const SFTCoreEventLoop *loop);
+
+/**
+ * Loop thread: starts watching the given source.
+ *
+ * @param[in,out] loop the loop to add the source to.
+ * @param[in,out] source the source to add, with its descriptor, callback,
+ * and user data already set.
+ * @param[in] interest the SFTCoreEvent conditions to watch for.
+ *
+ * @return true if the source was added, false otherwise.
+ */
+bool SFTCoreEventLoopAddSource(SFTCoreEventLoop *loop,
+                               SFTCoreEventSource *source, uint32_t interest);
+
+/**
+ * Loop thread: changes the conditions watched for on the given source.
+ *
+ * @param[in,out] loop the loop the source belongs to.
+ * @param[in,out] source the source to change.
+ * @param[in] interest the SFTCoreEvent conditions to watch for.
+ *
+ * @return true if the source was changed, false otherwise.
+ */
+bool SFTCoreEventLoopSetInterest(SFTCoreEventLoop *loop,
+                                 SFTCoreEventSource *source,
+                                 uint32_t interest);
+
+/**
+ * Loop thread: stops watching the given source, without closing its
+ * descriptor.  Events already collected for it are discarded.
+ *
+ * @param[in,out] loop the loop the source belongs to.
+ * @param[in,out] source the source to remove.
+ */
+void SFTCoreEventLoopRemoveSource(SFTCoreEventLoop *loop,
+                                  SFTCoreEventSource *source);
+
+#endif /* SFTCoreEventLoop_h */
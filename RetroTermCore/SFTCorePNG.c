@@ -0,0 +1,424 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTCorePNG.h"
+
+/**
+ * LZ77 window size, in bytes, as large as deflate allows.
+ */
+#define SFTCorePNGWindowSize 32768
+
+/**
+ * Hash table size for three byte sequences, in entries.
+ */
+#define SFTCorePNGHashSize 32768
+
+/**
+ * Match lengths and distances allowed by deflate.
+ */
+#define SFTCorePNGMinimumMatch 3
+#define SFTCorePNGMaximumMatch 258
+
+/**
+ * Earlier positions with the same hash tried before settling for the longest
+ * match found so far.
+ */
+#define SFTCorePNGChainLength 32
+
+static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A,
+                                      '\n'};
+
+static const uint16_t kLengthBases[29] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+
+static const uint8_t kLengthExtraBits[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                             1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                             4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+static const uint16_t kDistanceBases[30] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+
+static const uint8_t kDistanceExtraBits[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/**
+ * Growable output buffer, with a bit accumulator for the deflate stream.
+ */
+typedef struct {
+  uint8_t *bytes;
+  size_t length;
+  size_t capacity;
+  uint32_t bits;
+  uint32_t bitsCount;
+  bool failed;
+} SFTCorePNGBuffer;
+
+static bool SFTCorePNGReserve(SFTCorePNGBuffer *buffer, size_t length) {
+  if (buffer->failed) {
+    return false;
+  }
+
+  if (buffer->length + length <= buffer->capacity) {
+    return true;
+  }
+
+  size_t capacity = buffer->capacity * 2;
+  if (capacity < buffer->length + length) {
+    capacity = buffer->length + length;
+  }
+  uint8_t *bytes = (uint8_t *)realloc(buffer->bytes, capacity);
+  if (bytes == NULL) {
+    buffer->failed = true;
+    return false;
+  }
+
+  buffer->bytes = bytes;
+  buffer->capacity = capacity;
+  return true;
+}
+
+static void SFTCorePNGAppend(SFTCorePNGBuffer *buffer, const void *bytes,
+                             size_t length) {
+  if ((length > 0) && SFTCorePNGReserve(buffer, length)) {
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+  }
+}
+
+static void SFTCorePNGAppendUInt32(SFTCorePNGBuffer *buffer, uint32_t value) {
+  uint8_t bytes[4] = {(uint8_t)(value >> 24), (uint8_t)(value >> 16),
+                      (uint8_t)(value >> 8), (uint8_t)value};
+  SFTCorePNGAppend(buffer, bytes, sizeof(bytes));
+}
+
+/**
+ * Appends bits to the deflate stream, least significant bit first.
+ */
+static void SFTCorePNGWriteBits(SFTCorePNGBuffer *buffer, uint32_t bits,
+                                uint32_t count) {
+  buffer->bits |= bits << buffer->bitsCount;
+  buffer->bitsCount += count;
+  while (buffer->bitsCount >= 8) {
+    uint8_t byte = (uint8_t)buffer->bits;
+    SFTCorePNGAppend(buffer, &byte, 1);
+    buffer->bits >>= 8;
+    buffer->bitsCount -= 8;
+  }
+}
+
+static void SFTCorePNGFlushBits(SFTCorePNGBuffer *buffer) {
+  if (buffer->bitsCount > 0) {
+    SFTCorePNGWriteBits(buffer, 0, 8 - buffer->bitsCount);
+  }
+}
+
+/**
+ * Appends a Huffman code, which deflate stores most significant bit first.
+ */
+static void SFTCorePNGWriteCode(SFTCorePNGBuffer *buffer, uint32_t code,
+                                uint32_t count) {
+  uint32_t reversed = 0;
+  for (uint32_t bit = 0; bit < count; bit++) {
+    reversed = (reversed << 1) | ((code >> bit) & 0x01);
+  }
+  SFTCorePNGWriteBits(buffer, reversed, count);
+}
+
+/**
+ * Appends a literal or length symbol using the fixed Huffman codes.
+ */
+static void SFTCorePNGWriteSymbol(SFTCorePNGBuffer *buffer, uint32_t symbol) {
+  if (symbol < 144) {
+    SFTCorePNGWriteCode(buffer, 0x30 + symbol, 8);
+  } else if (symbol < 256) {
+    SFTCorePNGWriteCode(buffer, 0x190 + (symbol - 144), 9);
+  } else if (symbol < 280) {
+    SFTCorePNGWriteCode(buffer, symbol - 256, 7);
+  } else {
+    SFTCorePNGWriteCode(buffer, 0xC0 + (symbol - 280), 8);
+  }
+}
+
+static void SFTCorePNGWriteMatch(SFTCorePNGBuffer *buffer, size_t length,
+                                 size_t distance) {
+  uint32_t code = 28;
+  while (kLengthBases[code] > length) {
+    code--;
+  }
+  SFTCorePNGWriteSymbol(buffer, 257 + code);
+  SFTCorePNGWriteBits(buffer, (uint32_t)(length - kLengthBases[code]),
+                      kLengthExtraBits[code]);
+
+  code = 29;
+  while (kDistanceBases[code] > distance) {
+    code--;
+  }
+  SFTCorePNGWriteCode(buffer, code, 5);
+  SFTCorePNGWriteBits(buffer, (uint32_t)(distance - kDistanceBases[code]),
+                      kDistanceExtraBits[code]);
+}
+
+static uint32_t SFTCorePNGHash(const uint8_t *bytes) {
+  uint32_t value = ((uint32_t)bytes[0] << 16) | ((uint32_t)bytes[1] << 8) |
+                   (uint32_t)bytes[2];
+  return (value * 2654435761U) >> 17;
+}
+
+/**
+ * Compresses the given bytes as a zlib stream made of a single deflate block
+ * using the fixed Huffman codes.
+ */
+static bool SFTCorePNGDeflate(SFTCorePNGBuffer *buffer, const uint8_t *bytes,
+                              size_t length) {
+  int32_t *head = (int32_t *)malloc(SFTCorePNGHashSize * sizeof(int32_t));
+  int32_t *previous =
+      (int32_t *)malloc(SFTCorePNGWindowSize * sizeof(int32_t));
+  if ((head == NULL) || (previous == NULL)) {
+    free(head);
+    free(previous);
+    return false;
+  }
+  for (size_t index = 0; index < SFTCorePNGHashSize; index++) {
+    head[index] = -1;
+  }
+
+  // Deflate with a 32 KiB window, no dictionary, fastest level hint.
+  static const uint8_t kHeader[2] = {0x78, 0x01};
+  SFTCorePNGAppend(buffer, kHeader, sizeof(kHeader));
+  SFTCorePNGWriteBits(buffer, 0x03, 3);
+
+  size_t position = 0;
+  while (position < length) {
+    size_t bestLength = 0;
+    size_t bestDistance = 0;
+
+    if (position + SFTCorePNGMinimumMatch <= length) {
+      size_t limit = length - position;
+      if (limit > SFTCorePNGMaximumMatch) {
+        limit = SFTCorePNGMaximumMatch;
+      }
+
+      int32_t candidate = head[SFTCorePNGHash(bytes + position)];
+      for (size_t chain = 0;
+           (chain < SFTCorePNGChainLength) && (candidate >= 0) &&
+           (position - (size_t)candidate <= SFTCorePNGWindowSize);
+           chain++) {
+        const uint8_t *match = bytes + candidate;
+        if (match[bestLength] == bytes[position + bestLength]) {
+          size_t matched = 0;
+          while ((matched < limit) &&
+                 (match[matched] == bytes[position + matched])) {
+            matched++;
+          }
+          if (matched > bestLength) {
+            bestLength = matched;
+            bestDistance = position - (size_t)candidate;
+            if (matched == limit) {
+              break;
+            }
+          }
+        }
+        candidate = previous[(size_t)candidate % SFTCorePNGWindowSize];
+      }
+    }
+
+    size_t advance = 1;
+    if (bestLength >= SFTCorePNGMinimumMatch) {
+      SFTCorePNGWriteMatch(buffer, bestLength, bestDistance);
+      advance = bestLength;
+    } else {
+      SFTCorePNGWriteSymbol(buffer, bytes[position]);
+    }
+
+    // Every position goes in the hash chains, including those matched.
+    for (size_t index = 0; index < advance; index++, position++) {
+      if (position + SFTCorePNGMinimumMatch <= length) {
+        uint32_t hash = SFTCorePNGHash(bytes + position);
+        previous[position % SFTCorePNGWindowSize] = head[hash];
+        head[hash] = (int32_t)position;
+      }
+    }
+  }
+
+  SFTCorePNGWriteSymbol(buffer, 256);
+  SFTCorePNGFlushBits(buffer);
+
+  uint32_t low = 1;
+  uint32_t high = 0;
+  for (size_t offset = 0; offset < length;) {
+    // Sums stay within 32 bits for 5552 bytes before reducing them.
+    size_t end = offset + 5552 < length ? offset + 5552 : length;
+    for (; offset < end; offset++) {
+      low += bytes[offset];
+      high += low;
+    }
+    low %= 65521;
+    high %= 65521;
+  }
+  SFTCorePNGAppendUInt32(buffer, (high << 16) | low);
+
+  free(head);
+  free(previous);
+  return !buffer->failed;
+}
+
+static void SFTCorePNGAppendChunk(SFTCorePNGBuffer *buffer,
+                                  const uint32_t *crcTable, const char *type,
+                                  const uint8_t *data, size_t length) {
+  SFTCorePNGAppendUInt32(buffer, (uint32_t)length);
+  size_t start = buffer->length;
+  SFTCorePNGAppend(buffer, type, 4);
+  SFTCorePNGAppend(buffer, data, length);
+  if (buffer->failed) {
+    return;
+  }
+
+  uint32_t crc = 0xFFFFFFFFU;
+  for (size_t index = start; index < buffer->length; index++) {
+    crc = crcTable[(crc ^ buffer->bytes[index]) & 0xFF] ^ (crc >> 8);
+  }
+  SFTCorePNGAppendUInt32(buffer, crc ^ 0xFFFFFFFFU);
+}
+
+/**
+ * Sums the magnitude of filtered bytes, the smallest sum usually making for
+ * the best compression.
+ */
+static size_t SFTCorePNGCost(const uint8_t *bytes, size_t length) {
+  size_t cost = 0;
+  for (size_t index = 0; index < length; index++) {
+    cost += bytes[index] < 128 ? bytes[index] : 256U - bytes[index];
+  }
+  return cost;
+}
+
+bool SFTCorePNGEncode(const uint32_t *pixels, size_t width, size_t height,
+                      size_t stride, uint8_t **png, size_t *length) {
+  *png = NULL;
+  *length = 0;
+
+  if ((width == 0) || (height == 0) || (width > 0x7FFFFFFF) ||
+      (height > 0x7FFFFFFF)) {
+    return false;
+  }
+
+  size_t rowLength = 1 + (width * 3);
+  uint8_t *filtered = (uint8_t *)malloc(rowLength * height);
+  uint8_t *rows = (uint8_t *)malloc(width * 3 * 2);
+  uint8_t *candidates = (uint8_t *)malloc(width * 3 * 2);
+  if ((filtered == NULL) || (rows == NULL) || (candidates == NULL)) {
+    free(filtered);
+    free(rows);
+    free(candidates);
+    return false;
+  }
+
+  // The row above the first one is made of zeroes.
+  uint8_t *above = rows;
+  uint8_t *current = rows + (width * 3);
+  memset(above, 0, width * 3);
+
+  for (size_t y = 0; y < height; y++) {
+    const uint8_t *source = (const uint8_t *)(pixels + (y * stride));
+    for (size_t x = 0; x < width; x++) {
+      memcpy(current + (x * 3), source + (x * 4), 3);
+    }
+
+    uint8_t *sub = candidates;
+    uint8_t *up = candidates + (width * 3);
+    for (size_t index = 0; index < width * 3; index++) {
+      sub[index] = (uint8_t)(current[index] -
+                             (index >= 3 ? current[index - 3] : 0));
+      up[index] = (uint8_t)(current[index] - above[index]);
+    }
+
+    size_t noneCost = SFTCorePNGCost(current, width * 3);
+    size_t subCost = SFTCorePNGCost(sub, width * 3);
+    size_t upCost = SFTCorePNGCost(up, width * 3);
+
+    uint8_t *row = filtered + (y * rowLength);
+    if ((upCost <= subCost) && (upCost <= noneCost)) {
+      row[0] = 2;
+      memcpy(row + 1, up, width * 3);
+    } else if (subCost <= noneCost) {
+      row[0] = 1;
+      memcpy(row + 1, sub, width * 3);
+    } else {
+      row[0] = 0;
+      memcpy(row + 1, current, width * 3);
+    }
+
+    uint8_t *swap = above;
+    above = current;
+    current = swap;
+  }
+  free(rows);
+  free(candidates);
+
+  uint32_t crcTable[256];
+  for (uint32_t index = 0; index < 256; index++) {
+    uint32_t value = index;
+    for (size_t bit = 0; bit < 8; bit++) {
+      value = (value & 0x01) ? 0xEDB88320U ^ (value >> 1) : value >> 1;
+    }
+    crcTable[index] = value;
+  }
+
+  SFTCorePNGBuffer buffer = {0};
+  SFTCorePNGAppend(&buffer, kSignature, sizeof(kSignature));
+
+  // 8 bits per channel RGB, deflate, adaptive filtering, no interlacing.
+  uint8_t header[13] = {(uint8_t)(width >> 24),  (uint8_t)(width >> 16),
+                        (uint8_t)(width >> 8),   (uint8_t)width,
+                        (uint8_t)(height >> 24), (uint8_t)(height >> 16),
+                        (uint8_t)(height >> 8),  (uint8_t)height,
+                        8,                       2,
+                        0,                       0,
+                        0};
+  SFTCorePNGAppendChunk(&buffer, crcTable, "IHDR", header, sizeof(header));
+
+  SFTCorePNGBuffer stream = {0};
+  bool compressed = SFTCorePNGDeflate(&stream, filtered, rowLength * height);
+  free(filtered);
+  if (compressed) {
+    SFTCorePNGAppendChunk(&buffer, crcTable, "IDAT", stream.bytes,
+                          stream.length);
+  }
+  free(stream.bytes);
+  SFTCorePNGAppendChunk(&buffer, crcTable, "IEND", NULL, 0);
+
+  if (!compressed || buffer.failed) {
+    free(buffer.bytes);
+    return false;
+  }
+
+  *png = buffer.bytes;
+  *length = buffer.length;
+  return true;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCorePNG_h
+#define SFTCorePNG_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Encodes an image as an 8 bits per channel RGB PNG file, dropping alpha.
+ *
+ * Scanlines are filtered with whichever of the none, sub and up filters
+ * leaves the smallest residuals, and compressed with LZ77 and the fixed
+ * Huffman codes: screens made of a handful of colours and repeated glyphs
+ * shrink well without the cost of building dynamic codes.
+ *
+ * @param[in] pixels the image, each pixel holding red, green, blue and alpha
+ * bytes in memory order.
+ * @param[in] width the image width, in pixels.
+ * @param[in] height the image height, in pixels.
+ * @param[in] stride the distance between two image rows, in pixels.
+ * @param[out] png the encoded file, to be released with free().
+ * @param[out] length the encoded file length, in bytes.
+ *
+ * @return true if the image was encoded, false otherwise.
+ */
+bool SFTCorePNGEncode(const uint32_t *pixels, size_t width, size_t height,
+                      size_t stride, uint8_t **png, size_t *length);
+
+#endif /* SFTCorePNG_h */
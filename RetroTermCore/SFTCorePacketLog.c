@@ -0,0 +1,143 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTCorePacketLog.h"
+
+bool SFTCorePacketLogInitialise(SFTCorePacketLog *log, size_t byteBudget) {
+  memset(log, 0, sizeof(SFTCorePacketLog));
+
+  if ((byteBudget == 0) ||
+      (byteBudget > (size_t)(SFTCorePacketLogRecordInbound - 1))) {
+    return false;
+  }
+
+  size_t recordsCapacity = byteBudget / SFTCorePacketLogBytesPerRecord;
+  if (recordsCapacity < SFTCorePacketLogMinimumRecords) {
+    recordsCapacity = SFTCorePacketLogMinimumRecords;
+  }
+
+  log->arena = (uint8_t *)malloc(byteBudget);
+  log->records = (SFTCorePacketLogRecord *)malloc(
+      recordsCapacity * sizeof(SFTCorePacketLogRecord));
+  if ((log->arena == NULL) || (log->records == NULL)) {
+    SFTCorePacketLogRelease(log);
+    return false;
+  }
+
+  log->arenaCapacity = byteBudget;
+  log->recordsCapacity = recordsCapacity;
+  return true;
+}
+
+void SFTCorePacketLogRelease(SFTCorePacketLog *log) {
+  free(log->arena);
+  free(log->records);
+  memset(log, 0, sizeof(SFTCorePacketLog));
+}
+
+static void SFTCorePacketLogEvict(SFTCorePacketLog *log) {
+  log->first++;
+  if (log->first == log->recordsCapacity) {
+    log->first = 0;
+  }
+  log->count--;
+  log->evicted++;
+
+  if (log->count == 0) {
+    log->first = 0;
+    log->arenaHead = 0;
+    log->arenaTail = 0;
+  } else {
+    log->arenaHead = log->records[log->first].offset;
+  }
+}
+
+/**
+ * Finds room for a payload of the given length, which must fit in the arena,
+ * evicting old packets until there is some.
+ */
+static size_t SFTCorePacketLogReserve(SFTCorePacketLog *log, size_t length) {
+  for (;;) {
+    if (log->count == log->recordsCapacity) {
+      SFTCorePacketLogEvict(log);
+      continue;
+    }
+
+    if (log->count == 0) {
+      return 0;
+    }
+
+    if (log->arenaTail > log->arenaHead) {
+      // Free space sits both past the newest payload and before the oldest.
+      if (log->arenaCapacity - log->arenaTail >= length) {
+        return log->arenaTail;
+      }
+      if (log->arenaHead >= length) {
+        return 0;
+      }
+    } else if (log->arenaHead - log->arenaTail >= length) {
+      return log->arenaTail;
+    }
+
+    SFTCorePacketLogEvict(log);
+  }
+}
+
+void SFTCorePacketLogAppend(SFTCorePacketLog *log, uint64_t timestamp,
+                            bool inbound, const uint8_t *bytes,
+                            size_t length) {
+  if (length == 0) {
+    return;
+  }
+  if (length > log->arenaCapacity) {
+    length = log->arenaCapacity;
+  }
+
+  size_t offset = SFTCorePacketLogReserve(log, length);
+  memcpy(log->arena + offset, bytes, length);
+  if (log->count == 0) {
+    log->arenaHead = offset;
+  }
+  log->arenaTail = offset + length;
+
+  size_t slot = log->first + log->count;
+  if (slot >= log->recordsCapacity) {
+    slot -= log->recordsCapacity;
+  }
+  log->records[slot].timestamp = timestamp;
+  log->records[slot].offset = (uint32_t)offset;
+  log->records[slot].lengthAndDirection =
+      (uint32_t)length | (inbound ? SFTCorePacketLogRecordInbound : 0);
+  log->count++;
+  log->appended++;
+}
+
+void SFTCorePacketLogClear(SFTCorePacketLog *log) {
+  log->evicted += log->count;
+  log->first = 0;
+  log->count = 0;
+  log->arenaHead = 0;
+  log->arenaTail = 0;
+}
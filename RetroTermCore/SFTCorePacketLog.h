@@ -0,0 +1,181 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCorePacketLog_h
+#define SFTCorePacketLog_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Payload bytes the record ring is sized for, per record.
+ */
+#define SFTCorePacketLogBytesPerRecord 64
+
+/**
+ * Smallest amount of records a log can hold.
+ */
+#define SFTCorePacketLogMinimumRecords 64
+
+/**
+ * Metadata of a logged packet, whose payload lives in the log's arena.
+ */
+typedef struct {
+  /**
+   * Time the packet was logged at, in nanoseconds since the Unix epoch.
+   */
+  uint64_t timestamp;
+
+  /**
+   * Payload offset in the arena.
+   */
+  uint32_t offset;
+
+  /**
+   * Payload length, in bytes, with the inbound flag in the topmost bit.
+   */
+  uint32_t lengthAndDirection;
+} SFTCorePacketLogRecord;
+
+#define SFTCorePacketLogRecordInbound UINT32_C(0x80000000)
+
+/**
+ * Fixed size log of the most recent packets, evicting the oldest ones first.
+ *
+ * Packet payloads are packed one after the other in a byte arena, wrapping
+ * around to its start when the next payload does not fit before its end,
+ * while their metadata goes into a separate ring of records.  Nothing is
+ * allocated after initialisation.  The log is not thread-safe.
+ */
+typedef struct {
+  uint8_t *arena;
+  size_t arenaCapacity;
+
+  /**
+   * Arena offset of the oldest payload and right past the newest one.
+   */
+  size_t arenaHead;
+  size_t arenaTail;
+
+  SFTCorePacketLogRecord *records;
+  size_t recordsCapacity;
+
+  /**
+   * Ring index of the oldest record.
+   */
+  size_t first;
+  size_t count;
+
+  /**
+   * Packets ever logged, and packets evicted so far.
+   */
+  uint64_t appended;
+  uint64_t evicted;
+} SFTCorePacketLog;
+
+/**
+ * Initialises the given log, allocating its storage.
+ *
+ * @param[out] log the log to initialise.
+ * @param[in] byteBudget the arena size, in bytes; the record ring takes an
+ * extra byteBudget / SFTCorePacketLogBytesPerRecord records.
+ *
+ * @return true if the log was initialised, false otherwise.
+ */
+bool SFTCorePacketLogInitialise(SFTCorePacketLog *log, size_t byteBudget);
+
+/**
+ * Releases the storage held by the given log.
+ *
+ * @param[in,out] log the log to release.
+ */
+void SFTCorePacketLogRelease(SFTCorePacketLog *log);
+
+/**
+ * Appends a packet, evicting as many old ones as needed to make room.
+ *
+ * Payloads longer than the arena are truncated, and empty ones are ignored.
+ *
+ * @param[in,out] log the log to append to.
+ * @param[in] timestamp the packet time, in nanoseconds since the Unix epoch.
+ * @param[in] inbound whether the packet was received rather than sent.
+ * @param[in] bytes the packet contents.
+ * @param[in] length the packet length, in bytes.
+ */
+void SFTCorePacketLogAppend(SFTCorePacketLog *log, uint64_t timestamp,
+                            bool inbound, const uint8_t *bytes, size_t length);
+
+/**
+ * Removes every packet from the log.
+ *
+ * @param[in,out] log the log to clear.
+ */
+void SFTCorePacketLogClear(SFTCorePacketLog *log);
+
+/**
+ * Returns the packet at the given position, oldest first.
+ *
+ * @param[in] log the log to read from.
+ * @param[in] index the packet position, less than the log's count.
+ * @param[out] payload the packet contents, valid until the next append.
+ *
+ * @return the packet record.
+ */
+static inline const SFTCorePacketLogRecord *
+SFTCorePacketLogGet(const SFTCorePacketLog *log, size_t index,
+                    const uint8_t **payload) {
+  size_t slot = log->first + index;
+  if (slot >= log->recordsCapacity) {
+    slot -= log->recordsCapacity;
+  }
+
+  const SFTCorePacketLogRecord *record = &log->records[slot];
+  *payload = log->arena + record->offset;
+  return record;
+}
+
+/**
+ * Extracts the payload length from a packet record.
+ *
+ * @param[in] record the record to inspect.
+ *
+ * @return the payload length, in bytes.
+ */
+static inline size_t
+SFTCorePacketLogRecordLength(const SFTCorePacketLogRecord *record) {
+  return record->lengthAndDirection & ~SFTCorePacketLogRecordInbound;
+}
+
+/**
+ * Checks whether a packet record describes received bytes.
+ *
+ * @param[in] record the record to inspect.
+ *
+ * @return true for received packets, false for sent ones.
+ */
+static inline bool
+SFTCorePacketLogRecordIsInbound(const SFTCorePacketLogRecord *record) {
+  return (record->lengthAndDirection & SFTCorePacketLogRecordInbound) != 0;
+}
+
+#endif /* SFTCorePacketLog_h */
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "SFTCorePipeline.h"
+
+/**
+ * Runs a span through the stages between first and the end of the pipeline
+ * in the given direction, first included.
+ */
+static size_t SFTCorePipelineRunFrom(SFTCorePipeline *pipeline, size_t first,
+                                     SFTCorePipelineDirection direction,
+                                     uint8_t *bytes, size_t length) {
+  if (direction == SFTCorePipelineDirectionInbound) {
+    for (size_t stage = first; (stage < pipeline->count) && (length > 0);
+         stage++) {
+      length = pipeline->stages[stage].process(pipeline, stage, direction,
+                                               bytes, length);
+    }
+  } else {
+    for (size_t stage = first; (stage-- > 0) && (length > 0);) {
+      length = pipeline->stages[stage].process(pipeline, stage, direction,
+                                               bytes, length);
+    }
+  }
+
+  return length;
+}
+
+void SFTCorePipelineInitialise(SFTCorePipeline *pipeline) {
+  memset(pipeline, 0, sizeof(SFTCorePipeline));
+}
+
+bool SFTCorePipelineAppend(SFTCorePipeline *pipeline,
+                           SFTCorePipelineProcess process, void *context) {
+  if (pipeline->count == SFTCorePipelineMaximumStages) {
+    return false;
+  }
+
+  pipeline->stages[pipeline->count].process = process;
+  pipeline->stages[pipeline->count].context = context;
+  pipeline->count++;
+  return true;
+}
+
+size_t SFTCorePipelineRun(SFTCorePipeline *pipeline,
+                          SFTCorePipelineDirection direction, uint8_t *bytes,
+                          size_t length) {
+  return SFTCorePipelineRunFrom(
+      pipeline,
+      (direction == SFTCorePipelineDirectionInbound) ? 0 : pipeline->count,
+      direction, bytes, length);
+}
+
+bool SFTCorePipelineInject(SFTCorePipeline *pipeline, size_t stage,
+                           SFTCorePipelineDirection direction,
+                           const uint8_t *bytes, size_t length) {
+  SFTCorePipelineInjection *injection = &pipeline->injected[direction];
+  if (length > SFTCorePipelineInjectionCapacity - injection->length) {
+    return false;
+  }
+
+  // The injected bytes are copied once, and the stages past the injecting
+  // one work on them in place at the tail of the injection buffer.  Room is
+  // reserved upfront, as those stages may inject bytes of their own.
+  size_t start = injection->length;
+  memcpy(injection->bytes + start, bytes, length);
+  injection->length += length;
+  size_t kept = SFTCorePipelineRunFrom(
+      pipeline,
+      (direction == SFTCorePipelineDirectionInbound) ? stage + 1 : stage,
+      direction, injection->bytes + start, length);
+
+  if (kept < length) {
+    memmove(injection->bytes + start + kept,
+            injection->bytes + start + length,
+            injection->length - (start + length));
+    injection->length -= length - kept;
+  }
+
+  return true;
+}
+
+void SFTCorePipelineConsumeInjected(SFTCorePipeline *pipeline,
+                                    SFTCorePipelineDirection direction,
+                                    size_t length) {
+  SFTCorePipelineInjection *injection = &pipeline->injected[direction];
+  if (length >= injection->length) {
+    injection->length = 0;
+    return;
+  }
+
+  memmove(injection->bytes, injection->bytes + length,
+          injection->length - length);
+  injection->length -= length;
+}
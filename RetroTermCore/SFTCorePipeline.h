@@ -0,0 +1,194 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCorePipeline_h
+#define SFTCorePipeline_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Most stages a pipeline can hold.
+ */
+#define SFTCorePipelineMaximumStages 8
+
+/**
+ * Room for bytes injected by stages and not yet delivered, per direction.
+ */
+#define SFTCorePipelineInjectionCapacity 4096
+
+typedef enum {
+  /** From the transport towards the emulator. */
+  SFTCorePipelineDirectionInbound = 0,
+  /** From the emulator towards the transport. */
+  SFTCorePipelineDirectionOutbound,
+  SFTCorePipelineDirectionsCount
+} SFTCorePipelineDirection;
+
+struct SFTCorePipeline;
+
+/**
+ * Processes a span of bytes travelling through a stage.
+ *
+ * The span is borrowed for the duration of the call: the stage can read it,
+ * rewrite it in place, or drop bytes from it by compacting what is left at
+ * its start, but never grow it.  Bytes to add are injected instead, with
+ * SFTCorePipelineInject.
+ *
+ * @param[in,out] pipeline the pipeline the stage belongs to.
+ * @param[in] stage the stage index, from the transport side.
+ * @param[in] direction the direction the bytes travel in.
+ * @param[in,out] bytes the span to process.
+ * @param[in] length the span length, in bytes.
+ *
+ * @return the amount of bytes left at the start of the span, to be passed on
+ * to the next stage.
+ */
+typedef size_t (*SFTCorePipelineProcess)(struct SFTCorePipeline *pipeline,
+                                         size_t stage,
+                                         SFTCorePipelineDirection direction,
+                                         uint8_t *bytes, size_t length);
+
+typedef struct {
+  SFTCorePipelineProcess process;
+  void *context;
+} SFTCorePipelineStage;
+
+/**
+ * Bytes injected by stages, waiting to reach the end of the pipeline.
+ */
+typedef struct {
+  uint8_t bytes[SFTCorePipelineInjectionCapacity];
+  size_t length;
+} SFTCorePipelineInjection;
+
+/**
+ * Ordered stages sitting between a transport and the emulator.
+ *
+ * Inbound spans go through the stages from the transport side onwards, and
+ * outbound spans the other way round.  Each stage is handed the whole span
+ * the previous one left, so batching carries through the chain and no
+ * stage sees bytes one at a time.  A pipeline is only ever used from one
+ * thread at a time.
+ */
+typedef struct SFTCorePipeline {
+  SFTCorePipelineStage stages[SFTCorePipelineMaximumStages];
+  size_t count;
+
+  SFTCorePipelineInjection injected[SFTCorePipelineDirectionsCount];
+} SFTCorePipeline;
+
+/**
+ * Initialises the given pipeline, with no stages.
+ *
+ * @param[out] pipeline the pipeline to initialise.
+ */
+void SFTCorePipelineInitialise(SFTCorePipeline *pipeline);
+
+/**
+ * Adds a stage at the emulator end of the given pipeline.
+ *
+ * @param[in,out] pipeline the pipeline to add the stage to.
+ * @param[in] process the stage's processing function.
+ * @param[in] context the stage's private data.
+ *
+ * @return true if the stage was added, false if the pipeline is full.
+ */
+bool SFTCorePipelineAppend(SFTCorePipeline *pipeline,
+                           SFTCorePipelineProcess process, void *context);
+
+/**
+ * Runs a span through every stage of the given pipeline.
+ *
+ * @param[in,out] pipeline the pipeline to use.
+ * @param[in] direction the direction the bytes travel in.
+ * @param[in,out] bytes the span to process, in place.
+ * @param[in] length the span length, in bytes.
+ *
+ * @return the amount of bytes left at the start of the span, to be handed
+ * over to the emulator or the transport.
+ */
+size_t SFTCorePipelineRun(SFTCorePipeline *pipeline,
+                          SFTCorePipelineDirection direction, uint8_t *bytes,
+                          size_t length);
+
+/**
+ * Adds bytes to the flow from within a stage, running them through the
+ * stages past it in the given direction.
+ *
+ * Injected bytes are delivered after the span currently being processed,
+ * and outbound ones go out ahead of anything not yet taken from the
+ * emulator.
+ *
+ * @param[in,out] pipeline the pipeline to use.
+ * @param[in] stage the index of the stage injecting the bytes.
+ * @param[in] direction the direction the bytes travel in.
+ * @param[in] bytes the bytes to inject.
+ * @param[in] length the amount of bytes to inject.
+ *
+ * @return true if the bytes were injected, false if there is no room left
+ * for them until the pending ones are delivered.
+ */
+bool SFTCorePipelineInject(SFTCorePipeline *pipeline, size_t stage,
+                           SFTCorePipelineDirection direction,
+                           const uint8_t *bytes, size_t length);
+
+/**
+ * Forgets the given amount of injected bytes, once they were delivered.
+ *
+ * @param[in,out] pipeline the pipeline to update.
+ * @param[in] direction the direction the bytes travel in.
+ * @param[in] length the amount of bytes delivered from the front.
+ */
+void SFTCorePipelineConsumeInjected(SFTCorePipeline *pipeline,
+                                    SFTCorePipelineDirection direction,
+                                    size_t length);
+
+/**
+ * Returns the private data of the given stage.
+ *
+ * @param[in] pipeline the pipeline the stage belongs to.
+ * @param[in] stage the stage index.
+ *
+ * @return the stage's private data.
+ */
+static inline void *SFTCorePipelineContext(const SFTCorePipeline *pipeline,
+                                           size_t stage) {
+  return pipeline->stages[stage].context;
+}
+
+/**
+ * Returns the injected bytes waiting at the given end of the pipeline.
+ *
+ * @param[in] pipeline the pipeline to query.
+ * @param[in] direction the direction the bytes travel in.
+ *
+ * @return the injected bytes, SFTCorePipelineInjection.length long.
+ */
+static inline const SFTCorePipelineInjection *
+SFTCorePipelineInjected(const SFTCorePipeline *pipeline,
+                        SFTCorePipelineDirection direction) {
+  return &pipeline->injected[direction];
+}
+
+#endif /* SFTCorePipeline_h */
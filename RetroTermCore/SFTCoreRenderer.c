@@ -0,0 +1,680 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTCoreCellKernels.h"
+#include "SFTCoreRenderer.h"
+
+/**
+ * Bits of a drawn cell record past the cell's own: whether the cell is shown
+ * reversed by the selection or the cursor, and the charset half.
+ */
+#define SFTCoreRendererDrawnReversed (UINT32_C(1) << 17)
+#define SFTCoreRendererDrawnLowerCase (UINT32_C(1) << 18)
+
+/**
+ * Cell bits affecting its appearance.
+ */
+#define SFTCoreRendererCellMask UINT32_C(0x1FFFF)
+
+// The shader's half precision palette, once converted to 8 bits per channel.
+
+const uint8_t SFTCoreRendererPalette[16][4] = {
+    {0x00, 0x00, 0x00, 0xFF}, {0xFF, 0xFF, 0xFF, 0xFF},
+    {0x88, 0x00, 0x00, 0xFF}, {0xAA, 0xFF, 0xEE, 0xFF},
+    {0xCC, 0x44, 0xCC, 0xFF}, {0x00, 0xCC, 0x55, 0xFF},
+    {0x00, 0x00, 0xAA, 0xFF}, {0xEE, 0xEE, 0x77, 0xFF},
+    {0xDD, 0x88, 0x55, 0xFF}, {0x66, 0x44, 0x00, 0xFF},
+    {0xFF, 0x77, 0x77, 0xFF}, {0x33, 0x33, 0x33, 0xFF},
+    {0x77, 0x77, 0x77, 0xFF}, {0xAA, 0xFF, 0x66, 0xFF},
+    {0x00, 0x88, 0xFF, 0xFF}, {0xBB, 0xBB, 0xBB, 0xFF}};
+
+// Extracted from the CharsetTexture asset, whose texels are doubled on both
+// axes.
+
+const uint8_t SFTCoreRendererGlyphs[SFTCoreRendererGlyphsCount]
+                                   [SFTCoreRendererCellSize] = {
+    {0x3C, 0x66, 0x6E, 0x6E, 0x60, 0x62, 0x3C, 0x00},
+    {0x00, 0x00, 0x3C, 0x06, 0x3E, 0x66, 0x3E, 0x00},
+    {0x00, 0x60, 0x60, 0x7C, 0x66, 0x66, 0x7C, 0x00},
+    {0x00, 0x00, 0x3C, 0x60, 0x60, 0x60, 0x3C, 0x00},
+    {0x00, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3E, 0x00},
+    {0x00, 0x00, 0x3C, 0x66, 0x7E, 0x60, 0x3C, 0x00},
+    {0x00, 0x0E, 0x18, 0x3E, 0x18, 0x18, 0x18, 0x00},
+    {0x00, 0x00, 0x3E, 0x66, 0x66, 0x3E, 0x06, 0x7C},
+    {0x00, 0x60, 0x60, 0x7C, 0x66, 0x66, 0x66, 0x00},
+    {0x00, 0x18, 0x00, 0x38, 0x18, 0x18, 0x3C, 0x00},
+    {0x00, 0x06, 0x00, 0x06, 0x06, 0x06, 0x06, 0x3C},
+    {0x00, 0x60, 0x60, 0x6C, 0x78, 0x6C, 0x66, 0x00},
+    {0x00, 0x38, 0x18, 0x18, 0x18, 0x18, 0x3C, 0x00},
+    {0x00, 0x00, 0x66, 0x7F, 0x7F, 0x6B, 0x63, 0x00},
+    {0x00, 0x00, 0x7C, 0x66, 0x66, 0x66, 0x66, 0x00},
+    {0x00, 0x00, 0x3C, 0x66, 0x66, 0x66, 0x3C, 0x00},
+    {0x00, 0x00, 0x7C, 0x66, 0x66, 0x7C, 0x60, 0x60},
+    {0x00, 0x00, 0x3E, 0x66, 0x66, 0x3E, 0x06, 0x06},
+    {0x00, 0x00, 0x7C, 0x66, 0x60, 0x60, 0x60, 0x00},
+    {0x00, 0x00, 0x3E, 0x60, 0x3C, 0x06, 0x7C, 0x00},
+    {0x00, 0x18, 0x7E, 0x18, 0x18, 0x18, 0x0E, 0x00},
+    {0x00, 0x00, 0x66, 0x66, 0x66, 0x66, 0x3E, 0x00},
+    {0x00, 0x00, 0x66, 0x66, 0x66, 0x3C, 0x18, 0x00},
+    {0x00, 0x00, 0x63, 0x6B, 0x7F, 0x3E, 0x36, 0x00},
+    {0x00, 0x00, 0x66, 0x3C, 0x18, 0x3C, 0x66, 0x00},
+    {0x00, 0x00, 0x66, 0x66, 0x66, 0x3E, 0x0C, 0x78},
+    {0x00, 0x00, 0x7E, 0x0C, 0x18, 0x30, 0x7E, 0x00},
+    {0x3C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x3C, 0x00},
+    {0x0C, 0x12, 0x30, 0x7C, 0x30, 0x62, 0xFC, 0x00},
+    {0x3C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x3C, 0x00},
+    {0x00, 0x18, 0x3C, 0x7E, 0x18, 0x18, 0x18, 0x18},
+    {0x00, 0x10, 0x30, 0x7F, 0x7F, 0x30, 0x10, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x18, 0x00},
+    {0x66, 0x66, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x66, 0x66, 0xFF, 0x66, 0xFF, 0x66, 0x66, 0x00},
+    {0x18, 0x3E, 0x60, 0x3C, 0x06, 0x7C, 0x18, 0x00},
+    {0x62, 0x66, 0x0C, 0x18, 0x30, 0x66, 0x46, 0x00},
+    {0x3C, 0x66, 0x3C, 0x38, 0x67, 0x66, 0x3F, 0x00},
+    {0x06, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x0C, 0x18, 0x30, 0x30, 0x30, 0x18, 0x0C, 0x00},
+    {0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x18, 0x30, 0x00},
+    {0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00},
+    {0x00, 0x18, 0x18, 0x7E, 0x18, 0x18, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x30},
+    {0x00, 0x00, 0x00, 0x7E, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00},
+    {0x00, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x00},
+    {0x3C, 0x66, 0x6E, 0x76, 0x66, 0x66, 0x3C, 0x00},
+    {0x18, 0x18, 0x38, 0x18, 0x18, 0x18, 0x7E, 0x00},
+    {0x3C, 0x66, 0x06, 0x0C, 0x30, 0x60, 0x7E, 0x00},
+    {0x3C, 0x66, 0x06, 0x1C, 0x06, 0x66, 0x3C, 0x00},
+    {0x06, 0x0E, 0x1E, 0x66, 0x7F, 0x06, 0x06, 0x00},
+    {0x7E, 0x60, 0x7C, 0x06, 0x06, 0x66, 0x3C, 0x00},
+    {0x3C, 0x66, 0x60, 0x7C, 0x66, 0x66, 0x3C, 0x00},
+    {0x7E, 0x66, 0x0C, 0x18, 0x18, 0x18, 0x18, 0x00},
+    {0x3C, 0x66, 0x66, 0x3C, 0x66, 0x66, 0x3C, 0x00},
+    {0x3C, 0x66, 0x66, 0x3E, 0x06, 0x66, 0x3C, 0x00},
+    {0x00, 0x00, 0x18, 0x00, 0x00, 0x18, 0x00, 0x00},
+    {0x00, 0x00, 0x18, 0x00, 0x00, 0x18, 0x18, 0x30},
+    {0x0E, 0x18, 0x30, 0x60, 0x30, 0x18, 0x0E, 0x00},
+    {0x00, 0x00, 0x7E, 0x00, 0x7E, 0x00, 0x00, 0x00},
+    {0x70, 0x18, 0x0C, 0x06, 0x0C, 0x18, 0x70, 0x00},
+    {0x3C, 0x66, 0x06, 0x0C, 0x18, 0x00, 0x18, 0x00},
+    {0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00},
+    {0x18, 0x3C, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x00},
+    {0x7C, 0x66, 0x66, 0x7C, 0x66, 0x66, 0x7C, 0x00},
+    {0x3C, 0x66, 0x60, 0x60, 0x60, 0x66, 0x3C, 0x00},
+    {0x78, 0x6C, 0x66, 0x66, 0x66, 0x6C, 0x78, 0x00},
+    {0x7E, 0x60, 0x60, 0x78, 0x60, 0x60, 0x7E, 0x00},
+    {0x7E, 0x60, 0x60, 0x78, 0x60, 0x60, 0x60, 0x00},
+    {0x3C, 0x66, 0x60, 0x6E, 0x66, 0x66, 0x3C, 0x00},
+    {0x66, 0x66, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x00},
+    {0x3C, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, 0x00},
+    {0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x6C, 0x38, 0x00},
+    {0x66, 0x6C, 0x78, 0x70, 0x78, 0x6C, 0x66, 0x00},
+    {0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x7E, 0x00},
+    {0x63, 0x77, 0x7F, 0x6B, 0x63, 0x63, 0x63, 0x00},
+    {0x66, 0x76, 0x7E, 0x7E, 0x6E, 0x66, 0x66, 0x00},
+    {0x3C, 0x66, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x00},
+    {0x7C, 0x66, 0x66, 0x7C, 0x60, 0x60, 0x60, 0x00},
+    {0x3C, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x0E, 0x00},
+    {0x7C, 0x66, 0x66, 0x7C, 0x78, 0x6C, 0x66, 0x00},
+    {0x3C, 0x66, 0x60, 0x3C, 0x06, 0x66, 0x3C, 0x00},
+    {0x7E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00},
+    {0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x00},
+    {0x66, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x18, 0x00},
+    {0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00},
+    {0x66, 0x66, 0x3C, 0x18, 0x3C, 0x66, 0x66, 0x00},
+    {0x66, 0x66, 0x66, 0x3C, 0x18, 0x18, 0x18, 0x00},
+    {0x7E, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x7E, 0x00},
+    {0x18, 0x18, 0x18, 0xFF, 0xFF, 0x18, 0x18, 0x18},
+    {0xC0, 0xC0, 0x30, 0x30, 0xC0, 0xC0, 0x30, 0x30},
+    {0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18},
+    {0x33, 0x33, 0xCC, 0xCC, 0x33, 0x33, 0xCC, 0xCC},
+    {0x33, 0x99, 0xCC, 0x66, 0x33, 0x99, 0xCC, 0x66},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0},
+    {0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF},
+    {0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0},
+    {0xCC, 0xCC, 0x33, 0x33, 0xCC, 0xCC, 0x33, 0x33},
+    {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    {0x00, 0x00, 0x00, 0x00, 0xCC, 0xCC, 0x33, 0x33},
+    {0xCC, 0x99, 0x33, 0x66, 0xCC, 0x99, 0x33, 0x66},
+    {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    {0x18, 0x18, 0x18, 0x1F, 0x1F, 0x18, 0x18, 0x18},
+    {0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F},
+    {0x18, 0x18, 0x18, 0x1F, 0x1F, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0xF8, 0xF8, 0x18, 0x18, 0x18},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF},
+    {0x00, 0x00, 0x00, 0x1F, 0x1F, 0x18, 0x18, 0x18},
+    {0x18, 0x18, 0x18, 0xFF, 0xFF, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0xFF, 0xFF, 0x18, 0x18, 0x18},
+    {0x18, 0x18, 0x18, 0xF8, 0xF8, 0x18, 0x18, 0x18},
+    {0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0},
+    {0xE0, 0xE0, 0xE0, 0xE0, 0xE0, 0xE0, 0xE0, 0xE0},
+    {0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07},
+    {0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF},
+    {0x01, 0x03, 0x06, 0x6C, 0x78, 0x70, 0x60, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0},
+    {0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00},
+    {0x18, 0x18, 0x18, 0xF8, 0xF8, 0x00, 0x00, 0x00},
+    {0xF0, 0xF0, 0xF0, 0xF0, 0x00, 0x00, 0x00, 0x00},
+    {0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F},
+    {0xC3, 0x99, 0x91, 0x91, 0x9F, 0x99, 0xC3, 0xFF},
+    {0xFF, 0xFF, 0xC3, 0xF9, 0xC1, 0x99, 0xC1, 0xFF},
+    {0xFF, 0x9F, 0x9F, 0x83, 0x99, 0x99, 0x83, 0xFF},
+    {0xFF, 0xFF, 0xC3, 0x9F, 0x9F, 0x9F, 0xC3, 0xFF},
+    {0xFF, 0xF9, 0xF9, 0xC1, 0x99, 0x99, 0xC1, 0xFF},
+    {0xFF, 0xFF, 0xC3, 0x99, 0x81, 0x9F, 0xC3, 0xFF},
+    {0xFF, 0xF1, 0xE7, 0xC1, 0xE7, 0xE7, 0xE7, 0xFF},
+    {0xFF, 0xFF, 0xC1, 0x99, 0x99, 0xC1, 0xF9, 0x83},
+    {0xFF, 0x9F, 0x9F, 0x83, 0x99, 0x99, 0x99, 0xFF},
+    {0xFF, 0xE7, 0xFF, 0xC7, 0xE7, 0xE7, 0xC3, 0xFF},
+    {0xFF, 0xF9, 0xFF, 0xF9, 0xF9, 0xF9, 0xF9, 0xC3},
+    {0xFF, 0x9F, 0x9F, 0x93, 0x87, 0x93, 0x99, 0xFF},
+    {0xFF, 0xC7, 0xE7, 0xE7, 0xE7, 0xE7, 0xC3, 0xFF},
+    {0xFF, 0xFF, 0x99, 0x80, 0x80, 0x94, 0x9C, 0xFF},
+    {0xFF, 0xFF, 0x83, 0x99, 0x99, 0x99, 0x99, 0xFF},
+    {0xFF, 0xFF, 0xC3, 0x99, 0x99, 0x99, 0xC3, 0xFF},
+    {0xFF, 0xFF, 0x83, 0x99, 0x99, 0x83, 0x9F, 0x9F},
+    {0xFF, 0xFF, 0xC1, 0x99, 0x99, 0xC1, 0xF9, 0xF9},
+    {0xFF, 0xFF, 0x83, 0x99, 0x9F, 0x9F, 0x9F, 0xFF},
+    {0xFF, 0xFF, 0xC1, 0x9F, 0xC3, 0xF9, 0x83, 0xFF},
+    {0xFF, 0xE7, 0x81, 0xE7, 0xE7, 0xE7, 0xF1, 0xFF},
+    {0xFF, 0xFF, 0x99, 0x99, 0x99, 0x99, 0xC1, 0xFF},
+    {0xFF, 0xFF, 0x99, 0x99, 0x99, 0xC3, 0xE7, 0xFF},
+    {0xFF, 0xFF, 0x9C, 0x94, 0x80, 0xC1, 0xC9, 0xFF},
+    {0xFF, 0xFF, 0x99, 0xC3, 0xE7, 0xC3, 0x99, 0xFF},
+    {0xFF, 0xFF, 0x99, 0x99, 0x99, 0xC1, 0xF3, 0x87},
+    {0xFF, 0xFF, 0x81, 0xF3, 0xE7, 0xCF, 0x81, 0xFF},
+    {0xC3, 0xCF, 0xCF, 0xCF, 0xCF, 0xCF, 0xC3, 0xFF},
+    {0xF3, 0xED, 0xCF, 0x83, 0xCF, 0x9D, 0x03, 0xFF},
+    {0xC3, 0xF3, 0xF3, 0xF3, 0xF3, 0xF3, 0xC3, 0xFF},
+    {0xFF, 0xE7, 0xC3, 0x81, 0xE7, 0xE7, 0xE7, 0xE7},
+    {0xFF, 0xEF, 0xCF, 0x80, 0x80, 0xCF, 0xEF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xE7, 0xE7, 0xE7, 0xE7, 0xFF, 0xFF, 0xE7, 0xFF},
+    {0x99, 0x99, 0x99, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0x99, 0x99, 0x00, 0x99, 0x00, 0x99, 0x99, 0xFF},
+    {0xE7, 0xC1, 0x9F, 0xC3, 0xF9, 0x83, 0xE7, 0xFF},
+    {0x9D, 0x99, 0xF3, 0xE7, 0xCF, 0x99, 0xB9, 0xFF},
+    {0xC3, 0x99, 0xC3, 0xC7, 0x98, 0x99, 0xC0, 0xFF},
+    {0xF9, 0xF3, 0xE7, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xF3, 0xE7, 0xCF, 0xCF, 0xCF, 0xE7, 0xF3, 0xFF},
+    {0xCF, 0xE7, 0xF3, 0xF3, 0xF3, 0xE7, 0xCF, 0xFF},
+    {0xFF, 0x99, 0xC3, 0x00, 0xC3, 0x99, 0xFF, 0xFF},
+    {0xFF, 0xE7, 0xE7, 0x81, 0xE7, 0xE7, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xE7, 0xE7, 0xCF},
+    {0xFF, 0xFF, 0xFF, 0x81, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xE7, 0xE7, 0xFF},
+    {0xFF, 0xFC, 0xF9, 0xF3, 0xE7, 0xCF, 0x9F, 0xFF},
+    {0xC3, 0x99, 0x91, 0x89, 0x99, 0x99, 0xC3, 0xFF},
+    {0xE7, 0xE7, 0xC7, 0xE7, 0xE7, 0xE7, 0x81, 0xFF},
+    {0xC3, 0x99, 0xF9, 0xF3, 0xCF, 0x9F, 0x81, 0xFF},
+    {0xC3, 0x99, 0xF9, 0xE3, 0xF9, 0x99, 0xC3, 0xFF},
+    {0xF9, 0xF1, 0xE1, 0x99, 0x80, 0xF9, 0xF9, 0xFF},
+    {0x81, 0x9F, 0x83, 0xF9, 0xF9, 0x99, 0xC3, 0xFF},
+    {0xC3, 0x99, 0x9F, 0x83, 0x99, 0x99, 0xC3, 0xFF},
+    {0x81, 0x99, 0xF3, 0xE7, 0xE7, 0xE7, 0xE7, 0xFF},
+    {0xC3, 0x99, 0x99, 0xC3, 0x99, 0x99, 0xC3, 0xFF},
+    {0xC3, 0x99, 0x99, 0xC1, 0xF9, 0x99, 0xC3, 0xFF},
+    {0xFF, 0xFF, 0xE7, 0xFF, 0xFF, 0xE7, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xE7, 0xFF, 0xFF, 0xE7, 0xE7, 0xCF},
+    {0xF1, 0xE7, 0xCF, 0x9F, 0xCF, 0xE7, 0xF1, 0xFF},
+    {0xFF, 0xFF, 0x81, 0xFF, 0x81, 0xFF, 0xFF, 0xFF},
+    {0x8F, 0xE7, 0xF3, 0xF9, 0xF3, 0xE7, 0x8F, 0xFF},
+    {0xC3, 0x99, 0xF9, 0xF3, 0xE7, 0xFF, 0xE7, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0xFF},
+    {0xE7, 0xC3, 0x99, 0x81, 0x99, 0x99, 0x99, 0xFF},
+    {0x83, 0x99, 0x99, 0x83, 0x99, 0x99, 0x83, 0xFF},
+    {0xC3, 0x99, 0x9F, 0x9F, 0x9F, 0x99, 0xC3, 0xFF},
+    {0x87, 0x93, 0x99, 0x99, 0x99, 0x93, 0x87, 0xFF},
+    {0x81, 0x9F, 0x9F, 0x87, 0x9F, 0x9F, 0x81, 0xFF},
+    {0x81, 0x9F, 0x9F, 0x87, 0x9F, 0x9F, 0x9F, 0xFF},
+    {0xC3, 0x99, 0x9F, 0x91, 0x99, 0x99, 0xC3, 0xFF},
+    {0x99, 0x99, 0x99, 0x81, 0x99, 0x99, 0x99, 0xFF},
+    {0xC3, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xC3, 0xFF},
+    {0xE1, 0xF3, 0xF3, 0xF3, 0xF3, 0x93, 0xC7, 0xFF},
+    {0x99, 0x93, 0x87, 0x8F, 0x87, 0x93, 0x99, 0xFF},
+    {0x9F, 0x9F, 0x9F, 0x9F, 0x9F, 0x9F, 0x81, 0xFF},
+    {0x9C, 0x88, 0x80, 0x94, 0x9C, 0x9C, 0x9C, 0xFF},
+    {0x99, 0x89, 0x81, 0x81, 0x91, 0x99, 0x99, 0xFF},
+    {0xC3, 0x99, 0x99, 0x99, 0x99, 0x99, 0xC3, 0xFF},
+    {0x83, 0x99, 0x99, 0x83, 0x9F, 0x9F, 0x9F, 0xFF},
+    {0xC3, 0x99, 0x99, 0x99, 0x99, 0xC3, 0xF1, 0xFF},
+    {0x83, 0x99, 0x99, 0x83, 0x87, 0x93, 0x99, 0xFF},
+    {0xC3, 0x99, 0x9F, 0xC3, 0xF9, 0x99, 0xC3, 0xFF},
+    {0x81, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xFF},
+    {0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0xC3, 0xFF},
+    {0x99, 0x99, 0x99, 0x99, 0x99, 0xC3, 0xE7, 0xFF},
+    {0x9C, 0x9C, 0x9C, 0x94, 0x80, 0x88, 0x9C, 0xFF},
+    {0x99, 0x99, 0xC3, 0xE7, 0xC3, 0x99, 0x99, 0xFF},
+    {0x99, 0x99, 0x99, 0xC3, 0xE7, 0xE7, 0xE7, 0xFF},
+    {0x81, 0xF9, 0xF3, 0xE7, 0xCF, 0x9F, 0x81, 0xFF},
+    {0xE7, 0xE7, 0xE7, 0x00, 0x00, 0xE7, 0xE7, 0xE7},
+    {0x3F, 0x3F, 0xCF, 0xCF, 0x3F, 0x3F, 0xCF, 0xCF},
+    {0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7},
+    {0xCC, 0xCC, 0x33, 0x33, 0xCC, 0xCC, 0x33, 0x33},
+    {0xCC, 0x66, 0x33, 0x99, 0xCC, 0x66, 0x33, 0x99},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00},
+    {0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F},
+    {0x33, 0x33, 0xCC, 0xCC, 0x33, 0x33, 0xCC, 0xCC},
+    {0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0x33, 0x33, 0xCC, 0xCC},
+    {0x33, 0x66, 0xCC, 0x99, 0x33, 0x66, 0xCC, 0x99},
+    {0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC},
+    {0xE7, 0xE7, 0xE7, 0xE0, 0xE0, 0xE7, 0xE7, 0xE7},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xF0, 0xF0, 0xF0, 0xF0},
+    {0xE7, 0xE7, 0xE7, 0xE0, 0xE0, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0x07, 0x07, 0xE7, 0xE7, 0xE7},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00},
+    {0xFF, 0xFF, 0xFF, 0xE0, 0xE0, 0xE7, 0xE7, 0xE7},
+    {0xE7, 0xE7, 0xE7, 0x00, 0x00, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xE7, 0xE7, 0xE7},
+    {0xE7, 0xE7, 0xE7, 0x07, 0x07, 0xE7, 0xE7, 0xE7},
+    {0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F},
+    {0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F},
+    {0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8},
+    {0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00},
+    {0xFE, 0xFC, 0xF9, 0x93, 0x87, 0x8F, 0x9F, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x0F, 0x0F, 0x0F},
+    {0xF0, 0xF0, 0xF0, 0xF0, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xE7, 0xE7, 0xE7, 0x07, 0x07, 0xFF, 0xFF, 0xFF},
+    {0x0F, 0x0F, 0x0F, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0x0F, 0x0F, 0x0F, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0},
+    {0x3C, 0x66, 0x6E, 0x6E, 0x60, 0x62, 0x3C, 0x00},
+    {0x18, 0x3C, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x00},
+    {0x7C, 0x66, 0x66, 0x7C, 0x66, 0x66, 0x7C, 0x00},
+    {0x3C, 0x66, 0x60, 0x60, 0x60, 0x66, 0x3C, 0x00},
+    {0x78, 0x6C, 0x66, 0x66, 0x66, 0x6C, 0x78, 0x00},
+    {0x7E, 0x60, 0x60, 0x78, 0x60, 0x60, 0x7E, 0x00},
+    {0x7E, 0x60, 0x60, 0x78, 0x60, 0x60, 0x60, 0x00},
+    {0x3C, 0x66, 0x60, 0x6E, 0x66, 0x66, 0x3C, 0x00},
+    {0x66, 0x66, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x00},
+    {0x3C, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, 0x00},
+    {0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x6C, 0x38, 0x00},
+    {0x66, 0x6C, 0x78, 0x70, 0x78, 0x6C, 0x66, 0x00},
+    {0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x7E, 0x00},
+    {0x63, 0x77, 0x7F, 0x6B, 0x63, 0x63, 0x63, 0x00},
+    {0x66, 0x76, 0x7E, 0x7E, 0x6E, 0x66, 0x66, 0x00},
+    {0x3C, 0x66, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x00},
+    {0x7C, 0x66, 0x66, 0x7C, 0x60, 0x60, 0x60, 0x00},
+    {0x3C, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x0E, 0x00},
+    {0x7C, 0x66, 0x66, 0x7C, 0x78, 0x6C, 0x66, 0x00},
+    {0x3C, 0x66, 0x60, 0x3C, 0x06, 0x66, 0x3C, 0x00},
+    {0x7E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00},
+    {0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x00},
+    {0x66, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x18, 0x00},
+    {0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00},
+    {0x66, 0x66, 0x3C, 0x18, 0x3C, 0x66, 0x66, 0x00},
+    {0x66, 0x66, 0x66, 0x3C, 0x18, 0x18, 0x18, 0x00},
+    {0x7E, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x7E, 0x00},
+    {0x3C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x3C, 0x00},
+    {0x0C, 0x12, 0x30, 0x7C, 0x30, 0x62, 0xFC, 0x00},
+    {0x3C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x3C, 0x00},
+    {0x00, 0x18, 0x3C, 0x7E, 0x18, 0x18, 0x18, 0x18},
+    {0x00, 0x10, 0x30, 0x7F, 0x7F, 0x30, 0x10, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x18, 0x00},
+    {0x66, 0x66, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x66, 0x66, 0xFF, 0x66, 0xFF, 0x66, 0x66, 0x00},
+    {0x18, 0x3E, 0x60, 0x3C, 0x06, 0x7C, 0x18, 0x00},
+    {0x62, 0x66, 0x0C, 0x18, 0x30, 0x66, 0x46, 0x00},
+    {0x3C, 0x66, 0x3C, 0x38, 0x67, 0x66, 0x3F, 0x00},
+    {0x06, 0x0C, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x0C, 0x18, 0x30, 0x30, 0x30, 0x18, 0x0C, 0x00},
+    {0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x18, 0x30, 0x00},
+    {0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00},
+    {0x00, 0x18, 0x18, 0x7E, 0x18, 0x18, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x30},
+    {0x00, 0x00, 0x00, 0x7E, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00},
+    {0x00, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x00},
+    {0x3C, 0x66, 0x6E, 0x76, 0x66, 0x66, 0x3C, 0x00},
+    {0x18, 0x18, 0x38, 0x18, 0x18, 0x18, 0x7E, 0x00},
+    {0x3C, 0x66, 0x06, 0x0C, 0x30, 0x60, 0x7E, 0x00},
+    {0x3C, 0x66, 0x06, 0x1C, 0x06, 0x66, 0x3C, 0x00},
+    {0x06, 0x0E, 0x1E, 0x66, 0x7F, 0x06, 0x06, 0x00},
+    {0x7E, 0x60, 0x7C, 0x06, 0x06, 0x66, 0x3C, 0x00},
+    {0x3C, 0x66, 0x60, 0x7C, 0x66, 0x66, 0x3C, 0x00},
+    {0x7E, 0x66, 0x0C, 0x18, 0x18, 0x18, 0x18, 0x00},
+    {0x3C, 0x66, 0x66, 0x3C, 0x66, 0x66, 0x3C, 0x00},
+    {0x3C, 0x66, 0x66, 0x3E, 0x06, 0x66, 0x3C, 0x00},
+    {0x00, 0x00, 0x18, 0x00, 0x00, 0x18, 0x00, 0x00},
+    {0x00, 0x00, 0x18, 0x00, 0x00, 0x18, 0x18, 0x30},
+    {0x0E, 0x18, 0x30, 0x60, 0x30, 0x18, 0x0E, 0x00},
+    {0x00, 0x00, 0x7E, 0x00, 0x7E, 0x00, 0x00, 0x00},
+    {0x70, 0x18, 0x0C, 0x06, 0x0C, 0x18, 0x70, 0x00},
+    {0x3C, 0x66, 0x06, 0x0C, 0x18, 0x00, 0x18, 0x00},
+    {0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00},
+    {0x08, 0x1C, 0x3E, 0x7F, 0x7F, 0x1C, 0x3E, 0x00},
+    {0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18},
+    {0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00},
+    {0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30},
+    {0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C},
+    {0x00, 0x00, 0x00, 0xE0, 0xF0, 0x38, 0x18, 0x18},
+    {0x18, 0x18, 0x1C, 0x0F, 0x07, 0x00, 0x00, 0x00},
+    {0x18, 0x18, 0x38, 0xF0, 0xE0, 0x00, 0x00, 0x00},
+    {0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xFF, 0xFF},
+    {0xC0, 0xE0, 0x70, 0x38, 0x1C, 0x0E, 0x07, 0x03},
+    {0x03, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xC0},
+    {0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0},
+    {0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    {0x00, 0x3C, 0x7E, 0x7E, 0x7E, 0x7E, 0x3C, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0x00},
+    {0x36, 0x7F, 0x7F, 0x7F, 0x3E, 0x1C, 0x08, 0x00},
+    {0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60},
+    {0x00, 0x00, 0x00, 0x07, 0x0F, 0x1C, 0x18, 0x18},
+    {0xC3, 0xE7, 0x7E, 0x3C, 0x3C, 0x7E, 0xE7, 0xC3},
+    {0x00, 0x3C, 0x7E, 0x66, 0x66, 0x7E, 0x3C, 0x00},
+    {0x18, 0x18, 0x66, 0x66, 0x18, 0x18, 0x3C, 0x00},
+    {0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06},
+    {0x08, 0x1C, 0x3E, 0x7F, 0x3E, 0x1C, 0x08, 0x00},
+    {0x18, 0x18, 0x18, 0xFF, 0xFF, 0x18, 0x18, 0x18},
+    {0xC0, 0xC0, 0x30, 0x30, 0xC0, 0xC0, 0x30, 0x30},
+    {0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18},
+    {0x00, 0x00, 0x03, 0x3E, 0x76, 0x36, 0x36, 0x00},
+    {0xFF, 0x7F, 0x3F, 0x1F, 0x0F, 0x07, 0x03, 0x01},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0},
+    {0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF},
+    {0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0},
+    {0xCC, 0xCC, 0x33, 0x33, 0xCC, 0xCC, 0x33, 0x33},
+    {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    {0x00, 0x00, 0x00, 0x00, 0xCC, 0xCC, 0x33, 0x33},
+    {0xFF, 0xFE, 0xFC, 0xF8, 0xF0, 0xE0, 0xC0, 0x80},
+    {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03},
+    {0x18, 0x18, 0x18, 0x1F, 0x1F, 0x18, 0x18, 0x18},
+    {0x00, 0x00, 0x00, 0x00, 0x0F, 0x0F, 0x0F, 0x0F},
+    {0x18, 0x18, 0x18, 0x1F, 0x1F, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0xF8, 0xF8, 0x18, 0x18, 0x18},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF},
+    {0x00, 0x00, 0x00, 0x1F, 0x1F, 0x18, 0x18, 0x18},
+    {0x18, 0x18, 0x18, 0xFF, 0xFF, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0xFF, 0xFF, 0x18, 0x18, 0x18},
+    {0x18, 0x18, 0x18, 0xF8, 0xF8, 0x18, 0x18, 0x18},
+    {0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0, 0xC0},
+    {0xE0, 0xE0, 0xE0, 0xE0, 0xE0, 0xE0, 0xE0, 0xE0},
+    {0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07},
+    {0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF},
+    {0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0xFF, 0xFF},
+    {0x00, 0x00, 0x00, 0x00, 0xF0, 0xF0, 0xF0, 0xF0},
+    {0x0F, 0x0F, 0x0F, 0x0F, 0x00, 0x00, 0x00, 0x00},
+    {0x18, 0x18, 0x18, 0xF8, 0xF8, 0x00, 0x00, 0x00},
+    {0xF0, 0xF0, 0xF0, 0xF0, 0x00, 0x00, 0x00, 0x00},
+    {0xF0, 0xF0, 0xF0, 0xF0, 0x0F, 0x0F, 0x0F, 0x0F},
+    {0xC3, 0x99, 0x91, 0x91, 0x9F, 0x99, 0xC3, 0xFF},
+    {0xE7, 0xC3, 0x99, 0x81, 0x99, 0x99, 0x99, 0xFF},
+    {0x83, 0x99, 0x99, 0x83, 0x99, 0x99, 0x83, 0xFF},
+    {0xC3, 0x99, 0x9F, 0x9F, 0x9F, 0x99, 0xC3, 0xFF},
+    {0x87, 0x93, 0x99, 0x99, 0x99, 0x93, 0x87, 0xFF},
+    {0x81, 0x9F, 0x9F, 0x87, 0x9F, 0x9F, 0x81, 0xFF},
+    {0x81, 0x9F, 0x9F, 0x87, 0x9F, 0x9F, 0x9F, 0xFF},
+    {0xC3, 0x99, 0x9F, 0x91, 0x99, 0x99, 0xC3, 0xFF},
+    {0x99, 0x99, 0x99, 0x81, 0x99, 0x99, 0x99, 0xFF},
+    {0xC3, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xC3, 0xFF},
+    {0xE1, 0xF3, 0xF3, 0xF3, 0xF3, 0x93, 0xC7, 0xFF},
+    {0x99, 0x93, 0x87, 0x8F, 0x87, 0x93, 0x99, 0xFF},
+    {0x9F, 0x9F, 0x9F, 0x9F, 0x9F, 0x9F, 0x81, 0xFF},
+    {0x9C, 0x88, 0x80, 0x94, 0x9C, 0x9C, 0x9C, 0xFF},
+    {0x99, 0x89, 0x81, 0x81, 0x91, 0x99, 0x99, 0xFF},
+    {0xC3, 0x99, 0x99, 0x99, 0x99, 0x99, 0xC3, 0xFF},
+    {0x83, 0x99, 0x99, 0x83, 0x9F, 0x9F, 0x9F, 0xFF},
+    {0xC3, 0x99, 0x99, 0x99, 0x99, 0xC3, 0xF1, 0xFF},
+    {0x83, 0x99, 0x99, 0x83, 0x87, 0x93, 0x99, 0xFF},
+    {0xC3, 0x99, 0x9F, 0xC3, 0xF9, 0x99, 0xC3, 0xFF},
+    {0x81, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xFF},
+    {0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0xC3, 0xFF},
+    {0x99, 0x99, 0x99, 0x99, 0x99, 0xC3, 0xE7, 0xFF},
+    {0x9C, 0x9C, 0x9C, 0x94, 0x80, 0x88, 0x9C, 0xFF},
+    {0x99, 0x99, 0xC3, 0xE7, 0xC3, 0x99, 0x99, 0xFF},
+    {0x99, 0x99, 0x99, 0xC3, 0xE7, 0xE7, 0xE7, 0xFF},
+    {0x81, 0xF9, 0xF3, 0xE7, 0xCF, 0x9F, 0x81, 0xFF},
+    {0xC3, 0xCF, 0xCF, 0xCF, 0xCF, 0xCF, 0xC3, 0xFF},
+    {0xF3, 0xED, 0xCF, 0x83, 0xCF, 0x9D, 0x03, 0xFF},
+    {0xC3, 0xF3, 0xF3, 0xF3, 0xF3, 0xF3, 0xC3, 0xFF},
+    {0xFF, 0xE7, 0xC3, 0x81, 0xE7, 0xE7, 0xE7, 0xE7},
+    {0xFF, 0xEF, 0xCF, 0x80, 0x80, 0xCF, 0xEF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xE7, 0xE7, 0xE7, 0xE7, 0xFF, 0xFF, 0xE7, 0xFF},
+    {0x99, 0x99, 0x99, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0x99, 0x99, 0x00, 0x99, 0x00, 0x99, 0x99, 0xFF},
+    {0xE7, 0xC1, 0x9F, 0xC3, 0xF9, 0x83, 0xE7, 0xFF},
+    {0x9D, 0x99, 0xF3, 0xE7, 0xCF, 0x99, 0xB9, 0xFF},
+    {0xC3, 0x99, 0xC3, 0xC7, 0x98, 0x99, 0xC0, 0xFF},
+    {0xF9, 0xF3, 0xE7, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xF3, 0xE7, 0xCF, 0xCF, 0xCF, 0xE7, 0xF3, 0xFF},
+    {0xCF, 0xE7, 0xF3, 0xF3, 0xF3, 0xE7, 0xCF, 0xFF},
+    {0xFF, 0x99, 0xC3, 0x00, 0xC3, 0x99, 0xFF, 0xFF},
+    {0xFF, 0xE7, 0xE7, 0x81, 0xE7, 0xE7, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xE7, 0xE7, 0xCF},
+    {0xFF, 0xFF, 0xFF, 0x81, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xE7, 0xE7, 0xFF},
+    {0xFF, 0xFC, 0xF9, 0xF3, 0xE7, 0xCF, 0x9F, 0xFF},
+    {0xC3, 0x99, 0x91, 0x89, 0x99, 0x99, 0xC3, 0xFF},
+    {0xE7, 0xE7, 0xC7, 0xE7, 0xE7, 0xE7, 0x81, 0xFF},
+    {0xC3, 0x99, 0xF9, 0xF3, 0xCF, 0x9F, 0x81, 0xFF},
+    {0xC3, 0x99, 0xF9, 0xE3, 0xF9, 0x99, 0xC3, 0xFF},
+    {0xF9, 0xF1, 0xE1, 0x99, 0x80, 0xF9, 0xF9, 0xFF},
+    {0x81, 0x9F, 0x83, 0xF9, 0xF9, 0x99, 0xC3, 0xFF},
+    {0xC3, 0x99, 0x9F, 0x83, 0x99, 0x99, 0xC3, 0xFF},
+    {0x81, 0x99, 0xF3, 0xE7, 0xE7, 0xE7, 0xE7, 0xFF},
+    {0xC3, 0x99, 0x99, 0xC3, 0x99, 0x99, 0xC3, 0xFF},
+    {0xC3, 0x99, 0x99, 0xC1, 0xF9, 0x99, 0xC3, 0xFF},
+    {0xFF, 0xFF, 0xE7, 0xFF, 0xFF, 0xE7, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xE7, 0xFF, 0xFF, 0xE7, 0xE7, 0xCF},
+    {0xF1, 0xE7, 0xCF, 0x9F, 0xCF, 0xE7, 0xF1, 0xFF},
+    {0xFF, 0xFF, 0x81, 0xFF, 0x81, 0xFF, 0xFF, 0xFF},
+    {0x8F, 0xE7, 0xF3, 0xF9, 0xF3, 0xE7, 0x8F, 0xFF},
+    {0xC3, 0x99, 0xF9, 0xF3, 0xE7, 0xFF, 0xE7, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0xFF},
+    {0xF7, 0xE3, 0xC1, 0x80, 0x80, 0xE3, 0xC1, 0xFF},
+    {0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7},
+    {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF},
+    {0xCF, 0xCF, 0xCF, 0xCF, 0xCF, 0xCF, 0xCF, 0xCF},
+    {0xF3, 0xF3, 0xF3, 0xF3, 0xF3, 0xF3, 0xF3, 0xF3},
+    {0xFF, 0xFF, 0xFF, 0x1F, 0x0F, 0xC7, 0xE7, 0xE7},
+    {0xE7, 0xE7, 0xE3, 0xF0, 0xF8, 0xFF, 0xFF, 0xFF},
+    {0xE7, 0xE7, 0xC7, 0x0F, 0x1F, 0xFF, 0xFF, 0xFF},
+    {0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x00, 0x00},
+    {0x3F, 0x1F, 0x8F, 0xC7, 0xE3, 0xF1, 0xF8, 0xFC},
+    {0xFC, 0xF8, 0xF1, 0xE3, 0xC7, 0x8F, 0x1F, 0x3F},
+    {0x00, 0x00, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F},
+    {0x00, 0x00, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC},
+    {0xFF, 0xC3, 0x81, 0x81, 0x81, 0x81, 0xC3, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF},
+    {0xC9, 0x80, 0x80, 0x80, 0xC1, 0xE3, 0xF7, 0xFF},
+    {0x9F, 0x9F, 0x9F, 0x9F, 0x9F, 0x9F, 0x9F, 0x9F},
+    {0xFF, 0xFF, 0xFF, 0xF8, 0xF0, 0xE3, 0xE7, 0xE7},
+    {0x3C, 0x18, 0x81, 0xC3, 0xC3, 0x81, 0x18, 0x3C},
+    {0xFF, 0xC3, 0x81, 0x99, 0x99, 0x81, 0xC3, 0xFF},
+    {0xE7, 0xE7, 0x99, 0x99, 0xE7, 0xE7, 0xC3, 0xFF},
+    {0xF9, 0xF9, 0xF9, 0xF9, 0xF9, 0xF9, 0xF9, 0xF9},
+    {0xF7, 0xE3, 0xC1, 0x80, 0xC1, 0xE3, 0xF7, 0xFF},
+    {0xE7, 0xE7, 0xE7, 0x00, 0x00, 0xE7, 0xE7, 0xE7},
+    {0x3F, 0x3F, 0xCF, 0xCF, 0x3F, 0x3F, 0xCF, 0xCF},
+    {0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7, 0xE7},
+    {0xFF, 0xFF, 0xFC, 0xC1, 0x89, 0xC9, 0xC9, 0xFF},
+    {0x00, 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC, 0xFE},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00},
+    {0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00},
+    {0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F},
+    {0x33, 0x33, 0xCC, 0xCC, 0x33, 0x33, 0xCC, 0xCC},
+    {0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0x33, 0x33, 0xCC, 0xCC},
+    {0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F},
+    {0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC},
+    {0xE7, 0xE7, 0xE7, 0xE0, 0xE0, 0xE7, 0xE7, 0xE7},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xF0, 0xF0, 0xF0, 0xF0},
+    {0xE7, 0xE7, 0xE7, 0xE0, 0xE0, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0x07, 0x07, 0xE7, 0xE7, 0xE7},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00},
+    {0xFF, 0xFF, 0xFF, 0xE0, 0xE0, 0xE7, 0xE7, 0xE7},
+    {0xE7, 0xE7, 0xE7, 0x00, 0x00, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xE7, 0xE7, 0xE7},
+    {0xE7, 0xE7, 0xE7, 0x07, 0x07, 0xE7, 0xE7, 0xE7},
+    {0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F, 0x3F},
+    {0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F},
+    {0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8, 0xF8},
+    {0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00},
+    {0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0xFC, 0x00, 0x00},
+    {0xFF, 0xFF, 0xFF, 0xFF, 0x0F, 0x0F, 0x0F, 0x0F},
+    {0xF0, 0xF0, 0xF0, 0xF0, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0xE7, 0xE7, 0xE7, 0x07, 0x07, 0xFF, 0xFF, 0xFF},
+    {0x0F, 0x0F, 0x0F, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF},
+    {0x0F, 0x0F, 0x0F, 0x0F, 0xF0, 0xF0, 0xF0, 0xF0}
+};
+
+/**
+ * Blank glyph, for texels the shader samples past the end of the texture.
+ */
+static const uint8_t kBlankGlyph[SFTCoreRendererCellSize] = {0};
+
+bool SFTCoreRendererInitialise(SFTCoreRenderer *renderer, size_t width,
+                               size_t height) {
+  memset(renderer, 0, sizeof(SFTCoreRenderer));
+
+  if ((width == 0) || (height == 0)) {
+    return false;
+  }
+
+  renderer->width = width;
+  renderer->height = height;
+  renderer->pixels = (uint32_t *)malloc(width * height *
+                                        SFTCoreRendererCellSize *
+                                        SFTCoreRendererCellSize *
+                                        sizeof(uint32_t));
+  renderer->drawn = (uint32_t *)malloc(width * height * sizeof(uint32_t));
+  if ((renderer->pixels == NULL) || (renderer->drawn == NULL)) {
+    SFTCoreRendererRelease(renderer);
+    return false;
+  }
+
+  for (size_t index = 0; index < 16; index++) {
+    memcpy(&renderer->palette[index], SFTCoreRendererPalette[index],
+           sizeof(uint32_t));
+  }
+
+  SFTCoreRendererInvalidate(renderer);
+  return true;
+}
+
+void SFTCoreRendererRelease(SFTCoreRenderer *renderer) {
+  free(renderer->pixels);
+  free(renderer->drawn);
+  memset(renderer, 0, sizeof(SFTCoreRenderer));
+}
+
+void SFTCoreRendererInvalidate(SFTCoreRenderer *renderer) {
+  memset(renderer->drawn, 0xFF,
+         renderer->width * renderer->height * sizeof(uint32_t));
+}
+
+size_t SFTCoreRendererDraw(SFTCoreRenderer *renderer,
+                           const SFTTerminalEmulatorCell *cells,
+                           size_t baseRow,
+                           const SFTCoreRendererContext *context) {
+  size_t stride = SFTCoreRendererStride(renderer);
+  bool selection = context->selectionEnd > context->selectionStart;
+  bool cursor = (context->flags & SFTCoreRendererFlagCursor) != 0;
+  uint32_t lowerCase = (context->flags & SFTCoreRendererFlagLowerCase)
+                           ? SFTCoreRendererDrawnLowerCase
+                           : 0;
+  size_t drawn = 0;
+
+  for (size_t row = 0; row < renderer->height; row++) {
+    size_t physical = baseRow + row;
+    if (physical >= renderer->height) {
+      physical -= renderer->height;
+    }
+    const SFTTerminalEmulatorCell *source =
+        cells + (physical * renderer->width);
+    uint32_t *records = renderer->drawn + (row * renderer->width);
+
+    for (size_t column = 0; column < renderer->width; column++) {
+      // The shader computes the selection index on 32 bits.
+      uint32_t index = (uint32_t)((row * renderer->width) + column);
+      bool reversed = selection && (index >= context->selectionStart) &&
+                      (index <= context->selectionEnd);
+      if (cursor && (row == context->cursorRow) &&
+          (column == context->cursorColumn)) {
+        reversed = !reversed;
+      }
+
+      SFTTerminalEmulatorCell cell = source[column];
+      uint32_t record = (cell & SFTCoreRendererCellMask) | lowerCase |
+                        (reversed ? SFTCoreRendererDrawnReversed : 0);
+      if (records[column] == record) {
+        continue;
+      }
+      records[column] = record;
+
+      // Reverse video cells use the second 128 glyphs of the half, and
+      // anything past the texture's end samples as blank.
+      size_t glyph = (size_t)SFTTerminalEmulatorCellGetCharacter(cell) +
+                     (SFTTerminalEmulatorCellGetReverse(cell) ? 128U : 0U) +
+                     (lowerCase ? 256U : 0U);
+      uint32_t foreground =
+          renderer->palette[SFTTerminalEmulatorCellGetForeground(cell)];
+      uint32_t background =
+          renderer->palette[SFTTerminalEmulatorCellGetBackground(cell)];
+
+      SFTCoreCellExpandGlyph(
+          renderer->pixels + (row * SFTCoreRendererCellSize * stride) +
+              (column * SFTCoreRendererCellSize),
+          stride,
+          glyph < SFTCoreRendererGlyphsCount ? SFTCoreRendererGlyphs[glyph]
+                                             : kBlankGlyph,
+          reversed ? background : foreground,
+          reversed ? foreground : background);
+      drawn++;
+    }
+  }
+
+  renderer->cellsDrawn += drawn;
+  return drawn;
+}
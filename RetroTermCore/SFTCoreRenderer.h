@@ -0,0 +1,177 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreRenderer_h
+#define SFTCoreRenderer_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SFTCoreCell.h"
+
+/**
+ * Glyph size, in pixels, on both axes.
+ */
+#define SFTCoreRendererCellSize 8
+
+/**
+ * Glyphs in the charset texture: two halves of 256 glyphs each, the last
+ * 128 of a half being the reverse video versions of the first 128.
+ */
+#define SFTCoreRendererGlyphsCount 512
+
+/**
+ * Context flag making the cursor cell appear in reverse video.
+ */
+#define SFTCoreRendererFlagCursor 0x01
+
+/**
+ * Context flag making glyphs come from the second half of the charset
+ * texture, as the shader's lower case flag does.
+ */
+#define SFTCoreRendererFlagLowerCase 0x02
+
+/**
+ * The charset texture, one byte per glyph row with the leftmost pixel in
+ * the most significant bit, as sampled by the fragment shader.
+ */
+extern const uint8_t SFTCoreRendererGlyphs[SFTCoreRendererGlyphsCount]
+                                          [SFTCoreRendererCellSize];
+
+/**
+ * The shader's palette, as red, green, blue and alpha bytes.
+ */
+extern const uint8_t SFTCoreRendererPalette[16][4];
+
+/**
+ * Per frame state, mirroring the fields of the shader context that affect
+ * pixels.
+ */
+typedef struct {
+  /**
+   * Visible cell indices bounding the selection, inclusive.  Nothing is
+   * selected unless the end comes after the start.
+   */
+  uint32_t selectionStart;
+  uint32_t selectionEnd;
+
+  uint32_t cursorRow;
+  uint32_t cursorColumn;
+
+  /**
+   * Any of the SFTCoreRendererFlag values.
+   */
+  uint8_t flags;
+} SFTCoreRendererContext;
+
+/**
+ * Software renderer producing the same pixels the fragment shader does at
+ * one pixel per glyph texel, into an RGBA framebuffer.
+ *
+ * Each cell is only drawn again when what it shows changed since the last
+ * frame: its contents, its selection or cursor state, or the charset half.
+ */
+typedef struct {
+  /**
+   * Screen size, in cells.
+   */
+  size_t width;
+  size_t height;
+
+  /**
+   * Framebuffer, width * SFTCoreRendererCellSize pixels wide and height *
+   * SFTCoreRendererCellSize pixels tall, each pixel holding red, green,
+   * blue and alpha bytes in memory order.
+   */
+  uint32_t *pixels;
+
+  /**
+   * What each visible cell was last drawn as, or UINT32_MAX if it needs
+   * drawing.
+   */
+  uint32_t *drawn;
+
+  /**
+   * Palette entries as framebuffer pixels.
+   */
+  uint32_t palette[16];
+
+  /**
+   * Cells drawn since initialisation.
+   */
+  uint64_t cellsDrawn;
+} SFTCoreRenderer;
+
+/**
+ * Initialises the given renderer, allocating its framebuffer.
+ *
+ * @param[out] renderer the renderer to initialise.
+ * @param[in] width the screen width, in cells.
+ * @param[in] height the screen height, in cells.
+ *
+ * @return true if the renderer was initialised, false otherwise.
+ */
+bool SFTCoreRendererInitialise(SFTCoreRenderer *renderer, size_t width,
+                               size_t height);
+
+/**
+ * Releases everything held by the given renderer.
+ *
+ * @param[in,out] renderer the renderer to release.
+ */
+void SFTCoreRendererRelease(SFTCoreRenderer *renderer);
+
+/**
+ * Makes the next frame draw every cell again.
+ *
+ * @param[in,out] renderer the renderer to update.
+ */
+void SFTCoreRendererInvalidate(SFTCoreRenderer *renderer);
+
+/**
+ * Draws a frame, only touching cells whose appearance changed.
+ *
+ * @param[in,out] renderer the renderer to draw with.
+ * @param[in] cells the cell buffer, a ring of rows starting at baseRow.
+ * @param[in] baseRow the cell buffer row shown at the top of the screen.
+ * @param[in] context the selection, cursor and charset state.
+ *
+ * @return the amount of cells drawn.
+ */
+size_t SFTCoreRendererDraw(SFTCoreRenderer *renderer,
+                           const SFTTerminalEmulatorCell *cells,
+                           size_t baseRow,
+                           const SFTCoreRendererContext *context);
+
+/**
+ * Returns the distance between two framebuffer rows.
+ *
+ * @param[in] renderer the renderer to query.
+ *
+ * @return the framebuffer stride, in pixels.
+ */
+static inline size_t SFTCoreRendererStride(const SFTCoreRenderer *renderer) {
+  return renderer->width * SFTCoreRendererCellSize;
+}
+
+#endif /* SFTCoreRenderer_h */
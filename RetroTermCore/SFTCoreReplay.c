@@ -0,0 +1,234 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "SFTCoreReplay.h"
+#include "SFTCoreScrollback.h"
+
+static void SFTCoreReplayReset(SFTCoreReplay *replay) {
+  memset(replay, 0, sizeof(SFTCoreReplay));
+}
+
+static void SFTCoreReplayReleaseCheckpoints(SFTCoreReplay *replay) {
+  free(replay->checkpoints);
+  free(replay->checkpointCells);
+  replay->checkpoints = NULL;
+  replay->checkpointCells = NULL;
+  replay->checkpointsCount = 0;
+  replay->checkpointInterval = 0;
+}
+
+bool SFTCoreReplayOpen(SFTCoreReplay *replay, const char *path) {
+  SFTCoreReplayReset(replay);
+
+  int descriptor = open(path, O_RDONLY);
+  if (descriptor < 0) {
+    return false;
+  }
+
+  struct stat information;
+  if ((fstat(descriptor, &information) != 0) || (information.st_size < 0)) {
+    close(descriptor);
+    return false;
+  }
+
+  // Mapping an empty file fails, but it is still a valid, empty capture.
+  if (information.st_size == 0) {
+    close(descriptor);
+    return true;
+  }
+
+  void *bytes = mmap(NULL, (size_t)information.st_size, PROT_READ,
+                     MAP_PRIVATE, descriptor, 0);
+  close(descriptor);
+  if (bytes == MAP_FAILED) {
+    return false;
+  }
+
+  // Replays mostly go forward, so let the kernel read ahead.
+  madvise(bytes, (size_t)information.st_size, MADV_SEQUENTIAL);
+
+  replay->bytes = (const uint8_t *)bytes;
+  replay->length = (size_t)information.st_size;
+  replay->isMapped = true;
+  return true;
+}
+
+void SFTCoreReplayOpenMemory(SFTCoreReplay *replay, const uint8_t *bytes,
+                             size_t length) {
+  SFTCoreReplayReset(replay);
+  replay->bytes = bytes;
+  replay->length = length;
+}
+
+void SFTCoreReplayClose(SFTCoreReplay *replay) {
+  if (replay->isMapped) {
+    munmap((void *)replay->bytes, replay->length);
+  }
+
+  SFTCoreReplayReleaseCheckpoints(replay);
+  SFTCoreReplayReset(replay);
+}
+
+void SFTCoreReplaySetSpeed(SFTCoreReplay *replay, uint64_t bitsPerSecond,
+                           uint64_t now) {
+  replay->bitsPerSecond = bitsPerSecond;
+  replay->budget = 0.0;
+  replay->lastTimestamp = now;
+}
+
+size_t SFTCoreReplayNextBatch(SFTCoreReplay *replay, uint64_t now,
+                              size_t limit, const uint8_t **bytes) {
+  size_t count = replay->length - replay->position;
+  if (count > limit) {
+    count = limit;
+  }
+
+  if (replay->bitsPerSecond > 0) {
+    if (now > replay->lastTimestamp) {
+      replay->budget += (double)(now - replay->lastTimestamp) *
+                        (double)replay->bitsPerSecond / 8e9;
+      replay->lastTimestamp = now;
+    }
+    if (replay->budget > (double)limit) {
+      replay->budget = (double)limit;
+    }
+    if ((double)count > replay->budget) {
+      count = (size_t)replay->budget;
+    }
+  }
+
+  *bytes = replay->bytes + replay->position;
+  return count;
+}
+
+void SFTCoreReplayConsume(SFTCoreReplay *replay, size_t count) {
+  replay->position += count;
+  if (replay->bitsPerSecond > 0) {
+    replay->budget -= (double)count;
+    if (replay->budget < 0.0) {
+      replay->budget = 0.0;
+    }
+  }
+}
+
+bool SFTCoreReplayBuildCheckpoints(SFTCoreReplay *replay,
+                                   const SFTCoreEmulatorState *state,
+                                   const SFTTerminalEmulatorCell *cells,
+                                   size_t interval) {
+  SFTCoreReplayReleaseCheckpoints(replay);
+  if (interval == 0) {
+    return false;
+  }
+
+  size_t screenSize = state->width * state->height;
+  size_t count = (replay->length / interval) + 1;
+  replay->checkpoints =
+      (SFTCoreReplayCheckpoint *)calloc(count, sizeof(SFTCoreReplayCheckpoint));
+  replay->checkpointCells = (SFTTerminalEmulatorCell *)malloc(
+      count * screenSize * sizeof(SFTTerminalEmulatorCell));
+  if ((replay->checkpoints == NULL) || (replay->checkpointCells == NULL)) {
+    SFTCoreReplayReleaseCheckpoints(replay);
+    return false;
+  }
+
+  SFTCoreEmulatorState scratch = *state;
+  scratch.bellCallback = NULL;
+  scratch.userData = NULL;
+  scratch.scrollback = NULL;
+
+  for (size_t index = 0; index < count; index++) {
+    SFTCoreReplayCheckpoint *checkpoint = &replay->checkpoints[index];
+    checkpoint->offset = index * interval;
+    checkpoint->cells = replay->checkpointCells + (index * screenSize);
+
+    // Each checkpoint is the previous one with one more interval parsed.
+    if (index == 0) {
+      memcpy(checkpoint->cells, cells,
+             screenSize * sizeof(SFTTerminalEmulatorCell));
+    } else {
+      memcpy(checkpoint->cells, replay->checkpoints[index - 1].cells,
+             screenSize * sizeof(SFTTerminalEmulatorCell));
+      SFTCoreEmulatorProcessIncomingData(
+          &scratch, checkpoint->cells,
+          replay->bytes + replay->checkpoints[index - 1].offset, interval);
+    }
+
+    SFTCoreEmulatorClearDirtyRows(&scratch);
+    checkpoint->state = scratch;
+  }
+
+  replay->checkpointsCount = count;
+  replay->checkpointInterval = interval;
+  return true;
+}
+
+bool SFTCoreReplaySeek(SFTCoreReplay *replay, SFTCoreEmulatorState *state,
+                       SFTTerminalEmulatorCell *cells, size_t offset) {
+  if ((replay->checkpointsCount == 0) ||
+      (replay->checkpoints[0].state.width != state->width) ||
+      (replay->checkpoints[0].state.height != state->height)) {
+    return false;
+  }
+
+  if (offset > replay->length) {
+    offset = replay->length;
+  }
+
+  size_t index = offset / replay->checkpointInterval;
+  if (index >= replay->checkpointsCount) {
+    index = replay->checkpointsCount - 1;
+  }
+  const SFTCoreReplayCheckpoint *checkpoint = &replay->checkpoints[index];
+
+  SFTCoreEmulatorParserMode parserMode = state->parserMode;
+  SFTCoreEmulatorBellCallback bellCallback = state->bellCallback;
+  void *userData = state->userData;
+  SFTCoreScrollback *scrollback = state->scrollback;
+
+  *state = checkpoint->state;
+  state->parserMode = parserMode;
+  memcpy(cells, checkpoint->cells,
+         state->width * state->height * sizeof(SFTTerminalEmulatorCell));
+  SFTCoreEmulatorProcessIncomingData(state, cells,
+                                     replay->bytes + checkpoint->offset,
+                                     offset - checkpoint->offset);
+
+  state->bellCallback = bellCallback;
+  state->userData = userData;
+  state->scrollback = scrollback;
+  if (scrollback != NULL) {
+    // History before the checkpoint is unknown, so it is not kept at all.
+    SFTCoreScrollbackClear(scrollback);
+  }
+  SFTCoreEmulatorMarkAllRowsDirty(state);
+
+  replay->position = offset;
+  replay->budget = 0.0;
+  return true;
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreReplay_h
+#define SFTCoreReplay_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SFTCoreCell.h"
+#include "SFTCoreEmulator.h"
+
+/**
+ * Default distance, in capture bytes, between two screen checkpoints.
+ */
+#define SFTCoreReplayDefaultCheckpointInterval (64 * 1024)
+
+/**
+ * Emulator state and screen contents at a given capture offset.
+ */
+typedef struct {
+  size_t offset;
+  SFTCoreEmulatorState state;
+
+  /**
+   * Screen contents, pointing into the replay's checkpoint cell storage.
+   */
+  SFTTerminalEmulatorCell *cells;
+} SFTCoreReplayCheckpoint;
+
+/**
+ * Raw session capture being replayed, either memory mapped from disk or
+ * borrowed from memory.
+ */
+typedef struct {
+  const uint8_t *bytes;
+  size_t length;
+
+  /**
+   * Offset of the next byte to deliver.
+   */
+  size_t position;
+
+  /**
+   * Whether bytes were mapped by SFTCoreReplayOpen and have to be unmapped.
+   */
+  bool isMapped;
+
+  /**
+   * Delivery speed in bits per second, zero meaning unthrottled.
+   */
+  uint64_t bitsPerSecond;
+
+  /**
+   * Bytes that can be delivered right away, accumulated as time passes.
+   */
+  double budget;
+
+  /**
+   * Time of the last budget update, in nanoseconds.
+   */
+  uint64_t lastTimestamp;
+
+  /**
+   * Checkpoints, one every checkpointInterval bytes starting at offset 0.
+   */
+  SFTCoreReplayCheckpoint *checkpoints;
+  size_t checkpointsCount;
+  size_t checkpointInterval;
+  SFTTerminalEmulatorCell *checkpointCells;
+} SFTCoreReplay;
+
+/**
+ * Opens the given capture file, mapping it in memory.
+ *
+ * @param[out] replay the replay to initialise.
+ * @param[in] path the capture file path.
+ *
+ * @return true if the capture was opened, false otherwise.
+ */
+bool SFTCoreReplayOpen(SFTCoreReplay *replay, const char *path);
+
+/**
+ * Initialises a replay over a capture already in memory, which must outlive
+ * the replay.
+ *
+ * @param[out] replay the replay to initialise.
+ * @param[in] bytes the capture contents.
+ * @param[in] length the capture length, in bytes.
+ */
+void SFTCoreReplayOpenMemory(SFTCoreReplay *replay, const uint8_t *bytes,
+                             size_t length);
+
+/**
+ * Releases everything held by the given replay.
+ *
+ * @param[in,out] replay the replay to close.
+ */
+void SFTCoreReplayClose(SFTCoreReplay *replay);
+
+/**
+ * Changes the delivery speed, restarting the time slicing from now.
+ *
+ * @param[in,out] replay the replay to change.
+ * @param[in] bitsPerSecond the new speed, zero for unthrottled delivery.
+ * @param[in] now the current time, in nanoseconds.
+ */
+void SFTCoreReplaySetSpeed(SFTCoreReplay *replay, uint64_t bitsPerSecond,
+                           uint64_t now);
+
+/**
+ * Returns the bytes due for delivery by now, as a span into the capture.
+ *
+ * Bytes not consumed stay due, although no more than limit bytes are ever
+ * accumulated so that a stalled consumer does not get a burst afterwards.
+ *
+ * @param[in,out] replay the replay to read from.
+ * @param[in] now the current time, in nanoseconds.
+ * @param[in] limit the maximum amount of bytes to return.
+ * @param[out] bytes the start of the span.
+ *
+ * @return the span length, zero if nothing is due or the capture is over.
+ */
+size_t SFTCoreReplayNextBatch(SFTCoreReplay *replay, uint64_t now,
+                              size_t limit, const uint8_t **bytes);
+
+/**
+ * Marks the given amount of bytes returned by SFTCoreReplayNextBatch as
+ * delivered.
+ *
+ * @param[in,out] replay the replay read from.
+ * @param[in] count the amount of bytes delivered.
+ */
+void SFTCoreReplayConsume(SFTCoreReplay *replay, size_t count);
+
+/**
+ * Checks whether every byte in the capture was delivered.
+ *
+ * @param[in] replay the replay to check.
+ *
+ * @return true if the capture is over, false otherwise.
+ */
+static inline bool SFTCoreReplayIsFinished(const SFTCoreReplay *replay) {
+  return replay->position >= replay->length;
+}
+
+/**
+ * Parses the whole capture once, storing a checkpoint at its start and then
+ * every interval bytes.
+ *
+ * @param[in,out] replay the replay to index.
+ * @param[in] state the emulator state the capture starts from.
+ * @param[in] cells the screen contents the capture starts from.
+ * @param[in] interval the distance between checkpoints, in bytes.
+ *
+ * @return true if the checkpoints were built, false otherwise.
+ */
+bool SFTCoreReplayBuildCheckpoints(SFTCoreReplay *replay,
+                                   const SFTCoreEmulatorState *state,
+                                   const SFTTerminalEmulatorCell *cells,
+                                   size_t interval);
+
+/**
+ * Rebuilds the screen as it was after the given amount of capture bytes,
+ * starting from the nearest checkpoint, and resumes delivery from there.
+ *
+ * The bell callback and its user data are left untouched, and the bell is
+ * not rung while catching up.
+ *
+ * @param[in,out] replay the replay to seek, with checkpoints built.
+ * @param[in,out] state the emulator state to overwrite.
+ * @param[out] cells the screen contents to overwrite.
+ * @param[in] offset the capture offset to seek to, clamped to its length.
+ *
+ * @return true if the screen was rebuilt, false if no checkpoints are
+ * available for the given screen size.
+ */
+bool SFTCoreReplaySeek(SFTCoreReplay *replay, SFTCoreEmulatorState *state,
+                       SFTTerminalEmulatorCell *cells, size_t offset);
+
+#endif /* SFTCoreReplay_h */
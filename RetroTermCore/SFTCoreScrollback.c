@@ -0,0 +1,440 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTCoreCellKernels.h"
+#include "SFTCoreScrollback.h"
+#include "SFTCoreSearch.h"
+
+/**
+ * Longest run a single run header can describe.
+ */
+#define SFTCoreScrollbackMaximumRunLength 127
+
+/**
+ * Run length flag marking a run of one repeated font index.
+ */
+#define SFTCoreScrollbackFillRun 0x80
+
+/**
+ * Shortest repetition of the same cell encoded as a fill run, as the run
+ * header costs as much as three font indices.
+ */
+#define SFTCoreScrollbackMinimumFillLength 4
+
+/**
+ * Bytes taken by a run header: two for the attributes, one for the length.
+ */
+#define SFTCoreScrollbackRunHeaderSize 3
+
+/**
+ * Cold blocks the block ring starts with.
+ */
+#define SFTCoreScrollbackInitialBlocks 16
+
+#define SFTCoreScrollbackCellAttributes(cell) ((uint16_t)((cell) >> 8))
+
+static size_t SFTCoreScrollbackBlockSize(const SFTCoreScrollbackBlock *block) {
+  return sizeof(SFTCoreScrollbackBlock) + block->size;
+}
+
+static SFTCoreScrollbackBlock *
+SFTCoreScrollbackBlockAt(const SFTCoreScrollback *scrollback, size_t index) {
+  size_t slot = scrollback->blocksFirst + index;
+  if (slot >= scrollback->blocksCapacity) {
+    slot -= scrollback->blocksCapacity;
+  }
+  return scrollback->blocks[slot];
+}
+
+static bool SFTCoreScrollbackRowIsBlank(const SFTTerminalEmulatorCell *row,
+                                        size_t width) {
+  for (size_t index = 1; index < width; index++) {
+    if (row[index] != row[0]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static size_t
+SFTCoreScrollbackFillLength(const SFTTerminalEmulatorCell *row, size_t width,
+                            size_t index) {
+  size_t length = 1;
+  while ((index + length < width) &&
+         (length < SFTCoreScrollbackMaximumRunLength) &&
+         (row[index + length] == row[index])) {
+    length++;
+  }
+  return length;
+}
+
+/**
+ * Encodes a row as runs of cells sharing the same attributes, either
+ * followed by one font index per cell or, for fill runs, by the single font
+ * index repeated over the whole run.
+ *
+ * @return the encoded row length, in bytes.
+ */
+static size_t SFTCoreScrollbackEncodeRow(const SFTTerminalEmulatorCell *row,
+                                         size_t width, uint8_t *output) {
+  uint8_t *cursor = output;
+  size_t index = 0;
+  while (index < width) {
+    uint16_t attributes = SFTCoreScrollbackCellAttributes(row[index]);
+    cursor[0] = (uint8_t)(attributes & 0xFF);
+    cursor[1] = (uint8_t)(attributes >> 8);
+
+    size_t length = SFTCoreScrollbackFillLength(row, width, index);
+    if (length >= SFTCoreScrollbackMinimumFillLength) {
+      cursor[2] = (uint8_t)(length | SFTCoreScrollbackFillRun);
+      cursor[3] = SFTTerminalEmulatorCellGetCharacter(row[index]);
+      cursor += SFTCoreScrollbackRunHeaderSize + 1;
+      index += length;
+      continue;
+    }
+
+    // Literal runs stop where a fill run would start.
+    length = 0;
+    while ((index + length < width) &&
+           (length < SFTCoreScrollbackMaximumRunLength) &&
+           (SFTCoreScrollbackCellAttributes(row[index + length]) ==
+            attributes) &&
+           ((length == 0) ||
+            (SFTCoreScrollbackFillLength(row, width, index + length) <
+             SFTCoreScrollbackMinimumFillLength))) {
+      cursor[SFTCoreScrollbackRunHeaderSize + length] =
+          SFTTerminalEmulatorCellGetCharacter(row[index + length]);
+      length++;
+    }
+    cursor[2] = (uint8_t)length;
+    cursor += SFTCoreScrollbackRunHeaderSize + length;
+    index += length;
+  }
+
+  return (size_t)(cursor - output);
+}
+
+static void SFTCoreScrollbackDecodeRow(const uint8_t *input, size_t width,
+                                       SFTTerminalEmulatorCell *row) {
+  size_t index = 0;
+  while (index < width) {
+    SFTTerminalEmulatorCell attributes =
+        (SFTTerminalEmulatorCell)(input[0] | (input[1] << 8)) << 8;
+    size_t length = input[2] & SFTCoreScrollbackMaximumRunLength;
+    input += SFTCoreScrollbackRunHeaderSize;
+    if ((input[-1] & SFTCoreScrollbackFillRun) != 0) {
+      SFTCoreCellFill(row + index, length, attributes | input[0]);
+      input++;
+    } else {
+      for (size_t offset = 0; offset < length; offset++) {
+        row[index + offset] = attributes | input[offset];
+      }
+      input += length;
+    }
+    index += length;
+  }
+}
+
+/**
+ * Compresses SFTCoreScrollbackBlockRows rows into a new cold block.
+ *
+ * Blank rows made of the same cell repeated over are encoded once, and all
+ * the other blank rows with that cell share the same offset.
+ *
+ * @return the new block, or NULL if it could not be allocated.
+ */
+static SFTCoreScrollbackBlock *
+SFTCoreScrollbackCompress(SFTCoreScrollback *scrollback,
+                          const SFTTerminalEmulatorCell *rows) {
+  uint32_t rowOffsets[SFTCoreScrollbackBlockRows];
+  SFTTerminalEmulatorCell blankCells[SFTCoreScrollbackBlockRows];
+  uint32_t blankOffsets[SFTCoreScrollbackBlockRows];
+  size_t blankRows = 0;
+  size_t size = 0;
+
+  for (size_t index = 0; index < SFTCoreScrollbackBlockRows; index++) {
+    const SFTTerminalEmulatorCell *row = rows + (index * scrollback->width);
+    bool blank = SFTCoreScrollbackRowIsBlank(row, scrollback->width);
+    if (blank) {
+      size_t seen = 0;
+      while ((seen < blankRows) && (blankCells[seen] != row[0])) {
+        seen++;
+      }
+      if (seen < blankRows) {
+        rowOffsets[index] = blankOffsets[seen];
+        continue;
+      }
+    }
+
+    rowOffsets[index] = (uint32_t)size;
+    if (blank) {
+      blankCells[blankRows] = row[0];
+      blankOffsets[blankRows] = (uint32_t)size;
+      blankRows++;
+    }
+    size += SFTCoreScrollbackEncodeRow(row, scrollback->width,
+                                       scrollback->scratch + size);
+  }
+
+  SFTCoreScrollbackBlock *block =
+      malloc(sizeof(SFTCoreScrollbackBlock) + size);
+  if (block == NULL) {
+    return NULL;
+  }
+
+  memcpy(block->rowOffsets, rowOffsets, sizeof(rowOffsets));
+  block->size = size;
+  memcpy(block->data, scrollback->scratch, size);
+  return block;
+}
+
+static void SFTCoreScrollbackDropOldestBlock(SFTCoreScrollback *scrollback) {
+  SFTCoreScrollbackBlock *block = SFTCoreScrollbackBlockAt(scrollback, 0);
+  scrollback->coldBytes -= SFTCoreScrollbackBlockSize(block);
+  free(block);
+
+  scrollback->blocksFirst++;
+  if (scrollback->blocksFirst == scrollback->blocksCapacity) {
+    scrollback->blocksFirst = 0;
+  }
+  scrollback->blocksCount--;
+  scrollback->dropped += SFTCoreScrollbackBlockRows;
+}
+
+static bool SFTCoreScrollbackGrowBlocks(SFTCoreScrollback *scrollback) {
+  size_t capacity = scrollback->blocksCapacity * 2;
+  SFTCoreScrollbackBlock **blocks =
+      malloc(capacity * sizeof(SFTCoreScrollbackBlock *));
+  if (blocks == NULL) {
+    return false;
+  }
+
+  for (size_t index = 0; index < scrollback->blocksCount; index++) {
+    blocks[index] = SFTCoreScrollbackBlockAt(scrollback, index);
+  }
+  free((void *)scrollback->blocks);
+  scrollback->blocks = blocks;
+  scrollback->blocksCapacity = capacity;
+  scrollback->blocksFirst = 0;
+  return true;
+}
+
+/**
+ * Moves the oldest SFTCoreScrollbackBlockRows hot rows into a cold block,
+ * then drops the oldest cold blocks until the memory cap is honoured.
+ *
+ * The hot rows are freed even if they could not be compressed.
+ */
+static void SFTCoreScrollbackFreeze(SFTCoreScrollback *scrollback) {
+  SFTCoreScrollbackBlock *block = SFTCoreScrollbackCompress(
+      scrollback, scrollback->hot + (scrollback->hotFirst * scrollback->width));
+
+  scrollback->hotFirst += SFTCoreScrollbackBlockRows;
+  if (scrollback->hotFirst == scrollback->hotCapacity) {
+    scrollback->hotFirst = 0;
+  }
+  scrollback->hotCount -= SFTCoreScrollbackBlockRows;
+
+  if ((block != NULL) &&
+      (scrollback->blocksCount == scrollback->blocksCapacity) &&
+      !SFTCoreScrollbackGrowBlocks(scrollback)) {
+    free(block);
+    block = NULL;
+  }
+
+  if (block == NULL) {
+    /* Hot rows must stay contiguous, so history older than them is lost. */
+    while (scrollback->blocksCount > 0) {
+      SFTCoreScrollbackDropOldestBlock(scrollback);
+    }
+    scrollback->dropped += SFTCoreScrollbackBlockRows;
+    return;
+  }
+
+  size_t slot = scrollback->blocksFirst + scrollback->blocksCount;
+  if (slot >= scrollback->blocksCapacity) {
+    slot -= scrollback->blocksCapacity;
+  }
+  scrollback->blocks[slot] = block;
+  scrollback->blocksCount++;
+  scrollback->coldBytes += SFTCoreScrollbackBlockSize(block);
+
+  while ((scrollback->blocksCount > 0) &&
+         (SFTCoreScrollbackMemoryUsed(scrollback) > scrollback->memoryCap)) {
+    SFTCoreScrollbackDropOldestBlock(scrollback);
+  }
+}
+
+static void SFTCoreScrollbackDiscardIndex(SFTCoreScrollback *scrollback) {
+  if (scrollback->searchIndex != NULL) {
+    SFTCoreSearchIndexDiscard(scrollback->searchIndex,
+                              scrollback->pushed -
+                                  SFTCoreScrollbackCount(scrollback));
+  }
+}
+
+bool SFTCoreScrollbackInitialise(SFTCoreScrollback *scrollback, size_t width,
+                                 size_t hotRows, size_t memoryCap) {
+  memset(scrollback, 0, sizeof(SFTCoreScrollback));
+
+  if (width == 0) {
+    return false;
+  }
+
+  size_t hotCapacity = ((hotRows + SFTCoreScrollbackBlockRows - 1) /
+                        SFTCoreScrollbackBlockRows) *
+                       SFTCoreScrollbackBlockRows;
+  if (hotCapacity == 0) {
+    hotCapacity = SFTCoreScrollbackBlockRows;
+  }
+
+  scrollback->hot = malloc(width * hotCapacity *
+                           sizeof(SFTTerminalEmulatorCell));
+  scrollback->scratch =
+      malloc(width * SFTCoreScrollbackBlockRows *
+             (SFTCoreScrollbackRunHeaderSize + 1));
+  scrollback->blocks =
+      malloc(SFTCoreScrollbackInitialBlocks * sizeof(SFTCoreScrollbackBlock *));
+  if ((scrollback->hot == NULL) || (scrollback->scratch == NULL) ||
+      (scrollback->blocks == NULL)) {
+    SFTCoreScrollbackRelease(scrollback);
+    return false;
+  }
+
+  scrollback->width = width;
+  scrollback->hotCapacity = hotCapacity;
+  scrollback->blocksCapacity = SFTCoreScrollbackInitialBlocks;
+  scrollback->memoryCap = memoryCap;
+
+  return true;
+}
+
+void SFTCoreScrollbackRelease(SFTCoreScrollback *scrollback) {
+  if (scrollback->blocks != NULL) {
+    SFTCoreScrollbackClear(scrollback);
+  }
+  free(scrollback->hot);
+  free(scrollback->scratch);
+  free((void *)scrollback->blocks);
+  memset(scrollback, 0, sizeof(SFTCoreScrollback));
+}
+
+void SFTCoreScrollbackClear(SFTCoreScrollback *scrollback) {
+  for (size_t index = 0; index < scrollback->blocksCount; index++) {
+    free(SFTCoreScrollbackBlockAt(scrollback, index));
+  }
+
+  scrollback->blocksFirst = 0;
+  scrollback->blocksCount = 0;
+  scrollback->hotFirst = 0;
+  scrollback->hotCount = 0;
+  scrollback->coldBytes = 0;
+  SFTCoreScrollbackDiscardIndex(scrollback);
+}
+
+void SFTCoreScrollbackPush(SFTCoreScrollback *scrollback,
+                           const SFTTerminalEmulatorCell *row) {
+  if (scrollback->hotCount == scrollback->hotCapacity) {
+    SFTCoreScrollbackFreeze(scrollback);
+    SFTCoreScrollbackDiscardIndex(scrollback);
+  }
+
+  size_t slot = scrollback->hotFirst + scrollback->hotCount;
+  if (slot >= scrollback->hotCapacity) {
+    slot -= scrollback->hotCapacity;
+  }
+  memcpy(scrollback->hot + (slot * scrollback->width), row,
+         scrollback->width * sizeof(SFTTerminalEmulatorCell));
+  scrollback->hotCount++;
+
+  if (scrollback->searchIndex != NULL) {
+    SFTCoreSearchIndexAppend(scrollback->searchIndex, scrollback->pushed, row,
+                             scrollback->width);
+  }
+  scrollback->pushed++;
+}
+
+size_t SFTCoreScrollbackMemoryUsed(const SFTCoreScrollback *scrollback) {
+  return sizeof(SFTCoreScrollback) +
+         (scrollback->width * scrollback->hotCapacity *
+          sizeof(SFTTerminalEmulatorCell)) +
+         (scrollback->width * SFTCoreScrollbackBlockRows *
+          (SFTCoreScrollbackRunHeaderSize + 1)) +
+         (scrollback->blocksCapacity * sizeof(SFTCoreScrollbackBlock *)) +
+         scrollback->coldBytes;
+}
+
+bool SFTCoreScrollbackCopyLine(const SFTCoreScrollback *scrollback,
+                               size_t line,
+                               SFTTerminalEmulatorCell *destination) {
+  size_t coldLines = scrollback->blocksCount * SFTCoreScrollbackBlockRows;
+  if (line < coldLines) {
+    const SFTCoreScrollbackBlock *block =
+        SFTCoreScrollbackBlockAt(scrollback, line / SFTCoreScrollbackBlockRows);
+    SFTCoreScrollbackDecodeRow(
+        block->data + block->rowOffsets[line % SFTCoreScrollbackBlockRows],
+        scrollback->width, destination);
+    return true;
+  }
+
+  line -= coldLines;
+  if (line >= scrollback->hotCount) {
+    return false;
+  }
+
+  size_t slot = scrollback->hotFirst + line;
+  if (slot >= scrollback->hotCapacity) {
+    slot -= scrollback->hotCapacity;
+  }
+  memcpy(destination, scrollback->hot + (slot * scrollback->width),
+         scrollback->width * sizeof(SFTTerminalEmulatorCell));
+  return true;
+}
+
+size_t SFTCoreScrollbackCopyViewport(const SFTCoreScrollback *scrollback,
+                                     const SFTCoreEmulatorState *state,
+                                     const SFTTerminalEmulatorCell *cells,
+                                     size_t topLine,
+                                     SFTTerminalEmulatorCell *destination) {
+  size_t historyLines = SFTCoreScrollbackCount(scrollback);
+  if (topLine > historyLines) {
+    topLine = historyLines;
+  }
+
+  for (size_t row = 0; row < state->height; row++) {
+    size_t line = topLine + row;
+    SFTTerminalEmulatorCell *output = destination + (row * state->width);
+    if (line < historyLines) {
+      SFTCoreScrollbackCopyLine(scrollback, line, output);
+    } else {
+      memcpy(output,
+             cells + (state->width *
+                      SFTCoreEmulatorPhysicalRow(state, line - historyLines)),
+             state->width * sizeof(SFTTerminalEmulatorCell));
+    }
+  }
+
+  return topLine;
+}
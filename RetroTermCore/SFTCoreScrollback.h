@@ -0,0 +1,209 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreScrollback_h
+#define SFTCoreScrollback_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SFTCoreCell.h"
+#include "SFTCoreEmulator.h"
+
+struct SFTCoreSearchIndex;
+
+/**
+ * Rows compressed together into a single cold block.
+ */
+#define SFTCoreScrollbackBlockRows 64
+
+/**
+ * A block of SFTCoreScrollbackBlockRows compressed rows.
+ *
+ * Each row is a sequence of runs, made of two bytes holding the attributes
+ * shared by the run (the cell bits above the font index), one byte holding
+ * the run length, and then either one font index per cell or, when the top
+ * bit of the length is set, a single font index repeated over the run.
+ * Identical blank rows are only stored once per block.
+ */
+typedef struct {
+  /**
+   * Offset of each row in data.
+   */
+  uint32_t rowOffsets[SFTCoreScrollbackBlockRows];
+
+  size_t size;
+  uint8_t data[];
+} SFTCoreScrollbackBlock;
+
+/**
+ * History of rows scrolled off the top of the screen.
+ *
+ * The most recent rows are kept as packed cells in a ring, and whenever the
+ * ring fills up its oldest SFTCoreScrollbackBlockRows rows are compressed
+ * into a cold block.  Cold blocks are dropped oldest first to stay within
+ * the memory cap.  Any line can be read back in constant time.
+ */
+typedef struct SFTCoreScrollback {
+  size_t width;
+
+  /**
+   * Ring of packed recent rows, hotCapacity rows long.
+   */
+  SFTTerminalEmulatorCell *hot;
+  size_t hotCapacity;
+  size_t hotFirst;
+  size_t hotCount;
+
+  /**
+   * Ring of cold blocks, oldest first.
+   */
+  SFTCoreScrollbackBlock **blocks;
+  size_t blocksCapacity;
+  size_t blocksFirst;
+  size_t blocksCount;
+
+  /**
+   * Scratch space for compressing a block, sized for the worst case.
+   */
+  uint8_t *scratch;
+
+  /**
+   * Bytes held by cold blocks.
+   */
+  size_t coldBytes;
+
+  /**
+   * Cap for all memory held by the history.  Hot rows are allocated
+   * upfront, so only cold blocks are ever dropped to honour it.
+   */
+  size_t memoryCap;
+
+  /**
+   * Rows ever pushed, and rows dropped to honour the memory cap.
+   */
+  uint64_t pushed;
+  uint64_t dropped;
+
+  /**
+   * Index kept up to date with the rows in the history, can be NULL.  Must
+   * be attached before the first row is pushed.
+   */
+  struct SFTCoreSearchIndex *searchIndex;
+} SFTCoreScrollback;
+
+/**
+ * Initialises the given history, allocating its hot rows.
+ *
+ * @param[out] scrollback the history to initialise.
+ * @param[in] width the row width, in cells.
+ * @param[in] hotRows recent rows kept uncompressed, rounded up to a multiple
+ * of SFTCoreScrollbackBlockRows.
+ * @param[in] memoryCap the most memory the history may hold, in bytes.
+ *
+ * @return true if the history was initialised, false otherwise.
+ */
+bool SFTCoreScrollbackInitialise(SFTCoreScrollback *scrollback, size_t width,
+                                 size_t hotRows, size_t memoryCap);
+
+/**
+ * Releases everything held by the given history.
+ *
+ * @param[in,out] scrollback the history to release.
+ */
+void SFTCoreScrollbackRelease(SFTCoreScrollback *scrollback);
+
+/**
+ * Forgets every row in the history.
+ *
+ * @param[in,out] scrollback the history to clear.
+ */
+void SFTCoreScrollbackClear(SFTCoreScrollback *scrollback);
+
+/**
+ * Appends a row to the history.
+ *
+ * @param[in,out] scrollback the history to append to.
+ * @param[in] row the row contents, width cells long.
+ */
+void SFTCoreScrollbackPush(SFTCoreScrollback *scrollback,
+                           const SFTTerminalEmulatorCell *row);
+
+/**
+ * Returns the amount of rows in the history.
+ *
+ * @param[in] scrollback the history to inspect.
+ *
+ * @return the amount of rows that can be read back.
+ */
+static inline size_t
+SFTCoreScrollbackCount(const SFTCoreScrollback *scrollback) {
+  return (scrollback->blocksCount * SFTCoreScrollbackBlockRows) +
+         scrollback->hotCount;
+}
+
+/**
+ * Returns the memory held by the history, in bytes.
+ *
+ * @param[in] scrollback the history to inspect.
+ *
+ * @return the bytes used by hot rows, cold blocks and bookkeeping.
+ */
+size_t SFTCoreScrollbackMemoryUsed(const SFTCoreScrollback *scrollback);
+
+/**
+ * Copies a history row.
+ *
+ * @param[in] scrollback the history to read from.
+ * @param[in] line the row index, zero being the oldest row.
+ * @param[out] destination the buffer to fill, width cells long.
+ *
+ * @return true if the row was copied, false if line is out of range.
+ */
+bool SFTCoreScrollbackCopyLine(const SFTCoreScrollback *scrollback,
+                               size_t line,
+                               SFTTerminalEmulatorCell *destination);
+
+/**
+ * Composes a screenful from the history followed by the visible screen, as
+ * seen when scrolled back to the given line.
+ *
+ * Lines are numbered from the oldest history row, the visible screen starts
+ * at line SFTCoreScrollbackCount(scrollback).
+ *
+ * @param[in] scrollback the history to read from, as wide as the screen.
+ * @param[in] state the emulator state.
+ * @param[in] cells the cell buffer, width * height cells long.
+ * @param[in] topLine the line to show at the top, clamped so that the
+ * viewport never goes past the bottom of the screen.
+ * @param[out] destination the buffer to fill, width * height cells long.
+ *
+ * @return the line actually shown at the top.
+ */
+size_t SFTCoreScrollbackCopyViewport(const SFTCoreScrollback *scrollback,
+                                     const SFTCoreEmulatorState *state,
+                                     const SFTTerminalEmulatorCell *cells,
+                                     size_t topLine,
+                                     SFTTerminalEmulatorCell *destination);
+
+#endif /* SFTCoreScrollback_h */
@@ -0,0 +1,531 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTCoreCharacterSet.h"
+#include "SFTCoreSearch.h"
+
+/**
+ * Trigram made of three blanks, too common to be worth indexing.
+ */
+#define SFTCoreSearchBlankTrigram                                              \
+  ((SFTCharacterSetSpace << 14) | (SFTCharacterSetSpace << 7) |                \
+   SFTCharacterSetSpace)
+
+#define SFTCoreSearchTrigramMask 0x1FFFFF
+
+#define SFTCoreSearchNoPosting UINT32_MAX
+
+/**
+ * Postings the generation being filled starts with.
+ */
+#define SFTCoreSearchInitialPostings 16384
+
+/**
+ * Sealed generations the generation ring starts with.
+ */
+#define SFTCoreSearchInitialGenerations 8
+
+static inline size_t SFTCoreSearchBucket(uint32_t trigram) {
+  return (size_t)((trigram * 2654435761U) >> 19) & (SFTCoreSearchBuckets - 1);
+}
+
+static SFTCoreSearchGeneration *
+SFTCoreSearchGenerationAt(const SFTCoreSearchIndex *index, size_t position) {
+  size_t slot = index->generationsFirst + position;
+  if (slot >= index->generationsCapacity) {
+    slot -= index->generationsCapacity;
+  }
+  return &index->generations[slot];
+}
+
+static size_t
+SFTCoreSearchGenerationSize(const SFTCoreSearchGeneration *generation) {
+  return ((SFTCoreSearchBuckets + 1) * sizeof(uint32_t)) +
+         (generation->offsets[SFTCoreSearchBuckets] * sizeof(uint16_t));
+}
+
+static void
+SFTCoreSearchGenerationRelease(SFTCoreSearchIndex *index,
+                               SFTCoreSearchGeneration *generation) {
+  index->sealedBytes -= SFTCoreSearchGenerationSize(generation);
+  free(generation->offsets);
+  free(generation->lines);
+  memset(generation, 0, sizeof(SFTCoreSearchGeneration));
+}
+
+static void SFTCoreSearchResetActive(SFTCoreSearchIndex *index) {
+  memset(index->buckets, 0xFF, SFTCoreSearchBuckets * sizeof(uint32_t));
+  index->postingsCount = 0;
+  index->activeLines = 0;
+}
+
+static bool SFTCoreSearchGrowGenerations(SFTCoreSearchIndex *index) {
+  size_t capacity = index->generationsCapacity * 2;
+  SFTCoreSearchGeneration *generations = (SFTCoreSearchGeneration *)malloc(
+      capacity * sizeof(SFTCoreSearchGeneration));
+  if (generations == NULL) {
+    return false;
+  }
+
+  for (size_t position = 0; position < index->generationsCount; position++) {
+    generations[position] = *SFTCoreSearchGenerationAt(index, position);
+  }
+  free(index->generations);
+  index->generations = generations;
+  index->generationsCapacity = capacity;
+  index->generationsFirst = 0;
+  return true;
+}
+
+/**
+ * Flattens the chained postings of the generation being filled into a new
+ * sealed generation, then starts a new one.
+ */
+static void SFTCoreSearchSeal(SFTCoreSearchIndex *index) {
+  SFTCoreSearchGeneration generation;
+  generation.firstLine = index->activeFirstLine;
+  generation.offsets =
+      (uint32_t *)malloc((SFTCoreSearchBuckets + 1) * sizeof(uint32_t));
+  generation.lines =
+      (uint16_t *)malloc(index->postingsCount * sizeof(uint16_t));
+  if ((generation.offsets == NULL) || (generation.lines == NULL) ||
+      ((index->generationsCount == index->generationsCapacity) &&
+       !SFTCoreSearchGrowGenerations(index))) {
+    free(generation.offsets);
+    free(generation.lines);
+    index->incomplete = true;
+    SFTCoreSearchResetActive(index);
+    return;
+  }
+
+  // Chains run newest first, so each is written back to front.
+  uint32_t offset = 0;
+  for (size_t bucket = 0; bucket < SFTCoreSearchBuckets; bucket++) {
+    generation.offsets[bucket] = offset;
+    for (uint32_t posting = index->buckets[bucket];
+         posting != SFTCoreSearchNoPosting;
+         posting = index->postings[posting].next) {
+      offset++;
+    }
+
+    uint32_t position = offset;
+    for (uint32_t posting = index->buckets[bucket];
+         posting != SFTCoreSearchNoPosting;
+         posting = index->postings[posting].next) {
+      generation.lines[--position] = index->postings[posting].line;
+    }
+  }
+  generation.offsets[SFTCoreSearchBuckets] = offset;
+
+  size_t slot = index->generationsFirst + index->generationsCount;
+  if (slot >= index->generationsCapacity) {
+    slot -= index->generationsCapacity;
+  }
+  index->generations[slot] = generation;
+  index->generationsCount++;
+  index->sealedBytes += SFTCoreSearchGenerationSize(&generation);
+
+  SFTCoreSearchResetActive(index);
+}
+
+bool SFTCoreSearchIndexInitialise(SFTCoreSearchIndex *index) {
+  memset(index, 0, sizeof(SFTCoreSearchIndex));
+
+  index->generations = (SFTCoreSearchGeneration *)calloc(
+      SFTCoreSearchInitialGenerations, sizeof(SFTCoreSearchGeneration));
+  index->postings = (SFTCoreSearchPosting *)malloc(
+      SFTCoreSearchInitialPostings * sizeof(SFTCoreSearchPosting));
+  index->buckets = (uint32_t *)malloc(SFTCoreSearchBuckets * sizeof(uint32_t));
+  if ((index->generations == NULL) || (index->postings == NULL) ||
+      (index->buckets == NULL)) {
+    SFTCoreSearchIndexRelease(index);
+    return false;
+  }
+
+  index->generationsCapacity = SFTCoreSearchInitialGenerations;
+  index->postingsCapacity = SFTCoreSearchInitialPostings;
+  SFTCoreSearchResetActive(index);
+  return true;
+}
+
+void SFTCoreSearchIndexRelease(SFTCoreSearchIndex *index) {
+  for (size_t position = 0; position < index->generationsCount; position++) {
+    SFTCoreSearchGenerationRelease(index,
+                                   SFTCoreSearchGenerationAt(index, position));
+  }
+  free(index->generations);
+  free(index->postings);
+  free(index->buckets);
+  memset(index, 0, sizeof(SFTCoreSearchIndex));
+}
+
+void SFTCoreSearchIndexAppend(SFTCoreSearchIndex *index, uint64_t line,
+                              const SFTTerminalEmulatorCell *row,
+                              size_t width) {
+  if (index->activeLines == 0) {
+    index->activeFirstLine = line;
+  }
+  uint16_t relative = (uint16_t)(line - index->activeFirstLine);
+
+  uint32_t trigram = 0;
+  for (size_t column = 0; column < width; column++) {
+    trigram = ((trigram << 7) |
+               SFTCoreSearchCanonicalGlyph(
+                   SFTTerminalEmulatorCellGetCharacter(row[column]))) &
+              SFTCoreSearchTrigramMask;
+    if ((column < 2) || (trigram == SFTCoreSearchBlankTrigram)) {
+      continue;
+    }
+
+    // Chains run newest first: the row is listed once per bucket at most.
+    size_t bucket = SFTCoreSearchBucket(trigram);
+    uint32_t head = index->buckets[bucket];
+    if ((head != SFTCoreSearchNoPosting) &&
+        (index->postings[head].line == relative)) {
+      continue;
+    }
+
+    if (index->postingsCount == index->postingsCapacity) {
+      SFTCoreSearchPosting *postings = (SFTCoreSearchPosting *)realloc(
+          index->postings,
+          index->postingsCapacity * 2 * sizeof(SFTCoreSearchPosting));
+      if (postings == NULL) {
+        index->incomplete = true;
+        break;
+      }
+      index->postings = postings;
+      index->postingsCapacity *= 2;
+    }
+
+    SFTCoreSearchPosting *posting = &index->postings[index->postingsCount];
+    posting->line = relative;
+    posting->next = head;
+    index->buckets[bucket] = (uint32_t)index->postingsCount;
+    index->postingsCount++;
+  }
+
+  index->activeLines = (size_t)relative + 1;
+  if (index->activeLines == SFTCoreSearchGenerationLines) {
+    SFTCoreSearchSeal(index);
+  }
+}
+
+void SFTCoreSearchIndexDiscard(SFTCoreSearchIndex *index,
+                               uint64_t oldestLine) {
+  while (index->generationsCount > 0) {
+    SFTCoreSearchGeneration *generation = SFTCoreSearchGenerationAt(index, 0);
+    if (generation->firstLine + SFTCoreSearchGenerationLines > oldestLine) {
+      break;
+    }
+
+    SFTCoreSearchGenerationRelease(index, generation);
+    index->generationsFirst++;
+    if (index->generationsFirst == index->generationsCapacity) {
+      index->generationsFirst = 0;
+    }
+    index->generationsCount--;
+  }
+
+  if ((index->activeLines > 0) &&
+      (index->activeFirstLine + index->activeLines <= oldestLine)) {
+    SFTCoreSearchResetActive(index);
+  }
+
+  if ((index->generationsCount == 0) && (index->activeLines == 0)) {
+    index->incomplete = false;
+  }
+}
+
+size_t SFTCoreSearchIndexMemoryUsed(const SFTCoreSearchIndex *index) {
+  return sizeof(SFTCoreSearchIndex) +
+         (index->generationsCapacity * sizeof(SFTCoreSearchGeneration)) +
+         (index->postingsCapacity * sizeof(SFTCoreSearchPosting)) +
+         (SFTCoreSearchBuckets * sizeof(uint32_t)) + index->sealedBytes;
+}
+
+size_t SFTCoreSearchGlyphsFromText(const char *text, size_t length,
+                                   uint8_t *glyphs) {
+  size_t count = 0;
+  for (size_t position = 0; position < length; position++) {
+    uint16_t mapped = SFTASCIIToLowerCaseFontIndex[(uint8_t)text[position]];
+    if (mapped <= 0xFF) {
+      glyphs[count++] = (uint8_t)mapped;
+    }
+  }
+  return count;
+}
+
+/**
+ * Appends the matches found in a row to hits, in column order.
+ *
+ * @return the amount of hits appended.
+ */
+static size_t SFTCoreSearchMatchRow(const SFTTerminalEmulatorCell *row,
+                                    size_t width, const uint8_t *query,
+                                    size_t length, size_t line,
+                                    SFTCoreSearchHit *hits,
+                                    size_t maximumHits) {
+  size_t count = 0;
+  for (size_t column = 0; (column + length <= width) && (count < maximumHits);
+       column++) {
+    size_t matched = 0;
+    while ((matched < length) &&
+           (SFTCoreSearchCanonicalGlyph(SFTTerminalEmulatorCellGetCharacter(
+                row[column + matched])) == query[matched])) {
+      matched++;
+    }
+    if (matched == length) {
+      hits[count].line = line;
+      hits[count].column = column;
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * Checks a history row found through the index.
+ *
+ * @return the amount of hits appended.
+ */
+static size_t SFTCoreSearchCheckLine(const SFTCoreScrollback *scrollback,
+                                     uint64_t line, uint64_t oldestLine,
+                                     SFTTerminalEmulatorCell *buffer,
+                                     const uint8_t *query, size_t length,
+                                     SFTCoreSearchHit *hits,
+                                     size_t maximumHits) {
+  if ((line < oldestLine) ||
+      !SFTCoreScrollbackCopyLine(scrollback, (size_t)(line - oldestLine),
+                                 buffer)) {
+    return 0;
+  }
+  return SFTCoreSearchMatchRow(buffer, scrollback->width, query, length,
+                               (size_t)(line - oldestLine), hits,
+                               maximumHits);
+}
+
+static bool SFTCoreSearchListContains(const uint16_t *lines, size_t count,
+                                      uint16_t line) {
+  size_t low = 0;
+  size_t high = count;
+  while (low < high) {
+    size_t middle = low + ((high - low) / 2);
+    if (lines[middle] < line) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return (low < count) && (lines[low] == line);
+}
+
+/**
+ * Checks the rows of a generation listed under all the query buckets,
+ * newest first.
+ *
+ * @return the amount of hits appended.
+ */
+static size_t SFTCoreSearchFindInGeneration(
+    const SFTCoreScrollback *scrollback, uint64_t firstLine,
+    const uint16_t *const *lists, const size_t *counts, size_t listsCount,
+    SFTTerminalEmulatorCell *buffer, const uint8_t *query, size_t length,
+    SFTCoreSearchHit *hits, size_t maximumHits) {
+  uint64_t oldestLine =
+      scrollback->pushed - SFTCoreScrollbackCount(scrollback);
+
+  size_t shortest = 0;
+  for (size_t list = 1; list < listsCount; list++) {
+    if (counts[list] < counts[shortest]) {
+      shortest = list;
+    }
+  }
+
+  size_t count = 0;
+  for (size_t position = counts[shortest];
+       (position > 0) && (count < maximumHits); position--) {
+    uint16_t line = lists[shortest][position - 1];
+    if (firstLine + line < oldestLine) {
+      break;
+    }
+
+    bool candidate = true;
+    for (size_t list = 0; candidate && (list < listsCount); list++) {
+      candidate = (list == shortest) ||
+                  SFTCoreSearchListContains(lists[list], counts[list], line);
+    }
+    if (candidate) {
+      count += SFTCoreSearchCheckLine(scrollback, firstLine + line,
+                                      oldestLine, buffer, query, length,
+                                      hits + count, maximumHits - count);
+    }
+  }
+
+  return count;
+}
+
+static size_t SFTCoreSearchFindIndexed(const SFTCoreScrollback *scrollback,
+                                       const size_t *buckets,
+                                       size_t bucketsCount,
+                                       SFTTerminalEmulatorCell *buffer,
+                                       const uint8_t *query, size_t length,
+                                       SFTCoreSearchHit *hits,
+                                       size_t maximumHits) {
+  const SFTCoreSearchIndex *index = scrollback->searchIndex;
+  uint64_t oldestLine =
+      scrollback->pushed - SFTCoreScrollbackCount(scrollback);
+  const uint16_t **lists =
+      (const uint16_t **)malloc(bucketsCount * sizeof(uint16_t *));
+  size_t *counts = (size_t *)malloc(bucketsCount * sizeof(size_t));
+  uint16_t *chains = (uint16_t *)malloc(
+      bucketsCount * SFTCoreSearchGenerationLines * sizeof(uint16_t));
+  if ((lists == NULL) || (counts == NULL) || (chains == NULL)) {
+    free((void *)lists);
+    free(counts);
+    free(chains);
+    return 0;
+  }
+
+  // Chains of the generation being filled are copied out in ascending order
+  // to be looked up like sealed generations.
+  size_t count = 0;
+  if (index->activeLines > 0) {
+    for (size_t list = 0; list < bucketsCount; list++) {
+      uint16_t *chain = chains + (list * SFTCoreSearchGenerationLines);
+      size_t rows = 0;
+      for (uint32_t posting = index->buckets[buckets[list]];
+           posting != SFTCoreSearchNoPosting;
+           posting = index->postings[posting].next) {
+        rows++;
+      }
+      counts[list] = rows;
+      for (uint32_t posting = index->buckets[buckets[list]];
+           posting != SFTCoreSearchNoPosting;
+           posting = index->postings[posting].next) {
+        chain[--rows] = index->postings[posting].line;
+      }
+      lists[list] = chain;
+    }
+
+    count += SFTCoreSearchFindInGeneration(
+        scrollback, index->activeFirstLine, lists, counts, bucketsCount,
+        buffer, query, length, hits, maximumHits);
+  }
+
+  for (size_t position = index->generationsCount;
+       (position > 0) && (count < maximumHits); position--) {
+    const SFTCoreSearchGeneration *generation =
+        SFTCoreSearchGenerationAt(index, position - 1);
+    if (generation->firstLine + SFTCoreSearchGenerationLines <= oldestLine) {
+      break;
+    }
+
+    for (size_t list = 0; list < bucketsCount; list++) {
+      lists[list] = generation->lines + generation->offsets[buckets[list]];
+      counts[list] = generation->offsets[buckets[list] + 1] -
+                     generation->offsets[buckets[list]];
+    }
+
+    count += SFTCoreSearchFindInGeneration(
+        scrollback, generation->firstLine, lists, counts, bucketsCount,
+        buffer, query, length, hits + count, maximumHits - count);
+  }
+
+  free(chains);
+  free(counts);
+  free((void *)lists);
+  return count;
+}
+
+size_t SFTCoreSearchFind(const SFTCoreScrollback *scrollback,
+                         const SFTCoreEmulatorState *state,
+                         const SFTTerminalEmulatorCell *cells,
+                         const uint8_t *glyphs, size_t length,
+                         SFTCoreSearchHit *hits, size_t maximumHits) {
+  if ((length == 0) || (length > state->width) || (maximumHits == 0)) {
+    return 0;
+  }
+
+  uint8_t *query = (uint8_t *)malloc(length);
+  size_t *buckets = (size_t *)malloc(length * sizeof(size_t));
+  SFTTerminalEmulatorCell *buffer = (SFTTerminalEmulatorCell *)malloc(
+      state->width * sizeof(SFTTerminalEmulatorCell));
+  if ((query == NULL) || (buckets == NULL) || (buffer == NULL)) {
+    free(query);
+    free(buckets);
+    free(buffer);
+    return 0;
+  }
+
+  size_t bucketsCount = 0;
+  uint32_t trigram = 0;
+  for (size_t position = 0; position < length; position++) {
+    query[position] = SFTCoreSearchCanonicalGlyph(glyphs[position]);
+    trigram = ((trigram << 7) | query[position]) & SFTCoreSearchTrigramMask;
+    if ((position < 2) || (trigram == SFTCoreSearchBlankTrigram)) {
+      continue;
+    }
+
+    size_t bucket = SFTCoreSearchBucket(trigram);
+    size_t seen = 0;
+    while ((seen < bucketsCount) && (buckets[seen] != bucket)) {
+      seen++;
+    }
+    if (seen == bucketsCount) {
+      buckets[bucketsCount++] = bucket;
+    }
+  }
+
+  size_t historyLines = SFTCoreScrollbackCount(scrollback);
+  size_t count = 0;
+  for (size_t row = state->height; (row > 0) && (count < maximumHits);
+       row--) {
+    count += SFTCoreSearchMatchRow(
+        cells + (state->width * SFTCoreEmulatorPhysicalRow(state, row - 1)),
+        state->width, query, length, historyLines + row - 1, hits + count,
+        maximumHits - count);
+  }
+
+  if ((scrollback->width == state->width) && (count < maximumHits)) {
+    if ((scrollback->searchIndex != NULL) &&
+        !scrollback->searchIndex->incomplete && (bucketsCount > 0)) {
+      count += SFTCoreSearchFindIndexed(scrollback, buckets, bucketsCount,
+                                        buffer, query, length, hits + count,
+                                        maximumHits - count);
+    } else {
+      for (size_t line = historyLines; (line > 0) && (count < maximumHits);
+           line--) {
+        SFTCoreScrollbackCopyLine(scrollback, line - 1, buffer);
+        count += SFTCoreSearchMatchRow(buffer, state->width, query, length,
+                                       line - 1, hits + count,
+                                       maximumHits - count);
+      }
+    }
+  }
+
+  free(buffer);
+  free(buckets);
+  free(query);
+  return count;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreSearch_h
+#define SFTCoreSearch_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SFTCoreCell.h"
+#include "SFTCoreEmulator.h"
+#include "SFTCoreScrollback.h"
+
+/**
+ * History rows indexed together, then sealed into a sorted generation.
+ */
+#define SFTCoreSearchGenerationLines 4096
+
+/**
+ * Hash buckets trigrams are spread over, in each generation.  Rows are
+ * indexed by bucket rather than by trigram, and the rows listed under all
+ * the buckets of a query are checked for an actual match.
+ */
+#define SFTCoreSearchBuckets 8192
+
+/**
+ * Folds a font index into the form used for searching: reverse video is
+ * ignored, and the upper case letters of the lower case character set are
+ * folded onto the letters shared with the upper case character set.
+ *
+ * @param[in] fontIndex the font index to fold.
+ *
+ * @return the canonical glyph.
+ */
+static inline uint8_t SFTCoreSearchCanonicalGlyph(uint8_t fontIndex) {
+  fontIndex &= 0x7F;
+  return ((fontIndex >= 0x41) && (fontIndex <= 0x5A))
+             ? (uint8_t)(fontIndex - 0x40)
+             : fontIndex;
+}
+
+/**
+ * A row in the generation being filled holding trigrams of a bucket.
+ */
+typedef struct {
+  /**
+   * Next older posting in the same bucket, or UINT32_MAX.
+   */
+  uint32_t next;
+
+  /**
+   * Row, relative to the start of the generation.
+   */
+  uint16_t line;
+} SFTCoreSearchPosting;
+
+/**
+ * Buckets of SFTCoreSearchGenerationLines history rows.
+ */
+typedef struct {
+  /**
+   * First row in the generation, counting every row ever pushed into the
+   * history.
+   */
+  uint64_t firstLine;
+
+  /**
+   * Where each bucket's rows start in lines, SFTCoreSearchBuckets + 1
+   * entries.
+   */
+  uint32_t *offsets;
+
+  /**
+   * Rows holding trigrams of each bucket, relative to firstLine, in
+   * ascending order.
+   */
+  uint16_t *lines;
+} SFTCoreSearchGeneration;
+
+/**
+ * Trigram index over the rows pushed into a scrollback history.
+ *
+ * Rows are indexed once, as they enter the history, into a generation of
+ * chained postings that is flattened once full.  Generations are dropped as
+ * soon as the history drops all their rows.  Rows still on the screen
+ * change all the time, so they are scanned on every query instead.
+ */
+typedef struct SFTCoreSearchIndex {
+  SFTCoreSearchGeneration *generations;
+  size_t generationsCapacity;
+  size_t generationsFirst;
+  size_t generationsCount;
+
+  /**
+   * Postings of the generation being filled, chained from buckets.
+   */
+  SFTCoreSearchPosting *postings;
+  size_t postingsCount;
+  size_t postingsCapacity;
+  uint32_t *buckets;
+
+  uint64_t activeFirstLine;
+  size_t activeLines;
+
+  /**
+   * Bytes held by sealed generations.
+   */
+  size_t sealedBytes;
+
+  /**
+   * Set when some rows could not be indexed for lack of memory, so that
+   * queries scan the history instead until those rows are gone.
+   */
+  bool incomplete;
+} SFTCoreSearchIndex;
+
+/**
+ * A search match.
+ */
+typedef struct {
+  /**
+   * The matching row: history rows come first, oldest first, followed by
+   * the visible screen rows, as in SFTCoreScrollbackCopyViewport.
+   */
+  size_t line;
+
+  size_t column;
+} SFTCoreSearchHit;
+
+/**
+ * Initialises the given index.
+ *
+ * @param[out] index the index to initialise.
+ *
+ * @return true if the index was initialised, false otherwise.
+ */
+bool SFTCoreSearchIndexInitialise(SFTCoreSearchIndex *index);
+
+/**
+ * Releases everything held by the given index.
+ *
+ * @param[in,out] index the index to release.
+ */
+void SFTCoreSearchIndexRelease(SFTCoreSearchIndex *index);
+
+/**
+ * Indexes a history row, invoked by the history the index is attached to.
+ *
+ * @param[in,out] index the index to update.
+ * @param[in] line the row number, counting every row ever pushed.
+ * @param[in] row the row contents.
+ * @param[in] width the row width, in cells.
+ */
+void SFTCoreSearchIndexAppend(SFTCoreSearchIndex *index, uint64_t line,
+                              const SFTTerminalEmulatorCell *row,
+                              size_t width);
+
+/**
+ * Forgets every row older than the given one, invoked by the history the
+ * index is attached to.
+ *
+ * @param[in,out] index the index to update.
+ * @param[in] oldestLine the oldest row still in the history, counting every
+ * row ever pushed.
+ */
+void SFTCoreSearchIndexDiscard(SFTCoreSearchIndex *index,
+                               uint64_t oldestLine);
+
+/**
+ * Returns the memory held by the index, in bytes.
+ *
+ * @param[in] index the index to inspect.
+ *
+ * @return the bytes used by postings, generations and buckets.
+ */
+size_t SFTCoreSearchIndexMemoryUsed(const SFTCoreSearchIndex *index);
+
+/**
+ * Converts ASCII text into font indices to search for.
+ *
+ * @param[in] text the text to convert.
+ * @param[in] length the text length, in bytes.
+ * @param[out] glyphs the buffer to fill, length bytes long.
+ *
+ * @return the amount of font indices written, characters without a glyph
+ * being skipped.
+ */
+size_t SFTCoreSearchGlyphsFromText(const char *text, size_t length,
+                                   uint8_t *glyphs);
+
+/**
+ * Finds the given glyphs in the history and on the screen, newest rows
+ * first, ignoring reverse video and case.
+ *
+ * History rows are only looked up through the index attached to the
+ * history, if any, and when the query holds at least three glyphs not all
+ * of them blank; they are scanned one by one otherwise.
+ *
+ * @param[in] scrollback the history to search, with or without an index.
+ * @param[in] state the emulator state.
+ * @param[in] cells the cell buffer, width * height cells long.
+ * @param[in] glyphs the font indices to look for.
+ * @param[in] length the amount of font indices to look for.
+ * @param[out] hits the buffer to fill.
+ * @param[in] maximumHits the amount of hits that fit in the buffer.
+ *
+ * @return the amount of hits found, up to maximumHits.
+ */
+size_t SFTCoreSearchFind(const SFTCoreScrollback *scrollback,
+                         const SFTCoreEmulatorState *state,
+                         const SFTTerminalEmulatorCell *cells,
+                         const uint8_t *glyphs, size_t length,
+                         SFTCoreSearchHit *hits, size_t maximumHits);
+
+#endif /* SFTCoreSearch_h */
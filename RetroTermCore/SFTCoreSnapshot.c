@@ -0,0 +1,209 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "SFTCoreEmulator.h"
+#include "SFTCoreScrollback.h"
+#include "SFTCoreSnapshot.h"
+
+/**
+ * Flag set in the pending index when the writer published a snapshot the
+ * reader has not picked up yet.
+ */
+static const unsigned int kFreshFlag = 0x80;
+
+static const unsigned int kSlotMask = 0x7F;
+
+bool SFTCoreSnapshotBufferInitialise(SFTCoreSnapshotBuffer *buffer,
+                                     size_t width, size_t height) {
+  memset(buffer, 0, sizeof(SFTCoreSnapshotBuffer));
+  if ((width == 0) || (height == 0) ||
+      (height > SFTCoreEmulatorMaximumHeight) || (width > SIZE_MAX / height)) {
+    return false;
+  }
+
+  buffer->width = width;
+  buffer->height = height;
+  buffer->rowSequences = (uint64_t *)calloc(height, sizeof(uint64_t));
+  if (buffer->rowSequences == NULL) {
+    return false;
+  }
+
+  for (size_t index = 0; index < SFTCoreSnapshotSlotsCount; index++) {
+    SFTCoreSnapshot *snapshot = &buffer->slots[index];
+    snapshot->cells = (SFTTerminalEmulatorCell *)calloc(
+        width * height, sizeof(SFTTerminalEmulatorCell));
+    snapshot->rowSequences = (uint64_t *)calloc(height, sizeof(uint64_t));
+    snapshot->viewport = (SFTTerminalEmulatorCell *)calloc(
+        width * height, sizeof(SFTTerminalEmulatorCell));
+    if ((snapshot->cells == NULL) || (snapshot->rowSequences == NULL) ||
+        (snapshot->viewport == NULL)) {
+      SFTCoreSnapshotBufferRelease(buffer);
+      return false;
+    }
+  }
+
+  buffer->writeSlot = 0;
+  buffer->readSlot = 1;
+  buffer->published = &buffer->slots[2];
+  buffer->viewportLine = UINT64_MAX;
+  atomic_init(&buffer->pending, 2);
+  return true;
+}
+
+void SFTCoreSnapshotBufferRelease(SFTCoreSnapshotBuffer *buffer) {
+  for (size_t index = 0; index < SFTCoreSnapshotSlotsCount; index++) {
+    free(buffer->slots[index].cells);
+    free(buffer->slots[index].rowSequences);
+    free(buffer->slots[index].viewport);
+    buffer->slots[index].cells = NULL;
+    buffer->slots[index].rowSequences = NULL;
+    buffer->slots[index].viewport = NULL;
+  }
+  free(buffer->rowSequences);
+  buffer->rowSequences = NULL;
+}
+
+bool SFTCoreSnapshotBufferPublish(SFTCoreSnapshotBuffer *buffer,
+                                  SFTCoreEmulatorState *state,
+                                  const SFTTerminalEmulatorCell *cells) {
+  uint64_t sequence = buffer->sequence + 1;
+  bool changed = false;
+
+  size_t count = 0;
+  for (size_t row = SFTCoreEmulatorNextDirtyRows(state, 0, &count);
+       row < state->height;
+       row = SFTCoreEmulatorNextDirtyRows(state, row + count, &count)) {
+    for (size_t index = row; index < row + count; index++) {
+      buffer->rowSequences[index] = sequence;
+    }
+    changed = true;
+  }
+  SFTCoreEmulatorClearDirtyRows(state);
+
+  // The previously published snapshot is never written to by anybody while
+  // the writer is here, whether the reader picked it up or not.
+  const SFTCoreSnapshot *published = buffer->published;
+  if (!changed && !buffer->viewportMoved &&
+      (published->baseRow == state->baseRow) &&
+      (published->row == state->row) &&
+      (published->column == state->column) &&
+      (published->isInASCIIMode == state->isInASCIIMode) &&
+      (published->useLowerCase == state->useLowerCase)) {
+    return false;
+  }
+
+  // The snapshot being filled was last published two rounds ago at best,
+  // so it is brought up to date row by row.
+  SFTCoreSnapshot *snapshot = &buffer->slots[buffer->writeSlot];
+  size_t rowLength = buffer->width * sizeof(SFTTerminalEmulatorCell);
+  for (size_t row = 0; row < buffer->height; row++) {
+    if (snapshot->rowSequences[row] != buffer->rowSequences[row]) {
+      memcpy(snapshot->cells + (row * buffer->width),
+             cells + (row * buffer->width), rowLength);
+      snapshot->rowSequences[row] = buffer->rowSequences[row];
+    }
+  }
+  snapshot->sequence = sequence;
+  snapshot->baseRow = state->baseRow;
+  snapshot->row = state->row;
+  snapshot->column = state->column;
+  snapshot->isInASCIIMode = state->isInASCIIMode;
+  snapshot->useLowerCase = state->useLowerCase;
+
+  // The history may have grown or shrunk under the viewport, so it is
+  // composed again with every publication while scrolled back.
+  const SFTCoreScrollback *scrollback = state->scrollback;
+  snapshot->isScrolledBack = false;
+  snapshot->historyPushed = 0;
+  snapshot->historyCount = 0;
+  if (scrollback != NULL) {
+    size_t historyCount = SFTCoreScrollbackCount(scrollback);
+    uint64_t oldest = scrollback->pushed - historyCount;
+    if (buffer->viewportLine < oldest) {
+      buffer->viewportLine = oldest;
+    }
+    if (buffer->viewportLine < scrollback->pushed) {
+      SFTCoreScrollbackCopyViewport(scrollback, state, cells,
+                                    (size_t)(buffer->viewportLine - oldest),
+                                    snapshot->viewport);
+      snapshot->isScrolledBack = true;
+    } else {
+      buffer->viewportLine = UINT64_MAX;
+    }
+    snapshot->historyPushed = scrollback->pushed;
+    snapshot->historyCount = historyCount;
+  }
+  snapshot->viewportLine = snapshot->isScrolledBack ? buffer->viewportLine
+                                                    : snapshot->historyPushed;
+  buffer->viewportMoved = false;
+
+  buffer->sequence = sequence;
+  buffer->published = snapshot;
+  buffer->writeSlot =
+      atomic_exchange_explicit(&buffer->pending,
+                               buffer->writeSlot | kFreshFlag,
+                               memory_order_acq_rel) &
+      kSlotMask;
+  return true;
+}
+
+void SFTCoreSnapshotBufferScrollViewportToLine(SFTCoreSnapshotBuffer *buffer,
+                                               uint64_t line) {
+  buffer->viewportLine = line;
+  buffer->viewportMoved = true;
+}
+
+void SFTCoreSnapshotBufferScrollViewportByRows(
+    SFTCoreSnapshotBuffer *buffer, const SFTCoreEmulatorState *state,
+    int64_t rows) {
+  const SFTCoreScrollback *scrollback = state->scrollback;
+  if (scrollback == NULL) {
+    return;
+  }
+
+  uint64_t line = (buffer->viewportLine < scrollback->pushed)
+                      ? buffer->viewportLine
+                      : scrollback->pushed;
+  if (rows < 0) {
+    uint64_t distance = (uint64_t)(-(rows + 1)) + 1;
+    line = (line > distance) ? line - distance : 0;
+  } else {
+    line += (uint64_t)rows;
+  }
+  SFTCoreSnapshotBufferScrollViewportToLine(buffer, line);
+}
+
+const SFTCoreSnapshot *
+SFTCoreSnapshotBufferAcquire(SFTCoreSnapshotBuffer *buffer) {
+  if ((atomic_load_explicit(&buffer->pending, memory_order_relaxed) &
+       kFreshFlag) != 0) {
+    buffer->readSlot = atomic_exchange_explicit(&buffer->pending,
+                                                buffer->readSlot,
+                                                memory_order_acq_rel) &
+                       kSlotMask;
+  }
+
+  return &buffer->slots[buffer->readSlot];
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreSnapshot_h
+#define SFTCoreSnapshot_h
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SFTCoreCell.h"
+#include "SFTCoreEmulator.h"
+
+/**
+ * Amount of snapshots cycled between the parsing and the rendering thread.
+ */
+#define SFTCoreSnapshotSlotsCount 3
+
+/**
+ * A consistent copy of the screen as it was after a parsed chunk of data.
+ */
+typedef struct {
+  /**
+   * Cells laid out like the emulator's cell buffer, width * height cells.
+   */
+  SFTTerminalEmulatorCell *cells;
+
+  /**
+   * Sequence number of the publication that last changed each cell buffer
+   * row, indexed by physical row.
+   */
+  uint64_t *rowSequences;
+
+  /**
+   * Sequence number of this snapshot's publication, growing from 1; 0 is
+   * the blank screen snapshots start from.
+   */
+  uint64_t sequence;
+
+  size_t baseRow;
+  size_t row;
+  size_t column;
+  bool isInASCIIMode;
+  bool useLowerCase;
+
+  /**
+   * Screenful of history followed by the screen, as seen while scrolled
+   * back, width * height cells in visible row order.  Only filled in when
+   * isScrolledBack is set.
+   */
+  SFTTerminalEmulatorCell *viewport;
+
+  /**
+   * History row shown at the top, counting every row ever pushed to the
+   * scrollback so that it stays put as the history grows.  Equal to
+   * historyPushed when not scrolled back.
+   */
+  uint64_t viewportLine;
+
+  /**
+   * Rows ever pushed to the scrollback, and rows still held by it.
+   */
+  uint64_t historyPushed;
+  size_t historyCount;
+
+  bool isScrolledBack;
+} SFTCoreSnapshot;
+
+/**
+ * Lock-free triple buffer of screen snapshots, moving them from the one
+ * thread parsing incoming data to the one thread rendering it.
+ *
+ * The writer always fills a snapshot of its own and swaps it with the
+ * pending one when done; the reader swaps its snapshot with the pending one
+ * only if a newer one was published in the meantime.  Neither side ever
+ * waits for the other, and a snapshot is never written to while the reader
+ * holds it.  Snapshots skipped by the reader are simply overwritten.
+ */
+typedef struct {
+  size_t width;
+  size_t height;
+
+  SFTCoreSnapshot slots[SFTCoreSnapshotSlotsCount];
+
+  /**
+   * Writer: sequence number of the latest publication of each row.
+   */
+  uint64_t *rowSequences;
+
+  /**
+   * Writer: latest publication sequence number, and its snapshot.
+   */
+  uint64_t sequence;
+  const SFTCoreSnapshot *published;
+
+  /**
+   * Writer: index of the snapshot being filled.
+   */
+  unsigned int writeSlot;
+
+  /**
+   * Writer: history row requested at the top of the viewport, numbered as
+   * SFTCoreSnapshot.viewportLine, or UINT64_MAX to follow the screen.
+   */
+  uint64_t viewportLine;
+  bool viewportMoved;
+
+  /**
+   * Index of the snapshot waiting to be picked up by the reader, flagged
+   * as fresh if the writer published it after the reader last looked.
+   */
+  _Alignas(64) _Atomic unsigned int pending;
+
+  /**
+   * Reader: index of the snapshot being rendered.
+   */
+  _Alignas(64) unsigned int readSlot;
+} SFTCoreSnapshotBuffer;
+
+/**
+ * Initialises the given buffer, every snapshot holding a blank screen.
+ *
+ * @param[out] buffer the buffer to initialise.
+ * @param[in] width screen width, in cells.
+ * @param[in] height screen height, in cells.
+ *
+ * @return true if the buffer was initialised, false otherwise.
+ */
+bool SFTCoreSnapshotBufferInitialise(SFTCoreSnapshotBuffer *buffer,
+                                     size_t width, size_t height);
+
+/**
+ * Releases everything held by the given buffer.
+ *
+ * @param[in,out] buffer the buffer to release.
+ */
+void SFTCoreSnapshotBufferRelease(SFTCoreSnapshotBuffer *buffer);
+
+/**
+ * Writer: publishes the screen as it stands, clearing the state's dirty
+ * rows.  Only rows changed since the snapshot being filled was last
+ * published are copied into it.  While scrolled back, the viewport is
+ * composed from the state's scrollback and the screen as well.
+ *
+ * @param[in,out] buffer the buffer to publish to.
+ * @param[in,out] state the emulator state, whose dirty rows are consumed.
+ * @param[in] cells the emulator's cell buffer.
+ *
+ * @return true if a snapshot was published, false if nothing changed since
+ * the previous one.
+ */
+bool SFTCoreSnapshotBufferPublish(SFTCoreSnapshotBuffer *buffer,
+                                  SFTCoreEmulatorState *state,
+                                  const SFTTerminalEmulatorCell *cells);
+
+/**
+ * Writer: scrolls the viewport so that the given history row is shown at
+ * the top, from the next publication on.  Lines past the newest history
+ * row go back to following the screen, lines older than the oldest row
+ * still held are clamped to it.
+ *
+ * @param[in,out] buffer the buffer to publish to.
+ * @param[in] line the history row to show at the top, numbered as
+ * SFTCoreSnapshot.viewportLine, or UINT64_MAX to follow the screen.
+ */
+void SFTCoreSnapshotBufferScrollViewportToLine(SFTCoreSnapshotBuffer *buffer,
+                                               uint64_t line);
+
+/**
+ * Writer: scrolls the viewport by the given amount of rows, from the next
+ * publication on.
+ *
+ * @param[in,out] buffer the buffer to publish to.
+ * @param[in] state the emulator state, with the scrollback attached.
+ * @param[in] rows rows to scroll by, negative values going towards older
+ * history rows.
+ */
+void SFTCoreSnapshotBufferScrollViewportByRows(
+    SFTCoreSnapshotBuffer *buffer, const SFTCoreEmulatorState *state,
+    int64_t rows);
+
+/**
+ * Reader: returns the most recently published snapshot, which stays
+ * untouched until the next call.
+ *
+ * Rows whose sequence number is greater than the one of the snapshot
+ * previously returned are the only ones that changed since.
+ *
+ * @param[in,out] buffer the buffer to read from.
+ *
+ * @return the latest snapshot.
+ */
+const SFTCoreSnapshot *
+SFTCoreSnapshotBufferAcquire(SFTCoreSnapshotBuffer *buffer);
+
+#endif /* SFTCoreSnapshot_h */
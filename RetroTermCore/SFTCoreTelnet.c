@@ -0,0 +1,338 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "SFTCoreTelnet.h"
+
+/**
+ * TTYPE subnegotiation codes (RFC 1091).
+ */
+#define SFTCoreTelnetTerminalTypeIs 0
+#define SFTCoreTelnetTerminalTypeSend 1
+
+/**
+ * Options the server may enable on its side.
+ */
+static const uint64_t kRemoteOptions =
+    (UINT64_C(1) << SFTCoreTelnetOptionBinary) |
+    (UINT64_C(1) << SFTCoreTelnetOptionEcho) |
+    (UINT64_C(1) << SFTCoreTelnetOptionSuppressGoAhead);
+
+/**
+ * Options the server may ask this side to enable.
+ */
+static const uint64_t kLocalOptions =
+    (UINT64_C(1) << SFTCoreTelnetOptionBinary) |
+    (UINT64_C(1) << SFTCoreTelnetOptionSuppressGoAhead) |
+    (UINT64_C(1) << SFTCoreTelnetOptionTerminalType) |
+    (UINT64_C(1) << SFTCoreTelnetOptionWindowSize);
+
+static bool SFTCoreTelnetOptionIn(uint64_t options, uint8_t option) {
+  return (option < 64) && ((options >> option) & 1);
+}
+
+static void SFTCoreTelnetReply(SFTCoreTelnet *telnet, const uint8_t *bytes,
+                               size_t length) {
+  // A server flooding negotiations without reading the replies gets the
+  // excess dropped, rather than memory growing without bounds.
+  if (length > SFTCoreTelnetRepliesCapacity - telnet->repliesLength) {
+    return;
+  }
+
+  memcpy(telnet->replies + telnet->repliesLength, bytes, length);
+  telnet->repliesLength += length;
+}
+
+static void SFTCoreTelnetReplyCommand(SFTCoreTelnet *telnet, uint8_t command,
+                                      uint8_t option) {
+  uint8_t reply[3] = {SFTCoreTelnetIAC, command, option};
+  SFTCoreTelnetReply(telnet, reply, sizeof(reply));
+}
+
+static size_t SFTCoreTelnetEscape(uint8_t *destination, uint8_t byte) {
+  destination[0] = byte;
+  if (byte != SFTCoreTelnetIAC) {
+    return 1;
+  }
+
+  destination[1] = SFTCoreTelnetIAC;
+  return 2;
+}
+
+static void SFTCoreTelnetReplyWindowSize(SFTCoreTelnet *telnet) {
+  uint8_t reply[3 + (4 * 2) + 2] = {SFTCoreTelnetIAC, SFTCoreTelnetSB,
+                                    SFTCoreTelnetOptionWindowSize};
+  size_t length = 3;
+  length += SFTCoreTelnetEscape(reply + length, (uint8_t)(telnet->width >> 8));
+  length += SFTCoreTelnetEscape(reply + length, (uint8_t)telnet->width);
+  length += SFTCoreTelnetEscape(reply + length, (uint8_t)(telnet->height >> 8));
+  length += SFTCoreTelnetEscape(reply + length, (uint8_t)telnet->height);
+  reply[length++] = SFTCoreTelnetIAC;
+  reply[length++] = SFTCoreTelnetSE;
+  SFTCoreTelnetReply(telnet, reply, length);
+}
+
+static void SFTCoreTelnetReplyTerminalType(SFTCoreTelnet *telnet) {
+  uint8_t reply[4 + SFTCoreTelnetTerminalTypeCapacity + 2] = {
+      SFTCoreTelnetIAC, SFTCoreTelnetSB, SFTCoreTelnetOptionTerminalType,
+      SFTCoreTelnetTerminalTypeIs};
+  size_t typeLength = strlen(telnet->terminalType);
+  memcpy(reply + 4, telnet->terminalType, typeLength);
+  reply[4 + typeLength] = SFTCoreTelnetIAC;
+  reply[5 + typeLength] = SFTCoreTelnetSE;
+  SFTCoreTelnetReply(telnet, reply, typeLength + 6);
+}
+
+/**
+ * Answers a negotiation, only replying when an option changes state so that
+ * both sides cannot end up acknowledging each other forever (RFC 1143).
+ */
+static void SFTCoreTelnetNegotiate(SFTCoreTelnet *telnet, uint8_t command,
+                                   uint8_t option) {
+  uint64_t bit = (option < 64) ? (UINT64_C(1) << option) : 0;
+
+  switch (command) {
+  case SFTCoreTelnetWILL:
+    if (!SFTCoreTelnetOptionIn(kRemoteOptions, option)) {
+      SFTCoreTelnetReplyCommand(telnet, SFTCoreTelnetDONT, option);
+    } else if (!(telnet->remoteOptions & bit)) {
+      telnet->remoteOptions |= bit;
+      SFTCoreTelnetReplyCommand(telnet, SFTCoreTelnetDO, option);
+    }
+    break;
+
+  case SFTCoreTelnetWONT:
+    if (telnet->remoteOptions & bit) {
+      telnet->remoteOptions &= ~bit;
+      SFTCoreTelnetReplyCommand(telnet, SFTCoreTelnetDONT, option);
+    }
+    break;
+
+  case SFTCoreTelnetDO:
+    if (!SFTCoreTelnetOptionIn(kLocalOptions, option)) {
+      SFTCoreTelnetReplyCommand(telnet, SFTCoreTelnetWONT, option);
+    } else if (!(telnet->localOptions & bit)) {
+      telnet->localOptions |= bit;
+      SFTCoreTelnetReplyCommand(telnet, SFTCoreTelnetWILL, option);
+      if (option == SFTCoreTelnetOptionWindowSize) {
+        SFTCoreTelnetReplyWindowSize(telnet);
+      }
+    }
+    break;
+
+  case SFTCoreTelnetDONT:
+    if (telnet->localOptions & bit) {
+      telnet->localOptions &= ~bit;
+      SFTCoreTelnetReplyCommand(telnet, SFTCoreTelnetWONT, option);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+static void SFTCoreTelnetSubnegotiate(SFTCoreTelnet *telnet) {
+  if ((telnet->subnegotiationLength >= 2) &&
+      (telnet->subnegotiation[0] == SFTCoreTelnetOptionTerminalType) &&
+      (telnet->subnegotiation[1] == SFTCoreTelnetTerminalTypeSend) &&
+      SFTCoreTelnetLocalOption(telnet, SFTCoreTelnetOptionTerminalType)) {
+    SFTCoreTelnetReplyTerminalType(telnet);
+  }
+}
+
+static void SFTCoreTelnetAppendSubnegotiation(SFTCoreTelnet *telnet,
+                                              uint8_t byte) {
+  if (telnet->subnegotiationLength < SFTCoreTelnetSubnegotiationCapacity) {
+    telnet->subnegotiation[telnet->subnegotiationLength++] = byte;
+  }
+}
+
+void SFTCoreTelnetInitialise(SFTCoreTelnet *telnet, uint16_t width,
+                             uint16_t height, const char *terminalType) {
+  memset(telnet, 0, sizeof(SFTCoreTelnet));
+  telnet->state = SFTCoreTelnetParserStateData;
+  telnet->width = width;
+  telnet->height = height;
+  strncpy(telnet->terminalType, terminalType,
+          SFTCoreTelnetTerminalTypeCapacity - 1);
+}
+
+size_t SFTCoreTelnetFilter(SFTCoreTelnet *telnet, uint8_t *bytes,
+                           size_t length) {
+  size_t input = 0;
+  size_t output = 0;
+
+  while (input < length) {
+    if (telnet->state == SFTCoreTelnetParserStateData) {
+      // Plain data runs up to the next IAC are only moved once a command
+      // was stripped ahead of them.
+      const uint8_t *command =
+          memchr(bytes + input, SFTCoreTelnetIAC, length - input);
+      size_t run = (command != NULL) ? (size_t)(command - (bytes + input))
+                                     : length - input;
+      if ((output != input) && (run > 0)) {
+        memmove(bytes + output, bytes + input, run);
+      }
+      output += run;
+      input += run;
+
+      if (command == NULL) {
+        break;
+      }
+
+      input++;
+      telnet->state = SFTCoreTelnetParserStateCommand;
+      continue;
+    }
+
+    uint8_t byte = bytes[input++];
+
+    switch (telnet->state) {
+    case SFTCoreTelnetParserStateCommand:
+      switch (byte) {
+      case SFTCoreTelnetIAC:
+        // Escaped data byte
+        bytes[output++] = SFTCoreTelnetIAC;
+        telnet->state = SFTCoreTelnetParserStateData;
+        break;
+
+      case SFTCoreTelnetWILL:
+      case SFTCoreTelnetWONT:
+      case SFTCoreTelnetDO:
+      case SFTCoreTelnetDONT:
+        telnet->command = byte;
+        telnet->state = SFTCoreTelnetParserStateOption;
+        break;
+
+      case SFTCoreTelnetSB:
+        telnet->subnegotiationLength = 0;
+        telnet->state = SFTCoreTelnetParserStateSubnegotiation;
+        break;
+
+      default:
+        // NOP, GA, and the other single byte commands have no meaning here.
+        telnet->commands++;
+        telnet->state = SFTCoreTelnetParserStateData;
+        break;
+      }
+      break;
+
+    case SFTCoreTelnetParserStateOption:
+      SFTCoreTelnetNegotiate(telnet, telnet->command, byte);
+      telnet->commands++;
+      telnet->state = SFTCoreTelnetParserStateData;
+      break;
+
+    case SFTCoreTelnetParserStateSubnegotiation:
+      if (byte == SFTCoreTelnetIAC) {
+        telnet->state = SFTCoreTelnetParserStateSubnegotiationCommand;
+      } else {
+        SFTCoreTelnetAppendSubnegotiation(telnet, byte);
+      }
+      break;
+
+    case SFTCoreTelnetParserStateSubnegotiationCommand:
+      if (byte == SFTCoreTelnetIAC) {
+        SFTCoreTelnetAppendSubnegotiation(telnet, byte);
+        telnet->state = SFTCoreTelnetParserStateSubnegotiation;
+        break;
+      }
+
+      if (byte == SFTCoreTelnetSE) {
+        SFTCoreTelnetSubnegotiate(telnet);
+        telnet->commands++;
+        telnet->state = SFTCoreTelnetParserStateData;
+        break;
+      }
+
+      // An unterminated subnegotiation, the command is handled as if the
+      // subnegotiation was never there.
+      input--;
+      telnet->state = SFTCoreTelnetParserStateCommand;
+      break;
+
+    case SFTCoreTelnetParserStateData:
+      break;
+    }
+  }
+
+  return output;
+}
+
+void SFTCoreTelnetConsumeReplies(SFTCoreTelnet *telnet, size_t length) {
+  if (length >= telnet->repliesLength) {
+    telnet->repliesLength = 0;
+    return;
+  }
+
+  memmove(telnet->replies, telnet->replies + length,
+          telnet->repliesLength - length);
+  telnet->repliesLength -= length;
+}
+
+// A span holding IAC bytes is dropped, and injected again escaped.
+static size_t SFTCoreTelnetEscapeOutbound(SFTCorePipeline *pipeline,
+                                          size_t stage, const uint8_t *bytes,
+                                          size_t length) {
+  if ((length > SFTCoreTelnetOutboundSpanCapacity) ||
+      (memchr(bytes, SFTCoreTelnetIAC, length) == NULL)) {
+    return length;
+  }
+
+  uint8_t escaped[SFTCorePipelineInjectionCapacity];
+  size_t escapedLength = 0;
+  for (size_t index = 0; index < length; index++) {
+    escapedLength += SFTCoreTelnetEscape(escaped + escapedLength, bytes[index]);
+  }
+
+  // Sending the span unescaped beats losing it, should there be no room.
+  if (!SFTCorePipelineInject(pipeline, stage, SFTCorePipelineDirectionOutbound,
+                             escaped, escapedLength)) {
+    return length;
+  }
+
+  return 0;
+}
+
+size_t SFTCoreTelnetProcess(SFTCorePipeline *pipeline, size_t stage,
+                            SFTCorePipelineDirection direction,
+                            uint8_t *bytes, size_t length) {
+  SFTCoreTelnet *telnet =
+      (SFTCoreTelnet *)SFTCorePipelineContext(pipeline, stage);
+
+  if (direction == SFTCorePipelineDirectionInbound) {
+    length = SFTCoreTelnetFilter(telnet, bytes, length);
+  } else if (telnet->commands > 0) {
+    length = SFTCoreTelnetEscapeOutbound(pipeline, stage, bytes, length);
+  }
+
+  // Replies that found no room are retried whenever bytes go through.
+  if ((telnet->repliesLength > 0) &&
+      SFTCorePipelineInject(pipeline, stage, SFTCorePipelineDirectionOutbound,
+                            telnet->replies, telnet->repliesLength)) {
+    SFTCoreTelnetConsumeReplies(telnet, telnet->repliesLength);
+  }
+
+  return length;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreTelnet_h
+#define SFTCoreTelnet_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SFTCorePipeline.h"
+
+/**
+ * Telnet commands the filter knows about (RFC 854).
+ */
+#define SFTCoreTelnetSE 240
+#define SFTCoreTelnetSB 250
+#define SFTCoreTelnetWILL 251
+#define SFTCoreTelnetWONT 252
+#define SFTCoreTelnetDO 253
+#define SFTCoreTelnetDONT 254
+#define SFTCoreTelnetIAC 255
+
+/**
+ * Telnet options the filter negotiates.
+ */
+#define SFTCoreTelnetOptionBinary 0
+#define SFTCoreTelnetOptionEcho 1
+#define SFTCoreTelnetOptionSuppressGoAhead 3
+#define SFTCoreTelnetOptionTerminalType 24
+#define SFTCoreTelnetOptionWindowSize 31
+
+/**
+ * Longest subnegotiation kept, anything past it is dropped.
+ */
+#define SFTCoreTelnetSubnegotiationCapacity 64
+
+/**
+ * Room for replies not yet sent, enough for a whole negotiation round.
+ */
+#define SFTCoreTelnetRepliesCapacity 512
+
+/**
+ * Longest outgoing span the stage is handed at once, so that it still fits
+ * the injection buffer with every byte escaped.
+ */
+#define SFTCoreTelnetOutboundSpanCapacity (SFTCorePipelineInjectionCapacity / 2)
+
+/**
+ * Longest terminal type reported, terminator included.
+ */
+#define SFTCoreTelnetTerminalTypeCapacity 41
+
+typedef enum {
+  SFTCoreTelnetParserStateData = 0,
+  SFTCoreTelnetParserStateCommand,
+  SFTCoreTelnetParserStateOption,
+  SFTCoreTelnetParserStateSubnegotiation,
+  SFTCoreTelnetParserStateSubnegotiationCommand
+} SFTCoreTelnetParserState;
+
+/**
+ * Telnet protocol filter sitting between the socket and the emulator.
+ *
+ * Incoming data is filtered in place, stripping negotiations and answering
+ * them, with the parser state carried over between reads so sequences can
+ * be split anywhere.  The filter never starts a negotiation by itself, so
+ * servers that do not speak Telnet only see replies to bytes they sent.
+ */
+typedef struct {
+  SFTCoreTelnetParserState state;
+
+  /**
+   * The negotiation command whose option byte is expected next.
+   */
+  uint8_t command;
+
+  uint8_t subnegotiation[SFTCoreTelnetSubnegotiationCapacity];
+  size_t subnegotiationLength;
+
+  /**
+   * Options enabled on this side and on the server's side, one bit per
+   * option number.  Every option the filter accepts is below 64.
+   */
+  uint64_t localOptions;
+  uint64_t remoteOptions;
+
+  /**
+   * Window size reported to the server, in cells.
+   */
+  uint16_t width;
+  uint16_t height;
+
+  char terminalType[SFTCoreTelnetTerminalTypeCapacity];
+
+  /**
+   * Replies waiting to be sent to the server.
+   */
+  uint8_t replies[SFTCoreTelnetRepliesCapacity];
+  size_t repliesLength;
+
+  /**
+   * Commands stripped from the incoming data so far.
+   */
+  uint64_t commands;
+} SFTCoreTelnet;
+
+/**
+ * Initialises the given filter.
+ *
+ * @param[out] telnet the filter to initialise.
+ * @param[in] width the window width reported to the server, in cells.
+ * @param[in] height the window height reported to the server, in cells.
+ * @param[in] terminalType the terminal type reported to the server,
+ * truncated if needed.
+ */
+void SFTCoreTelnetInitialise(SFTCoreTelnet *telnet, uint16_t width,
+                             uint16_t height, const char *terminalType);
+
+/**
+ * Strips Telnet commands from incoming data, queueing replies as needed.
+ *
+ * Data is compacted in place only past the first command found, plain data
+ * runs are left untouched.
+ *
+ * @param[in,out] telnet the filter to use.
+ * @param[in,out] bytes the incoming data, replaced by its filtered version.
+ * @param[in] length the incoming data length, in bytes.
+ *
+ * @return the filtered data length, in bytes.
+ */
+size_t SFTCoreTelnetFilter(SFTCoreTelnet *telnet, uint8_t *bytes,
+                           size_t length);
+
+/**
+ * Forgets the given amount of replies, once they were sent.
+ *
+ * @param[in,out] telnet the filter to update.
+ * @param[in] length the amount of bytes sent from the front of the replies.
+ */
+void SFTCoreTelnetConsumeReplies(SFTCoreTelnet *telnet, size_t length);
+
+/**
+ * Pipeline stage running incoming bytes through a filter, whose replies are
+ * injected towards the transport.
+ *
+ * Once the server sent a Telnet command, outgoing IAC bytes are doubled:
+ * a span holding any is dropped and injected again escaped, so that stages
+ * closer to the transport still see the bytes in order.  Outgoing spans must
+ * then be at most SFTCoreTelnetOutboundSpanCapacity bytes long, and only be
+ * run while no outbound injected bytes are waiting.  Until then, outgoing
+ * bytes are passed through as they are.
+ *
+ * The stage's context must point to an initialised SFTCoreTelnet.
+ */
+size_t SFTCoreTelnetProcess(SFTCorePipeline *pipeline, size_t stage,
+                            SFTCorePipelineDirection direction,
+                            uint8_t *bytes, size_t length);
+
+/**
+ * Returns whether the given option is enabled on this side.
+ *
+ * @param[in] telnet the filter to query.
+ * @param[in] option the option number.
+ *
+ * @return true if the option is enabled, false otherwise.
+ */
+static inline bool SFTCoreTelnetLocalOption(const SFTCoreTelnet *telnet,
+                                            uint8_t option) {
+  return (option < 64) && ((telnet->localOptions >> option) & 1);
+}
+
+/**
+ * Returns whether the given option is enabled on the server's side.
+ *
+ * @param[in] telnet the filter to query.
+ * @param[in] option the option number.
+ *
+ * @return true if the option is enabled, false otherwise.
+ */
+static inline bool SFTCoreTelnetRemoteOption(const SFTCoreTelnet *telnet,
+                                             uint8_t option) {
+  return (option < 64) && ((telnet->remoteOptions >> option) & 1);
+}
+
+#endif /* SFTCoreTelnet_h */
@@ -0,0 +1,277 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "SFTCoreCapture.h"
+#include "SFTCoreEmulator.h"
+#include "SFTCorePNG.h"
+#include "SFTCoreReplay.h"
+#include "SFTCoreThumbnail.h"
+
+/**
+ * Worker threads past which a batch stops spawning more.
+ */
+#define SFTCoreThumbnailMaximumWorkers 64
+
+/**
+ * Buffers owned by a worker, reused for every job of the same screen size.
+ */
+typedef struct {
+  SFTCoreRenderer renderer;
+  SFTTerminalEmulatorCell *cells;
+  uint32_t *scaled;
+  size_t scaledCapacity;
+} SFTCoreThumbnailWorker;
+
+/**
+ * Jobs shared by the workers of a batch.
+ */
+typedef struct {
+  SFTCoreThumbnailJob *jobs;
+  size_t count;
+  atomic_size_t next;
+  atomic_size_t rendered;
+} SFTCoreThumbnailBatch;
+
+static void SFTCoreThumbnailWorkerRelease(SFTCoreThumbnailWorker *worker) {
+  SFTCoreRendererRelease(&worker->renderer);
+  free(worker->cells);
+  free(worker->scaled);
+  memset(worker, 0, sizeof(SFTCoreThumbnailWorker));
+}
+
+static bool SFTCoreThumbnailWorkerPrepare(SFTCoreThumbnailWorker *worker,
+                                          size_t width, size_t height) {
+  if ((worker->renderer.width == width) &&
+      (worker->renderer.height == height)) {
+    SFTCoreRendererInvalidate(&worker->renderer);
+    return true;
+  }
+
+  SFTCoreThumbnailWorkerRelease(worker);
+  worker->cells = (SFTTerminalEmulatorCell *)malloc(
+      width * height * sizeof(SFTTerminalEmulatorCell));
+  if ((worker->cells == NULL) ||
+      !SFTCoreRendererInitialise(&worker->renderer, width, height)) {
+    SFTCoreThumbnailWorkerRelease(worker);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Rebuilds the screen at the end of the given capture into the worker's cell
+ * buffer.
+ */
+static bool SFTCoreThumbnailReplay(const SFTCoreThumbnailJob *job,
+                                   SFTCoreThumbnailWorker *worker,
+                                   SFTCoreEmulatorState *state) {
+  if (!SFTCoreEmulatorStateInitialise(state, job->width, job->height,
+                                      job->background, job->foreground,
+                                      job->asciiMode, false)) {
+    return false;
+  }
+  SFTCoreEmulatorClearScreen(state, worker->cells);
+
+  // Timestamped captures rebuild the screen from their last checkpoint.
+  SFTCoreCaptureReader reader;
+  if (SFTCoreCaptureReaderOpen(&reader, job->path)) {
+    bool rebuilt = SFTCoreCaptureReaderSeek(&reader, state, worker->cells,
+                                            reader.inboundLength);
+    SFTCoreCaptureReaderClose(&reader);
+    return rebuilt;
+  }
+
+  SFTCoreReplay replay;
+  if (!SFTCoreReplayOpen(&replay, job->path)) {
+    return false;
+  }
+  SFTCoreEmulatorProcessIncomingData(state, worker->cells, replay.bytes,
+                                     replay.length);
+  SFTCoreReplayClose(&replay);
+  return true;
+}
+
+/**
+ * Scales the worker's framebuffer down, each thumbnail pixel averaging the
+ * framebuffer pixels it covers.
+ */
+static void SFTCoreThumbnailScale(const SFTCoreThumbnailWorker *worker,
+                                  size_t width, size_t height) {
+  const uint32_t *pixels = worker->renderer.pixels;
+  size_t stride = SFTCoreRendererStride(&worker->renderer);
+  size_t sourceHeight = worker->renderer.height * SFTCoreRendererCellSize;
+
+  for (size_t y = 0; y < height; y++) {
+    size_t top = (y * sourceHeight) / height;
+    size_t bottom = ((y + 1) * sourceHeight) / height;
+    bottom = bottom > top ? bottom : top + 1;
+
+    for (size_t x = 0; x < width; x++) {
+      size_t left = (x * stride) / width;
+      size_t right = ((x + 1) * stride) / width;
+      right = right > left ? right : left + 1;
+
+      uint32_t sums[4] = {0, 0, 0, 0};
+      for (size_t row = top; row < bottom; row++) {
+        const uint8_t *source = (const uint8_t *)(pixels + (row * stride));
+        for (size_t column = left; column < right; column++) {
+          for (size_t channel = 0; channel < 4; channel++) {
+            sums[channel] += source[(column * 4) + channel];
+          }
+        }
+      }
+
+      uint32_t area = (uint32_t)((bottom - top) * (right - left));
+      uint8_t average[4];
+      for (size_t channel = 0; channel < 4; channel++) {
+        average[channel] = (uint8_t)((sums[channel] + (area / 2)) / area);
+      }
+      memcpy(&worker->scaled[(y * width) + x], average, sizeof(uint32_t));
+    }
+  }
+}
+
+static bool SFTCoreThumbnailRenderWith(SFTCoreThumbnailJob *job,
+                                       SFTCoreThumbnailWorker *worker) {
+  job->png = NULL;
+  job->pngLength = 0;
+
+  if ((job->scale <= 0.0f) ||
+      !SFTCoreThumbnailWorkerPrepare(worker, job->width, job->height)) {
+    return false;
+  }
+
+  SFTCoreRendererContext context = job->context;
+  const SFTTerminalEmulatorCell *cells = job->cells;
+  size_t baseRow = job->baseRow;
+  if (job->path != NULL) {
+    SFTCoreEmulatorState state;
+    if (!SFTCoreThumbnailReplay(job, worker, &state)) {
+      return false;
+    }
+    cells = worker->cells;
+    baseRow = state.baseRow;
+    context.cursorRow = (uint32_t)state.row;
+    context.cursorColumn = (uint32_t)state.column;
+  } else if (cells == NULL) {
+    return false;
+  }
+
+  SFTCoreRendererDraw(&worker->renderer, cells, baseRow, &context);
+
+  size_t sourceWidth = SFTCoreRendererStride(&worker->renderer);
+  size_t sourceHeight = worker->renderer.height * SFTCoreRendererCellSize;
+  size_t width = (size_t)(((float)sourceWidth * job->scale) + 0.5f);
+  size_t height = (size_t)(((float)sourceHeight * job->scale) + 0.5f);
+  width = width > 0 ? width : 1;
+  height = height > 0 ? height : 1;
+
+  if ((width == sourceWidth) && (height == sourceHeight)) {
+    return SFTCorePNGEncode(worker->renderer.pixels, width, height,
+                            sourceWidth, &job->png, &job->pngLength);
+  }
+
+  if (worker->scaledCapacity < width * height) {
+    uint32_t *scaled = (uint32_t *)realloc(worker->scaled,
+                                           width * height * sizeof(uint32_t));
+    if (scaled == NULL) {
+      return false;
+    }
+    worker->scaled = scaled;
+    worker->scaledCapacity = width * height;
+  }
+
+  SFTCoreThumbnailScale(worker, width, height);
+  return SFTCorePNGEncode(worker->scaled, width, height, width, &job->png,
+                          &job->pngLength);
+}
+
+bool SFTCoreThumbnailRender(SFTCoreThumbnailJob *job) {
+  SFTCoreThumbnailWorker worker;
+  memset(&worker, 0, sizeof(SFTCoreThumbnailWorker));
+  bool rendered = SFTCoreThumbnailRenderWith(job, &worker);
+  SFTCoreThumbnailWorkerRelease(&worker);
+  return rendered;
+}
+
+static void *SFTCoreThumbnailWorkerThread(void *argument) {
+  SFTCoreThumbnailBatch *batch = (SFTCoreThumbnailBatch *)argument;
+  SFTCoreThumbnailWorker worker;
+  memset(&worker, 0, sizeof(SFTCoreThumbnailWorker));
+
+  for (;;) {
+    size_t index = atomic_fetch_add(&batch->next, 1);
+    if (index >= batch->count) {
+      break;
+    }
+
+    if (SFTCoreThumbnailRenderWith(&batch->jobs[index], &worker)) {
+      atomic_fetch_add(&batch->rendered, 1);
+    }
+  }
+
+  SFTCoreThumbnailWorkerRelease(&worker);
+  return NULL;
+}
+
+size_t SFTCoreThumbnailRenderBatch(SFTCoreThumbnailJob *jobs, size_t count,
+                                   size_t workers) {
+  if (workers == 0) {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    workers = processors > 0 ? (size_t)processors : 1;
+  }
+  if (workers > count) {
+    workers = count;
+  }
+  if (workers > SFTCoreThumbnailMaximumWorkers) {
+    workers = SFTCoreThumbnailMaximumWorkers;
+  }
+
+  SFTCoreThumbnailBatch batch = {.jobs = jobs, .count = count};
+  atomic_init(&batch.next, 0);
+  atomic_init(&batch.rendered, 0);
+
+  // Threads that cannot be started leave their share to the others.
+  pthread_t threads[SFTCoreThumbnailMaximumWorkers];
+  size_t started = 0;
+  while (started + 1 < workers) {
+    if (pthread_create(&threads[started], NULL, SFTCoreThumbnailWorkerThread,
+                       &batch) != 0) {
+      break;
+    }
+    started++;
+  }
+
+  SFTCoreThumbnailWorkerThread(&batch);
+  for (size_t index = 0; index < started; index++) {
+    pthread_join(threads[index], NULL);
+  }
+
+  return atomic_load(&batch.rendered);
+}
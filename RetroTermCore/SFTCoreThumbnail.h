@@ -0,0 +1,111 @@
+/*
+ * Copyright 2017-2018 Alessandro Gatti - frob.it
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SFTCoreThumbnail_h
+#define SFTCoreThumbnail_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "SFTCoreCell.h"
+#include "SFTCoreRenderer.h"
+
+/**
+ * A screen to turn into a PNG thumbnail, either given as a cell buffer or
+ * taken from the end of a session capture.
+ */
+typedef struct {
+  /**
+   * Capture to take the screen from once every byte in it went through the
+   * emulator, or NULL to use cells.  Both timestamped and raw captures are
+   * accepted.
+   */
+  const char *path;
+
+  /**
+   * Cell buffer to draw when there is no capture, a ring of rows starting at
+   * baseRow.
+   */
+  const SFTTerminalEmulatorCell *cells;
+  size_t baseRow;
+
+  /**
+   * Screen size, in cells.
+   */
+  size_t width;
+  size_t height;
+
+  /**
+   * Emulator state raw captures start from.
+   */
+  uint8_t background;
+  uint8_t foreground;
+  bool asciiMode;
+
+  /**
+   * Selection, cursor and charset state to draw with.  The cursor position
+   * is replaced by the emulator's one for captures.
+   */
+  SFTCoreRendererContext context;
+
+  /**
+   * Thumbnail size relative to the screen drawn at one pixel per glyph
+   * texel; smaller thumbnails average the pixels they cover.
+   */
+  float scale;
+
+  /**
+   * Encoded thumbnail, to be released with free(), or NULL if the job
+   * failed.
+   */
+  uint8_t *png;
+  size_t pngLength;
+} SFTCoreThumbnailJob;
+
+/**
+ * Renders a single thumbnail on the calling thread.
+ *
+ * @param[in,out] job the job to run, receiving the encoded thumbnail.
+ *
+ * @return true if the thumbnail was rendered, false otherwise.
+ */
+bool SFTCoreThumbnailRender(SFTCoreThumbnailJob *job);
+
+/**
+ * Renders thumbnails on a pool of worker threads, the calling thread being
+ * one of them, and waits for all of them to be done.
+ *
+ * Jobs are handed out one at a time as workers become idle, and every
+ * worker keeps its framebuffer and screen across jobs of the same size.
+ *
+ * @param[in,out] jobs the jobs to run, each receiving its thumbnail.
+ * @param[in] count the amount of jobs.
+ * @param[in] workers the amount of worker threads to use, or 0 to use one
+ * per online processor.
+ *
+ * @return the amount of thumbnails rendered.
+ */
+size_t SFTCoreThumbnailRenderBatch(SFTCoreThumbnailJob *jobs, size_t count,
+                                   size_t workers);
+
+#endif /* SFTCoreThumbnail_h */